@@ -0,0 +1,183 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glsl.hpp"
+#include "layout.hpp"
+#include "ModuleCache.hpp"
+#include "nodes.hpp"
+#include "passes.hpp"
+#include "ThreadPool.hpp"
+#include "Writer.hpp"
+
+namespace rsl
+{
+    struct CompileJob
+    {
+        std::string fileName = "<unknown>";
+        // When empty the file at fileName is read through the compiler's module cache
+        std::string source{};
+        EScopeType scopeType = EScopeType::Fragment;
+        std::unordered_map<std::string, std::string> defines{};
+    };
+
+    struct CompileResult
+    {
+        bool success = false;
+        bool cancelled = false;
+        std::string output{};
+        // Size of the generated source, including when it was written to a caller supplied Writer instead of output
+        size_t outputSize = 0;
+        std::string error{};
+        // Absolute paths of every file pulled in through #include
+        std::set<std::string> dependencies{};
+        // Time spent tokenizing, parsing and resolving the source. Shared by every job compiled from it.
+        std::chrono::microseconds parseTime{};
+        std::chrono::microseconds generateTime{};
+        // Layouts of the stage's blocks and push constants when CompilerOptions::reflect is set, or of every stage's
+        // for host output
+        Reflection reflection{};
+        // Sizes of the stage's blocks and push constants before and after CompilerOptions::reorderMembers
+        std::vector<MemberReorder> reorderedMembers{};
+    };
+
+    enum class ECompileTarget
+    {
+        // GLSL source text
+        Glsl,
+        // A validated SPIR-V module, stored as its raw little endian words
+        Spirv,
+        // A C++ header with the structs, constants and functions of the module, for running them on the CPU. The
+        // stage of the job is ignored.
+        Cpp,
+        // A C++ header mirroring the blocks and push constants of every stage, for filling them on the host. The
+        // stage of the job is ignored.
+        Host
+    };
+
+    struct CompilerOptions
+    {
+        ECompileTarget target = ECompileTarget::Glsl;
+        // Generate top level functions and structs of each stage in parallel on the compiler's pool
+        bool parallelGenerate = false;
+        // Reuse the generated text of functions and structs that were already generated by an earlier compile
+        bool cacheGenerated = false;
+        // Emit compact GLSL: no optional whitespace, shortened private identifiers and no redundant parentheses
+        bool minify = false;
+        // Invocations per call in C++ output, 1 for scalar code or 4 and 8 for SSE and AVX lanes
+        int cpuLanes = 1;
+        // Fill CompileResult::reflection. Ignored for C++ output.
+        bool reflect = false;
+        // Reorder struct, block and push constant members to minimize padding. Changes the layout the host uploads, so
+        // it should be read from the reflection. Ignored for C++ output.
+        bool reorderMembers = false;
+        // Run the optimization passes before generating: inlining, constant folding and propagation, loop unrolling,
+        // algebraic simplification, linking against the other stage and packing the varyings between them, common
+        // subexpression elimination, then removal of dead stores and of the declarations main does not use. Ignored
+        // for C++ output.
+        bool optimize = false;
+        // Which calls the optimization passes inline
+        InlineOptions inlining{};
+        // Which loops the optimization passes unroll
+        UnrollOptions unrolling{};
+    };
+
+    // Applies job defines to an extracted scope, replacing any #define with the same id
+    void applyDefines(const std::shared_ptr<ModuleNode>& node, const std::unordered_map<std::string, std::string>& defines);
+
+    enum class ECompilePhase
+    {
+        Tokenized,
+        Parsed,
+        Generated
+    };
+
+    // Called from the worker thread running the compile as each phase completes
+    using CompilePhaseCallback = std::function<void(ECompilePhase)>;
+
+    class CompileHandle
+    {
+        std::shared_ptr<std::atomic<bool>> _cancelled{};
+        std::shared_future<CompileResult> _future{};
+
+    public:
+        CompileHandle() = default;
+        CompileHandle(const std::shared_ptr<std::atomic<bool>>& inCancelled,
+                      const std::shared_future<CompileResult>& inFuture);
+
+        // Requests cancellation. The compile stops at the next phase or top level declaration boundary.
+        void Cancel() const;
+        [[nodiscard]] bool IsCancelled() const;
+        [[nodiscard]] bool IsReady() const;
+        [[nodiscard]] bool IsValid() const;
+
+        // Blocks until the compile finishes or observes cancellation
+        const CompileResult& Get() const;
+        [[nodiscard]] const std::shared_future<CompileResult>& GetFuture() const;
+    };
+
+    class Compiler
+    {
+        ThreadPool _pool;
+        ModuleCache _moduleCache{};
+        glsl::GenerateCache _generateCache{};
+        CompilerOptions _options{};
+
+        glsl::GenerateOptions MakeGenerateOptions();
+
+        // Passes that change which inputs and outputs a stage reads and writes, run on a stage and on the copy of the
+        // other stage it links against alike
+        void OptimizeForLink(const std::shared_ptr<ModuleNode>& stage) const;
+
+        // Extracts the stage of ast with the defines of job applied and runs the passes enabled in the options on it,
+        // cloning it first if any pass will modify it. Optimizing also extracts the other stage to link against.
+        std::shared_ptr<ModuleNode> ExtractStage(const std::shared_ptr<ModuleNode>& ast, const CompileJob& job,
+                                                 EScopeType scopeType, CompileResult& result) const;
+
+        // Generates a host header from the reflection of every stage, after the same passes as GLSL output
+        void GenerateHost(Writer& out, const std::shared_ptr<ModuleNode>& ast, const CompileJob& job,
+                          CompileResult& result) const;
+
+        std::shared_ptr<ModuleNode> ParseRoot(const CompileJob& job, std::set<std::string>& dependencies,
+                                              const std::atomic<bool>* cancelled = nullptr,
+                                              const CompilePhaseCallback& onPhase = {});
+        CompileResult CompileCancellable(const CompileJob& job, const std::atomic<bool>& cancelled,
+                                         const CompilePhaseCallback& onPhase, Writer& out);
+
+    public:
+        explicit Compiler(size_t numThreads = 0, const CompilerOptions& options = {});
+
+        // Compiles a single job on the calling thread. Includes are read through the module cache.
+        CompileResult Compile(const CompileJob& job);
+
+        // Compiles a single job on the calling thread, emitting straight into out instead of CompileResult::output.
+        // out is flushed before returning. With a sink, chunks already delivered are not retracted if compilation
+        // fails part way through.
+        CompileResult Compile(const CompileJob& job, Writer& out);
+
+        // Compiles every job on the pool. Jobs that share a file name and source are parsed once and every
+        // scope is extracted from that module. Results are returned in submission order.
+        std::vector<CompileResult> CompileBatch(const std::vector<CompileJob>& jobs);
+
+        // Compiles job once for every stage, sharing a single parse of the source. Stages are generated concurrently.
+        std::vector<CompileResult> CompileStages(const CompileJob& job, const std::vector<EScopeType>& stages);
+
+        // Compiles a single job on the pool without blocking the caller
+        CompileHandle CompileAsync(const CompileJob& job, const CompilePhaseCallback& onPhase = {});
+
+        ThreadPool& GetPool();
+        ModuleCache& GetModuleCache();
+        glsl::GenerateCache& GetGenerateCache();
+
+        // Not safe to call while compiles are running
+        void SetOptions(const CompilerOptions& options);
+        [[nodiscard]] const CompilerOptions& GetOptions() const;
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nodes.hpp"
+#include "Writer.hpp"
+
+namespace rsl::glsl
+{
+    // Generated text of top level functions and structs keyed by their structural hash combined with the generator
+    // options that affect output. Each entry keeps a copy of its node, and a lookup only hits when the node matches
+    // it structurally, so colliding hashes never return the text of another node. Shared by every stage and compile,
+    // so helpers included by many shaders are only emitted once. Once the cached text would grow past the capacity
+    // every entry is dropped and the cache fills up again from the nodes still in use. Safe to use from multiple
+    // threads.
+    class GenerateCache
+    {
+        struct Entry
+        {
+            std::shared_ptr<Node> node{};
+            std::string text{};
+        };
+
+        std::shared_mutex _mutex{};
+        std::unordered_map<size_t, std::vector<Entry>> _entries{};
+        size_t _capacity;
+        size_t _size = 0;
+        size_t _textSize = 0;
+        std::atomic<uint64_t> _hits = 0;
+        std::atomic<uint64_t> _misses = 0;
+        std::atomic<uint64_t> _clears = 0;
+
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+        // Capacity is the most bytes of generated text kept at once
+        explicit GenerateCache(size_t inCapacity = DEFAULT_CAPACITY);
+
+        // Appends the cached text for node under key to out, returns false and counts a miss if there is none
+        bool Write(size_t key, const Node& node, Writer& out);
+        // Caches text for a copy of node, unless an equal node is already cached under key
+        void Insert(size_t key, const std::shared_ptr<Node>& node, std::string text);
+
+        void Clear();
+
+        // Number of cached nodes
+        [[nodiscard]] size_t GetSize();
+        [[nodiscard]] size_t GetCapacity();
+        void SetCapacity(size_t capacity);
+        [[nodiscard]] uint64_t GetHits() const;
+        [[nodiscard]] uint64_t GetMisses() const;
+        // Times the cache was emptied because it was full
+        [[nodiscard]] uint64_t GetClears() const;
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "nodes.hpp"
+
+namespace rsl
+{
+    // Keeps parsed files in memory and re-parses them when their modification time or size changes. Callers
+    // always receive their own copy of the tree so cached modules are never mutated.
+    class ModuleCache
+    {
+        struct Entry
+        {
+            std::filesystem::file_time_type lastWriteTime{};
+            uintmax_t fileSize = 0;
+            std::shared_ptr<ModuleNode> module{};
+        };
+
+        std::mutex _mutex{};
+        std::unordered_map<std::string, Entry> _entries{};
+        std::atomic<uint64_t> _hits = 0;
+        std::atomic<uint64_t> _misses = 0;
+
+    public:
+        // Returns a copy of the parsed module at filePath, parsing it if it is not cached or is out of date
+        std::shared_ptr<ModuleNode> Get(const std::string& filePath);
+
+        void Invalidate(const std::string& filePath);
+        void Clear();
+
+        [[nodiscard]] size_t GetSize();
+        [[nodiscard]] uint64_t GetHits() const;
+        [[nodiscard]] uint64_t GetMisses() const;
+    };
+}
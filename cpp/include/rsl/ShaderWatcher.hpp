@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Compiler.hpp"
+
+namespace rsl
+{
+    struct ShaderReloadEvent
+    {
+        std::string rootFile{};
+        EScopeType scopeType = EScopeType::Fragment;
+        CompileResult result{};
+    };
+
+    // Called from the watcher thread for every stage whose output changed or failed to compile
+    using ShaderReloadCallback = std::function<void(const ShaderReloadEvent&)>;
+
+    // Watches the resolved include graph of every registered root and recompiles only the roots that depend on a
+    // changed file. Bursts of changes are debounced and untouched includes come from the compiler's module cache.
+    // Uses inotify on Linux and polls modification times elsewhere.
+    class ShaderWatcher
+    {
+        struct WatchedRoot
+        {
+            std::vector<EScopeType> stages{};
+            std::unordered_map<std::string, std::string> defines{};
+            std::set<std::string> files{};
+            std::map<EScopeType, std::string> outputs{};
+            // Changes on every Watch, so a compile that finishes after the root was watched again or unwatched is
+            // dropped
+            uint64_t generation = 0;
+        };
+
+        Compiler& _compiler;
+        ShaderReloadCallback _onReload;
+        std::chrono::milliseconds _debounce;
+
+        std::mutex _mutex{};
+        std::map<std::string, WatchedRoot> _roots{};
+        std::map<std::string, std::filesystem::file_time_type> _fileTimes{};
+        std::set<std::string> _pendingFiles{};
+        std::chrono::steady_clock::time_point _lastChange{};
+        uint64_t _nextGeneration = 0;
+
+        int _notifyFd = -1;
+        std::unordered_map<int, std::string> _watchDirectories{};
+        std::unordered_map<std::string, int> _directoryWatches{};
+
+        std::atomic<bool> _stopping = false;
+        std::thread _thread{};
+
+        // Compiles without holding _mutex, so Watch and Unwatch are not blocked by a compile
+        std::vector<CompileResult> CompileRoot(const std::string& rootFile, const WatchedRoot& root);
+        void UpdateWatches();
+        void CollectChanges();
+        void FlushChanges();
+        void Run();
+
+    public:
+        ShaderWatcher(Compiler& compiler, const ShaderReloadCallback& onReload,
+                      std::chrono::milliseconds debounce = std::chrono::milliseconds(50));
+        ~ShaderWatcher();
+
+        ShaderWatcher(const ShaderWatcher&) = delete;
+        ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+        // Compiles every stage of rootFile, starts watching its include graph and returns the initial results
+        std::vector<CompileResult> Watch(const std::string& rootFile, const std::vector<EScopeType>& stages,
+                                         const std::unordered_map<std::string, std::string>& defines = {});
+
+        void Unwatch(const std::string& rootFile);
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsl
+{
+    // Fixed size pool where every worker owns a task deque. Workers pop their own work LIFO and steal FIFO from
+    // the other workers when they run dry.
+    class ThreadPool
+    {
+        struct WorkerQueue
+        {
+            std::mutex mutex{};
+            std::deque<std::function<void()>> tasks{};
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> _queues{};
+        std::vector<std::thread> _threads{};
+        std::mutex _wakeMutex{};
+        std::condition_variable _wake{};
+        std::atomic<size_t> _pending = 0;
+        std::atomic<size_t> _nextQueue = 0;
+        bool _stopping = false;
+
+        bool TryPop(size_t queueIndex, std::function<void()>& task);
+        bool TrySteal(size_t thiefIndex, std::function<void()>& task);
+        void RunWorker(size_t index);
+
+    public:
+        explicit ThreadPool(size_t numThreads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void Enqueue(std::function<void()> task);
+
+        // Runs one queued task on the calling thread, returns false if there was nothing to run
+        bool RunPendingTask();
+
+        // Calls fn for every index in [0,count). The calling thread takes part so this is safe to use from
+        // inside a task.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+        template <typename F>
+        auto Submit(F&& fn) -> std::future<std::invoke_result_t<F>>;
+
+        [[nodiscard]] size_t GetThreadCount() const;
+    };
+
+    template <typename F>
+    auto ThreadPool::Submit(F&& fn) -> std::future<std::invoke_result_t<F>>
+    {
+        using ResultType = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(fn));
+        auto future = task->get_future();
+        Enqueue([task]
+        {
+            (*task)();
+        });
+        return future;
+    }
+}
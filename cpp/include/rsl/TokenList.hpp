@@ -1,5 +1,6 @@
 #pragma once
 #include <list>
+#include <vector>
 #include "Token.hpp"
 
 namespace rsl
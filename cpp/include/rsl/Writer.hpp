@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace rsl
+{
+    // Receives generated source in chunks. The view is only valid for the duration of the call.
+    using WriterSink = std::function<void(std::string_view)>;
+
+    // Growable output buffer shared by a whole generation pass. When constructed with a sink the buffer is handed
+    // to it whenever Commit is called past the chunk size, so memory use stays bounded by the largest statement.
+    // When constructed over caller memory output is written there directly and never allocated; anything past the
+    // capacity is dropped but still counted so GetSize reports the size that would have been required.
+    class Writer
+    {
+        std::string _buffer{};
+        WriterSink _sink{};
+        size_t _chunkSize = 0;
+        bool _fixed = false;
+        char* _external = nullptr;
+        size_t _capacity = 0;
+        size_t _size = 0;
+        size_t _flushed = 0;
+        bool _compact = false;
+        // Last character written, kept even when it was handed to the sink or did not fit in caller memory so
+        // measuring and writing make the same spacing decisions
+        char _last = '\0';
+
+        void Append(const char* data, size_t size);
+
+    public:
+        // A position to roll back to, with the character written just before it
+        struct Mark
+        {
+            size_t size = 0;
+            char last = '\0';
+        };
+
+        explicit Writer(size_t reserve = 4096);
+        Writer(const WriterSink& sink, size_t chunkSize = 16384);
+        // buffer may be null to only measure the output
+        Writer(char* buffer, size_t capacity);
+
+        Writer& operator<<(std::string_view text);
+        Writer& operator<<(const char* text);
+        Writer& operator<<(const std::string& text);
+        Writer& operator<<(char c);
+        Writer& operator<<(int value);
+        Writer& operator<<(int64_t value);
+        Writer& operator<<(uint64_t value);
+        // Shortest representation that reads back as the same float, always with a '.' or exponent
+        Writer& operator<<(float value);
+
+        // Indentation and line breaks are skipped in compact mode
+        Writer& Indent(int depth);
+        Writer& NewLine();
+        // Writes pretty normally and compact in compact mode
+        Writer& Pretty(std::string_view pretty, std::string_view compact);
+        // Starts a new line if anything has been written to the current one, even in compact mode. Used before
+        // preprocessor directives.
+        Writer& BeginLine();
+
+        // In compact mode whitespace is only written where it separates tokens, floats drop redundant zeros and a
+        // space is inserted wherever two '+' or '-' would otherwise merge into a different operator
+        void SetCompact(bool compact);
+        [[nodiscard]] bool IsCompact() const;
+
+        // Bytes written since the last Flush or Take
+        [[nodiscard]] size_t GetSize() const;
+        // Current position, usable with Truncate to roll back partially written output
+        [[nodiscard]] Mark GetMark() const;
+        void Truncate(const Mark& mark);
+
+        // Bytes written in total, including those already handed to the sink
+        [[nodiscard]] size_t GetTotalSize() const;
+
+        // True when writing into caller memory and the output did not fit
+        [[nodiscard]] bool IsOverflowed() const;
+
+        // Hands the buffer to the sink once it has grown past the chunk size. Only call between statements.
+        void Commit();
+        // Hands everything written so far to the sink
+        void Flush();
+
+        [[nodiscard]] const std::string& GetBuffer() const;
+        std::string Take();
+    };
+}
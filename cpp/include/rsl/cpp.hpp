@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <string>
+
+#include "nodes.hpp"
+#include "Writer.hpp"
+
+// Lowers the stage independent parts of a module, its structs, constants and functions, to a C++ header built on the
+// vector library in cpu.hpp. Used to run shader math on the CPU from the same source as the GPU.
+namespace rsl::cpp
+{
+    struct GenerateOptions
+    {
+        // Invocations processed by each call. 1 emits scalar code. 4 and 8 emit SoA code over SSE and AVX lanes where
+        // divergent branches and loops run under a mask and every function takes the mask of active invocations as an
+        // extra last argument.
+        int lanes = 1;
+        // Namespace the generated declarations are placed in. Left at global scope when empty.
+        std::string namespaceName{};
+    };
+
+    // Stage scopes, layouts and push constants are skipped. Defines are substituted at each use. Throws on constructs
+    // that only exist on the GPU, like texture sampling, derivatives or discard, and on functions that read stage
+    // interface variables.
+    void generate(Writer& out, const std::shared_ptr<ModuleNode>& module, const GenerateOptions& options = {});
+
+    std::string generate(const std::shared_ptr<ModuleNode>& module, const GenerateOptions& options = {});
+}
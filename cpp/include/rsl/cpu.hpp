@@ -0,0 +1,1666 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RSL_CPU_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define RSL_CPU_AVX 1
+#endif
+
+// Vector library targeted by the C++ backend in cpp.hpp. It is header only and does not depend on the rest of rsl, so
+// generated code can be compiled into programs that never link the compiler.
+//
+// Scalar code uses float2-float4, int2-int4, mat3 and mat4 over plain floats and ints. SoA code uses the same vectors
+// over Lanes, which hold one value for each of 4 or 8 invocations, and comparisons of lanes produce a Mask. Float
+// lanes are backed by SSE or AVX registers when the including translation unit enables them and fall back to plain
+// arrays otherwise. Builtins follow GLSL semantics and names.
+namespace rsl::cpu
+{
+    // Native float registers holding W lanes. Only specialized for widths the target supports.
+    template <int W>
+    struct Simd;
+
+#ifdef RSL_CPU_SSE
+    template <>
+    struct Simd<4>
+    {
+        using Reg = __m128;
+
+        static Reg Set1(float value)
+        {
+            return _mm_set1_ps(value);
+        }
+
+        static Reg Load(const float* data)
+        {
+            return _mm_loadu_ps(data);
+        }
+
+        static void Store(float* data, Reg a)
+        {
+            _mm_storeu_ps(data, a);
+        }
+
+        static Reg True()
+        {
+            return _mm_castsi128_ps(_mm_set1_epi32(-1));
+        }
+
+        static Reg Add(Reg a, Reg b)
+        {
+            return _mm_add_ps(a, b);
+        }
+
+        static Reg Sub(Reg a, Reg b)
+        {
+            return _mm_sub_ps(a, b);
+        }
+
+        static Reg Mul(Reg a, Reg b)
+        {
+            return _mm_mul_ps(a, b);
+        }
+
+        static Reg Div(Reg a, Reg b)
+        {
+            return _mm_div_ps(a, b);
+        }
+
+        static Reg Min(Reg a, Reg b)
+        {
+            return _mm_min_ps(a, b);
+        }
+
+        static Reg Max(Reg a, Reg b)
+        {
+            return _mm_max_ps(a, b);
+        }
+
+        static Reg Sqrt(Reg a)
+        {
+            return _mm_sqrt_ps(a);
+        }
+
+        static Reg And(Reg a, Reg b)
+        {
+            return _mm_and_ps(a, b);
+        }
+
+        static Reg Or(Reg a, Reg b)
+        {
+            return _mm_or_ps(a, b);
+        }
+
+        static Reg Xor(Reg a, Reg b)
+        {
+            return _mm_xor_ps(a, b);
+        }
+
+        // a & ~b
+        static Reg AndNot(Reg a, Reg b)
+        {
+            return _mm_andnot_ps(b, a);
+        }
+
+        static Reg Less(Reg a, Reg b)
+        {
+            return _mm_cmplt_ps(a, b);
+        }
+
+        static Reg LessEqual(Reg a, Reg b)
+        {
+            return _mm_cmple_ps(a, b);
+        }
+
+        static Reg Greater(Reg a, Reg b)
+        {
+            return _mm_cmpgt_ps(a, b);
+        }
+
+        static Reg GreaterEqual(Reg a, Reg b)
+        {
+            return _mm_cmpge_ps(a, b);
+        }
+
+        static Reg Equal(Reg a, Reg b)
+        {
+            return _mm_cmpeq_ps(a, b);
+        }
+
+        static Reg NotEqual(Reg a, Reg b)
+        {
+            return _mm_cmpneq_ps(a, b);
+        }
+
+        // Lanes of a where mask is set, b elsewhere
+        static Reg Select(Reg mask, Reg a, Reg b)
+        {
+#ifdef __SSE4_1__
+            return _mm_blendv_ps(b, a, mask);
+#else
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+#endif
+        }
+
+        static int MoveMask(Reg a)
+        {
+            return _mm_movemask_ps(a);
+        }
+
+        static Reg Floor(Reg a)
+        {
+#ifdef __SSE4_1__
+            return _mm_floor_ps(a);
+#else
+            alignas(16) float values[4];
+            Store(values, a);
+            for (auto& value : values) value = std::floor(value);
+            return Load(values);
+#endif
+        }
+
+        static Reg Ceil(Reg a)
+        {
+#ifdef __SSE4_1__
+            return _mm_ceil_ps(a);
+#else
+            alignas(16) float values[4];
+            Store(values, a);
+            for (auto& value : values) value = std::ceil(value);
+            return Load(values);
+#endif
+        }
+    };
+#endif
+
+#ifdef RSL_CPU_AVX
+    template <>
+    struct Simd<8>
+    {
+        using Reg = __m256;
+
+        static Reg Set1(float value)
+        {
+            return _mm256_set1_ps(value);
+        }
+
+        static Reg Load(const float* data)
+        {
+            return _mm256_loadu_ps(data);
+        }
+
+        static void Store(float* data, Reg a)
+        {
+            _mm256_storeu_ps(data, a);
+        }
+
+        static Reg True()
+        {
+            return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        }
+
+        static Reg Add(Reg a, Reg b)
+        {
+            return _mm256_add_ps(a, b);
+        }
+
+        static Reg Sub(Reg a, Reg b)
+        {
+            return _mm256_sub_ps(a, b);
+        }
+
+        static Reg Mul(Reg a, Reg b)
+        {
+            return _mm256_mul_ps(a, b);
+        }
+
+        static Reg Div(Reg a, Reg b)
+        {
+            return _mm256_div_ps(a, b);
+        }
+
+        static Reg Min(Reg a, Reg b)
+        {
+            return _mm256_min_ps(a, b);
+        }
+
+        static Reg Max(Reg a, Reg b)
+        {
+            return _mm256_max_ps(a, b);
+        }
+
+        static Reg Sqrt(Reg a)
+        {
+            return _mm256_sqrt_ps(a);
+        }
+
+        static Reg And(Reg a, Reg b)
+        {
+            return _mm256_and_ps(a, b);
+        }
+
+        static Reg Or(Reg a, Reg b)
+        {
+            return _mm256_or_ps(a, b);
+        }
+
+        static Reg Xor(Reg a, Reg b)
+        {
+            return _mm256_xor_ps(a, b);
+        }
+
+        // a & ~b
+        static Reg AndNot(Reg a, Reg b)
+        {
+            return _mm256_andnot_ps(b, a);
+        }
+
+        static Reg Less(Reg a, Reg b)
+        {
+            return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+        }
+
+        static Reg LessEqual(Reg a, Reg b)
+        {
+            return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+        }
+
+        static Reg Greater(Reg a, Reg b)
+        {
+            return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+        }
+
+        static Reg GreaterEqual(Reg a, Reg b)
+        {
+            return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+        }
+
+        static Reg Equal(Reg a, Reg b)
+        {
+            return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+        }
+
+        static Reg NotEqual(Reg a, Reg b)
+        {
+            return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+        }
+
+        // Lanes of a where mask is set, b elsewhere
+        static Reg Select(Reg mask, Reg a, Reg b)
+        {
+            return _mm256_blendv_ps(b, a, mask);
+        }
+
+        static int MoveMask(Reg a)
+        {
+            return _mm256_movemask_ps(a);
+        }
+
+        static Reg Floor(Reg a)
+        {
+            return _mm256_floor_ps(a);
+        }
+
+        static Reg Ceil(Reg a)
+        {
+            return _mm256_ceil_ps(a);
+        }
+    };
+#endif
+
+    template <int W>
+    concept HasSimd = requires { typename Simd<W>::Reg; };
+
+    // One bool for each of W invocations
+    template <int W>
+    struct Mask
+    {
+        bool values[W];
+
+        Mask() = default;
+
+        Mask(bool value)
+        {
+            for (auto& v : values) v = value;
+        }
+
+        static Mask FromBools(const bool* data)
+        {
+            Mask result;
+            for (auto i = 0; i < W; i++) result.values[i] = data[i];
+            return result;
+        }
+
+        bool operator[](int i) const
+        {
+            return values[i];
+        }
+
+        friend Mask operator&&(const Mask& a, const Mask& b)
+        {
+            Mask result;
+            for (auto i = 0; i < W; i++) result.values[i] = a.values[i] && b.values[i];
+            return result;
+        }
+
+        friend Mask operator||(const Mask& a, const Mask& b)
+        {
+            Mask result;
+            for (auto i = 0; i < W; i++) result.values[i] = a.values[i] || b.values[i];
+            return result;
+        }
+
+        friend Mask operator!(const Mask& a)
+        {
+            Mask result;
+            for (auto i = 0; i < W; i++) result.values[i] = !a.values[i];
+            return result;
+        }
+
+        friend Mask operator==(const Mask& a, const Mask& b)
+        {
+            Mask result;
+            for (auto i = 0; i < W; i++) result.values[i] = a.values[i] == b.values[i];
+            return result;
+        }
+
+        friend Mask operator!=(const Mask& a, const Mask& b)
+        {
+            return !(a == b);
+        }
+    };
+
+    // Lanes are set to all ones so the mask can blend float registers directly
+    template <int W> requires HasSimd<W>
+    struct Mask<W>
+    {
+        using S = Simd<W>;
+        typename S::Reg reg;
+
+        Mask() = default;
+
+        Mask(bool value) : reg(value ? S::True() : S::Set1(0.0f))
+        {
+        }
+
+        explicit Mask(typename S::Reg inReg) : reg(inReg)
+        {
+        }
+
+        static Mask FromBools(const bool* data)
+        {
+            alignas(32) uint32_t bits[W];
+            for (auto i = 0; i < W; i++) bits[i] = data[i] ? ~0u : 0u;
+            return Mask(S::Load(reinterpret_cast<const float*>(bits)));
+        }
+
+        bool operator[](int i) const
+        {
+            return (S::MoveMask(reg) >> i) & 1;
+        }
+
+        friend Mask operator&&(const Mask& a, const Mask& b)
+        {
+            return Mask(S::And(a.reg, b.reg));
+        }
+
+        friend Mask operator||(const Mask& a, const Mask& b)
+        {
+            return Mask(S::Or(a.reg, b.reg));
+        }
+
+        friend Mask operator!(const Mask& a)
+        {
+            return Mask(S::Xor(a.reg, S::True()));
+        }
+
+        friend Mask operator==(const Mask& a, const Mask& b)
+        {
+            return !(a != b);
+        }
+
+        friend Mask operator!=(const Mask& a, const Mask& b)
+        {
+            return Mask(S::Xor(a.reg, b.reg));
+        }
+    };
+
+    inline bool any(bool value)
+    {
+        return value;
+    }
+
+    inline bool all(bool value)
+    {
+        return value;
+    }
+
+    template <int W>
+    bool any(const Mask<W>& mask)
+    {
+        if constexpr (HasSimd<W>)
+        {
+            return Simd<W>::MoveMask(mask.reg) != 0;
+        }
+        else
+        {
+            for (auto value : mask.values) if (value) return true;
+            return false;
+        }
+    }
+
+    template <int W>
+    bool all(const Mask<W>& mask)
+    {
+        if constexpr (HasSimd<W>)
+        {
+            return Simd<W>::MoveMask(mask.reg) == (1 << W) - 1;
+        }
+        else
+        {
+            for (auto value : mask.values) if (!value) return false;
+            return true;
+        }
+    }
+
+    // One T for each of W invocations. Integer division and modulo by zero give zero so inactive lanes are harmless.
+    template <typename T, int W>
+    struct Lanes
+    {
+        T values[W];
+
+        Lanes() = default;
+
+        Lanes(T value)
+        {
+            for (auto& v : values) v = value;
+        }
+
+        template <typename U>
+        explicit Lanes(const Lanes<U, W>& other)
+        {
+            for (auto i = 0; i < W; i++) values[i] = static_cast<T>(other[i]);
+        }
+
+        static Lanes Load(const T* data)
+        {
+            Lanes result;
+            for (auto i = 0; i < W; i++) result.values[i] = data[i];
+            return result;
+        }
+
+        void Store(T* data) const
+        {
+            for (auto i = 0; i < W; i++) data[i] = values[i];
+        }
+
+        T operator[](int i) const
+        {
+            return values[i];
+        }
+
+        template <typename F>
+        static Lanes Zip(const Lanes& a, const Lanes& b, F f)
+        {
+            Lanes result;
+            for (auto i = 0; i < W; i++) result.values[i] = f(a.values[i], b.values[i]);
+            return result;
+        }
+
+        template <typename F>
+        static Mask<W> Compare(const Lanes& a, const Lanes& b, F f)
+        {
+            bool result[W];
+            for (auto i = 0; i < W; i++) result[i] = f(a.values[i], b.values[i]);
+            return Mask<W>::FromBools(result);
+        }
+
+        friend Lanes operator+(const Lanes& a, const Lanes& b)
+        {
+            return Zip(a, b, [](T x, T y) { return x + y; });
+        }
+
+        friend Lanes operator-(const Lanes& a, const Lanes& b)
+        {
+            return Zip(a, b, [](T x, T y) { return x - y; });
+        }
+
+        friend Lanes operator*(const Lanes& a, const Lanes& b)
+        {
+            return Zip(a, b, [](T x, T y) { return x * y; });
+        }
+
+        friend Lanes operator/(const Lanes& a, const Lanes& b)
+        {
+            return Zip(a, b, [](T x, T y)
+            {
+                if constexpr (std::is_integral_v<T>) return y == 0 ? T{} : x / y;
+                else return x / y;
+            });
+        }
+
+        friend Lanes operator%(const Lanes& a, const Lanes& b) requires std::is_integral_v<T>
+        {
+            return Zip(a, b, [](T x, T y) { return y == 0 ? T{} : x % y; });
+        }
+
+        friend Lanes operator-(const Lanes& a)
+        {
+            return Zip(a, a, [](T x, T) { return -x; });
+        }
+
+        friend Mask<W> operator<(const Lanes& a, const Lanes& b)
+        {
+            return Compare(a, b, [](T x, T y) { return x < y; });
+        }
+
+        friend Mask<W> operator<=(const Lanes& a, const Lanes& b)
+        {
+            return Compare(a, b, [](T x, T y) { return x <= y; });
+        }
+
+        friend Mask<W> operator>(const Lanes& a, const Lanes& b)
+        {
+            return Compare(a, b, [](T x, T y) { return x > y; });
+        }
+
+        friend Mask<W> operator>=(const Lanes& a, const Lanes& b)
+        {
+            return Compare(a, b, [](T x, T y) { return x >= y; });
+        }
+
+        friend Mask<W> operator==(const Lanes& a, const Lanes& b)
+        {
+            return Compare(a, b, [](T x, T y) { return x == y; });
+        }
+
+        friend Mask<W> operator!=(const Lanes& a, const Lanes& b)
+        {
+            return Compare(a, b, [](T x, T y) { return x != y; });
+        }
+    };
+
+    template <int W> requires HasSimd<W>
+    struct Lanes<float, W>
+    {
+        using S = Simd<W>;
+        typename S::Reg reg;
+
+        Lanes() = default;
+
+        Lanes(float value) : reg(S::Set1(value))
+        {
+        }
+
+        explicit Lanes(typename S::Reg inReg) : reg(inReg)
+        {
+        }
+
+        template <typename U>
+        explicit Lanes(const Lanes<U, W>& other)
+        {
+            alignas(32) float values[W];
+            for (auto i = 0; i < W; i++) values[i] = static_cast<float>(other[i]);
+            reg = S::Load(values);
+        }
+
+        static Lanes Load(const float* data)
+        {
+            return Lanes(S::Load(data));
+        }
+
+        void Store(float* data) const
+        {
+            S::Store(data, reg);
+        }
+
+        float operator[](int i) const
+        {
+            alignas(32) float values[W];
+            S::Store(values, reg);
+            return values[i];
+        }
+
+        friend Lanes operator+(const Lanes& a, const Lanes& b)
+        {
+            return Lanes(S::Add(a.reg, b.reg));
+        }
+
+        friend Lanes operator-(const Lanes& a, const Lanes& b)
+        {
+            return Lanes(S::Sub(a.reg, b.reg));
+        }
+
+        friend Lanes operator*(const Lanes& a, const Lanes& b)
+        {
+            return Lanes(S::Mul(a.reg, b.reg));
+        }
+
+        friend Lanes operator/(const Lanes& a, const Lanes& b)
+        {
+            return Lanes(S::Div(a.reg, b.reg));
+        }
+
+        friend Lanes operator-(const Lanes& a)
+        {
+            return Lanes(S::Xor(a.reg, S::Set1(-0.0f)));
+        }
+
+        friend Mask<W> operator<(const Lanes& a, const Lanes& b)
+        {
+            return Mask<W>(S::Less(a.reg, b.reg));
+        }
+
+        friend Mask<W> operator<=(const Lanes& a, const Lanes& b)
+        {
+            return Mask<W>(S::LessEqual(a.reg, b.reg));
+        }
+
+        friend Mask<W> operator>(const Lanes& a, const Lanes& b)
+        {
+            return Mask<W>(S::Greater(a.reg, b.reg));
+        }
+
+        friend Mask<W> operator>=(const Lanes& a, const Lanes& b)
+        {
+            return Mask<W>(S::GreaterEqual(a.reg, b.reg));
+        }
+
+        friend Mask<W> operator==(const Lanes& a, const Lanes& b)
+        {
+            return Mask<W>(S::Equal(a.reg, b.reg));
+        }
+
+        friend Mask<W> operator!=(const Lanes& a, const Lanes& b)
+        {
+            return Mask<W>(S::NotEqual(a.reg, b.reg));
+        }
+    };
+
+    template <typename T, int W, typename F>
+    Lanes<T, W> perLane(const Lanes<T, W>& a, F f)
+    {
+        alignas(32) T values[W];
+        a.Store(values);
+        for (auto& value : values) value = f(value);
+        return Lanes<T, W>::Load(values);
+    }
+
+    template <typename T, int W, typename F>
+    Lanes<T, W> perLane(const Lanes<T, W>& a, const Lanes<T, W>& b, F f)
+    {
+        alignas(32) T first[W];
+        alignas(32) T second[W];
+        a.Store(first);
+        b.Store(second);
+        for (auto i = 0; i < W; i++) first[i] = f(first[i], second[i]);
+        return Lanes<T, W>::Load(first);
+    }
+
+    template <typename T, int N>
+    struct VecStorage;
+
+    template <typename T>
+    struct VecStorage<T, 2>
+    {
+        T x, y;
+    };
+
+    template <typename T>
+    struct VecStorage<T, 3>
+    {
+        T x, y, z;
+    };
+
+    template <typename T>
+    struct VecStorage<T, 4>
+    {
+        T x, y, z, w;
+    };
+
+    template <typename T, int N>
+    struct Vec;
+
+    template <typename T, int N>
+    struct Mat;
+
+    template <typename T>
+    constexpr int COMPONENT_COUNT = 1;
+
+    template <typename T, int N>
+    constexpr int COMPONENT_COUNT<Vec<T, N>> = N;
+
+    template <typename T, int N>
+    constexpr int COMPONENT_COUNT<Mat<T, N>> = N * N;
+
+    // Writes the components of value to out in GLSL constructor order, converting each to T
+    template <typename T, typename A>
+    void appendComponents(T* out, int& count, const A& value)
+    {
+        if constexpr (COMPONENT_COUNT<A> == 1)
+        {
+            out[count++] = T(value);
+        }
+        else
+        {
+            for (auto i = 0; i < COMPONENT_COUNT<A>; i++) out[count++] = T(value.Component(i));
+        }
+    }
+
+    // Column vector of N components with GLSL constructors and component wise operators
+    template <typename T, int N>
+    struct Vec : VecStorage<T, N>
+    {
+        Vec() = default;
+
+        // Every component set to value
+        explicit Vec(const T& value)
+        {
+            for (auto i = 0; i < N; i++) (*this)[i] = value;
+        }
+
+        // Components taken in order from scalars and vectors, like vec4(v.xy, 0.0, 1.0)
+        template <typename... A> requires (sizeof...(A) > 1 && (COMPONENT_COUNT<A> + ...) >= N)
+        explicit Vec(const A&... args)
+        {
+            T components[(COMPONENT_COUNT<A> + ...)];
+            auto count = 0;
+            (appendComponents(components, count, args), ...);
+            for (auto i = 0; i < N; i++) (*this)[i] = components[i];
+        }
+
+        // Conversion between component types and truncation, like vec2(v) for a vec4 v
+        template <typename U, int M> requires (M >= N && !(std::is_same_v<T, U> && M == N))
+        explicit Vec(const Vec<U, M>& other)
+        {
+            for (auto i = 0; i < N; i++) (*this)[i] = T(other[i]);
+        }
+
+        T& operator[](int i)
+        {
+            return (&this->x)[i];
+        }
+
+        const T& operator[](int i) const
+        {
+            return (&this->x)[i];
+        }
+
+        const T& Component(int i) const
+        {
+            return (*this)[i];
+        }
+    };
+
+    template <typename T, int N, typename F>
+    auto map(const Vec<T, N>& a, F f)
+    {
+        Vec<decltype(f(a[0])), N> result;
+        for (auto i = 0; i < N; i++) result[i] = f(a[i]);
+        return result;
+    }
+
+    template <typename T, int N, typename F>
+    auto zip(const Vec<T, N>& a, const Vec<T, N>& b, F f)
+    {
+        Vec<decltype(f(a[0], b[0])), N> result;
+        for (auto i = 0; i < N; i++) result[i] = f(a[i], b[i]);
+        return result;
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator+(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        return zip(a, b, [](const T& x, const T& y) { return T(x + y); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator-(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        return zip(a, b, [](const T& x, const T& y) { return T(x - y); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator*(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        return zip(a, b, [](const T& x, const T& y) { return T(x * y); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator/(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        return zip(a, b, [](const T& x, const T& y) { return T(x / y); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator%(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        return zip(a, b, [](const T& x, const T& y) { return T(x % y); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator-(const Vec<T, N>& a)
+    {
+        return map(a, [](const T& x) { return T(-x); });
+    }
+
+    // Scalar operands are taken as T so literals and plain floats convert to lanes
+    template <typename T, int N>
+    Vec<T, N> operator+(const Vec<T, N>& a, const std::type_identity_t<T>& b)
+    {
+        return a + Vec<T, N>(b);
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator+(const std::type_identity_t<T>& a, const Vec<T, N>& b)
+    {
+        return Vec<T, N>(a) + b;
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator-(const Vec<T, N>& a, const std::type_identity_t<T>& b)
+    {
+        return a - Vec<T, N>(b);
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator-(const std::type_identity_t<T>& a, const Vec<T, N>& b)
+    {
+        return Vec<T, N>(a) - b;
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator*(const Vec<T, N>& a, const std::type_identity_t<T>& b)
+    {
+        return a * Vec<T, N>(b);
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator*(const std::type_identity_t<T>& a, const Vec<T, N>& b)
+    {
+        return Vec<T, N>(a) * b;
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator/(const Vec<T, N>& a, const std::type_identity_t<T>& b)
+    {
+        return a / Vec<T, N>(b);
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator/(const std::type_identity_t<T>& a, const Vec<T, N>& b)
+    {
+        return Vec<T, N>(a) / b;
+    }
+
+    template <typename T>
+    struct BoolOf
+    {
+        using Type = bool;
+    };
+
+    template <typename T, int W>
+    struct BoolOf<Lanes<T, W>>
+    {
+        using Type = Mask<W>;
+    };
+
+    // Like GLSL, vectors compare equal when every component does
+    template <typename T, int N>
+    typename BoolOf<T>::Type operator==(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        auto result = a[0] == b[0];
+        for (auto i = 1; i < N; i++) result = result && a[i] == b[i];
+        return result;
+    }
+
+    template <typename T, int N>
+    typename BoolOf<T>::Type operator!=(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        return !(a == b);
+    }
+
+    // Column major matrix of N columns with N components each
+    template <typename T, int N>
+    struct Mat
+    {
+        Vec<T, N> columns[N];
+
+        Mat() = default;
+
+        // value on the diagonal and zero elsewhere
+        explicit Mat(const T& value)
+        {
+            for (auto c = 0; c < N; c++)
+            {
+                for (auto r = 0; r < N; r++) columns[c][r] = c == r ? value : T(0.0f);
+            }
+        }
+
+        // Columns or components taken in column major order
+        template <typename... A> requires (sizeof...(A) > 1 && (COMPONENT_COUNT<A> + ...) >= N * N)
+        explicit Mat(const A&... args)
+        {
+            T components[(COMPONENT_COUNT<A> + ...)];
+            auto count = 0;
+            (appendComponents(components, count, args), ...);
+            for (auto i = 0; i < N * N; i++) columns[i / N][i % N] = components[i];
+        }
+
+        // The overlapping corner of other, with the identity filling the rest
+        template <int M> requires (M != N)
+        explicit Mat(const Mat<T, M>& other) : Mat(T(1.0f))
+        {
+            for (auto c = 0; c < (M < N ? M : N); c++)
+            {
+                for (auto r = 0; r < (M < N ? M : N); r++) columns[c][r] = other[c][r];
+            }
+        }
+
+        Vec<T, N>& operator[](int i)
+        {
+            return columns[i];
+        }
+
+        const Vec<T, N>& operator[](int i) const
+        {
+            return columns[i];
+        }
+
+        const T& Component(int i) const
+        {
+            return columns[i / N][i % N];
+        }
+    };
+
+    template <typename T, int N>
+    Mat<T, N> operator+(const Mat<T, N>& a, const Mat<T, N>& b)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = a[c] + b[c];
+        return result;
+    }
+
+    template <typename T, int N>
+    Mat<T, N> operator-(const Mat<T, N>& a, const Mat<T, N>& b)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = a[c] - b[c];
+        return result;
+    }
+
+    template <typename T, int N>
+    Mat<T, N> operator-(const Mat<T, N>& a)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = -a[c];
+        return result;
+    }
+
+    template <typename T, int N>
+    Mat<T, N> operator*(const Mat<T, N>& a, const std::type_identity_t<T>& b)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = a[c] * b;
+        return result;
+    }
+
+    template <typename T, int N>
+    Mat<T, N> operator*(const std::type_identity_t<T>& a, const Mat<T, N>& b)
+    {
+        return b * a;
+    }
+
+    template <typename T, int N>
+    Mat<T, N> operator/(const Mat<T, N>& a, const std::type_identity_t<T>& b)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = a[c] / b;
+        return result;
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator*(const Mat<T, N>& a, const Vec<T, N>& b)
+    {
+        auto result = a[0] * b[0];
+        for (auto c = 1; c < N; c++) result = result + a[c] * b[c];
+        return result;
+    }
+
+    template <typename T, int N>
+    Vec<T, N> operator*(const Vec<T, N>& a, const Mat<T, N>& b)
+    {
+        Vec<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = dot(a, b[c]);
+        return result;
+    }
+
+    template <typename T, int N>
+    Mat<T, N> operator*(const Mat<T, N>& a, const Mat<T, N>& b)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = a * b[c];
+        return result;
+    }
+
+    template <typename T>
+    constexpr int RANK = 0;
+
+    template <typename T, int W>
+    constexpr int RANK<Lanes<T, W>> = 1;
+
+    template <typename T, int N>
+    constexpr int RANK<Vec<T, N>> = 2;
+
+    template <typename T, int N>
+    constexpr int RANK<Mat<T, N>> = 3;
+
+    // The operand type mixed arguments of a builtin are converted to, like vec2 for clamp(v, 0.0, 1.0)
+    template <typename A, typename B>
+    using Wider = std::conditional_t<(RANK<B> > RANK<A>), B, A>;
+
+    template <typename T>
+    T select(bool condition, const T& a, const T& b)
+    {
+        return condition ? a : b;
+    }
+
+    template <typename T, int W>
+    Lanes<T, W> select(const Mask<W>& mask, const Lanes<T, W>& a, const Lanes<T, W>& b)
+    {
+        if constexpr (std::is_same_v<T, float> && HasSimd<W>)
+        {
+            return Lanes<T, W>(Simd<W>::Select(mask.reg, a.reg, b.reg));
+        }
+        else
+        {
+            Lanes<T, W> result;
+            for (auto i = 0; i < W; i++) result.values[i] = mask[i] ? a[i] : b[i];
+            return result;
+        }
+    }
+
+    template <int W>
+    Mask<W> select(const Mask<W>& mask, const Mask<W>& a, const Mask<W>& b)
+    {
+        return (mask && a) || (!mask && b);
+    }
+
+    template <typename T, int N, int W>
+    Vec<T, N> select(const Mask<W>& mask, const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        Vec<T, N> result;
+        for (auto i = 0; i < N; i++) result[i] = select(mask, a[i], b[i]);
+        return result;
+    }
+
+    template <typename T, int N, int W>
+    Mat<T, N> select(const Mask<W>& mask, const Mat<T, N>& a, const Mat<T, N>& b)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++) result[c] = select(mask, a[c], b[c]);
+        return result;
+    }
+
+    // Lanes of a where mask is set, b elsewhere. Generated structs get their own overload next to their definition.
+    template <int W, typename A, typename B> requires (!std::is_same_v<A, B>)
+    Wider<A, B> select(const Mask<W>& mask, const A& a, const B& b)
+    {
+        return select(mask, Wider<A, B>(a), Wider<A, B>(b));
+    }
+
+    // target = value in the lanes set in mask
+    template <int W, typename T, typename V>
+    const T& assign(const Mask<W>& mask, T& target, const V& value)
+    {
+        target = select(mask, value, target);
+        return target;
+    }
+
+    // Reads the swizzle v.xy as swizzle<0, 1>(v)
+    template <int... I, typename T, int N>
+    Vec<T, sizeof...(I)> swizzle(const Vec<T, N>& v)
+    {
+        return Vec<T, sizeof...(I)>(v[I]...);
+    }
+
+    // Writes the swizzle v.xy = value as store<0, 1>(v, value)
+    template <int... I, typename T, int N>
+    Vec<T, sizeof...(I)> store(Vec<T, N>& v, const Vec<T, sizeof...(I)>& value)
+    {
+        auto i = 0;
+        ((v[I] = value[i++]), ...);
+        return value;
+    }
+
+    template <int... I, typename T, int N, int W>
+    Vec<T, sizeof...(I)> store(const Mask<W>& mask, Vec<T, N>& v, const Vec<T, sizeof...(I)>& value)
+    {
+        auto i = 0;
+        ((v[I] = select(mask, value[i++], v[I])), ...);
+        return value;
+    }
+
+    // Indexing with a different index in each lane. Lanes whose index is out of range read element 0 and write
+    // nothing.
+    template <typename C, typename T, int W>
+    T gather(const C& container, int size, const Lanes<int, W>& index)
+    {
+        T result = container[0];
+        for (auto i = 1; i < size; i++) result = select(index == i, container[i], result);
+        return result;
+    }
+
+    template <typename T, size_t N>
+    const T& at(const T (&array)[N], int index)
+    {
+        return array[index];
+    }
+
+    template <typename T, size_t N, int W>
+    T at(const T (&array)[N], const Lanes<int, W>& index)
+    {
+        return gather<T[N], T>(array, static_cast<int>(N), index);
+    }
+
+    template <typename T, int N>
+    const T& at(const Vec<T, N>& v, int index)
+    {
+        return v[index];
+    }
+
+    template <typename T, int N, int W>
+    T at(const Vec<T, N>& v, const Lanes<int, W>& index)
+    {
+        return gather<Vec<T, N>, T>(v, N, index);
+    }
+
+    template <typename T, int N>
+    const Vec<T, N>& at(const Mat<T, N>& m, int index)
+    {
+        return m[index];
+    }
+
+    template <typename T, int N, int W>
+    Vec<T, N> at(const Mat<T, N>& m, const Lanes<int, W>& index)
+    {
+        return gather<Mat<T, N>, Vec<T, N>>(m, N, index);
+    }
+
+    template <typename C, typename V, int W>
+    V assignAt(const Mask<W>& mask, C& container, int size, const Lanes<int, W>& index, const V& value)
+    {
+        for (auto i = 0; i < size; i++) assign(mask && index == i, container[i], value);
+        return value;
+    }
+
+    template <typename T, size_t N, typename V, int W>
+    V assignAt(const Mask<W>& mask, T (&array)[N], int index, const V& value)
+    {
+        assign(mask, array[index], value);
+        return value;
+    }
+
+    template <typename T, size_t N, typename V, int W>
+    V assignAt(const Mask<W>& mask, T (&array)[N], const Lanes<int, W>& index, const V& value)
+    {
+        return assignAt(mask, array, static_cast<int>(N), index, value);
+    }
+
+    template <typename T, int N, typename V, int W>
+    V assignAt(const Mask<W>& mask, Vec<T, N>& v, int index, const V& value)
+    {
+        assign(mask, v[index], value);
+        return value;
+    }
+
+    template <typename T, int N, typename V, int W>
+    V assignAt(const Mask<W>& mask, Vec<T, N>& v, const Lanes<int, W>& index, const V& value)
+    {
+        return assignAt(mask, v, N, index, value);
+    }
+
+    template <typename T, int N, typename V, int W>
+    V assignAt(const Mask<W>& mask, Mat<T, N>& m, int index, const V& value)
+    {
+        assign(mask, m[index], value);
+        return value;
+    }
+
+    template <typename T, int N, typename V, int W>
+    V assignAt(const Mask<W>& mask, Mat<T, N>& m, const Lanes<int, W>& index, const V& value)
+    {
+        return assignAt(mask, m, N, index, value);
+    }
+
+    inline int abs(int x)
+    {
+        return x < 0 ? -x : x;
+    }
+
+    inline float abs(float x)
+    {
+        return std::fabs(x);
+    }
+
+    template <typename T, int W>
+    Lanes<T, W> abs(const Lanes<T, W>& x)
+    {
+        if constexpr (std::is_same_v<T, float> && HasSimd<W>)
+        {
+            return Lanes<T, W>(Simd<W>::AndNot(x.reg, Simd<W>::Set1(-0.0f)));
+        }
+        else
+        {
+            return perLane(x, [](T c) { return abs(c); });
+        }
+    }
+
+    inline float floor(float x)
+    {
+        return std::floor(x);
+    }
+
+    template <int W>
+    Lanes<float, W> floor(const Lanes<float, W>& x)
+    {
+        if constexpr (HasSimd<W>) return Lanes<float, W>(Simd<W>::Floor(x.reg));
+        else return perLane(x, [](float c) { return std::floor(c); });
+    }
+
+    inline float ceil(float x)
+    {
+        return std::ceil(x);
+    }
+
+    template <int W>
+    Lanes<float, W> ceil(const Lanes<float, W>& x)
+    {
+        if constexpr (HasSimd<W>) return Lanes<float, W>(Simd<W>::Ceil(x.reg));
+        else return perLane(x, [](float c) { return std::ceil(c); });
+    }
+
+    inline float sqrt(float x)
+    {
+        return std::sqrt(x);
+    }
+
+    template <int W>
+    Lanes<float, W> sqrt(const Lanes<float, W>& x)
+    {
+        if constexpr (HasSimd<W>) return Lanes<float, W>(Simd<W>::Sqrt(x.reg));
+        else return perLane(x, [](float c) { return std::sqrt(c); });
+    }
+
+    inline int min(int x, int y)
+    {
+        return y < x ? y : x;
+    }
+
+    inline float min(float x, float y)
+    {
+        return y < x ? y : x;
+    }
+
+    template <typename T, int W>
+    Lanes<T, W> min(const Lanes<T, W>& x, const Lanes<T, W>& y)
+    {
+        if constexpr (std::is_same_v<T, float> && HasSimd<W>) return Lanes<T, W>(Simd<W>::Min(x.reg, y.reg));
+        else return perLane(x, y, [](T a, T b) { return min(a, b); });
+    }
+
+    inline int max(int x, int y)
+    {
+        return x < y ? y : x;
+    }
+
+    inline float max(float x, float y)
+    {
+        return x < y ? y : x;
+    }
+
+    template <typename T, int W>
+    Lanes<T, W> max(const Lanes<T, W>& x, const Lanes<T, W>& y)
+    {
+        if constexpr (std::is_same_v<T, float> && HasSimd<W>) return Lanes<T, W>(Simd<W>::Max(x.reg, y.reg));
+        else return perLane(x, y, [](T a, T b) { return max(a, b); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> abs(const Vec<T, N>& x)
+    {
+        return map(x, [](const T& c) { return abs(c); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> floor(const Vec<T, N>& x)
+    {
+        return map(x, [](const T& c) { return floor(c); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> ceil(const Vec<T, N>& x)
+    {
+        return map(x, [](const T& c) { return ceil(c); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> sqrt(const Vec<T, N>& x)
+    {
+        return map(x, [](const T& c) { return sqrt(c); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> min(const Vec<T, N>& x, const Vec<T, N>& y)
+    {
+        return zip(x, y, [](const T& a, const T& b) { return min(a, b); });
+    }
+
+    template <typename T, int N>
+    Vec<T, N> max(const Vec<T, N>& x, const Vec<T, N>& y)
+    {
+        return zip(x, y, [](const T& a, const T& b) { return max(a, b); });
+    }
+
+    template <typename A, typename B> requires (!std::is_same_v<A, B>)
+    Wider<A, B> min(const A& x, const B& y)
+    {
+        return min(Wider<A, B>(x), Wider<A, B>(y));
+    }
+
+    template <typename A, typename B> requires (!std::is_same_v<A, B>)
+    Wider<A, B> max(const A& x, const B& y)
+    {
+        return max(Wider<A, B>(x), Wider<A, B>(y));
+    }
+
+    // Component wise functions without a native lane implementation run the scalar version on each lane
+#define RSL_CPU_UNARY(name, expression) \
+    inline float name(float x) \
+    { \
+        return expression; \
+    } \
+    template <int W> \
+    Lanes<float, W> name(const Lanes<float, W>& x) \
+    { \
+        return perLane(x, [](float c) { return name(c); }); \
+    } \
+    template <typename T, int N> \
+    Vec<T, N> name(const Vec<T, N>& x) \
+    { \
+        return map(x, [](const T& c) { return name(c); }); \
+    }
+
+#define RSL_CPU_BINARY(name, expression) \
+    inline float name(float x, float y) \
+    { \
+        return expression; \
+    } \
+    template <int W> \
+    Lanes<float, W> name(const Lanes<float, W>& x, const Lanes<float, W>& y) \
+    { \
+        return perLane(x, y, [](float a, float b) { return name(a, b); }); \
+    } \
+    template <typename T, int N> \
+    Vec<T, N> name(const Vec<T, N>& x, const Vec<T, N>& y) \
+    { \
+        return zip(x, y, [](const T& a, const T& b) { return name(a, b); }); \
+    } \
+    template <typename A, typename B> requires (!std::is_same_v<A, B>) \
+    Wider<A, B> name(const A& x, const B& y) \
+    { \
+        return name(Wider<A, B>(x), Wider<A, B>(y)); \
+    }
+
+    RSL_CPU_UNARY(sign, x > 0.0f ? 1.0f : (x < 0.0f ? -1.0f : 0.0f))
+    RSL_CPU_UNARY(fract, x - std::floor(x))
+    RSL_CPU_UNARY(trunc, std::trunc(x))
+    RSL_CPU_UNARY(round, std::round(x))
+    RSL_CPU_UNARY(inversesqrt, 1.0f / std::sqrt(x))
+    RSL_CPU_UNARY(exp, std::exp(x))
+    RSL_CPU_UNARY(exp2, std::exp2(x))
+    RSL_CPU_UNARY(log, std::log(x))
+    RSL_CPU_UNARY(log2, std::log2(x))
+    RSL_CPU_UNARY(sin, std::sin(x))
+    RSL_CPU_UNARY(cos, std::cos(x))
+    RSL_CPU_UNARY(tan, std::tan(x))
+    RSL_CPU_UNARY(asin, std::asin(x))
+    RSL_CPU_UNARY(acos, std::acos(x))
+    RSL_CPU_UNARY(atan, std::atan(x))
+    RSL_CPU_UNARY(radians, x * 0.017453292519943295f)
+    RSL_CPU_UNARY(degrees, x * 57.29577951308232f)
+
+    RSL_CPU_BINARY(pow, std::pow(x, y))
+    RSL_CPU_BINARY(atan, std::atan2(x, y))
+    RSL_CPU_BINARY(mod, x - y * std::floor(x / y))
+    RSL_CPU_BINARY(step, y < x ? 0.0f : 1.0f)
+
+#undef RSL_CPU_UNARY
+#undef RSL_CPU_BINARY
+
+    inline int sign(int x)
+    {
+        return x > 0 ? 1 : (x < 0 ? -1 : 0);
+    }
+
+    template <typename A, typename B, typename C>
+    Wider<Wider<A, B>, C> clamp(const A& x, const B& low, const C& high)
+    {
+        using S = Wider<Wider<A, B>, C>;
+        return min(max(S(x), S(low)), S(high));
+    }
+
+    template <typename A, typename B, typename C>
+    Wider<Wider<A, B>, C> mix(const A& x, const B& y, const C& a)
+    {
+        using S = Wider<Wider<A, B>, C>;
+        return S(x) + (S(y) - S(x)) * S(a);
+    }
+
+    template <typename A, typename B, typename C>
+    Wider<Wider<A, B>, C> smoothstep(const A& edge0, const B& edge1, const C& x)
+    {
+        using S = Wider<Wider<A, B>, C>;
+        const auto t = clamp((S(x) - S(edge0)) / (S(edge1) - S(edge0)), 0.0f, 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    inline float dot(float a, float b)
+    {
+        return a * b;
+    }
+
+    template <typename T, int W>
+    Lanes<T, W> dot(const Lanes<T, W>& a, const Lanes<T, W>& b)
+    {
+        return a * b;
+    }
+
+    template <typename T, int N>
+    T dot(const Vec<T, N>& a, const Vec<T, N>& b)
+    {
+        T result = a[0] * b[0];
+        for (auto i = 1; i < N; i++) result = result + a[i] * b[i];
+        return result;
+    }
+
+    template <typename T>
+    auto length(const T& x)
+    {
+        if constexpr (RANK<T> == 2) return sqrt(dot(x, x));
+        else return abs(x);
+    }
+
+    template <typename T>
+    auto distance(const T& a, const T& b)
+    {
+        return length(a - b);
+    }
+
+    template <typename T>
+    T normalize(const T& x)
+    {
+        if constexpr (RANK<T> == 2) return x * inversesqrt(dot(x, x));
+        else return sign(x);
+    }
+
+    template <typename T>
+    Vec<T, 3> cross(const Vec<T, 3>& a, const Vec<T, 3>& b)
+    {
+        return Vec<T, 3>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    template <typename T>
+    T reflect(const T& i, const T& n)
+    {
+        return i - 2.0f * dot(n, i) * n;
+    }
+
+    template <typename T, typename E>
+    T refract(const T& i, const T& n, const E& eta)
+    {
+        const auto d = dot(n, i);
+        const auto k = 1.0f - eta * eta * (1.0f - d * d);
+        const auto result = eta * i - (eta * d + sqrt(max(k, 0.0f))) * n;
+        return select(k < 0.0f, T(0.0f), result);
+    }
+
+    template <typename T>
+    T faceforward(const T& n, const T& i, const T& nRef)
+    {
+        return select(dot(nRef, i) < 0.0f, n, -n);
+    }
+
+    template <typename T, int N>
+    Mat<T, N> transpose(const Mat<T, N>& m)
+    {
+        Mat<T, N> result;
+        for (auto c = 0; c < N; c++)
+        {
+            for (auto r = 0; r < N; r++) result[c][r] = m[r][c];
+        }
+        return result;
+    }
+
+    template <typename T>
+    T determinant(const Mat<T, 3>& m)
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2]) -
+            m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2]) +
+            m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+    }
+
+    // m without column skipColumn and row skipRow
+    template <typename T>
+    Mat<T, 3> minor(const Mat<T, 4>& m, int skipColumn, int skipRow)
+    {
+        Mat<T, 3> result;
+        for (auto c = 0, outColumn = 0; c < 4; c++)
+        {
+            if (c == skipColumn) continue;
+            for (auto r = 0, outRow = 0; r < 4; r++)
+            {
+                if (r == skipRow) continue;
+                result[outColumn][outRow++] = m[c][r];
+            }
+            outColumn++;
+        }
+        return result;
+    }
+
+    template <typename T>
+    T determinant(const Mat<T, 4>& m)
+    {
+        T result = m[0][0] * determinant(minor(m, 0, 0));
+        for (auto c = 1; c < 4; c++)
+        {
+            const auto term = m[c][0] * determinant(minor(m, c, 0));
+            result = c % 2 == 0 ? result + term : result - term;
+        }
+        return result;
+    }
+
+    template <typename T>
+    Mat<T, 3> inverse(const Mat<T, 3>& m)
+    {
+        Mat<T, 3> result;
+        result[0][0] = m[1][1] * m[2][2] - m[2][1] * m[1][2];
+        result[0][1] = m[2][1] * m[0][2] - m[0][1] * m[2][2];
+        result[0][2] = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        result[1][0] = m[2][0] * m[1][2] - m[1][0] * m[2][2];
+        result[1][1] = m[0][0] * m[2][2] - m[2][0] * m[0][2];
+        result[1][2] = m[1][0] * m[0][2] - m[0][0] * m[1][2];
+        result[2][0] = m[1][0] * m[2][1] - m[2][0] * m[1][1];
+        result[2][1] = m[2][0] * m[0][1] - m[0][0] * m[2][1];
+        result[2][2] = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        return result * (1.0f / determinant(m));
+    }
+
+    template <typename T>
+    Mat<T, 4> inverse(const Mat<T, 4>& m)
+    {
+        Mat<T, 4> result;
+        for (auto c = 0; c < 4; c++)
+        {
+            for (auto r = 0; r < 4; r++)
+            {
+                // The adjugate is the transposed cofactor matrix
+                const auto cofactor = determinant(minor(m, r, c));
+                result[c][r] = (c + r) % 2 == 0 ? cofactor : -cofactor;
+            }
+        }
+        return result * (1.0f / determinant(m));
+    }
+
+    // Type names used by generated code, one namespace per invocation count
+    namespace scalar
+    {
+        using Float = float;
+        using Int = int;
+        using Bool = bool;
+        using float2 = Vec<Float, 2>;
+        using float3 = Vec<Float, 3>;
+        using float4 = Vec<Float, 4>;
+        using int2 = Vec<Int, 2>;
+        using int3 = Vec<Int, 3>;
+        using int4 = Vec<Int, 4>;
+        using mat3 = Mat<Float, 3>;
+        using mat4 = Mat<Float, 4>;
+    }
+
+    namespace x4
+    {
+        using Float = Lanes<float, 4>;
+        using Int = Lanes<int, 4>;
+        using Bool = Mask<4>;
+        using float2 = Vec<Float, 2>;
+        using float3 = Vec<Float, 3>;
+        using float4 = Vec<Float, 4>;
+        using int2 = Vec<Int, 2>;
+        using int3 = Vec<Int, 3>;
+        using int4 = Vec<Int, 4>;
+        using mat3 = Mat<Float, 3>;
+        using mat4 = Mat<Float, 4>;
+    }
+
+    namespace x8
+    {
+        using Float = Lanes<float, 8>;
+        using Int = Lanes<int, 8>;
+        using Bool = Mask<8>;
+        using float2 = Vec<Float, 2>;
+        using float3 = Vec<Float, 3>;
+        using float4 = Vec<Float, 4>;
+        using int2 = Vec<Int, 2>;
+        using int3 = Vec<Int, 3>;
+        using int4 = Vec<Int, 4>;
+        using mat3 = Mat<Float, 3>;
+        using mat4 = Mat<Float, 4>;
+    }
+}
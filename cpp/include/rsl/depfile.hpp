@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Make/Ninja depfiles, which rslc writes next to its outputs and reads back to decide whether they are up to date
+namespace rsl
+{
+    // Escapes a path for a depfile: spaces and # get a backslash, backslashes before them are doubled and $ is doubled.
+    // Other backslashes, such as the separators of Windows paths, are written as they are.
+    std::string escapeDepfilePath(const std::string& path);
+
+    // A rule making every target depend on the prerequisites, with each prerequisite after the first on a continued
+    // line
+    std::string formatDepfile(const std::vector<std::string>& targets, const std::vector<std::string>& prerequisites);
+
+    // Unescaped prerequisites of a depfile written by formatDepfile. Empty when content holds no rule.
+    std::vector<std::string> parseDepfile(const std::string& content);
+}
@@ -2,26 +2,52 @@
 
 #include <string>
 #include <memory>
+#include "GenerateCache.hpp"
 #include "nodes.hpp"
+#include "ThreadPool.hpp"
+#include "Writer.hpp"
 
 namespace rsl::glsl
 {
+    struct GenerateOptions
+    {
+        // When set, top level functions and structs are generated on this pool into separate buffers and joined in
+        // declaration order, so the output is identical to a serial run
+        ThreadPool* pool = nullptr;
+        // Modules with fewer functions and structs than this are generated serially
+        size_t minParallelStatements = 8;
+        // When set, top level functions and structs are looked up here before being generated
+        GenerateCache* cache = nullptr;
+        // Only emit whitespace that separates tokens. See Writer::SetCompact.
+        bool minify = false;
+
+        // Hash of every option that changes the generated text
+        [[nodiscard]] size_t ComputeHash() const;
+    };
+
     std::string typeNameToGlslTypeName(const std::string& typeName);
-    std::string tabs(int depth);
-    std::string generateDeclaration(const std::shared_ptr<DeclarationNode>& node, int depth = 0);
-    std::string generateFunctionArgument(const std::shared_ptr<FunctionArgumentNode>& node);
-    std::string generateScope(const std::shared_ptr<ScopeNode>& node, int depth = 0);
-    std::string generateFunction(const std::shared_ptr<FunctionNode>& node, int depth = 0);
-    std::string generateTags(const std::unordered_map<std::string,std::string>& tags);
-    std::string generateLayout(const std::shared_ptr<LayoutNode>& node, int depth = 0);
-    std::string generateDefine(const std::shared_ptr<DefineNode>& node, int depth = 0);
-    std::string generateInclude(const std::shared_ptr<DefineNode>& node, int depth = 0);
-    std::string generateIf(const std::shared_ptr<IfNode>& node, int depth = 0);
-    std::string generateElse(const std::shared_ptr<Node>& node, int depth = 0);
-    std::string generateFor(const std::shared_ptr<ForNode>& node, int depth = 0);
-    std::string generatePushConstant(const std::shared_ptr<PushConstantNode>& node, int depth = 0);
-    std::string generateStruct(const std::shared_ptr<StructNode>& node, int depth = 0);
-    std::string generateStatement(const std::shared_ptr<Node>& node, int depth = 0);
+    void generateDeclaration(Writer& out, const std::shared_ptr<DeclarationNode>& node, int depth = 0);
+    void generateFunctionArgument(Writer& out, const std::shared_ptr<FunctionArgumentNode>& node);
+    void generateScope(Writer& out, const std::shared_ptr<ScopeNode>& node, int depth = 0);
+    void generateFunction(Writer& out, const std::shared_ptr<FunctionNode>& node, int depth = 0);
+    void generateTags(Writer& out, const std::unordered_map<std::string,std::string>& tags);
+    void generateLayout(Writer& out, const std::shared_ptr<LayoutNode>& node, int depth = 0);
+    void generateDefine(Writer& out, const std::shared_ptr<DefineNode>& node, int depth = 0);
+    void generateInclude(Writer& out, const std::shared_ptr<IncludeNode>& node, int depth = 0);
+    void generateIf(Writer& out, const std::shared_ptr<IfNode>& node, int depth = 0);
+    void generateElse(Writer& out, const std::shared_ptr<Node>& node, int depth = 0);
+    void generateFor(Writer& out, const std::shared_ptr<ForNode>& node, int depth = 0);
+    void generatePushConstant(Writer& out, const std::shared_ptr<PushConstantNode>& node, int depth = 0);
+    void generateStruct(Writer& out, const std::shared_ptr<StructNode>& node, int depth = 0);
+    void generateStatement(Writer& out, const std::shared_ptr<Node>& node, int depth = 0);
+    void generateExpression(Writer& out, const std::shared_ptr<Node>& node, int depth = 0);
+    void generateTopLevelStatement(Writer& out, const std::shared_ptr<Node>& node, int depth = 0);
+    void generateTopLevelStatement(Writer& out, const std::shared_ptr<Node>& node, const GenerateOptions& options);
+    void generate(Writer& out, const std::shared_ptr<ModuleNode>& node, int depth = 0);
+    void generate(Writer& out, const std::shared_ptr<ModuleNode>& node, const GenerateOptions& options);
+
     std::string generateExpression(const std::shared_ptr<Node>& node, int depth = 0);
+    std::string generateTopLevelStatement(const std::shared_ptr<Node>& node, int depth = 0);
     std::string generate(const std::shared_ptr<ModuleNode>& node, int depth = 0);
+    std::string generate(const std::shared_ptr<ModuleNode>& node, const GenerateOptions& options);
 }
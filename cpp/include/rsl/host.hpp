@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+
+#include "layout.hpp"
+#include "Writer.hpp"
+
+// Generates C++ mirrors of the blocks a module shares with the host from its reflection, so host code can fill them
+// in place and copy them into mapped buffers as is. Every struct is declared with the alignment and explicit padding
+// of its layout rule, followed by static_asserts on its size and the offset of every member.
+namespace rsl::host
+{
+    struct GenerateOptions
+    {
+        // Namespace the generated declarations are placed in. Left at global scope when empty.
+        std::string namespaceName{};
+    };
+
+    // Declares a struct for every uniform block, storage buffer and push constant of reflection, named after it, and
+    // one for every RSL struct they contain. A struct used under more than one layout rule gets one declaration per
+    // rule with the rule appended to its name. Vectors are arrays of their components and matrices arrays of their
+    // columns, with the padding of each column included. An unsized array at the end of a buffer is not a member,
+    // its offset and stride are given as constants instead.
+    void generate(Writer& out, const Reflection& reflection, const GenerateOptions& options = {});
+
+    std::string generate(const Reflection& reflection, const GenerateOptions& options = {});
+}
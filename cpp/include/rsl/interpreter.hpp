@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nodes.hpp"
+
+// Runs the functions of a module on the CPU, for testing shader math without a GPU and for evaluating constant
+// expressions at compile time. Functions are compiled to a flat instruction list over a register file holding a fixed
+// number of invocations per register, so every instruction processes a whole chunk of invocations in lockstep and the
+// dispatch cost is paid once per chunk instead of once per invocation.
+namespace rsl::interp
+{
+    // A value of any type, flattened to 32 bit components in declaration order. Vectors and matrices are stored
+    // component by component with matrices column major, arrays element by element and structs member by member.
+    // float components hold their bits, int and bool components their integer value.
+    struct Value
+    {
+        std::vector<uint32_t> words{};
+
+        Value() = default;
+        explicit Value(std::vector<uint32_t> inWords);
+
+        static Value Float(std::initializer_list<float> components);
+        static Value Int(std::initializer_list<int32_t> components);
+        static Value Bool(bool value);
+
+        [[nodiscard]] float GetFloat(size_t component = 0) const;
+        [[nodiscard]] int32_t GetInt(size_t component = 0) const;
+        [[nodiscard]] bool GetBool(size_t component = 0) const;
+        [[nodiscard]] size_t GetComponentCount() const;
+    };
+
+    // The same value for a number of invocations, stored component major: component c of invocation i is at
+    // words[c * count + i]
+    struct Batch
+    {
+        size_t count = 0;
+        std::vector<uint32_t> words{};
+
+        Batch() = default;
+        // Zero initialized storage for count invocations of a value with componentCount components
+        Batch(size_t inCount, size_t componentCount);
+
+        [[nodiscard]] Value Get(size_t invocation) const;
+        void Set(size_t invocation, const Value& value);
+        [[nodiscard]] size_t GetComponentCount() const;
+    };
+
+    // Not thread safe, every call runs on registers shared by the whole program
+    class Program
+    {
+        struct State;
+        std::unique_ptr<State> _state;
+
+    public:
+        // Structs, functions, constants and defines are registered up front. Functions are compiled the first time
+        // they are run, so functions that only make sense on the GPU do not stop the rest from running. Interface
+        // variables, texture sampling, derivatives and discard throw when a function that uses them is compiled.
+        explicit Program(const std::shared_ptr<ModuleNode>& module);
+        ~Program();
+        Program(Program&&) noexcept;
+        Program& operator=(Program&&) noexcept;
+
+        // Runs one invocation of the overload of function taking args.size() arguments. Out arguments are written
+        // back to args. Returns an empty value for void functions.
+        Value Invoke(const std::string& function, std::vector<Value>& args);
+
+        // Runs count invocations in lockstep. Every argument holds count invocations and out arguments are written
+        // back in place. Out arguments left empty are allocated.
+        Batch InvokeBatch(const std::string& function, std::vector<Batch>& args, size_t count);
+
+        // Evaluates an expression that may use the module's constants, defines and functions
+        Value Evaluate(const std::shared_ptr<Node>& expression);
+
+        // Evaluates expression and sets typeName to the RSL type of the result, like float3 or mat4
+        Value Evaluate(const std::shared_ptr<Node>& expression, std::string& typeName);
+
+        // Value of a top level constant, evaluated the first time it is used
+        Value GetConstant(const std::string& name);
+    };
+}
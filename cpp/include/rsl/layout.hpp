@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "nodes.hpp"
+
+// Memory layout of the blocks a module shares with the host, computed with the same std140, std430 and scalar rules
+// the GPU uses so host side uploads can match it byte for byte.
+namespace rsl
+{
+    // Structs by name, used to lay out struct members whose declaration was not resolved to its StructNode
+    using StructLookup = std::unordered_map<std::string, std::shared_ptr<StructNode>>;
+
+    struct MemberLayout
+    {
+        std::string name{};
+        // RSL type name without the array suffix
+        std::string typeName{};
+        uint32_t offset = 0;
+        // Bytes from offset to the end of the member, including the padding of array elements and struct members
+        uint32_t size = 0;
+        uint32_t alignment = 0;
+        // 0 when not an array and -1 for an unsized array
+        int arrayLength = 0;
+        uint32_t arrayStride = 0;
+        // Bytes between the columns of a matrix, or of each matrix in an array of them. 0 for other types.
+        uint32_t matrixStride = 0;
+        // Members of a struct with offsets relative to the start of the struct element
+        std::vector<MemberLayout> members{};
+    };
+
+    struct BlockLayout
+    {
+        std::string name{};
+        ELayoutRule rule = ELayoutRule::Std140;
+        // End of the last member rounded up to alignment. An unsized array at the end adds nothing, so each of its
+        // elements takes a further arrayStride bytes.
+        uint32_t size = 0;
+        uint32_t alignment = 0;
+        std::vector<MemberLayout> members{};
+
+        // Bytes of size not covered by any member, including the padding inside arrays and nested structs
+        [[nodiscard]] uint32_t GetPadding() const;
+    };
+
+    enum class EResourceType
+    {
+        UniformBlock,
+        StorageBuffer,
+        PushConstant,
+        // sampler2D, texture2D and sampler uniforms, which have no layout
+        Opaque
+    };
+
+    struct ResourceReflection
+    {
+        std::string name{};
+        EResourceType type = EResourceType::UniformBlock;
+        // -1 for push constants
+        int set = -1;
+        int binding = -1;
+        bool isReadonly = false;
+        // Empty for opaque resources
+        BlockLayout layout{};
+    };
+
+    // A stage input or output
+    struct InterfaceReflection
+    {
+        std::string name{};
+        // RSL type name without the array suffix
+        std::string typeName{};
+        // -1 when the declaration has no location
+        int location = -1;
+        // First component within the location
+        int component = 0;
+        // 0 when not an array
+        int arrayLength = 0;
+        bool isFlat = false;
+    };
+
+    struct Reflection
+    {
+        // In declaration order
+        std::vector<ResourceReflection> resources{};
+        std::vector<InterfaceReflection> inputs{};
+        std::vector<InterfaceReflection> outputs{};
+
+        [[nodiscard]] const ResourceReflection* Find(const std::string& name) const;
+    };
+
+    // The rule named by a scalar, std430 or std140 tag, or fallback when there is none
+    ELayoutRule layoutRuleOf(const std::unordered_map<std::string, std::string>& tags, ELayoutRule fallback);
+
+    std::string_view layoutRuleName(ELayoutRule rule);
+
+    // Layout of a single declaration at offset 0. Throws for types that cannot be placed in a block.
+    MemberLayout layoutOf(const DeclarationNode& declaration, ELayoutRule rule, const StructLookup& structs = {});
+
+    // Lays out declarations one after the other as the members of a block or struct. Only the last member may be an
+    // unsized array.
+    BlockLayout layoutOf(const std::string& name, const std::vector<std::shared_ptr<DeclarationNode>>& declarations,
+                         ELayoutRule rule, const StructLookup& structs = {});
+
+    // Resources, inputs and outputs declared at the top level of a module extracted for one stage. Uniform blocks
+    // default to std140, storage buffers and push constants to std430.
+    Reflection reflect(const std::shared_ptr<ModuleNode>& module);
+
+    // Human readable table of every member of layout, one per line, with nested struct members indented
+    std::string formatLayout(const BlockLayout& layout);
+}
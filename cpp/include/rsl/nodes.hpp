@@ -49,6 +49,8 @@ namespace rsl
     {
     protected:
         [[nodiscard]] virtual size_t ComputeSelfHash() const;
+        // Whether other has the same type and the same values for the fields ComputeSelfHash covers, children aside
+        [[nodiscard]] virtual bool HasSameFields(const Node& other) const;
 
     public:
         virtual ~Node() = default;
@@ -58,6 +60,9 @@ namespace rsl
 
         [[nodiscard]] virtual std::vector<std::shared_ptr<Node>> GetChildren() const = 0;
         [[nodiscard]] virtual size_t ComputeHash() const;
+        // Whether other is the same tree, compared field by field and child by child. Confirms two nodes are equal
+        // after their hashes matched.
+        [[nodiscard]] bool IsSameAs(const Node& other) const;
     };
 
 
@@ -98,6 +103,14 @@ namespace rsl
         Sampler2D
     };
 
+    // Rules for placing the members of uniform blocks, storage buffers and push constants in memory
+    enum class ELayoutRule
+    {
+        Std140,
+        Std430,
+        // Every member aligned to its component size, from the scalar tag
+        Scalar
+    };
 
     struct DeclarationNode : Node
     {
@@ -111,28 +124,31 @@ namespace rsl
 
         DeclarationNode(const Token& typeToken, const std::string& inDeclarationName, const int& inDeclarationCount);
 
-        [[nodiscard]] virtual uint64_t GetSize() const;
+        // Bytes the declaration occupies inside a block using rule, including the padding of array elements and
+        // struct members. Unsized arrays occupy nothing.
+        [[nodiscard]] uint64_t GetSize(ELayoutRule rule = ELayoutRule::Scalar) const;
 
-        virtual std::string GetTypeName();
+        [[nodiscard]] virtual std::string GetTypeName() const;
 
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
         size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct StructNode : Node
     {
         std::vector<std::shared_ptr<DeclarationNode>> declarations{};
         std::string name{};
-        [[nodiscard]] uint64_t GetSize() const;
+        [[nodiscard]] uint64_t GetSize(ELayoutRule rule = ELayoutRule::Scalar) const;
         StructNode(const std::string& inName, const std::vector<std::shared_ptr<DeclarationNode>>& inDeclarations);
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
         size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct StructDeclarationNode : DeclarationNode
     {
-        uint64_t GetSize() const override;
-        std::string GetTypeName() override;
+        [[nodiscard]] std::string GetTypeName() const override;
         [[nodiscard]] std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         std::shared_ptr<StructNode> structNode{};
@@ -142,6 +158,7 @@ namespace rsl
         explicit StructDeclarationNode(const std::shared_ptr<StructNode>& inStruct,
                                        const std::string& inDeclarationName, const int& inCount);
         size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct BufferDeclarationNode : DeclarationNode
@@ -150,15 +167,13 @@ namespace rsl
         explicit BufferDeclarationNode(const std::string& inName, const int& inCount,
                                        const std::vector<std::shared_ptr<DeclarationNode>>& inDeclarations);
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
-        std::string GetTypeName() override;
-        [[nodiscard]] uint64_t GetSize() const override;
+        [[nodiscard]] std::string GetTypeName() const override;
     };
 
     struct BlockDeclarationNode : DeclarationNode
     {
         std::vector<std::shared_ptr<DeclarationNode>> declarations{};
-        [[nodiscard]] uint64_t GetSize() const override;
-        std::string GetTypeName() override;
+        [[nodiscard]] std::string GetTypeName() const override;
         explicit BlockDeclarationNode(const std::string& inDeclarationName, const int& inCount,
                                       const std::vector<std::shared_ptr<DeclarationNode>>& inDeclarations);
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
@@ -206,6 +221,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct FunctionArgumentNode : Node
@@ -215,6 +232,8 @@ namespace rsl
 
         explicit FunctionArgumentNode(bool inIsInput, const std::shared_ptr<DeclarationNode>& inDeclaration);
         [[nodiscard]] std::vector<std::shared_ptr<Node>> GetChildren() const override;
+        size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct FunctionNode : Node
@@ -228,6 +247,8 @@ namespace rsl
                               const std::vector<std::shared_ptr<FunctionArgumentNode>>& inArguments,
                               const std::shared_ptr<ScopeNode>& inScope);
         [[nodiscard]] std::vector<std::shared_ptr<Node>> GetChildren() const override;
+        size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct IdentifierNode : Node
@@ -239,6 +260,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct AccessNode : Node
@@ -277,6 +300,8 @@ namespace rsl
         IntegerLiteralNode(const int& inData);
 
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
+        size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct BooleanLiteralNode : Node
@@ -286,6 +311,8 @@ namespace rsl
         BooleanLiteralNode(const bool& inData);
 
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
+        size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct FloatLiteralNode : Node
@@ -295,6 +322,8 @@ namespace rsl
         FloatLiteralNode(const float& inData);
 
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
+        size_t ComputeSelfHash() const override;
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct CallNode : Node
@@ -317,6 +346,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct DecrementNode : Node
@@ -329,6 +360,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct NegateNode : Node
@@ -403,6 +436,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct PushConstantNode : Node
@@ -417,7 +452,10 @@ namespace rsl
 
         size_t ComputeSelfHash() const override;
 
-        size_t GetSize() const;
+        bool HasSameFields(const Node& other) const override;
+
+        // Size of the block under the rule from its tags, std430 by default
+        [[nodiscard]] size_t GetSize() const;
     };
 
     struct DefineNode : Node
@@ -430,6 +468,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct IncludeNode : Node
@@ -442,6 +482,8 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 
     struct ConditionalNode : Node
@@ -498,5 +540,7 @@ namespace rsl
         std::vector<std::shared_ptr<Node>> GetChildren() const override;
 
         size_t ComputeSelfHash() const override;
+
+        bool HasSameFields(const Node& other) const override;
     };
 }
@@ -64,5 +64,7 @@ namespace rsl
 
     std::shared_ptr<FunctionNode> parseFunction(TokenList& input);
 
+    std::shared_ptr<Node> parseTopLevelStatement(TokenList& input);
+
     std::shared_ptr<ModuleNode> parse(TokenList& input);
 }
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "layout.hpp"
+#include "nodes.hpp"
+
+// Transformations run on an extracted scope before generation. Passes modify the module they are given in place, so
+// clone it first if its nodes are shared with other scopes.
+namespace rsl
+{
+    // Renames locals, function arguments, private globals and every function except main to the shortest names that
+    // do not collide with anything else in the module. Interface names are kept: layouts, push constants, blocks,
+    // structs and their members, defines and anything a define refers to.
+    void shortenIdentifiers(const std::shared_ptr<ModuleNode>& module);
+
+    // Removes parentheses that do not change how the generated expression parses. Define expressions are left alone
+    // since they are substituted textually.
+    void removeRedundantParentheses(const std::shared_ptr<ModuleNode>& module);
+
+    struct MemberReorder
+    {
+        // Name of the uniform block, storage buffer or push constant
+        std::string name{};
+        ELayoutRule rule = ELayoutRule::Std140;
+        uint32_t sizeBefore = 0;
+        uint32_t sizeAfter = 0;
+    };
+
+    // Reorders the members of structs, uniform blocks, storage buffers and push constants to minimize their size under
+    // the layout rules, and reorders the arguments of struct constructors to match. Changes the layout the host has to
+    // upload, so the reflection of the reordered module must be used. Returns the size of every block before and after.
+    std::vector<MemberReorder> reorderMembers(const std::shared_ptr<ModuleNode>& module);
+
+    // Evaluates arithmetic, comparisons, logic, constructors and builtins whose operands are all constant, and
+    // replaces them with literals. Values of const declarations and defines are substituted where they are used,
+    // and ifs and conditionals with a constant condition are replaced by the branch taken.
+    void foldConstants(const std::shared_ptr<ModuleNode>& module);
+
+    // Removes the functions, structs, globals, consts, defines, uniform blocks, storage buffers, textures and push
+    // constants that main cannot reach. Inputs and outputs are kept. Does nothing to a module without a main.
+    void removeUnusedDeclarations(const std::shared_ptr<ModuleNode>& module);
+
+    // Removes locals and private globals that are never read, along with the stores to them and, repeatedly, the
+    // locals that only fed those stores. Stores that call functions of the module are kept since those may have
+    // other effects.
+    void removeDeadStores(const std::shared_ptr<ModuleNode>& module);
+
+    // Links the vertex and fragment stages of one module, both extracted and with their defines applied. Inputs of
+    // either stage that are never read are removed, and vertex outputs the fragment stage has no input for stop
+    // being outputs, together with the code that only computes them. Locations are left as declared. Does nothing
+    // unless both stages have a main.
+    void linkStages(const std::shared_ptr<ModuleNode>& vertex, const std::shared_ptr<ModuleNode>& fragment);
+
+    // Assigns the locations of the varyings between the stages of a linked module, packing scalars and vectors into
+    // shared locations with component qualifiers. Components sharing a location have the same base type and
+    // interpolation. Integer varyings are made flat. Matrices and arrays take whole locations and come first. Both
+    // stages are rewritten the same way, and nothing is changed unless every fragment input has a matching output.
+    void packVaryings(const std::shared_ptr<ModuleNode>& vertex, const std::shared_ptr<ModuleNode>& fragment);
+
+    struct InlineOptions
+    {
+        // Largest body, in AST nodes, that is inlined at every call. Functions called once are inlined at any size.
+        size_t threshold = 32;
+        // Functions inlined whatever their size
+        std::unordered_set<std::string> always{};
+        // Functions never inlined
+        std::unordered_set<std::string> never{};
+    };
+
+    // Replaces calls with the body of the function called. A body that only returns an expression of its arguments
+    // replaces the call in place. Other bodies are placed before the statement making the call, with their locals
+    // renamed, in arguments copied to locals unless the argument can be used as is, out arguments copied back after
+    // it and early returns turned into stores to a result local. Calls that are only evaluated conditionally, calls
+    // in the header of a for and functions that return from inside a loop are left alone.
+    void inlineFunctions(const std::shared_ptr<ModuleNode>& module, const InlineOptions& options = {});
+
+    struct UnrollOptions
+    {
+        // Loops running at most this many times are unrolled fully
+        size_t maxIterations = 16;
+        // Largest unrolled body, in AST nodes of the loop body times the number of copies
+        size_t maxSize = 512;
+        // Loops too long to unroll fully repeat their body up to this many times per iteration. 1 only unrolls fully.
+        size_t partialFactor = 4;
+    };
+
+    // Unrolls for loops over an int declared in their init, starting at a constant and stepping by a constant
+    // towards a constant bound, whose body never writes it. Short loops are replaced by one copy of the body per
+    // iteration with the variable replaced by its value, in a scope of its own when the body declares locals.
+    // Longer loops repeat their body a number of times that divides their iterations, with the variable offset in
+    // each copy.
+    void unrollLoops(const std::shared_ptr<ModuleNode>& module, const UnrollOptions& options = {});
+
+    // Rewrites expressions into cheaper forms with the same value: operations with an identity operand such as x * 1.0
+    // or mix(a, b, 0.0) are dropped, float division by a constant multiplies by its reciprocal, pow with a constant
+    // exponent of 1 to 4 becomes multiplications and of 0.5 or -0.5 sqrt or inversesqrt, and int(floor(a / b)) and
+    // int(mod(a, b)) over ints become int division and remainder, the latter only where a is known not to be
+    // negative. Expressions are only rewritten when their type can be told and stays the same. Assignments left
+    // assigning a variable to itself, such as s = s from s = s + 0.0, are removed.
+    void simplifyExpressions(const std::shared_ptr<ModuleNode>& module);
+
+    // Computes expressions that are evaluated more than once in a scope into a local before the first, and uses the
+    // local wherever nothing the expression reads was written since. Expressions with side effects, calls to
+    // functions that write out arguments or globals, and expressions whose type cannot be declared are left alone.
+    void eliminateCommonSubexpressions(const std::shared_ptr<ModuleNode>& module);
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "layout.hpp"
+#include "Writer.hpp"
+
+// Compact binary form of a stage's reflection, written next to its GLSL or SPIR-V so pipeline layouts can be created
+// at load time without parsing any text.
+//
+// Every field is a little endian 32 bit word. The blob is a header followed by the resource, member, input and output
+// records and a table of NUL terminated strings that records refer to by offset:
+//
+//   header     magic, version, stage, resource count, member count, input count, output count, string table size
+//   resource   name, type, set, binding, readonly, rule, size, alignment, first member, member count
+//   member     name, type name, offset, size, alignment, array length, array stride, matrix stride, first member,
+//              member count
+//   interface  name, type name, location, component, array length, flat
+//
+// The members of a resource or struct are consecutive records, with their own members stored after them.
+namespace rsl
+{
+    constexpr uint32_t REFLECTION_MAGIC = 0x524c5352; // "RSLR"
+    constexpr uint32_t REFLECTION_VERSION = 2;
+
+    void writeReflection(Writer& out, const Reflection& reflection, EScopeType stage);
+
+    std::string writeReflection(const Reflection& reflection, EScopeType stage);
+
+    struct ResourceInfo
+    {
+        std::string_view name{};
+        EResourceType type = EResourceType::UniformBlock;
+        // -1 for push constants
+        int set = -1;
+        int binding = -1;
+        bool isReadonly = false;
+        ELayoutRule rule = ELayoutRule::Std140;
+        // For push constants the range is [0, size)
+        uint32_t size = 0;
+        uint32_t alignment = 0;
+        uint32_t firstMember = 0;
+        uint32_t memberCount = 0;
+    };
+
+    struct MemberInfo
+    {
+        std::string_view name{};
+        std::string_view typeName{};
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t alignment = 0;
+        // 0 when not an array and -1 for an unsized array
+        int arrayLength = 0;
+        uint32_t arrayStride = 0;
+        uint32_t matrixStride = 0;
+        uint32_t firstMember = 0;
+        uint32_t memberCount = 0;
+    };
+
+    struct InterfaceInfo
+    {
+        std::string_view name{};
+        std::string_view typeName{};
+        // -1 when the declaration has no location
+        int location = -1;
+        int component = 0;
+        int arrayLength = 0;
+        bool isFlat = false;
+    };
+
+    // Reads a blob in place without allocating. The blob is checked once on construction, after which every index
+    // below the matching count is valid. Names point into the blob, which must outlive the reader.
+    class ReflectionReader
+    {
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+        bool _valid = false;
+
+        [[nodiscard]] uint32_t Word(size_t index) const;
+        [[nodiscard]] size_t RecordStart(size_t section) const;
+        [[nodiscard]] std::string_view String(uint32_t offset) const;
+        [[nodiscard]] bool Validate() const;
+
+    public:
+        ReflectionReader(const void* data, size_t size);
+        explicit ReflectionReader(std::string_view data);
+
+        // False when the blob is truncated, of another version or refers outside itself
+        [[nodiscard]] bool IsValid() const;
+
+        // Stage the blob was written for. Fragment, the stage stored as 0, when the blob is invalid.
+        [[nodiscard]] EScopeType GetStage() const;
+
+        [[nodiscard]] uint32_t GetResourceCount() const;
+        [[nodiscard]] ResourceInfo GetResource(uint32_t index) const;
+        // Index of the resource called name, or -1
+        [[nodiscard]] int FindResource(std::string_view name) const;
+
+        [[nodiscard]] uint32_t GetMemberCount() const;
+        [[nodiscard]] MemberInfo GetMember(uint32_t index) const;
+
+        [[nodiscard]] uint32_t GetInputCount() const;
+        [[nodiscard]] InterfaceInfo GetInput(uint32_t index) const;
+
+        [[nodiscard]] uint32_t GetOutputCount() const;
+        [[nodiscard]] InterfaceInfo GetOutput(uint32_t index) const;
+    };
+}
@@ -0,0 +1,93 @@
+#ifndef RSL_H
+#define RSL_H
+
+/*
+ * C interface to the rsl compiler. Only plain C types cross this boundary so the shared library can be loaded
+ * without depending on the C++ ABI it was built with. No function throws. Memory returned by the library must be
+ * released with rsl_free.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RSL_ERROR_MESSAGE_SIZE 1024
+
+typedef struct rsl_compiler rsl_compiler;
+
+typedef enum rsl_stage
+{
+    RSL_STAGE_VERTEX = 0,
+    RSL_STAGE_FRAGMENT = 1
+} rsl_stage;
+
+typedef enum rsl_status
+{
+    RSL_OK = 0,
+    /* The source failed to tokenize, parse or generate. See rsl_error.message. */
+    RSL_ERROR_COMPILE = 1,
+    /* The output did not fit in the caller's buffer. *out_size holds the required size. */
+    RSL_ERROR_BUFFER_TOO_SMALL = 2,
+    RSL_ERROR_INVALID_ARGUMENT = 3,
+    RSL_ERROR_OUT_OF_MEMORY = 4
+} rsl_status;
+
+typedef struct rsl_error
+{
+    rsl_status status;
+    /* Null terminated, truncated to fit */
+    char message[RSL_ERROR_MESSAGE_SIZE];
+} rsl_error;
+
+typedef struct rsl_define
+{
+    const char* name;
+    /* May be null or empty to define name as 1 */
+    const char* value;
+} rsl_define;
+
+typedef struct rsl_compile_options
+{
+    /* Used for diagnostics and to resolve relative includes. When source is null the file is read from here. */
+    const char* file_name;
+    const char* source;
+    size_t source_size;
+    rsl_stage stage;
+    const rsl_define* defines;
+    size_t define_count;
+} rsl_compile_options;
+
+/* Called with consecutive pieces of the output. data is only valid for the duration of the call. */
+typedef void (*rsl_chunk_callback)(const char* data, size_t size, void* user_data);
+
+/* num_threads of 0 uses the hardware concurrency. Returns null if the compiler could not be created. */
+rsl_compiler* rsl_compiler_create(size_t num_threads);
+void rsl_compiler_destroy(rsl_compiler* compiler);
+
+/*
+ * Compiles into a null terminated buffer allocated by the library. On success *out_data must be released with
+ * rsl_free and *out_size excludes the terminator. error may be null.
+ */
+rsl_status rsl_compile(rsl_compiler* compiler, const rsl_compile_options* options, char** out_data, size_t* out_size,
+                       rsl_error* error);
+
+/*
+ * Compiles directly into buffer without allocating the output. *out_size always receives the size of the output, so
+ * passing a null buffer with a capacity of 0 measures it. The output is not null terminated.
+ */
+rsl_status rsl_compile_to_buffer(rsl_compiler* compiler, const rsl_compile_options* options, char* buffer,
+                                 size_t capacity, size_t* out_size, rsl_error* error);
+
+/* Compiles and streams the output to callback in chunks. Chunks already delivered are kept if compilation fails. */
+rsl_status rsl_compile_to_callback(rsl_compiler* compiler, const rsl_compile_options* options,
+                                   rsl_chunk_callback callback, void* user_data, rsl_error* error);
+
+void rsl_free(void* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,9 +1,21 @@
 #pragma once
+#include "Compiler.hpp"
+#include "cpp.hpp"
 #include "glsl.hpp"
+#include "host.hpp"
+#include "interpreter.hpp"
+#include "layout.hpp"
+#include "ModuleCache.hpp"
 #include "nodes.hpp"
 #include "parser.hpp"
+#include "passes.hpp"
+#include "reflection.hpp"
+#include "ShaderWatcher.hpp"
+#include "spirv.hpp"
 #include "Token.hpp"
 #include "TokenDebugInfo.hpp"
 #include "tokenizer.hpp"
+#include "ThreadPool.hpp"
 #include "TokenList.hpp"
-#include "utils.hpp"
\ No newline at end of file
+#include "utils.hpp"
+#include "Writer.hpp"
\ No newline at end of file
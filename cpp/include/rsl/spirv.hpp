@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "nodes.hpp"
+
+// Lowers an extracted scope straight to a SPIR-V 1.0 module for Vulkan, without going through GLSL text
+namespace rsl::spirv
+{
+    constexpr uint32_t MAGIC = 0x07230203;
+    constexpr uint32_t VERSION_1_0 = 0x00010000;
+
+    // The subset of the instruction set the backend emits and the validator understands
+    enum class Op : uint16_t
+    {
+        Nop = 0,
+        Undef = 1,
+        Source = 3,
+        Name = 5,
+        MemberName = 6,
+        ExtInstImport = 11,
+        ExtInst = 12,
+        MemoryModel = 14,
+        EntryPoint = 15,
+        ExecutionMode = 16,
+        Capability = 17,
+        TypeVoid = 19,
+        TypeBool = 20,
+        TypeInt = 21,
+        TypeFloat = 22,
+        TypeVector = 23,
+        TypeMatrix = 24,
+        TypeImage = 25,
+        TypeSampler = 26,
+        TypeSampledImage = 27,
+        TypeArray = 28,
+        TypeRuntimeArray = 29,
+        TypeStruct = 30,
+        TypePointer = 32,
+        TypeFunction = 33,
+        ConstantTrue = 41,
+        ConstantFalse = 42,
+        Constant = 43,
+        ConstantComposite = 44,
+        Function = 54,
+        FunctionParameter = 55,
+        FunctionEnd = 56,
+        FunctionCall = 57,
+        Variable = 59,
+        Load = 61,
+        Store = 62,
+        AccessChain = 65,
+        Decorate = 71,
+        MemberDecorate = 72,
+        VectorShuffle = 79,
+        CompositeConstruct = 80,
+        CompositeExtract = 81,
+        CompositeInsert = 82,
+        Transpose = 84,
+        SampledImage = 86,
+        ImageSampleImplicitLod = 87,
+        ImageSampleExplicitLod = 88,
+        Image = 100,
+        ImageQuerySizeLod = 103,
+        ConvertFToS = 110,
+        ConvertSToF = 111,
+        SNegate = 126,
+        FNegate = 127,
+        IAdd = 128,
+        FAdd = 129,
+        ISub = 130,
+        FSub = 131,
+        IMul = 132,
+        FMul = 133,
+        SDiv = 135,
+        FDiv = 136,
+        SMod = 139,
+        FMod = 141,
+        VectorTimesScalar = 142,
+        MatrixTimesScalar = 143,
+        VectorTimesMatrix = 144,
+        MatrixTimesVector = 145,
+        MatrixTimesMatrix = 146,
+        Dot = 148,
+        Any = 154,
+        All = 155,
+        LogicalEqual = 164,
+        LogicalNotEqual = 165,
+        LogicalOr = 166,
+        LogicalAnd = 167,
+        LogicalNot = 168,
+        Select = 169,
+        IEqual = 170,
+        INotEqual = 171,
+        SGreaterThan = 173,
+        SGreaterThanEqual = 175,
+        SLessThan = 177,
+        SLessThanEqual = 179,
+        FOrdEqual = 180,
+        FOrdNotEqual = 182,
+        FOrdLessThan = 184,
+        FOrdGreaterThan = 186,
+        FOrdLessThanEqual = 188,
+        FOrdGreaterThanEqual = 190,
+        DPdx = 207,
+        DPdy = 208,
+        Fwidth = 209,
+        Phi = 245,
+        LoopMerge = 246,
+        SelectionMerge = 247,
+        Label = 248,
+        Branch = 249,
+        BranchConditional = 250,
+        Kill = 252,
+        Return = 253,
+        ReturnValue = 254,
+        Unreachable = 255
+    };
+
+    enum class StorageClass : uint32_t
+    {
+        UniformConstant = 0,
+        Input = 1,
+        Uniform = 2,
+        Output = 3,
+        Private = 6,
+        Function = 7,
+        PushConstant = 9
+    };
+
+    // Generates a module whose entry point is the scope's main function. Defines are substituted at each use and the
+    // GLSL.std.450 instruction set backs the builtin functions. Throws on constructs that have no SPIR-V lowering.
+    std::vector<uint32_t> generate(const std::shared_ptr<ModuleNode>& module, EScopeType scopeType);
+
+    // Checks the structure of a module without disassembling it: header, section order, id definitions, block
+    // structure of every function, entry point interfaces and the types of loads, stores and returns. Covers the
+    // instructions generate emits. Throws std::runtime_error describing the first problem found.
+    void validate(const std::vector<uint32_t>& words);
+}
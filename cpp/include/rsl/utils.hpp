@@ -72,16 +72,45 @@ namespace rsl
         return result;
     }
 
+    // Loads and parses the file at an absolute path, used to pull in #include targets
+    using ModuleLoader = std::function<std::shared_ptr<ModuleNode>(const std::string& filePath)>;
+
+    std::shared_ptr<ModuleNode> loadModule(const std::string& filePath);
+
+    // Deep copies a node tree. Struct declarations keep pointing at the original struct until resolveReferences runs
+    std::shared_ptr<Node> cloneNode(const std::shared_ptr<Node>& node);
+
+    template <typename T>
+    std::shared_ptr<T> clone(const std::shared_ptr<T>& node);
+
+    template <typename T>
+    std::shared_ptr<T> clone(const std::shared_ptr<T>& node)
+    {
+        return std::dynamic_pointer_cast<T>(cloneNode(node));
+    }
+
+    void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node, std::set<std::string>& included,
+                         const ModuleLoader& loader);
+
     void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node, std::set<std::string>& included);
 
     void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node);
 
+    void resolveIncludes(const std::shared_ptr<ModuleNode>& node, std::set<std::string>& included,
+                         const ModuleLoader& loader);
+
     void resolveIncludes(const std::shared_ptr<ModuleNode>& node, std::set<std::string>& included);
 
     void resolveIncludes(const std::shared_ptr<ModuleNode>& node);
 
     void walk(const std::shared_ptr<Node>& start, const std::function<bool(const std::shared_ptr<Node>&)>& callback);
 
+    using NodeTransform = std::function<std::shared_ptr<Node>(const std::shared_ptr<Node>&)>;
+
+    // Replaces every direct child of node with transform(child). Struct declarations are left alone since their
+    // struct is a reference rather than a child. Throws if a child is replaced with a node of the wrong kind.
+    void transformChildren(const std::shared_ptr<Node>& node, const NodeTransform& transform);
+
     void resolveReferences(const std::shared_ptr<ModuleNode>& node);
 
     std::shared_ptr<ModuleNode> extractScope(const std::shared_ptr<ModuleNode>& node, const EScopeType& scopeType);
@@ -0,0 +1,502 @@
+#include "rsl/Compiler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <string_view>
+
+#include "rsl/cpp.hpp"
+#include "rsl/host.hpp"
+#include "rsl/parser.hpp"
+#include "rsl/passes.hpp"
+#include "rsl/spirv.hpp"
+#include "rsl/tokenizer.hpp"
+#include "rsl/utils.hpp"
+
+namespace rsl
+{
+    namespace
+    {
+        struct ParsedSource
+        {
+            std::shared_ptr<ModuleNode> ast{};
+            std::set<std::string> includes{};
+            std::string error{};
+            std::chrono::microseconds parseTime{};
+        };
+
+        std::chrono::microseconds elapsedSince(const std::chrono::steady_clock::time_point& start)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        }
+
+        struct SourceKeyHash
+        {
+            size_t operator()(const std::pair<std::string_view, std::string_view>& key) const
+            {
+                return hashCombine(key.first, key.second);
+            }
+        };
+
+        struct CancelledError : std::runtime_error
+        {
+            CancelledError() : std::runtime_error("Compilation cancelled")
+            {
+            }
+        };
+
+        void throwIfCancelled(const std::atomic<bool>* cancelled)
+        {
+            if (cancelled && *cancelled) throw CancelledError();
+        }
+
+        // Appends the module for scope as raw words after checking its structure
+        void generateSpirv(Writer& out, const std::shared_ptr<ModuleNode>& scope, EScopeType scopeType)
+        {
+            const auto words = spirv::generate(scope, scopeType);
+            spirv::validate(words);
+            out << std::string_view(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint32_t));
+        }
+
+        // Namespace generated headers are placed in, named after the source file
+        std::string namespaceFor(const CompileJob& job)
+        {
+            auto name = std::filesystem::path(job.fileName).stem().string();
+            for (auto& c : name)
+            {
+                if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+            }
+            if (!name.empty() && std::isdigit(static_cast<unsigned char>(name[0])))
+            {
+                name.insert(0, "_");
+            }
+            return name;
+        }
+
+        // Generates a header for the whole module
+        void generateCpp(Writer& out, const std::shared_ptr<ModuleNode>& ast, const CompileJob& job, int lanes)
+        {
+            auto module = std::make_shared<ModuleNode>(ast->statements);
+            applyDefines(module, job.defines);
+
+            cpp::GenerateOptions options{};
+            options.lanes = lanes;
+            options.namespaceName = namespaceFor(job);
+            cpp::generate(out, module, options);
+        }
+    }
+
+    void applyDefines(const std::shared_ptr<ModuleNode>& node, const std::unordered_map<std::string, std::string>& defines)
+    {
+        if (defines.empty()) return;
+
+        std::vector<std::shared_ptr<Node>> statements{};
+        statements.reserve(node->statements.size() + defines.size());
+
+        for (auto& [id,value] : defines)
+        {
+            auto tokens = tokenize("<define>", value);
+            statements.push_back(std::make_shared<DefineNode>(id, tokens.Empty()
+                                                                      ? std::make_shared<IntegerLiteralNode>(1)
+                                                                      : parseExpression(tokens)));
+        }
+
+        for (auto& statement : node->statements)
+        {
+            if (statement->nodeType == NodeType::Define)
+            {
+                if (auto asDefine = std::dynamic_pointer_cast<DefineNode>(statement); defines.contains(asDefine->id))
+                {
+                    continue;
+                }
+            }
+
+            statements.push_back(statement);
+        }
+
+        node->statements = statements;
+    }
+
+    CompileHandle::CompileHandle(const std::shared_ptr<std::atomic<bool>>& inCancelled,
+                                 const std::shared_future<CompileResult>& inFuture)
+    {
+        _cancelled = inCancelled;
+        _future = inFuture;
+    }
+
+    void CompileHandle::Cancel() const
+    {
+        if (_cancelled) *_cancelled = true;
+    }
+
+    bool CompileHandle::IsCancelled() const
+    {
+        return _cancelled && *_cancelled;
+    }
+
+    bool CompileHandle::IsReady() const
+    {
+        return _future.valid() && _future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    bool CompileHandle::IsValid() const
+    {
+        return _future.valid();
+    }
+
+    const CompileResult& CompileHandle::Get() const
+    {
+        return _future.get();
+    }
+
+    const std::shared_future<CompileResult>& CompileHandle::GetFuture() const
+    {
+        return _future;
+    }
+
+    Compiler::Compiler(size_t numThreads, const CompilerOptions& options) : _pool(numThreads), _options(options)
+    {
+    }
+
+    glsl::GenerateOptions Compiler::MakeGenerateOptions()
+    {
+        glsl::GenerateOptions options{};
+        if (_options.parallelGenerate) options.pool = &_pool;
+        if (_options.cacheGenerated) options.cache = &_generateCache;
+        options.minify = _options.minify;
+        return options;
+    }
+
+    void Compiler::OptimizeForLink(const std::shared_ptr<ModuleNode>& stage) const
+    {
+        inlineFunctions(stage, _options.inlining);
+        foldConstants(stage);
+        // Folded first so loops bounded by constants are found, and again to propagate the unrolled variables
+        unrollLoops(stage, _options.unrolling);
+        foldConstants(stage);
+        simplifyExpressions(stage);
+    }
+
+    std::shared_ptr<ModuleNode> Compiler::ExtractStage(const std::shared_ptr<ModuleNode>& ast, const CompileJob& job,
+                                                       EScopeType scopeType, CompileResult& result) const
+    {
+        auto scope = extractScope(ast, scopeType);
+        applyDefines(scope, job.defines);
+        if (!_options.minify && !_options.reorderMembers && !_options.optimize) return scope;
+
+        // extractScope shares nodes with the parsed module and the module cache
+        auto passed = clone(scope);
+        if (_options.reorderMembers) result.reorderedMembers = reorderMembers(passed);
+        if (_options.optimize)
+        {
+            OptimizeForLink(passed);
+
+            // Each stage job links against its own copy of the other stage. Both copies go through the same passes
+            // as the stage itself, so every job sees the same reads and reaches the same interface.
+            const auto otherType = scopeType == EScopeType::Vertex ? EScopeType::Fragment : EScopeType::Vertex;
+            auto other = clone(extractScope(ast, otherType));
+            applyDefines(other, job.defines);
+            OptimizeForLink(other);
+            auto& vertex = scopeType == EScopeType::Vertex ? passed : other;
+            auto& fragment = scopeType == EScopeType::Vertex ? other : passed;
+            linkStages(vertex, fragment);
+            packVaryings(vertex, fragment);
+
+            eliminateCommonSubexpressions(passed);
+            removeDeadStores(passed);
+            removeUnusedDeclarations(passed);
+        }
+        if (_options.minify)
+        {
+            shortenIdentifiers(passed);
+            removeRedundantParentheses(passed);
+        }
+        return passed;
+    }
+
+    void Compiler::GenerateHost(Writer& out, const std::shared_ptr<ModuleNode>& ast, const CompileJob& job,
+                                CompileResult& result) const
+    {
+        // Blocks may be declared inside a stage, so the stages are merged by name
+        for (auto scopeType : {EScopeType::Vertex, EScopeType::Fragment})
+        {
+            CompileResult stageResult{};
+            auto scope = ExtractStage(ast, job, scopeType, stageResult);
+            for (auto& resource : reflect(scope).resources)
+            {
+                if (!result.reflection.Find(resource.name)) result.reflection.resources.push_back(std::move(resource));
+            }
+            for (auto& reorder : stageResult.reorderedMembers)
+            {
+                if (std::ranges::none_of(result.reorderedMembers, [&reorder](const MemberReorder& existing)
+                {
+                    return existing.name == reorder.name;
+                }))
+                {
+                    result.reorderedMembers.push_back(reorder);
+                }
+            }
+        }
+
+        host::GenerateOptions options{};
+        options.namespaceName = namespaceFor(job);
+        host::generate(out, result.reflection, options);
+    }
+
+    std::shared_ptr<ModuleNode> Compiler::ParseRoot(const CompileJob& job, std::set<std::string>& dependencies,
+                                                    const std::atomic<bool>* cancelled,
+                                                    const CompilePhaseCallback& onPhase)
+    {
+        std::shared_ptr<ModuleNode> ast{};
+
+        if (job.source.empty())
+        {
+            ast = _moduleCache.Get(job.fileName);
+            if (onPhase) onPhase(ECompilePhase::Tokenized);
+        }
+        else
+        {
+            auto tokens = tokenize(job.fileName, job.source);
+            if (onPhase) onPhase(ECompilePhase::Tokenized);
+            throwIfCancelled(cancelled);
+
+            std::vector<std::shared_ptr<Node>> statements{};
+            while (tokens.NotEmpty())
+            {
+                statements.push_back(parseTopLevelStatement(tokens));
+                throwIfCancelled(cancelled);
+            }
+            ast = std::make_shared<ModuleNode>(statements);
+        }
+
+        resolveIncludes(ast, dependencies, [this](const std::string& filePath)
+        {
+            return _moduleCache.Get(filePath);
+        });
+        resolveReferences(ast);
+        return ast;
+    }
+
+    CompileResult Compiler::CompileCancellable(const CompileJob& job, const std::atomic<bool>& cancelled,
+                                               const CompilePhaseCallback& onPhase, Writer& out)
+    {
+        CompileResult result{};
+
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto ast = ParseRoot(job, result.dependencies, &cancelled, onPhase);
+            result.parseTime = elapsedSince(start);
+            if (onPhase) onPhase(ECompilePhase::Parsed);
+            throwIfCancelled(&cancelled);
+
+            start = std::chrono::steady_clock::now();
+            if (_options.target == ECompileTarget::Cpp)
+            {
+                generateCpp(out, ast, job, _options.cpuLanes);
+            }
+            else if (_options.target == ECompileTarget::Host)
+            {
+                GenerateHost(out, ast, job, result);
+            }
+            else
+            {
+                auto scope = ExtractStage(ast, job, job.scopeType, result);
+                if (_options.reflect) result.reflection = reflect(scope);
+
+                if (_options.target == ECompileTarget::Spirv)
+                {
+                    generateSpirv(out, scope, job.scopeType);
+                }
+                else if (auto generateOptions = MakeGenerateOptions(); generateOptions.pool)
+                {
+                    glsl::generate(out, scope, generateOptions);
+                    throwIfCancelled(&cancelled);
+                }
+                else
+                {
+                    for (auto& statement : scope->statements)
+                    {
+                        glsl::generateTopLevelStatement(out, statement, generateOptions);
+                        out.Commit();
+                        throwIfCancelled(&cancelled);
+                    }
+                }
+            }
+            out.Flush();
+            result.outputSize = out.GetTotalSize();
+
+            result.generateTime = elapsedSince(start);
+            result.success = true;
+            if (onPhase) onPhase(ECompilePhase::Generated);
+        }
+        catch (const CancelledError& e)
+        {
+            result.cancelled = true;
+            result.error = e.what();
+        }
+        catch (const std::exception& e)
+        {
+            result.error = e.what();
+        }
+
+        return result;
+    }
+
+    CompileResult Compiler::Compile(const CompileJob& job)
+    {
+        Writer out{};
+        const std::atomic<bool> cancelled = false;
+        auto result = CompileCancellable(job, cancelled, {}, out);
+        if (result.success) result.output = out.Take();
+        return result;
+    }
+
+    CompileResult Compiler::Compile(const CompileJob& job, Writer& out)
+    {
+        const std::atomic<bool> cancelled = false;
+        return CompileCancellable(job, cancelled, {}, out);
+    }
+
+    std::vector<CompileResult> Compiler::CompileBatch(const std::vector<CompileJob>& jobs)
+    {
+        std::unordered_map<std::pair<std::string_view, std::string_view>, size_t, SourceKeyHash> sourceIndices{};
+        std::vector<const CompileJob*> uniqueSources{};
+        std::vector<size_t> jobSources{};
+        jobSources.reserve(jobs.size());
+
+        for (auto& job : jobs)
+        {
+            auto [it, inserted] = sourceIndices.try_emplace({job.fileName, job.source}, uniqueSources.size());
+            if (inserted)
+            {
+                uniqueSources.push_back(&job);
+            }
+            jobSources.push_back(it->second);
+        }
+
+        std::vector<ParsedSource> parsed(uniqueSources.size());
+
+        _pool.ParallelFor(uniqueSources.size(), [this,&uniqueSources,&parsed](size_t i)
+        {
+            try
+            {
+                auto start = std::chrono::steady_clock::now();
+                parsed[i].ast = ParseRoot(*uniqueSources[i], parsed[i].includes);
+                parsed[i].parseTime = elapsedSince(start);
+            }
+            catch (const std::exception& e)
+            {
+                parsed[i].error = e.what();
+            }
+        });
+
+        std::vector<CompileResult> results(jobs.size());
+
+        const auto generateOptions = MakeGenerateOptions();
+        _pool.ParallelFor(jobs.size(), [this,&jobs,&jobSources,&parsed,&results,&generateOptions](size_t i)
+        {
+            auto& source = parsed[jobSources[i]];
+            auto& result = results[i];
+            result.dependencies = source.includes;
+            result.parseTime = source.parseTime;
+
+            if (!source.ast)
+            {
+                result.error = source.error;
+                return;
+            }
+
+            try
+            {
+                auto start = std::chrono::steady_clock::now();
+                if (_options.target == ECompileTarget::Cpp)
+                {
+                    Writer out{};
+                    generateCpp(out, source.ast, jobs[i], _options.cpuLanes);
+                    result.output = out.Take();
+                }
+                else if (_options.target == ECompileTarget::Host)
+                {
+                    Writer out{};
+                    GenerateHost(out, source.ast, jobs[i], result);
+                    result.output = out.Take();
+                }
+                else
+                {
+                    auto scope = ExtractStage(source.ast, jobs[i], jobs[i].scopeType, result);
+                    if (_options.reflect) result.reflection = reflect(scope);
+                    if (_options.target == ECompileTarget::Spirv)
+                    {
+                        Writer out{};
+                        generateSpirv(out, scope, jobs[i].scopeType);
+                        result.output = out.Take();
+                    }
+                    else
+                    {
+                        result.output = glsl::generate(scope, generateOptions);
+                    }
+                }
+                result.outputSize = result.output.size();
+                result.generateTime = elapsedSince(start);
+                result.success = true;
+            }
+            catch (const std::exception& e)
+            {
+                result.error = e.what();
+            }
+        });
+
+        return results;
+    }
+
+    std::vector<CompileResult> Compiler::CompileStages(const CompileJob& job, const std::vector<EScopeType>& stages)
+    {
+        std::vector<CompileJob> jobs(stages.size(), job);
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            jobs[i].scopeType = stages[i];
+        }
+
+        return CompileBatch(jobs);
+    }
+
+    CompileHandle Compiler::CompileAsync(const CompileJob& job, const CompilePhaseCallback& onPhase)
+    {
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+        auto future = _pool.Submit([this, job, onPhase, cancelled]
+        {
+            Writer out{};
+            auto result = CompileCancellable(job, *cancelled, onPhase, out);
+            if (result.success) result.output = out.Take();
+            return result;
+        });
+
+        return {cancelled, future.share()};
+    }
+
+    ThreadPool& Compiler::GetPool()
+    {
+        return _pool;
+    }
+
+    ModuleCache& Compiler::GetModuleCache()
+    {
+        return _moduleCache;
+    }
+
+    glsl::GenerateCache& Compiler::GetGenerateCache()
+    {
+        return _generateCache;
+    }
+
+    void Compiler::SetOptions(const CompilerOptions& options)
+    {
+        _options = options;
+    }
+
+    const CompilerOptions& Compiler::GetOptions() const
+    {
+        return _options;
+    }
+}
@@ -0,0 +1,111 @@
+#include "rsl/GenerateCache.hpp"
+
+#include <mutex>
+
+#include "rsl/utils.hpp"
+
+namespace rsl::glsl
+{
+    GenerateCache::GenerateCache(size_t inCapacity)
+    {
+        _capacity = inCapacity;
+    }
+
+    bool GenerateCache::Write(size_t key, const Node& node, Writer& out)
+    {
+        {
+            std::shared_lock lock(_mutex);
+            if (auto it = _entries.find(key); it != _entries.end())
+            {
+                for (auto& entry : it->second)
+                {
+                    if (!entry.node->IsSameAs(node)) continue;
+
+                    out << entry.text;
+                    ++_hits;
+                    return true;
+                }
+            }
+        }
+
+        ++_misses;
+        return false;
+    }
+
+    void GenerateCache::Insert(size_t key, const std::shared_ptr<Node>& node, std::string text)
+    {
+        // Copied outside the lock, and so later passes over node cannot change the cached key
+        auto copy = cloneNode(node);
+
+        std::unique_lock lock(_mutex);
+        // Texts larger than the whole cache are never kept
+        if (text.size() > _capacity) return;
+
+        if (auto it = _entries.find(key); it != _entries.end())
+        {
+            for (auto& entry : it->second)
+            {
+                if (entry.node->IsSameAs(*node)) return;
+            }
+        }
+
+        if (_textSize + text.size() > _capacity)
+        {
+            _entries.clear();
+            _size = 0;
+            _textSize = 0;
+            ++_clears;
+        }
+
+        _textSize += text.size();
+        ++_size;
+        _entries[key].push_back({std::move(copy), std::move(text)});
+    }
+
+    void GenerateCache::Clear()
+    {
+        std::unique_lock lock(_mutex);
+        _entries.clear();
+        _size = 0;
+        _textSize = 0;
+    }
+
+    size_t GenerateCache::GetSize()
+    {
+        std::shared_lock lock(_mutex);
+        return _size;
+    }
+
+    size_t GenerateCache::GetCapacity()
+    {
+        std::shared_lock lock(_mutex);
+        return _capacity;
+    }
+
+    void GenerateCache::SetCapacity(size_t capacity)
+    {
+        std::unique_lock lock(_mutex);
+        _capacity = capacity;
+        if (_textSize <= _capacity) return;
+
+        _entries.clear();
+        _size = 0;
+        _textSize = 0;
+        ++_clears;
+    }
+
+    uint64_t GenerateCache::GetHits() const
+    {
+        return _hits;
+    }
+
+    uint64_t GenerateCache::GetMisses() const
+    {
+        return _misses;
+    }
+
+    uint64_t GenerateCache::GetClears() const
+    {
+        return _clears;
+    }
+}
@@ -0,0 +1,74 @@
+#include "rsl/ModuleCache.hpp"
+
+#include "rsl/utils.hpp"
+
+namespace rsl
+{
+    namespace
+    {
+        std::string normalizePath(const std::string& filePath)
+        {
+            return std::filesystem::absolute(filePath).lexically_normal().string();
+        }
+    }
+
+    std::shared_ptr<ModuleNode> ModuleCache::Get(const std::string& filePath)
+    {
+        const auto key = normalizePath(filePath);
+
+        std::error_code error{};
+        const auto lastWriteTime = std::filesystem::last_write_time(key, error);
+        const auto fileSize = error ? 0 : std::filesystem::file_size(key, error);
+
+        {
+            std::lock_guard lock(_mutex);
+            if (auto it = _entries.find(key); !error && it != _entries.end() && it->second.lastWriteTime ==
+                lastWriteTime && it->second.fileSize == fileSize)
+            {
+                ++_hits;
+                return clone(it->second.module);
+            }
+        }
+
+        ++_misses;
+
+        // Parse outside the lock so unrelated files can load concurrently
+        auto module = loadModule(key);
+
+        if (!error)
+        {
+            std::lock_guard lock(_mutex);
+            _entries.insert_or_assign(key, Entry{lastWriteTime, fileSize, module});
+        }
+
+        return clone(module);
+    }
+
+    void ModuleCache::Invalidate(const std::string& filePath)
+    {
+        std::lock_guard lock(_mutex);
+        _entries.erase(normalizePath(filePath));
+    }
+
+    void ModuleCache::Clear()
+    {
+        std::lock_guard lock(_mutex);
+        _entries.clear();
+    }
+
+    size_t ModuleCache::GetSize()
+    {
+        std::lock_guard lock(_mutex);
+        return _entries.size();
+    }
+
+    uint64_t ModuleCache::GetHits() const
+    {
+        return _hits;
+    }
+
+    uint64_t ModuleCache::GetMisses() const
+    {
+        return _misses;
+    }
+}
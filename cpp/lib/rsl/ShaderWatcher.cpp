@@ -0,0 +1,288 @@
+#include "rsl/ShaderWatcher.hpp"
+
+#include <algorithm>
+#include <ranges>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace rsl
+{
+    namespace
+    {
+        std::string normalizePath(const std::filesystem::path& path)
+        {
+            return std::filesystem::absolute(path).lexically_normal().string();
+        }
+
+        std::filesystem::file_time_type lastWriteTime(const std::string& filePath)
+        {
+            std::error_code error{};
+            auto time = std::filesystem::last_write_time(filePath, error);
+            return error ? std::filesystem::file_time_type::min() : time;
+        }
+
+        // The root and every file it included in any stage
+        std::set<std::string> filesOf(const std::string& rootFile, const std::vector<CompileResult>& results)
+        {
+            std::set<std::string> files{rootFile};
+            for (auto& result : results)
+            {
+                files.insert(result.dependencies.begin(), result.dependencies.end());
+            }
+            return files;
+        }
+    }
+
+    ShaderWatcher::ShaderWatcher(Compiler& compiler, const ShaderReloadCallback& onReload,
+                                 std::chrono::milliseconds debounce) : _compiler(compiler), _onReload(onReload),
+                                                                       _debounce(debounce)
+    {
+#ifdef __linux__
+        _notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+        _thread = std::thread([this]
+        {
+            Run();
+        });
+    }
+
+    ShaderWatcher::~ShaderWatcher()
+    {
+        _stopping = true;
+        _thread.join();
+#ifdef __linux__
+        if (_notifyFd >= 0) close(_notifyFd);
+#endif
+    }
+
+    std::vector<CompileResult> ShaderWatcher::CompileRoot(const std::string& rootFile, const WatchedRoot& root)
+    {
+        return _compiler.CompileStages({rootFile, "", EScopeType::Fragment, root.defines}, root.stages);
+    }
+
+    void ShaderWatcher::UpdateWatches()
+    {
+        std::set<std::string> files{};
+        for (auto& root : _roots | std::views::values)
+        {
+            files.insert(root.files.begin(), root.files.end());
+        }
+
+        std::map<std::string, std::filesystem::file_time_type> fileTimes{};
+        for (auto& file : files)
+        {
+            auto existing = _fileTimes.find(file);
+            fileTimes.emplace(file, existing == _fileTimes.end() ? lastWriteTime(file) : existing->second);
+        }
+        _fileTimes = fileTimes;
+
+#ifdef __linux__
+        if (_notifyFd < 0) return;
+
+        std::set<std::string> directories{};
+        for (auto& file : files)
+        {
+            directories.insert(std::filesystem::path(file).parent_path().string());
+        }
+
+        for (auto it = _directoryWatches.begin(); it != _directoryWatches.end();)
+        {
+            if (directories.contains(it->first))
+            {
+                ++it;
+                continue;
+            }
+
+            inotify_rm_watch(_notifyFd, it->second);
+            _watchDirectories.erase(it->second);
+            it = _directoryWatches.erase(it);
+        }
+
+        // Watch directories rather than files so editors that save by renaming a temporary file are seen
+        for (auto& directory : directories)
+        {
+            if (_directoryWatches.contains(directory)) continue;
+
+            const auto wd = inotify_add_watch(_notifyFd, directory.c_str(),
+                                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+            if (wd < 0) continue;
+
+            _directoryWatches.emplace(directory, wd);
+            _watchDirectories.emplace(wd, directory);
+        }
+#endif
+    }
+
+    void ShaderWatcher::CollectChanges()
+    {
+        const auto timeout = _pendingFiles.empty() ? std::chrono::milliseconds(100) : _debounce;
+
+#ifdef __linux__
+        if (_notifyFd >= 0)
+        {
+            pollfd descriptor{_notifyFd, POLLIN, 0};
+            if (poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0) return;
+
+            alignas(inotify_event) char buffer[4096];
+            std::lock_guard lock(_mutex);
+            while (true)
+            {
+                const auto count = read(_notifyFd, buffer, sizeof(buffer));
+                if (count <= 0) break;
+
+                for (ssize_t offset = 0; offset < count;)
+                {
+                    const auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                    offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+                    auto directory = _watchDirectories.find(event->wd);
+                    if (event->len == 0 || directory == _watchDirectories.end()) continue;
+
+                    auto file = normalizePath(std::filesystem::path(directory->second) / event->name);
+                    if (!_fileTimes.contains(file)) continue;
+
+                    _pendingFiles.insert(file);
+                    _lastChange = std::chrono::steady_clock::now();
+                }
+            }
+            return;
+        }
+#endif
+
+        std::this_thread::sleep_for(timeout);
+
+        std::lock_guard lock(_mutex);
+        for (auto& [file,time] : _fileTimes)
+        {
+            if (auto current = lastWriteTime(file); current != time)
+            {
+                time = current;
+                _pendingFiles.insert(file);
+                _lastChange = std::chrono::steady_clock::now();
+            }
+        }
+    }
+
+    void ShaderWatcher::FlushChanges()
+    {
+        // Copies of the affected roots, compiled once the lock is released
+        std::vector<std::pair<std::string, WatchedRoot>> affected{};
+
+        {
+            std::lock_guard lock(_mutex);
+            if (_pendingFiles.empty() || std::chrono::steady_clock::now() - _lastChange < _debounce) return;
+
+            auto changed = std::move(_pendingFiles);
+            _pendingFiles.clear();
+
+            for (auto& file : changed)
+            {
+                _compiler.GetModuleCache().Invalidate(file);
+                _fileTimes[file] = lastWriteTime(file);
+            }
+
+            for (auto& [rootFile,root] : _roots)
+            {
+                auto dependsOnChange = std::ranges::any_of(changed, [&root](const std::string& file)
+                {
+                    return root.files.contains(file);
+                });
+
+                if (dependsOnChange) affected.emplace_back(rootFile, root);
+            }
+        }
+
+        if (affected.empty()) return;
+
+        std::vector<std::vector<CompileResult>> compiled{};
+        compiled.reserve(affected.size());
+        for (auto& [rootFile,root] : affected)
+        {
+            compiled.push_back(CompileRoot(rootFile, root));
+        }
+
+        std::vector<ShaderReloadEvent> events{};
+
+        {
+            std::lock_guard lock(_mutex);
+            for (size_t i = 0; i < affected.size(); i++)
+            {
+                auto& [rootFile,snapshot] = affected[i];
+                auto root = _roots.find(rootFile);
+                if (root == _roots.end() || root->second.generation != snapshot.generation) continue;
+
+                auto& results = compiled[i];
+                root->second.files = filesOf(rootFile, results);
+                for (size_t stage = 0; stage < results.size(); stage++)
+                {
+                    auto& previous = root->second.outputs[snapshot.stages[stage]];
+                    if (results[stage].success && results[stage].output == previous) continue;
+
+                    if (results[stage].success) previous = results[stage].output;
+                    events.push_back({rootFile, snapshot.stages[stage], results[stage]});
+                }
+            }
+
+            UpdateWatches();
+        }
+
+        for (auto& event : events)
+        {
+            _onReload(event);
+        }
+    }
+
+    void ShaderWatcher::Run()
+    {
+        while (!_stopping)
+        {
+            CollectChanges();
+            FlushChanges();
+        }
+    }
+
+    std::vector<CompileResult> ShaderWatcher::Watch(const std::string& rootFile, const std::vector<EScopeType>& stages,
+                                                    const std::unordered_map<std::string, std::string>& defines)
+    {
+        auto key = normalizePath(rootFile);
+        WatchedRoot snapshot{};
+
+        {
+            std::lock_guard lock(_mutex);
+            auto& root = _roots[key];
+            root.stages = stages;
+            root.defines = defines;
+            root.files = {key};
+            root.outputs.clear();
+            root.generation = ++_nextGeneration;
+            snapshot = root;
+            UpdateWatches();
+        }
+
+        auto results = CompileRoot(key, snapshot);
+
+        std::lock_guard lock(_mutex);
+        auto root = _roots.find(key);
+        if (root == _roots.end() || root->second.generation != snapshot.generation) return results;
+
+        root->second.files = filesOf(key, results);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            if (results[i].success) root->second.outputs[stages[i]] = results[i].output;
+        }
+
+        UpdateWatches();
+        return results;
+    }
+
+    void ShaderWatcher::Unwatch(const std::string& rootFile)
+    {
+        std::lock_guard lock(_mutex);
+        _roots.erase(normalizePath(rootFile));
+        UpdateWatches();
+    }
+}
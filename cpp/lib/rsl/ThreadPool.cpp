@@ -0,0 +1,202 @@
+#include "rsl/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace rsl
+{
+    namespace
+    {
+        thread_local ThreadPool* currentPool = nullptr;
+        thread_local size_t currentWorker = 0;
+    }
+
+    ThreadPool::ThreadPool(size_t numThreads)
+    {
+        if (numThreads == 0)
+        {
+            numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        _queues.reserve(numThreads);
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            _queues.push_back(std::make_unique<WorkerQueue>());
+        }
+
+        _threads.reserve(numThreads);
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            _threads.emplace_back([this, i]
+            {
+                RunWorker(i);
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(_wakeMutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+
+        for (auto& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    bool ThreadPool::TryPop(size_t queueIndex, std::function<void()>& task)
+    {
+        auto& queue = *_queues[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        --_pending;
+        return true;
+    }
+
+    bool ThreadPool::TrySteal(size_t thiefIndex, std::function<void()>& task)
+    {
+        for (size_t i = 1; i <= _queues.size(); i++)
+        {
+            auto& queue = *_queues[(thiefIndex + i) % _queues.size()];
+            std::unique_lock lock(queue.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || queue.tasks.empty()) continue;
+
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --_pending;
+            return true;
+        }
+
+        return false;
+    }
+
+    void ThreadPool::RunWorker(size_t index)
+    {
+        currentPool = this;
+        currentWorker = index;
+
+        while (true)
+        {
+            std::function<void()> task{};
+            if (TryPop(index, task) || TrySteal(index, task))
+            {
+                task();
+                continue;
+            }
+
+            std::unique_lock lock(_wakeMutex);
+            _wake.wait(lock, [this]
+            {
+                return _stopping || _pending > 0;
+            });
+
+            if (_stopping && _pending == 0) return;
+        }
+    }
+
+    void ThreadPool::Enqueue(std::function<void()> task)
+    {
+        const auto queueIndex = currentPool == this ? currentWorker : _nextQueue++ % _queues.size();
+
+        {
+            // Counted under the queue lock, before any worker can pop the task, so _pending never drops below zero
+            auto& queue = *_queues[queueIndex];
+            std::lock_guard lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+            ++_pending;
+        }
+
+        {
+            std::lock_guard lock(_wakeMutex);
+        }
+        _wake.notify_one();
+    }
+
+    bool ThreadPool::RunPendingTask()
+    {
+        std::function<void()> task{};
+        const auto index = currentPool == this ? currentWorker : 0;
+        if ((currentPool == this && TryPop(index, task)) || TrySteal(index, task))
+        {
+            task();
+            return true;
+        }
+
+        return false;
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (count == 0) return;
+
+        struct State
+        {
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> done = 0;
+            std::mutex mutex{};
+            std::condition_variable finished{};
+            std::exception_ptr error{};
+        };
+
+        auto state = std::make_shared<State>();
+
+        // Indices past count are never passed to fn, so helpers that start after we return never touch it
+        auto work = [state, count, &fn]
+        {
+            for (auto i = state->next++; i < count; i = state->next++)
+            {
+                try
+                {
+                    fn(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(state->mutex);
+                    if (!state->error) state->error = std::current_exception();
+                }
+
+                if (++state->done == count)
+                {
+                    std::lock_guard lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        const auto numHelpers = std::min(count - 1, _threads.size());
+        for (size_t i = 0; i < numHelpers; i++)
+        {
+            Enqueue(work);
+        }
+
+        work();
+
+        while (state->done < count)
+        {
+            if (RunPendingTask()) continue;
+
+            std::unique_lock lock(state->mutex);
+            state->finished.wait_for(lock, std::chrono::milliseconds(1), [&state, count]
+            {
+                return state->done >= count;
+            });
+        }
+
+        if (state->error)
+        {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    size_t ThreadPool::GetThreadCount() const
+    {
+        return _threads.size();
+    }
+}
@@ -1,5 +1,6 @@
 #include "rsl/TokenList.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace rsl
@@ -0,0 +1,226 @@
+#include "rsl/Writer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace rsl
+{
+    namespace
+    {
+        constexpr std::string_view INDENTATION = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+    }
+
+    Writer::Writer(size_t reserve)
+    {
+        _buffer.reserve(reserve);
+    }
+
+    Writer::Writer(const WriterSink& sink, size_t chunkSize) : _sink(sink), _chunkSize(chunkSize)
+    {
+        _buffer.reserve(chunkSize);
+    }
+
+    Writer::Writer(char* buffer, size_t capacity) : _fixed(true), _external(buffer), _capacity(buffer ? capacity : 0)
+    {
+    }
+
+    void Writer::Append(const char* data, size_t size)
+    {
+        if (size == 0) return;
+
+        if (_compact && (data[0] == '+' || data[0] == '-') && _last == data[0])
+        {
+            Append(" ", 1);
+        }
+
+        _last = data[size - 1];
+        if (_fixed)
+        {
+            if (_size < _capacity)
+            {
+                std::memcpy(_external + _size, data, std::min(size, _capacity - _size));
+            }
+            _size += size;
+            return;
+        }
+
+        _buffer.append(data, size);
+    }
+
+    Writer& Writer::operator<<(std::string_view text)
+    {
+        Append(text.data(), text.size());
+        return *this;
+    }
+
+    Writer& Writer::operator<<(const char* text)
+    {
+        Append(text, std::strlen(text));
+        return *this;
+    }
+
+    Writer& Writer::operator<<(const std::string& text)
+    {
+        Append(text.data(), text.size());
+        return *this;
+    }
+
+    Writer& Writer::operator<<(char c)
+    {
+        Append(&c, 1);
+        return *this;
+    }
+
+    Writer& Writer::operator<<(int value)
+    {
+        return *this << static_cast<int64_t>(value);
+    }
+
+    Writer& Writer::operator<<(int64_t value)
+    {
+        char chars[24];
+        auto [end, error] = std::to_chars(chars, chars + sizeof(chars), value);
+        Append(chars, end - chars);
+        return *this;
+    }
+
+    Writer& Writer::operator<<(uint64_t value)
+    {
+        char chars[24];
+        auto [end, error] = std::to_chars(chars, chars + sizeof(chars), value);
+        Append(chars, end - chars);
+        return *this;
+    }
+
+    Writer& Writer::operator<<(float value)
+    {
+        char chars[32];
+        auto [end, error] = std::to_chars(chars, chars + sizeof(chars) - 2, value);
+
+        // "1" would read back as an integer
+        if (std::find_first_of(chars, end, ".en", ".en" + 3) == end)
+        {
+            *end++ = '.';
+            *end++ = '0';
+        }
+
+        auto start = chars;
+        if (_compact)
+        {
+            // 1.0 -> 1. and 0.5 -> .5
+            if (end - start >= 2 && end[-2] == '.' && end[-1] == '0') --end;
+
+            const auto sign = *start == '-' ? 1 : 0;
+            if (end - start > 2 + sign && start[sign] == '0' && start[sign + 1] == '.')
+            {
+                if (sign) start[1] = '-';
+                ++start;
+            }
+        }
+
+        Append(start, end - start);
+        return *this;
+    }
+
+    Writer& Writer::Indent(int depth)
+    {
+        if (_compact) return *this;
+
+        while (depth > 0)
+        {
+            const auto count = std::min(static_cast<size_t>(depth), INDENTATION.size());
+            Append(INDENTATION.data(), count);
+            depth -= static_cast<int>(count);
+        }
+        return *this;
+    }
+
+    Writer& Writer::NewLine()
+    {
+        if (!_compact) Append("\n", 1);
+        return *this;
+    }
+
+    Writer& Writer::Pretty(std::string_view pretty, std::string_view compact)
+    {
+        return *this << (_compact ? compact : pretty);
+    }
+
+    Writer& Writer::BeginLine()
+    {
+        if (_last != '\0' && _last != '\n') Append("\n", 1);
+        return *this;
+    }
+
+    void Writer::SetCompact(bool compact)
+    {
+        _compact = compact;
+    }
+
+    bool Writer::IsCompact() const
+    {
+        return _compact;
+    }
+
+    size_t Writer::GetSize() const
+    {
+        return _fixed ? _size : _buffer.size();
+    }
+
+    Writer::Mark Writer::GetMark() const
+    {
+        return {GetSize(), _last};
+    }
+
+    void Writer::Truncate(const Mark& mark)
+    {
+        if (mark.size >= GetSize()) return;
+
+        if (_fixed)
+        {
+            _size = mark.size;
+        }
+        else
+        {
+            _buffer.resize(mark.size);
+        }
+        _last = mark.last;
+    }
+
+    size_t Writer::GetTotalSize() const
+    {
+        return _flushed + GetSize();
+    }
+
+    bool Writer::IsOverflowed() const
+    {
+        return _fixed && _size > _capacity;
+    }
+
+    void Writer::Commit()
+    {
+        if (_sink && _buffer.size() >= _chunkSize) Flush();
+    }
+
+    void Writer::Flush()
+    {
+        if (!_sink || _buffer.empty()) return;
+        _sink(_buffer);
+        _flushed += _buffer.size();
+        _buffer.clear();
+    }
+
+    const std::string& Writer::GetBuffer() const
+    {
+        return _buffer;
+    }
+
+    std::string Writer::Take()
+    {
+        _flushed += _buffer.size();
+        auto result = std::move(_buffer);
+        _buffer.clear();
+        return result;
+    }
+}
@@ -0,0 +1,218 @@
+#include "rsl/rsl.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "rsl/Compiler.hpp"
+
+struct rsl_compiler
+{
+    rsl::Compiler compiler;
+
+    explicit rsl_compiler(size_t numThreads) : compiler(numThreads)
+    {
+    }
+};
+
+namespace
+{
+    rsl_status fail(rsl_error* error, rsl_status status, const char* message)
+    {
+        if (error)
+        {
+            error->status = status;
+            std::strncpy(error->message, message, RSL_ERROR_MESSAGE_SIZE - 1);
+            error->message[RSL_ERROR_MESSAGE_SIZE - 1] = '\0';
+        }
+        return status;
+    }
+
+    rsl_status succeed(rsl_error* error)
+    {
+        if (error)
+        {
+            error->status = RSL_OK;
+            error->message[0] = '\0';
+        }
+        return RSL_OK;
+    }
+
+    rsl::CompileJob toJob(const rsl_compile_options* options)
+    {
+        rsl::CompileJob job{};
+        if (options->file_name) job.fileName = options->file_name;
+        if (options->source) job.source.assign(options->source, options->source_size);
+        job.scopeType = options->stage == RSL_STAGE_VERTEX ? rsl::EScopeType::Vertex : rsl::EScopeType::Fragment;
+
+        for (size_t i = 0; i < options->define_count; i++)
+        {
+            auto& define = options->defines[i];
+            if (define.name) job.defines.insert_or_assign(define.name, define.value ? define.value : "");
+        }
+
+        return job;
+    }
+
+    // Runs compile with every C++ exception translated into an error status
+    template <typename F>
+    rsl_status guard(rsl_error* error, F&& compile)
+    {
+        try
+        {
+            return compile();
+        }
+        catch (const std::bad_alloc&)
+        {
+            return fail(error, RSL_ERROR_OUT_OF_MEMORY, "Out of memory");
+        }
+        catch (const std::exception& e)
+        {
+            return fail(error, RSL_ERROR_COMPILE, e.what());
+        }
+        catch (...)
+        {
+            return fail(error, RSL_ERROR_COMPILE, "Unknown error");
+        }
+    }
+
+    bool isValid(const rsl_compiler* compiler, const rsl_compile_options* options)
+    {
+        return compiler && options && (options->source || options->file_name) &&
+            (options->defines || options->define_count == 0);
+    }
+}
+
+extern "C" {
+rsl_compiler* rsl_compiler_create(size_t num_threads)
+{
+    try
+    {
+        return new rsl_compiler(num_threads);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void rsl_compiler_destroy(rsl_compiler* compiler)
+{
+    delete compiler;
+}
+
+rsl_status rsl_compile(rsl_compiler* compiler, const rsl_compile_options* options, char** out_data, size_t* out_size,
+                       rsl_error* error)
+{
+    if (!isValid(compiler, options) || !out_data) return fail(error, RSL_ERROR_INVALID_ARGUMENT, "Invalid argument");
+    *out_data = nullptr;
+    if (out_size) *out_size = 0;
+
+    return guard(error, [&]
+    {
+        char* data = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+        // The compiler reports exceptions from the sink as compile errors, so running out of memory is recorded here
+        auto outOfMemory = false;
+
+        // Chunks are appended straight into memory the caller will own, so the output is never held twice
+        rsl::Writer out([&](std::string_view chunk)
+        {
+            if (size + chunk.size() + 1 > capacity)
+            {
+                auto newCapacity = std::max(capacity * 2, size + chunk.size() + 1);
+                auto newData = static_cast<char*>(std::realloc(data, newCapacity));
+                if (!newData)
+                {
+                    outOfMemory = true;
+                    throw std::bad_alloc();
+                }
+                data = newData;
+                capacity = newCapacity;
+            }
+            std::memcpy(data + size, chunk.data(), chunk.size());
+            size += chunk.size();
+        });
+
+        rsl::CompileResult result{};
+        try
+        {
+            result = compiler->compiler.Compile(toJob(options), out);
+        }
+        catch (...)
+        {
+            std::free(data);
+            throw;
+        }
+
+        if (outOfMemory)
+        {
+            std::free(data);
+            throw std::bad_alloc();
+        }
+
+        if (!result.success)
+        {
+            std::free(data);
+            return fail(error, RSL_ERROR_COMPILE, result.error.c_str());
+        }
+
+        if (!data)
+        {
+            data = static_cast<char*>(std::malloc(1));
+            if (!data) throw std::bad_alloc();
+        }
+
+        data[size] = '\0';
+        *out_data = data;
+        if (out_size) *out_size = size;
+        return succeed(error);
+    });
+}
+
+rsl_status rsl_compile_to_buffer(rsl_compiler* compiler, const rsl_compile_options* options, char* buffer,
+                                 size_t capacity, size_t* out_size, rsl_error* error)
+{
+    if (!isValid(compiler, options) || (!buffer && capacity != 0))
+    {
+        return fail(error, RSL_ERROR_INVALID_ARGUMENT, "Invalid argument");
+    }
+    if (out_size) *out_size = 0;
+
+    return guard(error, [&]
+    {
+        rsl::Writer out(buffer, capacity);
+        auto result = compiler->compiler.Compile(toJob(options), out);
+        if (!result.success) return fail(error, RSL_ERROR_COMPILE, result.error.c_str());
+
+        if (out_size) *out_size = result.outputSize;
+        if (out.IsOverflowed()) return fail(error, RSL_ERROR_BUFFER_TOO_SMALL, "Output buffer is too small");
+        return succeed(error);
+    });
+}
+
+rsl_status rsl_compile_to_callback(rsl_compiler* compiler, const rsl_compile_options* options,
+                                   rsl_chunk_callback callback, void* user_data, rsl_error* error)
+{
+    if (!isValid(compiler, options) || !callback) return fail(error, RSL_ERROR_INVALID_ARGUMENT, "Invalid argument");
+
+    return guard(error, [&]
+    {
+        rsl::Writer out([callback, user_data](std::string_view chunk)
+        {
+            callback(chunk.data(), chunk.size(), user_data);
+        });
+
+        auto result = compiler->compiler.Compile(toJob(options), out);
+        if (!result.success) return fail(error, RSL_ERROR_COMPILE, result.error.c_str());
+        return succeed(error);
+    });
+}
+
+void rsl_free(void* data)
+{
+    std::free(data);
+}
+}
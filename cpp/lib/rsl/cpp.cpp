@@ -0,0 +1,1343 @@
+#include "rsl/cpp.hpp"
+
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "rsl/utils.hpp"
+
+namespace rsl::cpp
+{
+    namespace
+    {
+        // Builtins implemented by cpu.hpp under their GLSL names
+        const std::unordered_set<std::string> CPU_BUILTINS = {
+            "abs", "sign", "floor", "ceil", "fract", "trunc", "round", "sqrt", "inversesqrt", "exp", "exp2", "log",
+            "log2", "sin", "cos", "tan", "asin", "acos", "atan", "radians", "degrees", "pow", "mod", "step", "min",
+            "max", "clamp", "mix", "smoothstep", "dot", "length", "distance", "normalize", "cross", "reflect",
+            "refract", "faceforward", "transpose", "determinant", "inverse", "any", "all"
+        };
+
+        // Builtins that only have a meaning inside a draw
+        const std::unordered_set<std::string> GPU_BUILTINS = {
+            "texture", "textureLod", "textureSize", "texelFetch", "dFdx", "dFdy", "fwidth"
+        };
+
+        // Identifiers that would not compile, or would hide something the generated code relies on
+        const std::unordered_set<std::string> RESERVED_NAMES = {
+            "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "break", "case", "catch", "char",
+            "char8_t", "char16_t", "char32_t", "class", "compl", "concept", "const", "consteval", "constexpr",
+            "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default",
+            "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float",
+            "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not",
+            "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+            "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static", "static_assert",
+            "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef",
+            "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while",
+            "xor", "xor_eq", "Float", "Int", "Bool", "rsl", "std", "select"
+        };
+
+        struct Symbol
+        {
+            // Name in the generated code, which differs when the RSL name is reserved or shadows another
+            std::string name{};
+            // RSL type name, like float3 or the name of a struct
+            std::string type{};
+            bool isArray = false;
+            bool isOutput = false;
+            // Layout, block and push constant variables, which only exist on the GPU
+            bool isInterface = false;
+        };
+
+        bool isArrayCount(int declarationCount)
+        {
+            return declarationCount == -1 || declarationCount > 1;
+        }
+
+        // Component index of a swizzle letter, or -1
+        int swizzleIndex(char c)
+        {
+            for (auto set : {std::string_view{"xyzw"}, std::string_view{"rgba"}, std::string_view{"stpq"}})
+            {
+                if (auto index = set.find(c); index != std::string_view::npos) return static_cast<int>(index);
+            }
+            return -1;
+        }
+
+        bool isSwizzle(const std::string& name)
+        {
+            if (name.empty() || name.size() > 4) return false;
+            for (auto& c : name)
+            {
+                if (swizzleIndex(c) < 0) return false;
+            }
+            return true;
+        }
+
+        bool isFloatType(const std::string& type)
+        {
+            return type == "float" || type == "float2" || type == "float3" || type == "float4" || type == "mat3" ||
+                type == "mat4";
+        }
+
+        bool isIntType(const std::string& type)
+        {
+            return type == "int" || type == "int2" || type == "int3" || type == "int4";
+        }
+
+        bool isMatrixType(const std::string& type)
+        {
+            return type == "mat3" || type == "mat4";
+        }
+
+        // Components of a scalar or vector type, 0 for anything else
+        int componentCount(const std::string& type)
+        {
+            if (type == "float" || type == "int" || type == "bool") return 1;
+            if (type == "float2" || type == "int2") return 2;
+            if (type == "float3" || type == "int3") return 3;
+            if (type == "float4" || type == "int4") return 4;
+            return 0;
+        }
+
+        // float and 3 give float3
+        std::string withComponents(const std::string& type, int count)
+        {
+            const std::string base = isIntType(type) ? "int" : type == "bool" ? "bool" : "float";
+            return count == 1 ? base : base + std::to_string(count);
+        }
+
+        std::string elementType(const std::string& type)
+        {
+            if (type.ends_with("[]")) return type.substr(0, type.size() - 2);
+            if (type == "mat3") return "float3";
+            if (type == "mat4") return "float4";
+            if (componentCount(type) > 1) return withComponents(type, 1);
+            return {};
+        }
+
+        class Generator
+        {
+            Writer* _out;
+            const GenerateOptions& _options;
+            bool _soa;
+
+            std::unordered_map<std::string, std::shared_ptr<StructNode>> _structs{};
+            std::unordered_map<std::string, std::vector<std::shared_ptr<FunctionNode>>> _functions{};
+            std::unordered_map<std::string, std::shared_ptr<Node>> _defines{};
+            std::unordered_set<std::string> _expandingDefines{};
+            std::vector<std::unordered_map<std::string, Symbol>> _scopes{};
+            // Names taken at global scope and in the current function
+            std::unordered_set<std::string> _globalNames{};
+            std::unordered_set<std::string> _localNames{};
+
+            // State of the function being generated in SoA mode. _exec holds the invocations running the current
+            // statement, which differs from _active inside divergent branches and loops and after some invocations
+            // returned.
+            std::string _returnType{};
+            int _divergence = 0;
+            bool _mayHaveReturned = false;
+            bool _usesExec = false;
+            bool _usesResult = false;
+            bool _usesReturned = false;
+            int _nextMask = 0;
+
+        public:
+            Generator(Writer& out, const GenerateOptions& options) : _out(&out), _options(options),
+                                                                     _soa(options.lanes > 1)
+            {
+                if (options.lanes != 1 && options.lanes != 4 && options.lanes != 8)
+                {
+                    throw std::runtime_error("C++ generation supports 1, 4 or 8 lanes, not " +
+                        std::to_string(options.lanes));
+                }
+            }
+
+            void Generate(const std::shared_ptr<ModuleNode>& module)
+            {
+                *_out << "// Generated from RSL. Do not edit.\n#pragma once\n\n#include \"rsl/cpu.hpp\"\n\n";
+
+                auto depth = 0;
+                if (!_options.namespaceName.empty())
+                {
+                    *_out << "namespace " << _options.namespaceName << "\n{\n";
+                    depth = 1;
+                }
+
+                _out->Indent(depth) << "using namespace rsl::cpu::" <<
+                    (_options.lanes == 1 ? "scalar" : _options.lanes == 4 ? "x4" : "x8") << ";\n";
+
+                _scopes.emplace_back();
+                for (auto& statement : module->statements)
+                {
+                    GenerateTopLevelStatement(statement, depth);
+                    _out->Commit();
+                }
+
+                if (!_options.namespaceName.empty()) *_out << "}\n";
+            }
+
+        private:
+            void GenerateTopLevelStatement(const std::shared_ptr<Node>& node, int depth)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::Struct:
+                    GenerateStruct(std::dynamic_pointer_cast<StructNode>(node), depth);
+                    break;
+                case NodeType::Function:
+                    GenerateFunction(std::dynamic_pointer_cast<FunctionNode>(node), depth);
+                    break;
+                case NodeType::Define:
+                    if (auto casted = std::dynamic_pointer_cast<DefineNode>(node))
+                    {
+                        _defines.insert_or_assign(casted->id, casted->expression);
+                    }
+                    break;
+                case NodeType::Layout:
+                    if (auto casted = std::dynamic_pointer_cast<LayoutNode>(node))
+                    {
+                        DeclareInterface(casted->declaration);
+                    }
+                    break;
+                case NodeType::PushConstant:
+                    DeclareInterface("push");
+                    break;
+                case NodeType::Assign:
+                    if (auto casted = std::dynamic_pointer_cast<AssignNode>(node);
+                        casted->target->nodeType == NodeType::Const)
+                    {
+                        _out->NewLine();
+                        _out->Indent(depth) << "inline ";
+                        GenerateDeclaration(std::dynamic_pointer_cast<ConstNode>(casted->target)->declaration, true,
+                                            casted->value);
+                        *_out << ";\n";
+                    }
+                    break;
+                default:
+                    // Stage scopes and includes, which are already resolved
+                    break;
+                }
+            }
+
+            void DeclareInterface(const std::string& name)
+            {
+                Symbol symbol{};
+                symbol.name = name;
+                symbol.isInterface = true;
+                _scopes.front().insert_or_assign(name, symbol);
+            }
+
+            void DeclareInterface(const std::shared_ptr<DeclarationNode>& declaration)
+            {
+                DeclareInterface(declaration->declarationName);
+
+                // Buffer members are visible without the block name
+                if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(declaration))
+                {
+                    for (auto& member : asBuffer->declarations) DeclareInterface(member->declarationName);
+                }
+            }
+
+            std::string TypeName(const std::string& type) const
+            {
+                switch (DeclarationNode::TokenTypeToDeclarationType(Token(type, {}).type))
+                {
+                case EDeclarationType::Float:
+                    return _soa ? "Float" : "float";
+                case EDeclarationType::Int:
+                    return _soa ? "Int" : "int";
+                case EDeclarationType::Boolean:
+                    return _soa ? "Bool" : "bool";
+                case EDeclarationType::Float2:
+                case EDeclarationType::Int2:
+                case EDeclarationType::Float3:
+                case EDeclarationType::Int3:
+                case EDeclarationType::Float4:
+                case EDeclarationType::Int4:
+                case EDeclarationType::Mat3:
+                case EDeclarationType::Mat4:
+                case EDeclarationType::Void:
+                    return type;
+                case EDeclarationType::Struct:
+                    if (_structs.contains(type)) return type;
+                    break;
+                default:
+                    break;
+                }
+
+                throw std::runtime_error("Type '" + type + "' has no CPU equivalent");
+            }
+
+            static std::string MemberName(const std::string& name)
+            {
+                return RESERVED_NAMES.contains(name) ? name + "_" : name;
+            }
+
+            // A name for a new local that is not reserved and does not shadow anything, so initializers that refer
+            // to an outer variable of the same name keep working
+            std::string UniqueLocalName(const std::string& name)
+            {
+                auto result = name;
+                for (auto i = 1; RESERVED_NAMES.contains(result) || _globalNames.contains(result) ||
+                     _localNames.contains(result) || result.starts_with("_"); i++)
+                {
+                    result = (name.starts_with("_") ? "v" + name : name) + "_" + std::to_string(i);
+                }
+                _localNames.insert(result);
+                return result;
+            }
+
+            const Symbol* FindSymbol(const std::string& name) const
+            {
+                for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it)
+                {
+                    if (auto found = it->find(name); found != it->end()) return &found->second;
+                }
+                return nullptr;
+            }
+
+            std::shared_ptr<FunctionNode> FindFunction(const std::string& name, size_t argCount) const
+            {
+                auto found = _functions.find(name);
+                if (found == _functions.end()) return {};
+                for (auto& function : found->second)
+                {
+                    if (function->arguments.size() == argCount) return function;
+                }
+                return found->second.front();
+            }
+
+            static bool IsConstructor(const std::string& name)
+            {
+                switch (DeclarationNode::TokenTypeToDeclarationType(Token(name, {}).type))
+                {
+                case EDeclarationType::Float:
+                case EDeclarationType::Int:
+                case EDeclarationType::Boolean:
+                case EDeclarationType::Float2:
+                case EDeclarationType::Int2:
+                case EDeclarationType::Float3:
+                case EDeclarationType::Int3:
+                case EDeclarationType::Float4:
+                case EDeclarationType::Int4:
+                case EDeclarationType::Mat3:
+                case EDeclarationType::Mat4:
+                    return true;
+                default:
+                    return false;
+                }
+            }
+
+            // RSL type of an expression as far as the generator needs it, empty when unknown. Arrays end in [].
+            std::string TypeOf(const std::shared_ptr<Node>& node)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::FloatLiteral:
+                    return "float";
+                case NodeType::IntLiteral:
+                    return "int";
+                case NodeType::BooleanLiteral:
+                    return "bool";
+                case NodeType::Identifier:
+                    {
+                        const auto& id = std::dynamic_pointer_cast<IdentifierNode>(node)->id;
+                        if (auto symbol = FindSymbol(id)) return symbol->type + (symbol->isArray ? "[]" : "");
+                        if (auto define = _defines.find(id); define != _defines.end() && !_expandingDefines.contains(id))
+                        {
+                            _expandingDefines.insert(id);
+                            auto type = TypeOf(define->second);
+                            _expandingDefines.erase(id);
+                            return type;
+                        }
+                        return {};
+                    }
+                case NodeType::Precedence:
+                    return TypeOf(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+                case NodeType::Negate:
+                    return TypeOf(std::dynamic_pointer_cast<NegateNode>(node)->target);
+                case NodeType::Increment:
+                    return TypeOf(std::dynamic_pointer_cast<IncrementNode>(node)->target);
+                case NodeType::Decrement:
+                    return TypeOf(std::dynamic_pointer_cast<DecrementNode>(node)->target);
+                case NodeType::Assign:
+                    return TypeOf(std::dynamic_pointer_cast<AssignNode>(node)->target);
+                case NodeType::Declaration:
+                    {
+                        auto casted = std::dynamic_pointer_cast<DeclarationNode>(node);
+                        return casted->GetTypeName() + (isArrayCount(casted->declarationCount) ? "[]" : "");
+                    }
+                case NodeType::Conditional:
+                    {
+                        auto casted = std::dynamic_pointer_cast<ConditionalNode>(node);
+                        auto type = TypeOf(casted->left);
+                        return type.empty() ? TypeOf(casted->right) : type;
+                    }
+                case NodeType::Index:
+                    return elementType(TypeOf(std::dynamic_pointer_cast<IndexNode>(node)->left));
+                case NodeType::Access:
+                    {
+                        auto casted = std::dynamic_pointer_cast<AccessNode>(node);
+                        auto member = std::dynamic_pointer_cast<IdentifierNode>(casted->right);
+                        if (!member) return {};
+
+                        auto leftType = TypeOf(casted->left);
+                        if (auto found = _structs.find(leftType); found != _structs.end())
+                        {
+                            for (auto& declaration : found->second->declarations)
+                            {
+                                if (declaration->declarationName == member->id)
+                                {
+                                    return TypeOf(declaration);
+                                }
+                            }
+                            return {};
+                        }
+
+                        if (!isSwizzle(member->id)) return {};
+                        return withComponents(leftType, static_cast<int>(member->id.size()));
+                    }
+                case NodeType::BinaryOp:
+                    {
+                        auto casted = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                        switch (casted->op)
+                        {
+                        case EBinaryOp::And:
+                        case EBinaryOp::Or:
+                        case EBinaryOp::Not:
+                        case EBinaryOp::Equal:
+                        case EBinaryOp::NotEqual:
+                        case EBinaryOp::Less:
+                        case EBinaryOp::LessEqual:
+                        case EBinaryOp::Greater:
+                        case EBinaryOp::GreaterEqual:
+                            return "bool";
+                        default:
+                            break;
+                        }
+
+                        auto left = TypeOf(casted->left);
+                        auto right = TypeOf(casted->right);
+                        // Matrix times vector and vector times matrix give the vector
+                        if (isMatrixType(left) && componentCount(right) > 1) return right;
+                        if (isMatrixType(right) && componentCount(left) > 1) return left;
+                        // Scalars mixed with vectors take the vector shape, ints mixed with floats become floats
+                        if (componentCount(left) == 1 && !right.empty())
+                        {
+                            return isFloatType(left) && isIntType(right)
+                                       ? withComponents("float", componentCount(right))
+                                       : right;
+                        }
+                        if (left.empty()) return right;
+                        return isIntType(left) && isFloatType(right) ? withComponents(right, componentCount(left)) : left;
+                    }
+                case NodeType::Call:
+                    {
+                        auto casted = std::dynamic_pointer_cast<CallNode>(node);
+                        const auto& name = casted->identifier->id;
+                        if (IsConstructor(name) || _structs.contains(name)) return name;
+                        if (auto function = FindFunction(name, casted->args.size()))
+                        {
+                            return function->returnDeclaration->GetTypeName();
+                        }
+                        if (name == "dot" || name == "length" || name == "distance" || name == "determinant")
+                        {
+                            return "float";
+                        }
+                        if (name == "any" || name == "all") return "bool";
+
+                        // Component wise builtins return the widest argument
+                        std::string widest{};
+                        for (auto& arg : casted->args)
+                        {
+                            auto type = TypeOf(arg);
+                            if (widest.empty() || componentCount(widest) == 1) widest = type;
+                        }
+                        return widest;
+                    }
+                default:
+                    return {};
+                }
+            }
+
+            void GenerateStruct(const std::shared_ptr<StructNode>& node, int depth)
+            {
+                _structs.insert_or_assign(node->name, node);
+                _globalNames.insert(node->name);
+
+                _out->NewLine();
+                _out->Indent(depth) << "struct " << node->name << '\n';
+                _out->Indent(depth) << "{\n";
+                for (auto& member : node->declarations)
+                {
+                    _out->Indent(depth + 1) << TypeName(member->GetTypeName()) << ' ' <<
+                        MemberName(member->declarationName);
+                    GenerateArraySuffix(member->declarationCount);
+                    *_out << "{};\n";
+                }
+                _out->Indent(depth) << "};\n";
+
+                if (!_soa) return;
+
+                // Lets masked assignments and select work on the struct like on any other type
+                _out->NewLine();
+                _out->Indent(depth) << "inline " << node->name << " select(const Bool& mask, const " << node->name <<
+                    "& a, const " << node->name << "& b)\n";
+                _out->Indent(depth) << "{\n";
+                _out->Indent(depth + 1) << node->name << " result;\n";
+                for (auto& member : node->declarations)
+                {
+                    const auto name = MemberName(member->declarationName);
+                    if (isArrayCount(member->declarationCount))
+                    {
+                        _out->Indent(depth + 1) << "for (auto i = 0; i < " << member->declarationCount << "; i++) " <<
+                            "result." << name << "[i] = select(mask, a." << name << "[i], b." << name << "[i]);\n";
+                    }
+                    else
+                    {
+                        _out->Indent(depth + 1) << "result." << name << " = select(mask, a." << name << ", b." << name
+                            << ");\n";
+                    }
+                }
+                _out->Indent(depth + 1) << "return result;\n";
+                _out->Indent(depth) << "}\n";
+            }
+
+            void GenerateArraySuffix(int declarationCount)
+            {
+                if (declarationCount == -1)
+                {
+                    *_out << "[]";
+                }
+                else if (declarationCount > 1)
+                {
+                    *_out << '[' << declarationCount << ']';
+                }
+            }
+
+            void GenerateFunction(const std::shared_ptr<FunctionNode>& node, int depth)
+            {
+                _functions[node->name].push_back(node);
+                _globalNames.insert(node->name);
+
+                _returnType = node->returnDeclaration->GetTypeName();
+                _divergence = 0;
+                _mayHaveReturned = false;
+                _usesExec = false;
+                _usesResult = false;
+                _usesReturned = false;
+                _nextMask = 0;
+                _localNames.clear();
+
+                _scopes.emplace_back();
+                std::vector<std::string> parameters{};
+                for (auto& argument : node->arguments)
+                {
+                    auto& declaration = argument->declaration;
+                    Symbol symbol{};
+                    symbol.name = UniqueLocalName(declaration->declarationName);
+                    symbol.type = declaration->GetTypeName();
+                    symbol.isArray = isArrayCount(declaration->declarationCount);
+                    symbol.isOutput = !argument->isInput;
+
+                    std::string parameter{};
+                    if (symbol.isArray)
+                    {
+                        if (declaration->declarationCount == -1)
+                        {
+                            throw std::runtime_error("Unsized array argument '" + declaration->declarationName +
+                                "' has no CPU equivalent");
+                        }
+                        parameter = (symbol.isOutput ? "" : "const ") + TypeName(symbol.type) + " (&" + symbol.name +
+                            ")[" + std::to_string(declaration->declarationCount) + "]";
+                    }
+                    else
+                    {
+                        parameter = TypeName(symbol.type) + (symbol.isOutput ? "& " : " ") + symbol.name;
+                    }
+                    parameters.push_back(parameter);
+                    _scopes.back().insert_or_assign(declaration->declarationName, symbol);
+                }
+
+                // The body decides which mask state the function needs, so it is generated first
+                Writer body{};
+                auto out = _out;
+                _out = &body;
+                for (auto& statement : node->scope->statements)
+                {
+                    GenerateStatement(statement, depth + 1);
+                }
+                _out = out;
+                _scopes.pop_back();
+
+                _out->NewLine();
+                _out->Indent(depth) << "inline " << TypeName(_returnType) << ' ' << node->name << '(';
+                for (size_t i = 0; i < parameters.size(); i++)
+                {
+                    *_out << (i == 0 ? "" : ", ") << parameters[i];
+                }
+                if (_soa)
+                {
+                    *_out << (parameters.empty() ? "" : ", ") << "const Bool&" << (_usesExec ? " _active" : "") <<
+                        " = true";
+                }
+                *_out << ")\n";
+                _out->Indent(depth) << "{\n";
+
+                if (_usesExec) _out->Indent(depth + 1) << "Bool _exec = _active;\n";
+                if (_usesReturned) _out->Indent(depth + 1) << "Bool _returned = false;\n";
+                if (_usesResult) _out->Indent(depth + 1) << TypeName(_returnType) << " _result{};\n";
+                *_out << body.GetBuffer();
+                if (_usesResult) _out->Indent(depth + 1) << "return _result;\n";
+
+                _out->Indent(depth) << "}\n";
+            }
+
+            // Masked writes are needed once invocations may disagree on whether the write happens, and for outputs
+            // whose inactive invocations belong to the caller
+            bool IsMasked(const std::shared_ptr<Node>& target) const
+            {
+                if (!_soa) return false;
+                if (_divergence > 0 || _mayHaveReturned) return true;
+
+                auto root = target;
+                while (true)
+                {
+                    if (root->nodeType == NodeType::Access)
+                    {
+                        root = std::dynamic_pointer_cast<AccessNode>(root)->left;
+                    }
+                    else if (root->nodeType == NodeType::Index)
+                    {
+                        root = std::dynamic_pointer_cast<IndexNode>(root)->left;
+                    }
+                    else if (root->nodeType == NodeType::Precedence)
+                    {
+                        root = std::dynamic_pointer_cast<PrecedenceNode>(root)->target;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+
+                if (auto identifier = std::dynamic_pointer_cast<IdentifierNode>(root))
+                {
+                    if (auto symbol = FindSymbol(identifier->id)) return symbol->isOutput;
+                }
+                return false;
+            }
+
+            std::string NextMaskName()
+            {
+                return "_mask" + std::to_string(_nextMask++);
+            }
+
+            void RestoreExec(const std::string& mask, int depth)
+            {
+                _out->Indent(depth) << "_exec = " << mask << (_mayHaveReturned ? " && !_returned" : "") << ";\n";
+            }
+
+            void GenerateScope(const std::shared_ptr<ScopeNode>& node, int depth)
+            {
+                _scopes.emplace_back();
+                _out->Indent(depth) << "{\n";
+                for (auto& statement : node->statements)
+                {
+                    GenerateStatement(statement, depth + 1);
+                }
+                _out->Indent(depth) << "}\n";
+                _scopes.pop_back();
+            }
+
+            void GenerateBranch(const std::shared_ptr<Node>& node, int depth)
+            {
+                if (node->nodeType == NodeType::Scope)
+                {
+                    GenerateScope(std::dynamic_pointer_cast<ScopeNode>(node), depth);
+                }
+                else
+                {
+                    _out->Indent(depth) << "{\n";
+                    GenerateStatement(node, depth + 1);
+                    _out->Indent(depth) << "}\n";
+                }
+            }
+
+            void GenerateIf(const std::shared_ptr<IfNode>& node, int depth)
+            {
+                if (!_soa)
+                {
+                    *_out << "if (";
+                    GenerateExpression(node->condition);
+                    *_out << ")\n";
+                    GenerateScope(node->scope, depth);
+                    if (!node->elseNode) return;
+
+                    if (node->elseNode->nodeType == NodeType::If)
+                    {
+                        _out->Indent(depth) << "else ";
+                        GenerateIf(std::dynamic_pointer_cast<IfNode>(node->elseNode), depth);
+                    }
+                    else
+                    {
+                        _out->Indent(depth) << "else\n";
+                        GenerateBranch(node->elseNode, depth);
+                    }
+                    return;
+                }
+
+                // Both sides run under complementary masks and are skipped when no invocation takes them
+                _usesExec = true;
+                const auto mask = NextMaskName();
+                const auto condition = NextMaskName();
+                *_out << "{\n";
+                _out->Indent(depth + 1) << "const Bool " << mask << " = _exec;\n";
+                _out->Indent(depth + 1) << "const Bool " << condition << " = ";
+                GenerateExpression(node->condition);
+                *_out << ";\n";
+
+                _divergence++;
+                _out->Indent(depth + 1) << "_exec = " << mask << " && " << condition << ";\n";
+                _out->Indent(depth + 1) << "if (rsl::cpu::any(_exec))\n";
+                GenerateScope(node->scope, depth + 1);
+                if (node->elseNode)
+                {
+                    _out->Indent(depth + 1) << "_exec = " << mask << " && !" << condition << ";\n";
+                    _out->Indent(depth + 1) << "if (rsl::cpu::any(_exec))\n";
+                    GenerateBranch(node->elseNode, depth + 1);
+                }
+                _divergence--;
+
+                RestoreExec(mask, depth + 1);
+                _out->Indent(depth) << "}\n";
+            }
+
+            void GenerateFor(const std::shared_ptr<ForNode>& node, int depth)
+            {
+                _scopes.emplace_back();
+
+                if (!_soa)
+                {
+                    *_out << "for (";
+                    GenerateExpression(node->init);
+                    *_out << "; ";
+                    GenerateExpression(node->condition);
+                    *_out << "; ";
+                    GenerateExpression(node->update);
+                    *_out << ")\n";
+                    GenerateScope(node->scope, depth);
+                    _scopes.pop_back();
+                    return;
+                }
+
+                // Iterates until no invocation is left running the loop
+                _usesExec = true;
+                const auto mask = NextMaskName();
+                *_out << "{\n";
+                if (node->init->nodeType != NodeType::NoOp)
+                {
+                    _out->Indent(depth + 1);
+                    GenerateExpression(node->init);
+                    *_out << ";\n";
+                }
+                _out->Indent(depth + 1) << "const Bool " << mask << " = _exec;\n";
+                _out->Indent(depth + 1) << "while (true)\n";
+                _out->Indent(depth + 1) << "{\n";
+
+                _divergence++;
+                _out->Indent(depth + 2) << "_exec = _exec && (";
+                GenerateExpression(node->condition);
+                *_out << ");\n";
+                _out->Indent(depth + 2) << "if (!rsl::cpu::any(_exec)) break;\n";
+                GenerateScope(node->scope, depth + 2);
+                if (node->update->nodeType != NodeType::NoOp)
+                {
+                    _out->Indent(depth + 2);
+                    GenerateExpression(node->update);
+                    *_out << ";\n";
+                }
+                _divergence--;
+
+                _out->Indent(depth + 1) << "}\n";
+                RestoreExec(mask, depth + 1);
+                _out->Indent(depth) << "}\n";
+                _scopes.pop_back();
+            }
+
+            void GenerateReturn(const std::shared_ptr<ReturnNode>& node, int depth)
+            {
+                const auto isVoid = _returnType == "void";
+
+                if (!_soa || (_divergence == 0 && !_mayHaveReturned))
+                {
+                    *_out << "return";
+                    if (!isVoid && node->expression && node->expression->nodeType != NodeType::NoOp)
+                    {
+                        *_out << ' ';
+                        GenerateConverted(node->expression, _returnType);
+                    }
+                    *_out << ";\n";
+                    return;
+                }
+
+                // Every invocation running this statement is done. The rest run on and the result is returned at
+                // the end.
+                _usesExec = true;
+                _usesReturned = true;
+                _mayHaveReturned = true;
+                if (!isVoid)
+                {
+                    _usesResult = true;
+                    *_out << "rsl::cpu::assign(_exec, _result, ";
+                    GenerateConverted(node->expression, _returnType);
+                    *_out << ");\n";
+                    _out->Indent(depth);
+                }
+                *_out << "_returned = _returned || _exec;\n";
+                _out->Indent(depth) << "_exec = false;\n";
+            }
+
+            void GenerateStatement(const std::shared_ptr<Node>& node, int depth)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::NoOp:
+                    return;
+                case NodeType::Scope:
+                    GenerateScope(std::dynamic_pointer_cast<ScopeNode>(node), depth);
+                    return;
+                default:
+                    break;
+                }
+
+                _out->Indent(depth);
+                switch (node->nodeType)
+                {
+                case NodeType::If:
+                    GenerateIf(std::dynamic_pointer_cast<IfNode>(node), depth);
+                    break;
+                case NodeType::For:
+                    GenerateFor(std::dynamic_pointer_cast<ForNode>(node), depth);
+                    break;
+                case NodeType::Return:
+                    GenerateReturn(std::dynamic_pointer_cast<ReturnNode>(node), depth);
+                    break;
+                case NodeType::Discard:
+                    throw std::runtime_error("discard has no CPU equivalent");
+                default:
+                    GenerateExpression(node);
+                    *_out << ";\n";
+                    break;
+                }
+            }
+
+            // Declares a local or global and registers it once its initializer is generated, so the initializer
+            // still sees any variable it shadows
+            void GenerateDeclaration(const std::shared_ptr<DeclarationNode>& node, bool isConst,
+                                     const std::shared_ptr<Node>& value)
+            {
+                Symbol symbol{};
+                symbol.type = node->GetTypeName();
+                symbol.isArray = isArrayCount(node->declarationCount);
+                if (_scopes.size() == 1)
+                {
+                    symbol.name = node->declarationName;
+                    if (RESERVED_NAMES.contains(symbol.name) || _globalNames.contains(symbol.name))
+                    {
+                        throw std::runtime_error("'" + symbol.name + "' cannot be used as a global name in C++");
+                    }
+                    _globalNames.insert(symbol.name);
+                }
+                else
+                {
+                    symbol.name = UniqueLocalName(node->declarationName);
+                }
+
+                *_out << (isConst ? "const " : "") << TypeName(symbol.type) << ' ' << symbol.name;
+                GenerateArraySuffix(node->declarationCount);
+                if (value)
+                {
+                    *_out << " = ";
+                    GenerateConverted(value, symbol.type);
+                }
+                else
+                {
+                    *_out << "{}";
+                }
+
+                _scopes.back().insert_or_assign(node->declarationName, symbol);
+            }
+
+            // Writes value converted to type when GLSL would convert it implicitly, like an int expression assigned to
+            // a float
+            void GenerateConverted(const std::shared_ptr<Node>& value, const std::string& type)
+            {
+                if (value->nodeType != NodeType::IntLiteral && isFloatType(type) && isIntType(TypeOf(value)))
+                {
+                    *_out << TypeName(type) << '(';
+                    GenerateExpression(value);
+                    *_out << ')';
+                    return;
+                }
+
+                GenerateExpression(value);
+            }
+
+            // Writes target = value, going through the masked helpers of cpu.hpp where needed
+            void GenerateWrite(const std::shared_ptr<Node>& target, const std::function<void()>& generateValue)
+            {
+                const auto masked = IsMasked(target);
+                if (masked) _usesExec = true;
+
+                if (auto access = std::dynamic_pointer_cast<AccessNode>(target))
+                {
+                    auto member = std::dynamic_pointer_cast<IdentifierNode>(access->right);
+                    if (member && member->id.size() > 1 && IsSwizzleAccess(access))
+                    {
+                        *_out << "rsl::cpu::store<";
+                        GenerateSwizzleIndices(member->id);
+                        *_out << ">(" << (masked ? "_exec, " : "");
+                        GenerateTarget(access->left);
+                        *_out << ", ";
+                        generateValue();
+                        *_out << ')';
+                        return;
+                    }
+                }
+
+                if (auto index = std::dynamic_pointer_cast<IndexNode>(target);
+                    index && _soa && index->indexExpression->nodeType != NodeType::IntLiteral)
+                {
+                    _usesExec = true;
+                    *_out << "rsl::cpu::assignAt(_exec, ";
+                    GenerateTarget(index->left);
+                    *_out << ", ";
+                    GenerateExpression(index->indexExpression);
+                    *_out << ", ";
+                    generateValue();
+                    *_out << ')';
+                    return;
+                }
+
+                if (masked)
+                {
+                    *_out << "rsl::cpu::assign(_exec, ";
+                    GenerateTarget(target);
+                    *_out << ", ";
+                    generateValue();
+                    *_out << ')';
+                    return;
+                }
+
+                GenerateTarget(target);
+                *_out << " = ";
+                generateValue();
+            }
+
+            // Writes the lvalue an assignment stores to. Unlike reads, indices that differ between invocations and
+            // multi component swizzles cannot appear inside it.
+            void GenerateTarget(const std::shared_ptr<Node>& node)
+            {
+                if (auto index = std::dynamic_pointer_cast<IndexNode>(node))
+                {
+                    if (_soa && index->indexExpression->nodeType != NodeType::IntLiteral)
+                    {
+                        throw std::runtime_error("Only the last index of an assignment target may differ between "
+                            "invocations in SoA code");
+                    }
+                    GenerateTarget(index->left);
+                    *_out << '[';
+                    GenerateExpression(index->indexExpression);
+                    *_out << ']';
+                    return;
+                }
+
+                if (auto access = std::dynamic_pointer_cast<AccessNode>(node))
+                {
+                    auto member = std::dynamic_pointer_cast<IdentifierNode>(access->right);
+                    if (member && member->id.size() > 1 && IsSwizzleAccess(access))
+                    {
+                        throw std::runtime_error("Cannot assign through the swizzle ." + member->id);
+                    }
+                    GenerateTarget(access->left);
+                    GenerateMember(access);
+                    return;
+                }
+
+                if (node->nodeType == NodeType::Precedence)
+                {
+                    GenerateTarget(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+                    return;
+                }
+
+                GenerateExpression(node);
+            }
+
+            bool IsSwizzleAccess(const std::shared_ptr<AccessNode>& node)
+            {
+                auto member = std::dynamic_pointer_cast<IdentifierNode>(node->right);
+                return member && isSwizzle(member->id) && !_structs.contains(TypeOf(node->left));
+            }
+
+            void GenerateSwizzleIndices(const std::string& swizzle)
+            {
+                for (size_t i = 0; i < swizzle.size(); i++)
+                {
+                    *_out << (i == 0 ? "" : ", ") << swizzleIndex(swizzle[i]);
+                }
+            }
+
+            // Writes .member for a struct member or single component swizzle
+            void GenerateMember(const std::shared_ptr<AccessNode>& node)
+            {
+                auto member = std::dynamic_pointer_cast<IdentifierNode>(node->right);
+                if (!member) throw std::runtime_error("Expected a member name after '.'");
+
+                if (IsSwizzleAccess(node))
+                {
+                    *_out << '.' << "xyzw"[swizzleIndex(member->id[0])];
+                }
+                else
+                {
+                    *_out << '.' << MemberName(member->id);
+                }
+            }
+
+            void GenerateAccess(const std::shared_ptr<AccessNode>& node)
+            {
+                auto member = std::dynamic_pointer_cast<IdentifierNode>(node->right);
+                if (member && member->id.size() > 1 && IsSwizzleAccess(node))
+                {
+                    *_out << "rsl::cpu::swizzle<";
+                    GenerateSwizzleIndices(member->id);
+                    *_out << ">(";
+                    GenerateExpression(node->left);
+                    *_out << ')';
+                    return;
+                }
+
+                GenerateExpression(node->left);
+                GenerateMember(node);
+            }
+
+            void GenerateIdentifier(const std::shared_ptr<IdentifierNode>& node)
+            {
+                if (auto symbol = FindSymbol(node->id))
+                {
+                    if (symbol->isInterface)
+                    {
+                        throw std::runtime_error("'" + node->id + "' is a shader interface variable and has no CPU "
+                            "equivalent");
+                    }
+                    *_out << symbol->name;
+                    return;
+                }
+
+                if (auto define = _defines.find(node->id); define != _defines.end())
+                {
+                    if (!_expandingDefines.insert(node->id).second)
+                    {
+                        throw std::runtime_error("Define " + node->id + " refers to itself");
+                    }
+                    *_out << '(';
+                    GenerateExpression(define->second);
+                    *_out << ')';
+                    _expandingDefines.erase(node->id);
+                    return;
+                }
+
+                if (node->id.starts_with("gl_"))
+                {
+                    throw std::runtime_error("'" + node->id + "' has no CPU equivalent");
+                }
+
+                throw std::runtime_error("Unknown identifier '" + node->id + "'");
+            }
+
+            void GenerateArguments(const std::vector<std::shared_ptr<Node>>& args,
+                                   const std::shared_ptr<FunctionNode>& function = {})
+            {
+                for (size_t i = 0; i < args.size(); i++)
+                {
+                    if (i != 0) *_out << ", ";
+                    if (function && i < function->arguments.size() && function->arguments[i]->isInput)
+                    {
+                        GenerateConverted(args[i], function->arguments[i]->declaration->GetTypeName());
+                    }
+                    else
+                    {
+                        GenerateExpression(args[i]);
+                    }
+                }
+            }
+
+            void GenerateCall(const std::shared_ptr<CallNode>& node)
+            {
+                const auto& name = node->identifier->id;
+
+                if (IsConstructor(name))
+                {
+                    *_out << TypeName(name) << '(';
+                    GenerateArguments(node->args);
+                    *_out << ')';
+                    return;
+                }
+
+                if (_structs.contains(name))
+                {
+                    *_out << name << '{';
+                    GenerateArguments(node->args);
+                    *_out << '}';
+                    return;
+                }
+
+                if (auto function = FindFunction(name, node->args.size()))
+                {
+                    *_out << name << '(';
+                    GenerateArguments(node->args, function);
+                    if (_soa)
+                    {
+                        _usesExec = true;
+                        *_out << (node->args.empty() ? "_exec" : ", _exec");
+                    }
+                    *_out << ')';
+                    return;
+                }
+
+                if (GPU_BUILTINS.contains(name))
+                {
+                    throw std::runtime_error("'" + name + "' has no CPU equivalent");
+                }
+
+                if (!CPU_BUILTINS.contains(name))
+                {
+                    throw std::runtime_error("Unknown function '" + name + "'");
+                }
+
+                *_out << "rsl::cpu::" << name << '(';
+                GenerateArguments(node->args);
+                *_out << ')';
+            }
+
+            std::string_view BinaryOpToString(EBinaryOp op)
+            {
+                switch (op)
+                {
+                case EBinaryOp::Multiply:
+                    return " * ";
+                case EBinaryOp::Divide:
+                    return " / ";
+                case EBinaryOp::Add:
+                    return " + ";
+                case EBinaryOp::Subtract:
+                    return " - ";
+                case EBinaryOp::Mod:
+                    return " % ";
+                case EBinaryOp::And:
+                    return " && ";
+                case EBinaryOp::Or:
+                    return " || ";
+                case EBinaryOp::Equal:
+                    return " == ";
+                case EBinaryOp::NotEqual:
+                    return " != ";
+                case EBinaryOp::Less:
+                    return " < ";
+                case EBinaryOp::LessEqual:
+                    return " <= ";
+                case EBinaryOp::Greater:
+                    return " > ";
+                case EBinaryOp::GreaterEqual:
+                    return " >= ";
+                case EBinaryOp::Not:
+                    break;
+                }
+
+                throw std::runtime_error("! not supported");
+            }
+
+            void GenerateBinaryOp(const std::shared_ptr<BinaryOpNode>& node)
+            {
+                const auto op = BinaryOpToString(node->op);
+                const auto leftType = TypeOf(node->left);
+                const auto rightType = TypeOf(node->right);
+
+                // int operands mixed with float ones are converted like GLSL does
+                GenerateConverted(node->left, isFloatType(rightType) ? withComponents("float", std::max(
+                                      componentCount(leftType), 1)) : leftType);
+                *_out << op;
+                GenerateConverted(node->right, isFloatType(leftType) ? withComponents("float", std::max(
+                                      componentCount(rightType), 1)) : rightType);
+            }
+
+            void GenerateExpression(const std::shared_ptr<Node>& node)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::Unknown:
+                    throw std::runtime_error("Unknown node");
+                case NodeType::NoOp:
+                    break;
+                case NodeType::BinaryOp:
+                    GenerateBinaryOp(std::dynamic_pointer_cast<BinaryOpNode>(node));
+                    break;
+                case NodeType::Assign:
+                    if (auto casted = std::dynamic_pointer_cast<AssignNode>(node))
+                    {
+                        if (casted->target->nodeType == NodeType::Declaration)
+                        {
+                            GenerateDeclaration(std::dynamic_pointer_cast<DeclarationNode>(casted->target), false,
+                                                casted->value);
+                        }
+                        else if (casted->target->nodeType == NodeType::Const)
+                        {
+                            GenerateDeclaration(std::dynamic_pointer_cast<ConstNode>(casted->target)->declaration, true,
+                                                casted->value);
+                        }
+                        else
+                        {
+                            const auto type = TypeOf(casted->target);
+                            GenerateWrite(casted->target, [this, &casted, &type]
+                            {
+                                GenerateConverted(casted->value, type);
+                            });
+                        }
+                    }
+                    break;
+                case NodeType::Declaration:
+                    GenerateDeclaration(std::dynamic_pointer_cast<DeclarationNode>(node), false, {});
+                    break;
+                case NodeType::Const:
+                    throw std::runtime_error("Constants must be initialized");
+                case NodeType::Call:
+                    GenerateCall(std::dynamic_pointer_cast<CallNode>(node));
+                    break;
+                case NodeType::Access:
+                    GenerateAccess(std::dynamic_pointer_cast<AccessNode>(node));
+                    break;
+                case NodeType::Index:
+                    if (auto casted = std::dynamic_pointer_cast<IndexNode>(node))
+                    {
+                        if (_soa && casted->indexExpression->nodeType != NodeType::IntLiteral)
+                        {
+                            *_out << "rsl::cpu::at(";
+                            GenerateExpression(casted->left);
+                            *_out << ", ";
+                            GenerateExpression(casted->indexExpression);
+                            *_out << ')';
+                        }
+                        else
+                        {
+                            GenerateExpression(casted->left);
+                            *_out << '[';
+                            GenerateExpression(casted->indexExpression);
+                            *_out << ']';
+                        }
+                    }
+                    break;
+                case NodeType::Identifier:
+                    GenerateIdentifier(std::dynamic_pointer_cast<IdentifierNode>(node));
+                    break;
+                case NodeType::FloatLiteral:
+                    *_out << std::dynamic_pointer_cast<FloatLiteralNode>(node)->data << 'f';
+                    break;
+                case NodeType::IntLiteral:
+                    *_out << std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data;
+                    break;
+                case NodeType::BooleanLiteral:
+                    *_out << (std::dynamic_pointer_cast<BooleanLiteralNode>(node)->data ? "true" : "false");
+                    break;
+                case NodeType::ArrayLiteral:
+                    if (auto casted = std::dynamic_pointer_cast<ArrayLiteralNode>(node))
+                    {
+                        *_out << "{ ";
+                        GenerateArguments(casted->nodes);
+                        *_out << " }";
+                    }
+                    break;
+                case NodeType::Negate:
+                    *_out << '-';
+                    GenerateExpression(std::dynamic_pointer_cast<NegateNode>(node)->target);
+                    break;
+                case NodeType::Precedence:
+                    *_out << '(';
+                    GenerateExpression(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+                    *_out << ')';
+                    break;
+                case NodeType::Increment:
+                case NodeType::Decrement:
+                    {
+                        const auto isIncrement = node->nodeType == NodeType::Increment;
+                        auto target = isIncrement
+                                          ? std::dynamic_pointer_cast<IncrementNode>(node)->target
+                                          : std::dynamic_pointer_cast<DecrementNode>(node)->target;
+                        auto isPrefix = isIncrement
+                                            ? std::dynamic_pointer_cast<IncrementNode>(node)->isPrefix
+                                            : std::dynamic_pointer_cast<DecrementNode>(node)->isPrefix;
+                        if (!_soa)
+                        {
+                            if (isPrefix) *_out << (isIncrement ? "++" : "--");
+                            GenerateTarget(target);
+                            if (!isPrefix) *_out << (isIncrement ? "++" : "--");
+                            break;
+                        }
+
+                        // Lanes have no increment operators. The expression gives the new value.
+                        GenerateWrite(target, [this, &target, isIncrement]
+                        {
+                            GenerateExpression(target);
+                            *_out << (isIncrement ? " + 1" : " - 1");
+                        });
+                    }
+                    break;
+                case NodeType::Conditional:
+                    if (auto casted = std::dynamic_pointer_cast<ConditionalNode>(node))
+                    {
+                        if (_soa)
+                        {
+                            // Both sides are evaluated for every invocation, which is safe as expressions other
+                            // than assignments have no side effects outside their invocation
+                            *_out << "select(";
+                            GenerateExpression(casted->condition);
+                            *_out << ", ";
+                            GenerateExpression(casted->left);
+                            *_out << ", ";
+                            GenerateExpression(casted->right);
+                            *_out << ')';
+                        }
+                        else
+                        {
+                            GenerateExpression(casted->condition);
+                            *_out << " ? ";
+                            GenerateExpression(casted->left);
+                            *_out << " : ";
+                            GenerateExpression(casted->right);
+                        }
+                    }
+                    break;
+                case NodeType::Discard:
+                    throw std::runtime_error("discard has no CPU equivalent");
+                default:
+                    throw std::runtime_error("Unexpected node in an expression");
+                }
+            }
+        };
+    }
+
+    void generate(Writer& out, const std::shared_ptr<ModuleNode>& module, const GenerateOptions& options)
+    {
+        Generator(out, options).Generate(module);
+    }
+
+    std::string generate(const std::shared_ptr<ModuleNode>& module, const GenerateOptions& options)
+    {
+        Writer out{};
+        generate(out, module, options);
+        return out.Take();
+    }
+}
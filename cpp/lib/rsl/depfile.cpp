@@ -0,0 +1,108 @@
+#include "rsl/depfile.hpp"
+
+namespace rsl
+{
+    std::string escapeDepfilePath(const std::string& path)
+    {
+        std::string result{};
+        result.reserve(path.size());
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            const auto c = path[i];
+            if (c == '\\')
+            {
+                // Backslashes are only escapes before a space or #, so only a run ending at one is doubled
+                auto end = path.find_first_not_of('\\', i);
+                const auto escaped = end != std::string::npos && (path[end] == ' ' || path[end] == '#');
+                end = end == std::string::npos ? path.size() : end;
+                result.append((end - i) * (escaped ? 2 : 1), '\\');
+                i = end - 1;
+                continue;
+            }
+
+            if (c == ' ' || c == '#') result += '\\';
+            if (c == '$') result += '$';
+            result += c;
+        }
+        return result;
+    }
+
+    std::string formatDepfile(const std::vector<std::string>& targets, const std::vector<std::string>& prerequisites)
+    {
+        std::string result{};
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            result += (i == 0 ? "" : " ") + escapeDepfilePath(targets[i]);
+        }
+        result += ":";
+        for (size_t i = 0; i < prerequisites.size(); i++)
+        {
+            result += (i == 0 ? " " : " \\\n  ") + escapeDepfilePath(prerequisites[i]);
+        }
+        result += "\n";
+        return result;
+    }
+
+    std::vector<std::string> parseDepfile(const std::string& content)
+    {
+        std::vector<std::string> result{};
+        auto separator = content.find(": ");
+        if (separator == std::string::npos) return result;
+
+        std::string current{};
+        for (auto i = separator + 2; i < content.size(); i++)
+        {
+            auto c = content[i];
+            if (c == '\\')
+            {
+                auto end = content.find_first_not_of('\\', i);
+                end = end == std::string::npos ? content.size() : end;
+                const auto count = end - i;
+                const auto next = end < content.size() ? content[end] : '\0';
+
+                if (count == 1 && next == '\n')
+                {
+                    i = end;
+                    continue;
+                }
+
+                // A run before a space or # holds one backslash for each pair, and an odd one out escapes the space or
+                // #. Anywhere else, as in Windows paths, backslashes are kept as they are.
+                if (next == ' ' || next == '#')
+                {
+                    current.append(count / 2, '\\');
+                    if (count % 2 == 1)
+                    {
+                        current += next;
+                        i = end;
+                        continue;
+                    }
+                }
+                else
+                {
+                    current.append(count, '\\');
+                }
+                i = end - 1;
+                continue;
+            }
+
+            if (c == '$' && i + 1 < content.size() && content[i + 1] == '$')
+            {
+                current += content[++i];
+                continue;
+            }
+
+            if (c == ' ' || c == '\n')
+            {
+                if (!current.empty()) result.push_back(current);
+                current.clear();
+                continue;
+            }
+
+            current += c;
+        }
+
+        if (!current.empty()) result.push_back(current);
+        return result;
+    }
+}
@@ -1,7 +1,10 @@
 ﻿#include "rsl/glsl.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 
+#include "rsl/utils.hpp"
+
 namespace rsl::glsl
 {
     std::string typeNameToGlslTypeName(const std::string& typeName)
@@ -44,328 +47,326 @@ namespace rsl::glsl
         return "";
     }
 
-    std::string tabs(int depth)
+    namespace
     {
-        if (depth == 0) return "";
-        std::string r{};
-        r.resize(depth, '\t');
-        return r;
-    }
-
-    std::string generateDeclaration(const std::shared_ptr<DeclarationNode>& node, int depth)
-    {
-        if (node->declarationType == EDeclarationType::Block)
+        void generateArraySuffix(Writer& out, int declarationCount)
         {
-            if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(node))
+            if (declarationCount == -1)
             {
-                auto result = asBlock->GetTypeName() + " " + " {\n";
-                for (auto& declarationNode : asBlock->declarations)
-                {
-                    result += tabs(depth + 1) + generateDeclaration(declarationNode, depth + 1) + ";\n";
-                }
-
-                result += tabs(depth) + "} " + asBlock->declarationName;
-                return result;
+                out << "[]";
+            }
+            else if (declarationCount > 1)
+            {
+                out << '[' << declarationCount << ']';
             }
         }
 
-        if (node->declarationType == EDeclarationType::Buffer)
+        void generateMembers(Writer& out, const std::vector<std::shared_ptr<DeclarationNode>>& declarations, int depth)
         {
-            if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(node))
+            for (auto& declarationNode : declarations)
             {
-                auto result = asBuffer->GetTypeName() + " " + asBuffer->declarationName + " {\n";
-                for (auto& declarationNode : asBuffer->declarations)
-                {
-                    result += tabs(depth + 1) + generateDeclaration(declarationNode, depth + 1) + ";\n";
-                }
-
-                result += tabs(depth) + "}";
+                out.Indent(depth);
+                generateDeclaration(out, declarationNode, depth);
+                out << ';';
+                out.NewLine();
             }
         }
 
-        auto result = typeNameToGlslTypeName(node->GetTypeName()) + (node->declarationName.empty()
-                                                                         ? ""
-                                                                         : " " + node->declarationName);
-        if (node->declarationCount == -1)
+        std::string_view binaryOpToString(EBinaryOp op)
         {
-            result += "[]";
-        }
-        else if (node->declarationCount > 1)
-        {
-            result += "[" + std::to_string(node->declarationCount) + "]";
+            switch (op)
+            {
+            case EBinaryOp::Multiply:
+                return " * ";
+            case EBinaryOp::Divide:
+                return " / ";
+            case EBinaryOp::Add:
+                return " + ";
+            case EBinaryOp::Subtract:
+                return " - ";
+            case EBinaryOp::Mod:
+                return " % ";
+            case EBinaryOp::And:
+                return " && ";
+            case EBinaryOp::Or:
+                return " || ";
+            case EBinaryOp::Not:
+                return "!";
+            case EBinaryOp::Equal:
+                return " == ";
+            case EBinaryOp::NotEqual:
+                return " != ";
+            case EBinaryOp::Less:
+                return " < ";
+            case EBinaryOp::LessEqual:
+                return " <= ";
+            case EBinaryOp::Greater:
+                return " > ";
+            case EBinaryOp::GreaterEqual:
+                return " >= ";
+            }
+
+            return "";
         }
-        return result;
     }
 
-    std::string generateFunctionArgument(const std::shared_ptr<FunctionArgumentNode>& node)
+    void generateDeclaration(Writer& out, const std::shared_ptr<DeclarationNode>& node, int depth)
     {
-        std::string result{};
-        if (node->isInput)
-        {
-            result += "in ";
-        }
-        else
+        if (node->declarationType == EDeclarationType::Block)
         {
-            result += "out ";
+            if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(node))
+            {
+                out << asBlock->GetTypeName();
+                out.Pretty("  {\n", "{");
+                generateMembers(out, asBlock->declarations, depth + 1);
+                out.Indent(depth).Pretty("} ", "}") << asBlock->declarationName;
+                return;
+            }
         }
 
-        result += typeNameToGlslTypeName(node->declaration->GetTypeName());
-
-        if (node->declaration->declarationCount == -1)
-        {
-            result += "[]";
-        }
-        else if (node->declaration->declarationCount > 1)
+        out << typeNameToGlslTypeName(node->GetTypeName());
+        if (!node->declarationName.empty())
         {
-            result += "[" + std::to_string(node->declaration->declarationCount) + "]";
+            out << ' ' << node->declarationName;
         }
+        generateArraySuffix(out, node->declarationCount);
+    }
 
-        result += " " + node->declaration->declarationName;
-        return result;
+    void generateFunctionArgument(Writer& out, const std::shared_ptr<FunctionArgumentNode>& node)
+    {
+        out << (node->isInput ? "in " : "out ") << typeNameToGlslTypeName(node->declaration->GetTypeName());
+        generateArraySuffix(out, node->declaration->declarationCount);
+        out << ' ' << node->declaration->declarationName;
     }
 
-    std::string generateScope(const std::shared_ptr<ScopeNode>& node, int depth)
+    void generateScope(Writer& out, const std::shared_ptr<ScopeNode>& node, int depth)
     {
-        std::string result = "{\n";
+        out << '{';
+        out.NewLine();
 
         for (auto& statement : node->statements)
         {
-            result += tabs(depth + 1) + generateStatement(statement, depth + 1);
+            out.Indent(depth + 1);
+            generateStatement(out, statement, depth + 1);
         }
 
-        result += tabs(depth) + "}\n";
-        return result;
+        out.Indent(depth) << '}';
+        out.NewLine();
     }
 
-    std::string generateFunction(const std::shared_ptr<FunctionNode>& node, int depth)
+    void generateFunction(Writer& out, const std::shared_ptr<FunctionNode>& node, int depth)
     {
-        std::string result = tabs(depth) + generateDeclaration(node->returnDeclaration, depth) + " " + node->name + "(";
+        out.Indent(depth);
+        generateDeclaration(out, node->returnDeclaration, depth);
+        out << ' ' << node->name << '(';
 
         for (size_t i = 0; i < node->arguments.size(); i++)
         {
-            result += generateFunctionArgument(node->arguments[i]);
-            if (i != node->arguments.size() - 1) result += " , ";
+            generateFunctionArgument(out, node->arguments[i]);
+            if (i != node->arguments.size() - 1) out.Pretty(" , ", ",");
         }
 
-        result += ")\n";
-
-        return result + tabs(depth) + generateScope(node->scope, depth);
+        out << ')';
+        out.NewLine();
+        out.Indent(depth);
+        generateScope(out, node->scope, depth);
     }
 
-    std::string generateTags(const std::unordered_map<std::string, std::string>& tags)
+    void generateTags(Writer& out, const std::unordered_map<std::string, std::string>& tags)
     {
         auto isFirst = true;
-        std::string result{};
-        
+
         for (auto& [tag,val] : tags)
         {
-            if(tag.starts_with("$")) continue;
-            
-            result += (isFirst ? "" : " , ") + tag;
+            if (tag.starts_with("$")) continue;
+
+            if (!isFirst) out.Pretty(" , ", ",");
+            out << tag;
             isFirst = false;
-            if(!val.empty())
+            if (!val.empty())
             {
-                result += " = " + val;
+                out.Pretty(" = ", "=") << val;
             }
         }
-
-        return result;
     }
 
-    std::string generateLayout(const std::shared_ptr<LayoutNode>& node, int depth)
+    void generateLayout(Writer& out, const std::shared_ptr<LayoutNode>& node, int depth)
     {
-        std::string result = tabs(depth) + "layout(" + generateTags(node->tags) + ")";
-        
+        out.Indent(depth) << "layout(";
+        generateTags(out, node->tags);
+        out << ')';
+
         if (node->tags.contains("$flat"))
         {
-            result += " flat";
+            out.Pretty(" flat", "flat ");
         }
 
         switch (node->layoutType)
         {
         case ELayoutType::Uniform:
-            result += " uniform ";
+            out.Pretty(" uniform ", "uniform ");
             break;
         case ELayoutType::Readonly:
-            result += " readonly ";
+            out.Pretty(" readonly ", "readonly ");
             break;
         case ELayoutType::Input:
-            result += " in ";
+            out.Pretty(" in ", "in ");
             break;
         case ELayoutType::Output:
-            result += " out ";
+            out.Pretty(" out ", "out ");
             break;
         }
 
-        result += generateDeclaration(node->declaration, depth) + ";\n";
-        return result;
+        generateDeclaration(out, node->declaration, depth);
+        out << ';';
+        out.NewLine();
     }
 
-    std::string generateDefine(const std::shared_ptr<DefineNode>& node, int depth)
+    void generateDefine(Writer& out, const std::shared_ptr<DefineNode>& node, int depth)
     {
-        return tabs(depth) + "#define " + node->id + " " + generateExpression(node->expression);
+        out.BeginLine().Indent(depth) << "#define " << node->id << ' ';
+        generateExpression(out, node->expression);
+        out << '\n';
     }
 
-    std::string generateInclude(const std::shared_ptr<IncludeNode>& node, int depth)
+    void generateInclude(Writer& out, const std::shared_ptr<IncludeNode>& node, int depth)
     {
-        return tabs(depth) + "#include \"" + node->targetFile + "\"";
+        out.BeginLine().Indent(depth) << "#include \"" << node->targetFile << "\"\n";
     }
 
-    std::string generateIf(const std::shared_ptr<IfNode>& node, int depth)
+    void generateIf(Writer& out, const std::shared_ptr<IfNode>& node, int depth)
     {
-        std::string result = "if(" + generateExpression(node->condition, 0) + ")\n";
-        result += tabs(depth) + generateScope(node->scope, depth) + generateElse(node->elseNode, depth);
-        return result;
+        out << "if(";
+        generateExpression(out, node->condition, 0);
+        out << ')';
+        out.NewLine();
+        out.Indent(depth);
+        generateScope(out, node->scope, depth);
+        generateElse(out, node->elseNode, depth);
     }
 
-    std::string generateElse(const std::shared_ptr<Node>& node, int depth)
+    void generateElse(Writer& out, const std::shared_ptr<Node>& node, int depth)
     {
-        if (node)
+        if (!node) return;
+
+        if (node->nodeType == NodeType::If)
         {
-            std::string result = tabs(depth) + "else ";
-            if (node->nodeType == NodeType::If)
-            {
-                return result + generateIf(std::dynamic_pointer_cast<IfNode>(node), depth);
-            }
-            if (node->nodeType == NodeType::Scope)
-            {
-                return result + "\n" + tabs(depth) + generateScope(std::dynamic_pointer_cast<ScopeNode>(node), depth);
-            }
+            out.Indent(depth) << "else ";
+            generateIf(out, std::dynamic_pointer_cast<IfNode>(node), depth);
+        }
+        else if (node->nodeType == NodeType::Scope)
+        {
+            out.Indent(depth).Pretty("else \n", "else");
+            out.Indent(depth);
+            generateScope(out, std::dynamic_pointer_cast<ScopeNode>(node), depth);
         }
-
-        return "";
     }
 
-    std::string generateFor(const std::shared_ptr<ForNode>& node, int depth)
+    void generateFor(Writer& out, const std::shared_ptr<ForNode>& node, int depth)
     {
-        std::string result = "for(" + generateExpression(node->init, 0) + ";" + generateExpression(node->condition, 0) +
-            ";" + generateExpression(node->update) + ")\n";
-        result += tabs(depth) + generateScope(node->scope, depth);
-        return result;
+        out << "for(";
+        generateExpression(out, node->init, 0);
+        out << ';';
+        generateExpression(out, node->condition, 0);
+        out << ';';
+        generateExpression(out, node->update);
+        out << ')';
+        out.NewLine();
+        out.Indent(depth);
+        generateScope(out, node->scope, depth);
     }
 
-    std::string generatePushConstant(const std::shared_ptr<PushConstantNode>& node, int depth)
+    void generatePushConstant(Writer& out, const std::shared_ptr<PushConstantNode>& node, int depth)
     {
-        std::string result = tabs(depth) + "layout(push_constant" + (node->tags.empty() ? ")" : " , " + generateTags(node->tags)) + ")";
+        out.Indent(depth) << "layout(push_constant";
+        if (!node->tags.empty())
+        {
+            out.Pretty(" , ", ",");
+            generateTags(out, node->tags);
+        }
+        out.Pretty(") uniform constant {\n", ")uniform constant{");
 
-        result += " uniform constant {\n";
         for (auto& declarationNode : node->declarations)
         {
-            result += tabs(depth + 1) + generateDeclaration(declarationNode) + ";\n";
+            out.Indent(depth + 1);
+            generateDeclaration(out, declarationNode);
+            out << ';';
+            out.NewLine();
         }
-        result += tabs(depth) + "} push;\n";
-        return result;
+        out.Indent(depth).Pretty("} push;\n", "}push;");
     }
 
-    std::string generateStruct(const std::shared_ptr<StructNode>& node, int depth)
+    void generateStruct(Writer& out, const std::shared_ptr<StructNode>& node, int depth)
     {
-        std::string result = tabs(depth) + "struct " + node->name + " {\n";
-        for (auto& declarationNode : node->declarations)
-        {
-            result += tabs(depth + 1) + generateDeclaration(declarationNode, depth + 1) + ";\n";
-        }
-        result += tabs(depth) + "};\n";
-        return result;
+        out.Indent(depth) << "struct " << node->name;
+        out.Pretty(" {\n", "{");
+        generateMembers(out, node->declarations, depth + 1);
+        out.Indent(depth) << "};";
+        out.NewLine();
     }
 
-    std::string generateStatement(const std::shared_ptr<Node>& node, int depth)
+    void generateStatement(Writer& out, const std::shared_ptr<Node>& node, int depth)
     {
         switch (node->nodeType)
         {
         case NodeType::If:
             if (auto casted = std::dynamic_pointer_cast<IfNode>(node))
             {
-                return generateIf(casted, depth);
+                generateIf(out, casted, depth);
             }
             break;
         case NodeType::For:
             if (auto casted = std::dynamic_pointer_cast<ForNode>(node))
             {
-                return generateFor(casted, depth);
+                generateFor(out, casted, depth);
             }
             break;
+        case NodeType::Scope:
+            generateScope(out, std::dynamic_pointer_cast<ScopeNode>(node), depth);
+            break;
         default:
-            return generateExpression(node, depth) + ";\n";
+            generateExpression(out, node, depth);
+            out << ';';
+            out.NewLine();
+            break;
         }
-        return "";
     }
 
-    std::string generateExpression(const std::shared_ptr<Node>& node, int depth)
+    void generateExpression(Writer& out, const std::shared_ptr<Node>& node, int depth)
     {
         switch (node->nodeType)
         {
         case NodeType::Unknown:
             throw std::runtime_error("Unknown node");
         case NodeType::NoOp:
-            return "";
+            break;
         case NodeType::BinaryOp:
             if (auto casted = std::dynamic_pointer_cast<BinaryOpNode>(node))
             {
-                std::string op{};
-                switch (casted->op)
-                {
-                case EBinaryOp::Multiply:
-                    op = " * ";
-                    break;
-                case EBinaryOp::Divide:
-                    op = " / ";
-                    break;
-                case EBinaryOp::Add:
-                    op = " + ";
-                    break;
-                case EBinaryOp::Subtract:
-                    op = " - ";
-                    break;
-                case EBinaryOp::Mod:
-                    op = " % ";
-                    break;
-                case EBinaryOp::And:
-                    op = " && ";
-                    break;
-                case EBinaryOp::Or:
-                    op = " || ";
-                    break;
-                case EBinaryOp::Not:
-                    op = "!";
-                    break;
-                case EBinaryOp::Equal:
-                    op = " == ";
-                    break;
-                case EBinaryOp::NotEqual:
-                    op = " != ";
-                    break;
-                case EBinaryOp::Less:
-                    op = " < ";
-                    break;
-                case EBinaryOp::LessEqual:
-                    op = " <= ";
-                    break;
-                case EBinaryOp::Greater:
-                    op = " > ";
-                    break;
-                case EBinaryOp::GreaterEqual:
-                    op = " >= ";
-                    break;
-                }
-
                 if (casted->op == EBinaryOp::Not)
                 {
                     throw std::runtime_error("! not supported");
                 }
 
-                return generateExpression(casted->left) + op + generateExpression(casted->right);
+                const auto op = binaryOpToString(casted->op);
+                generateExpression(out, casted->left);
+                out.Pretty(op, op.substr(1, op.size() - 2));
+                generateExpression(out, casted->right);
             }
             break;
         case NodeType::Return:
             if (auto casted = std::dynamic_pointer_cast<ReturnNode>(node))
             {
-                return "return " + generateExpression(casted->expression);
+                out << "return ";
+                generateExpression(out, casted->expression);
             }
             break;
         case NodeType::Assign:
             if (auto casted = std::dynamic_pointer_cast<AssignNode>(node))
             {
-                return generateExpression(casted->target) + " = " + generateExpression(casted->value);
+                generateExpression(out, casted->target);
+                out.Pretty(" = ", "=");
+                generateExpression(out, casted->value);
             }
             break;
         case NodeType::BinaryOpAndAssign:
@@ -373,194 +374,312 @@ namespace rsl::glsl
         case NodeType::Call:
             if (auto casted = std::dynamic_pointer_cast<CallNode>(node))
             {
-                std::string args{};
+                generateExpression(out, casted->identifier);
 
+                // Calls whose arguments generate nothing are written as "()"
+                const auto start = out.GetMark();
+                out.Pretty("( ", "(");
+                const auto argsStart = out.GetSize();
                 for (size_t i = 0; i < casted->args.size(); i++)
                 {
-                    args += generateExpression(casted->args[i], 0);
+                    generateExpression(out, casted->args[i], 0);
                     if (i != casted->args.size() - 1)
                     {
-                        args += " , ";
+                        out.Pretty(" , ", ",");
                     }
                 }
 
-                return generateExpression(casted->identifier) + (args.empty() ? "()" : "( " + args + " )");
+                if (out.GetSize() == argsStart)
+                {
+                    out.Truncate(start);
+                    out << "()";
+                }
+                else
+                {
+                    out.Pretty(" )", ")");
+                }
             }
             break;
         case NodeType::Access:
             if (auto casted = std::dynamic_pointer_cast<AccessNode>(node))
             {
-                return generateExpression(casted->left) + "." + generateExpression(casted->right);
+                generateExpression(out, casted->left);
+                out << '.';
+                generateExpression(out, casted->right);
             }
             break;
         case NodeType::Index:
             if (auto casted = std::dynamic_pointer_cast<IndexNode>(node))
             {
-                return generateExpression(casted->left) + "[" + generateExpression(casted->indexExpression) + "]";
+                generateExpression(out, casted->left);
+                out << '[';
+                generateExpression(out, casted->indexExpression);
+                out << ']';
             }
             break;
         case NodeType::Scope:
             if (auto casted = std::dynamic_pointer_cast<ScopeNode>(node))
             {
-                return generateScope(casted, depth);
+                generateScope(out, casted, depth);
             }
             break;
         case NodeType::Identifier:
             if (auto casted = std::dynamic_pointer_cast<IdentifierNode>(node))
             {
-                return typeNameToGlslTypeName(casted->id);
+                out << typeNameToGlslTypeName(casted->id);
             }
             break;
         case NodeType::Declaration:
             if (auto casted = std::dynamic_pointer_cast<DeclarationNode>(node))
             {
-                return generateDeclaration(casted, depth);
+                generateDeclaration(out, casted, depth);
             }
             break;
         case NodeType::FloatLiteral:
             if (auto casted = std::dynamic_pointer_cast<FloatLiteralNode>(node))
             {
-                auto str = std::to_string(casted->data);
-                while (!str.empty() && str[str.length() - 1] == '0' && str[str.length() - 2] != '.')
-                {
-                    str = str.substr(0, str.length() - 1);
-                }
-                return str;
+                out << casted->data;
             }
             break;
         case NodeType::IntLiteral:
             if (auto casted = std::dynamic_pointer_cast<IntegerLiteralNode>(node))
             {
-                return std::to_string(casted->data);
+                out << casted->data;
             }
             break;
         case NodeType::Const:
             if (auto casted = std::dynamic_pointer_cast<ConstNode>(node))
             {
-                return "const " + generateExpression(casted->declaration);
+                out << "const ";
+                generateExpression(out, casted->declaration);
             }
             break;
         case NodeType::ArrayLiteral:
             if (auto casted = std::dynamic_pointer_cast<ArrayLiteralNode>(node))
             {
-                std::string result = "{ ";
+                out.Pretty("{ ", "{");
 
                 for (size_t i = 0; i < casted->nodes.size(); i++)
                 {
-                    result += generateExpression(casted->nodes[i]);
+                    generateExpression(out, casted->nodes[i]);
                     if (i != casted->nodes.size() - 1)
                     {
-                        result += " , ";
+                        out.Pretty(" , ", ",");
                     }
                 }
 
-                result += " }";
-
-                return result;
+                out.Pretty(" }", "}");
             }
             break;
-            break;
         case NodeType::Negate:
             if (auto casted = std::dynamic_pointer_cast<NegateNode>(node))
             {
-                return "-" + generateExpression(casted->target);
+                out << '-';
+                generateExpression(out, casted->target);
             }
             break;
         case NodeType::Precedence:
             if (auto casted = std::dynamic_pointer_cast<PrecedenceNode>(node))
             {
-                return "( " + generateExpression(casted->target) + " )";
+                out.Pretty("( ", "(");
+                generateExpression(out, casted->target);
+                out.Pretty(" )", ")");
             }
             break;
         case NodeType::Increment:
             if (auto casted = std::dynamic_pointer_cast<IncrementNode>(node))
             {
-                return (casted->isPrefix
-                            ? "++" + generateExpression(casted->target)
-                            : generateExpression(casted->target) + "++");
+                if (casted->isPrefix) out << "++";
+                generateExpression(out, casted->target);
+                if (!casted->isPrefix) out << "++";
             }
             break;
         case NodeType::Decrement:
             if (auto casted = std::dynamic_pointer_cast<DecrementNode>(node))
             {
-                return (casted->isPrefix
-                            ? "--" + generateExpression(casted->target)
-                            : generateExpression(casted->target) + "--");
+                if (casted->isPrefix) out << "--";
+                generateExpression(out, casted->target);
+                if (!casted->isPrefix) out << "--";
             }
             break;
         case NodeType::Discard:
-            if (auto casted = std::dynamic_pointer_cast<DiscardNode>(node))
-            {
-                return "discard";
-            }
+            out << "discard";
             break;
         case NodeType::Conditional:
             if (auto casted = std::dynamic_pointer_cast<ConditionalNode>(node))
             {
-                return generateExpression(casted->condition) + " ? " + generateExpression(casted->left) + " : " +
-                    generateExpression(casted->right);
+                generateExpression(out, casted->condition);
+                out.Pretty(" ? ", "?");
+                generateExpression(out, casted->left);
+                out.Pretty(" : ", ":");
+                generateExpression(out, casted->right);
             }
             break;
         case NodeType::BooleanLiteral:
             if (auto casted = std::dynamic_pointer_cast<BooleanLiteralNode>(node))
             {
-                return (casted->data ? "true" : "false");
+                out << (casted->data ? "true" : "false");
             }
             break;
+        default:
+            break;
         }
-
-        return "";
     }
 
-    std::string generate(const std::shared_ptr<ModuleNode>& node, int depth)
+    void generateTopLevelStatement(Writer& out, const std::shared_ptr<Node>& node, int depth)
     {
-        std::string result{};
-
-        for (auto& statement : node->statements)
+        switch (node->nodeType)
         {
-            switch (statement->nodeType)
+        case NodeType::Include:
+            generateInclude(out, std::dynamic_pointer_cast<IncludeNode>(node), depth);
+            break;
+        case NodeType::Function:
+            generateFunction(out, std::dynamic_pointer_cast<FunctionNode>(node), depth);
+            break;
+        case NodeType::Layout:
+            generateLayout(out, std::dynamic_pointer_cast<LayoutNode>(node), depth);
+            break;
+        case NodeType::Define:
+            generateDefine(out, std::dynamic_pointer_cast<DefineNode>(node), depth);
+            break;
+        case NodeType::PushConstant:
+            generatePushConstant(out, std::dynamic_pointer_cast<PushConstantNode>(node), depth);
+            break;
+        case NodeType::Struct:
+            generateStruct(out, std::dynamic_pointer_cast<StructNode>(node), depth);
+            break;
+        default:
             {
-            case NodeType::Include:
-                {
-                    result += generateInclude(std::dynamic_pointer_cast<IncludeNode>(statement), depth);
-                }
-                break;
-            case NodeType::Function:
-                {
-                    result += generateFunction(std::dynamic_pointer_cast<FunctionNode>(statement), depth);
-                }
-                break;
-            case NodeType::Layout:
-                {
-                    result += generateLayout(std::dynamic_pointer_cast<LayoutNode>(statement), depth);
-                }
-                break;
-            case NodeType::Define:
-                {
-                    result += generateDefine(std::dynamic_pointer_cast<DefineNode>(statement), depth);
-                }
-                break;
-            case NodeType::PushConstant:
-                {
-                    result += generatePushConstant(std::dynamic_pointer_cast<PushConstantNode>(statement), depth);
-                }
-                break;
-            case NodeType::Struct:
+                // Statements that generate nothing are dropped along with their indentation
+                const auto start = out.GetMark();
+                out.Indent(depth);
+                const auto expressionStart = out.GetSize();
+                generateExpression(out, node, depth);
+
+                if (out.GetSize() == expressionStart)
                 {
-                    result += generateStruct(std::dynamic_pointer_cast<StructNode>(statement), depth);
+                    out.Truncate(start);
                 }
-                break;
-            default:
+                else
                 {
-                    if (auto expr = generateExpression(statement, depth); !expr.empty())
-                    {
-                        result += tabs(depth) + generateExpression(statement, depth) + ";\n";
-                    }
+                    out << ';';
+                    out.NewLine();
                 }
-                break;
             }
+            break;
         }
+    }
 
-        return result;
+    void generate(Writer& out, const std::shared_ptr<ModuleNode>& node, int depth)
+    {
+        for (auto& statement : node->statements)
+        {
+            generateTopLevelStatement(out, statement, depth);
+            out.Commit();
+        }
+    }
+
+    size_t GenerateOptions::ComputeHash() const
+    {
+        return hashCombine(minify);
+    }
+
+    void generateTopLevelStatement(Writer& out, const std::shared_ptr<Node>& node, const GenerateOptions& options)
+    {
+        out.SetCompact(options.minify);
+
+        if (!options.cache || (node->nodeType != NodeType::Function && node->nodeType != NodeType::Struct))
+        {
+            generateTopLevelStatement(out, node);
+            return;
+        }
+
+        const auto key = hashCombine(node->ComputeHash(), options.ComputeHash());
+        if (options.cache->Write(key, *node, out)) return;
+
+        Writer statementOut{1024};
+        statementOut.SetCompact(options.minify);
+        generateTopLevelStatement(statementOut, node);
+        out << statementOut.GetBuffer();
+        options.cache->Insert(key, node, statementOut.Take());
+    }
+
+    void generate(Writer& out, const std::shared_ptr<ModuleNode>& node, const GenerateOptions& options)
+    {
+        out.SetCompact(options.minify);
+
+        std::vector<size_t> parallelIndices{};
+        if (options.pool)
+        {
+            for (size_t i = 0; i < node->statements.size(); i++)
+            {
+                const auto type = node->statements[i]->nodeType;
+                if (type == NodeType::Function || type == NodeType::Struct) parallelIndices.push_back(i);
+            }
+        }
+
+        if (parallelIndices.size() < std::max<size_t>(options.minParallelStatements, 2))
+        {
+            for (auto& statement : node->statements)
+            {
+                generateTopLevelStatement(out, statement, options);
+                out.Commit();
+            }
+            return;
+        }
+
+        std::vector<std::string> buffers(node->statements.size());
+        options.pool->ParallelFor(parallelIndices.size(), [&node,&parallelIndices,&buffers,&options](size_t i)
+        {
+            const auto index = parallelIndices[i];
+            Writer statementOut{1024};
+            statementOut.SetCompact(options.minify);
+            generateTopLevelStatement(statementOut, node->statements[index], options);
+            buffers[index] = statementOut.Take();
+        });
+
+        // Defines, layouts and the like are cheap enough to generate while joining
+        auto nextParallel = parallelIndices.begin();
+        for (size_t i = 0; i < node->statements.size(); i++)
+        {
+            if (nextParallel != parallelIndices.end() && *nextParallel == i)
+            {
+                out << buffers[i];
+                ++nextParallel;
+            }
+            else
+            {
+                generateTopLevelStatement(out, node->statements[i]);
+            }
+            out.Commit();
+        }
+    }
+
+    std::string generateExpression(const std::shared_ptr<Node>& node, int depth)
+    {
+        Writer out{256};
+        generateExpression(out, node, depth);
+        return out.Take();
+    }
+
+    std::string generateTopLevelStatement(const std::shared_ptr<Node>& node, int depth)
+    {
+        Writer out{};
+        generateTopLevelStatement(out, node, depth);
+        return out.Take();
+    }
+
+    std::string generate(const std::shared_ptr<ModuleNode>& node, int depth)
+    {
+        Writer out{};
+        generate(out, node, depth);
+        return out.Take();
+    }
+
+    std::string generate(const std::shared_ptr<ModuleNode>& node, const GenerateOptions& options)
+    {
+        Writer out{};
+        generate(out, node, options);
+        return out.Take();
     }
 }
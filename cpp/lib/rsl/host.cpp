@@ -0,0 +1,260 @@
+#include "rsl/host.hpp"
+
+#include <optional>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rsl::host
+{
+    namespace
+    {
+        struct Shape
+        {
+            std::string_view scalar{};
+            uint32_t components = 0;
+            uint32_t columns = 0;
+        };
+
+        // Host type and shape of the RSL types that can be placed in a block, or nullopt for structs
+        std::optional<Shape> shapeOf(const std::string& typeName)
+        {
+            switch (DeclarationNode::TokenTypeToDeclarationType(Token(typeName, {}).type))
+            {
+            case EDeclarationType::Float:
+                return Shape{"float", 1, 1};
+            case EDeclarationType::Float2:
+                return Shape{"float", 2, 1};
+            case EDeclarationType::Float3:
+                return Shape{"float", 3, 1};
+            case EDeclarationType::Float4:
+                return Shape{"float", 4, 1};
+            case EDeclarationType::Int:
+                return Shape{"std::int32_t", 1, 1};
+            case EDeclarationType::Int2:
+                return Shape{"std::int32_t", 2, 1};
+            case EDeclarationType::Int3:
+                return Shape{"std::int32_t", 3, 1};
+            case EDeclarationType::Int4:
+                return Shape{"std::int32_t", 4, 1};
+            case EDeclarationType::Boolean:
+                // Booleans take a whole 32 bit word in every layout
+                return Shape{"std::uint32_t", 1, 1};
+            case EDeclarationType::Mat3:
+                return Shape{"float", 3, 3};
+            case EDeclarationType::Mat4:
+                return Shape{"float", 4, 4};
+            default:
+                return std::nullopt;
+            }
+        }
+
+        std::string resourceComment(const ResourceReflection& resource)
+        {
+            std::string kind = resource.type == EResourceType::PushConstant
+                                   ? "Push constants"
+                                   : resource.type == EResourceType::StorageBuffer
+                                   ? "Storage buffer"
+                                   : "Uniform block";
+            if (resource.type != EResourceType::PushConstant)
+            {
+                kind += " at set " + std::to_string(resource.set) + ", binding " + std::to_string(resource.binding);
+            }
+            return kind + ", " + std::string(layoutRuleName(resource.layout.rule));
+        }
+
+        class Generator
+        {
+            Writer& _out;
+            const GenerateOptions& _options;
+            // Declarations are written here first since the padded element template is only declared when used
+            Writer _body{};
+            bool _usesPaddedElement = false;
+            // Rules each RSL struct is used under, to tell apart the declarations of a struct used under several
+            std::unordered_map<std::string, std::set<ELayoutRule>> _structRules{};
+            std::unordered_set<std::string> _declared{};
+
+        public:
+            Generator(Writer& inOut, const GenerateOptions& inOptions) : _out(inOut), _options(inOptions)
+            {
+            }
+
+            void Generate(const Reflection& reflection)
+            {
+                const auto depth = _options.namespaceName.empty() ? 0 : 1;
+                for (auto& resource : reflection.resources)
+                {
+                    if (resource.type == EResourceType::Opaque) continue;
+                    CollectStructs(resource.layout.members, resource.layout.rule);
+                }
+
+                for (auto& resource : reflection.resources)
+                {
+                    if (resource.type == EResourceType::Opaque) continue;
+
+                    auto& layout = resource.layout;
+                    DeclareStructs(layout.members, layout.rule, depth);
+                    DeclareStruct(layout.name, layout.alignment, layout.size, layout.members, layout.rule, depth,
+                                  resourceComment(resource));
+                }
+
+                _out << "// Generated from RSL. Do not edit.\n#pragma once\n\n#include <cstddef>\n#include <cstdint>\n\n";
+                if (depth > 0) _out << "namespace " << _options.namespaceName << "\n{\n";
+
+                if (_usesPaddedElement)
+                {
+                    _out.Indent(depth) << "// Array element followed by the padding its layout adds between elements\n";
+                    _out.Indent(depth) << "template <typename T, std::size_t Stride>\n";
+                    _out.Indent(depth) << "struct PaddedElement\n";
+                    _out.Indent(depth) << "{\n";
+                    _out.Indent(depth + 1) << "T value;\n";
+                    _out.Indent(depth + 1) << "std::uint8_t padding[Stride - sizeof(T)];\n";
+                    _out.Indent(depth) << "};\n\n";
+                }
+
+                _out << _body.GetBuffer();
+                if (depth > 0) _out << "}\n";
+            }
+
+        private:
+            void CollectStructs(const std::vector<MemberLayout>& members, ELayoutRule rule)
+            {
+                for (auto& member : members)
+                {
+                    if (shapeOf(member.typeName)) continue;
+                    _structRules[member.typeName].insert(rule);
+                    CollectStructs(member.members, rule);
+                }
+            }
+
+            [[nodiscard]] std::string StructName(const std::string& typeName, ELayoutRule rule) const
+            {
+                if (_structRules.at(typeName).size() == 1) return typeName;
+                return typeName + "_" + std::string(layoutRuleName(rule));
+            }
+
+            // Declares the structs used by members that are not declared yet, innermost first
+            void DeclareStructs(const std::vector<MemberLayout>& members, ELayoutRule rule, int depth)
+            {
+                for (auto& member : members)
+                {
+                    if (shapeOf(member.typeName)) continue;
+
+                    auto name = StructName(member.typeName, rule);
+                    if (_declared.contains(name)) continue;
+
+                    DeclareStructs(member.members, rule, depth);
+                    // The alignment of a struct array is that of its elements in every rule, since std140 already
+                    // rounds struct alignment up to 16
+                    DeclareStruct(name, member.alignment, member.arrayLength == 0 ? member.size : member.arrayStride,
+                                  member.members, rule, depth);
+                }
+            }
+
+            void DeclareStruct(const std::string& name, uint32_t alignment, uint32_t size,
+                               const std::vector<MemberLayout>& members, ELayoutRule rule, int depth,
+                               const std::string& comment = {})
+            {
+                if (!_declared.empty()) _body << '\n';
+                _declared.insert(name);
+                if (!comment.empty()) _body.Indent(depth) << "// " << comment << '\n';
+                _body.Indent(depth) << "struct alignas(" << static_cast<uint64_t>(alignment) << ") " << name << '\n';
+                _body.Indent(depth) << "{\n";
+
+                uint32_t offset = 0;
+                auto paddingIndex = 0;
+                auto pad = [&](uint32_t to)
+                {
+                    if (to <= offset) return;
+                    _body.Indent(depth + 1) << "std::uint8_t _padding" << paddingIndex++ << '[' <<
+                        static_cast<uint64_t>(to - offset) << "];\n";
+                    offset = to;
+                };
+
+                for (auto& member : members)
+                {
+                    if (member.arrayLength < 0) continue;
+
+                    pad(member.offset);
+                    auto [type, suffix] = MemberType(member, rule);
+                    _body.Indent(depth + 1) << type << ' ' << member.name << suffix << ";\n";
+                    offset = member.offset + member.size;
+                }
+                pad(size);
+
+                if (!members.empty() && members.back().arrayLength < 0)
+                {
+                    auto& member = members.back();
+                    auto [type, suffix] = ElementType(member, rule);
+                    _body << '\n';
+                    _body.Indent(depth + 1) << "// Followed by an unsized array of " << type << suffix << '\n';
+                    _body.Indent(depth + 1) << "static constexpr std::size_t " << member.name << "Offset = " <<
+                        static_cast<uint64_t>(member.offset) << ";\n";
+                    _body.Indent(depth + 1) << "static constexpr std::size_t " << member.name << "Stride = " <<
+                        static_cast<uint64_t>(member.arrayStride) << ";\n";
+                }
+
+                _body.Indent(depth) << "};\n\n";
+                _body.Indent(depth) << "static_assert(sizeof(" << name << ") == " << static_cast<uint64_t>(size) <<
+                    ");\n";
+                for (auto& member : members)
+                {
+                    if (member.arrayLength < 0) continue;
+                    _body.Indent(depth) << "static_assert(offsetof(" << name << ", " << member.name << ") == " <<
+                        static_cast<uint64_t>(member.offset) << ");\n";
+                }
+            }
+
+            // Type and declarator suffix of a single element of member
+            std::pair<std::string, std::string> ElementType(const MemberLayout& member, ELayoutRule rule) const
+            {
+                auto shape = shapeOf(member.typeName);
+                if (!shape) return {StructName(member.typeName, rule), ""};
+
+                if (shape->columns > 1)
+                {
+                    return {
+                        std::string(shape->scalar),
+                        "[" + std::to_string(shape->columns) + "][" + std::to_string(member.matrixStride / 4) + "]"
+                    };
+                }
+                if (shape->components > 1)
+                {
+                    return {std::string(shape->scalar), "[" + std::to_string(shape->components) + "]"};
+                }
+                return {std::string(shape->scalar), ""};
+            }
+
+            std::pair<std::string, std::string> MemberType(const MemberLayout& member, ELayoutRule rule)
+            {
+                auto [type, suffix] = ElementType(member, rule);
+                if (member.arrayLength == 0) return {type, suffix};
+
+                const auto length = "[" + std::to_string(member.arrayLength) + "]";
+                auto elementSize = member.arrayStride;
+                if (auto shape = shapeOf(member.typeName))
+                {
+                    elementSize = shape->columns > 1 ? member.matrixStride * shape->columns : shape->components * 4;
+                }
+                if (elementSize == member.arrayStride) return {type, length + suffix};
+
+                // std140 arrays of scalars and vectors, and std430 arrays of float3, leave a gap after each element
+                _usesPaddedElement = true;
+                return {"PaddedElement<" + type + suffix + ", " + std::to_string(member.arrayStride) + ">", length};
+            }
+        };
+    }
+
+    void generate(Writer& out, const Reflection& reflection, const GenerateOptions& options)
+    {
+        Generator(out, options).Generate(reflection);
+    }
+
+    std::string generate(const Reflection& reflection, const GenerateOptions& options)
+    {
+        Writer out{};
+        generate(out, reflection, options);
+        return out.Take();
+    }
+}
@@ -0,0 +1,3160 @@
+#include "rsl/interpreter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace rsl::interp
+{
+    namespace
+    {
+        // Invocations held by each register and processed by each instruction
+        constexpr uint32_t CHUNK = 32;
+        // Set on register indices that refer to the constant pool instead of the register file
+        constexpr uint32_t CONSTANT_BIT = 0x80000000u;
+        constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+        union Word
+        {
+            float f;
+            int32_t i;
+            uint32_t u;
+        };
+
+        enum class EBase : uint8_t
+        {
+            Void,
+            Float,
+            Int,
+            Bool,
+            Struct
+        };
+
+        struct StructInfo;
+
+        struct Type
+        {
+            EBase base = EBase::Void;
+            // Components per column, and columns for matrices
+            uint32_t rows = 1;
+            uint32_t columns = 1;
+            // 0 when not an array, NONE for an unsized array waiting for its initializer
+            uint32_t arrayLength = 0;
+            const StructInfo* structInfo = nullptr;
+
+            [[nodiscard]] uint32_t ElementSize() const;
+
+            [[nodiscard]] uint32_t Size() const
+            {
+                return ElementSize() * std::max(arrayLength, 1u);
+            }
+
+            [[nodiscard]] Type Element() const
+            {
+                auto result = *this;
+                result.arrayLength = 0;
+                return result;
+            }
+
+            [[nodiscard]] bool IsArray() const
+            {
+                return arrayLength != 0;
+            }
+
+            [[nodiscard]] bool IsNumeric() const
+            {
+                return !IsArray() && (base == EBase::Float || base == EBase::Int || base == EBase::Bool);
+            }
+
+            [[nodiscard]] bool IsScalar() const
+            {
+                return IsNumeric() && rows == 1 && columns == 1;
+            }
+
+            [[nodiscard]] bool IsVector() const
+            {
+                return IsNumeric() && rows > 1 && columns == 1;
+            }
+
+            [[nodiscard]] bool IsMatrix() const
+            {
+                return IsNumeric() && columns > 1;
+            }
+
+            [[nodiscard]] Type WithBase(EBase inBase) const
+            {
+                auto result = *this;
+                result.base = inBase;
+                return result;
+            }
+
+            [[nodiscard]] std::string Name() const;
+
+            bool operator==(const Type&) const = default;
+        };
+
+        struct Member
+        {
+            std::string name{};
+            Type type{};
+            uint32_t offset = 0;
+        };
+
+        struct StructInfo
+        {
+            std::string name{};
+            std::vector<Member> members{};
+            uint32_t size = 0;
+        };
+
+        uint32_t Type::ElementSize() const
+        {
+            switch (base)
+            {
+            case EBase::Void:
+                return 0;
+            case EBase::Struct:
+                return structInfo->size;
+            default:
+                return rows * columns;
+            }
+        }
+
+        std::string Type::Name() const
+        {
+            std::string result{};
+            switch (base)
+            {
+            case EBase::Void:
+                result = "void";
+                break;
+            case EBase::Struct:
+                result = structInfo->name;
+                break;
+            case EBase::Float:
+                result = columns > 1 ? "mat" + std::to_string(columns) : rows > 1 ? "float" + std::to_string(rows) : "float";
+                break;
+            case EBase::Int:
+                result = rows > 1 ? "int" + std::to_string(rows) : "int";
+                break;
+            case EBase::Bool:
+                result = "bool";
+                break;
+            }
+            if (arrayLength == NONE) return result + "[]";
+            if (arrayLength != 0) return result + "[" + std::to_string(arrayLength) + "]";
+            return result;
+        }
+
+        Type scalarType(EBase base, uint32_t rows = 1, uint32_t columns = 1)
+        {
+            Type result{};
+            result.base = base;
+            result.rows = rows;
+            result.columns = columns;
+            return result;
+        }
+
+        enum class EOp : uint8_t
+        {
+            // dst = a for count components
+            Copy,
+            // dst = a where the mask in c is set
+            Store,
+            // Fills count components of dst with imm
+            Fill,
+            // dst = a[b + imm], where b holds a component offset per invocation
+            LoadDynamic,
+            // dst[b + imm] = a where the mask in c is set
+            StoreDynamic,
+            // dst = clamp(a, 0, count - 1) * imm, plus b when it is not NONE
+            IndexOffset,
+            // Component wise float function selected by sub with up to three arguments
+            Float,
+            // Component wise int function selected by sub with up to three arguments
+            Int,
+            // Scalar comparison selected by sub, giving a bool
+            CompareFloat,
+            CompareInt,
+            // Whether all count components of a and b are equal, or any differ when imm is 1. sub is 1 to compare
+            // bits instead of floats.
+            Equal,
+            And,
+            Or,
+            Not,
+            // Base type conversion selected by sub
+            Convert,
+            // dst = c ? a : b with a scalar condition
+            Select,
+            Dot,
+            Length,
+            Distance,
+            Normalize,
+            Cross,
+            Reflect,
+            Refract,
+            FaceForward,
+            // dst = a * b for a count x imm matrix a and an imm x c matrix b, all column major
+            MatrixMultiply,
+            Transpose,
+            Determinant,
+            Inverse,
+            Jump,
+            // Jumps to imm when the mask in a is clear for every invocation
+            JumpIfNone,
+            Call,
+            Return
+        };
+
+        enum class EFloatOp : uint8_t
+        {
+            Add,
+            Subtract,
+            Multiply,
+            Divide,
+            Negate,
+            Abs,
+            Sign,
+            Floor,
+            Ceil,
+            Fract,
+            Trunc,
+            Round,
+            Sqrt,
+            InverseSqrt,
+            Exp,
+            Exp2,
+            Log,
+            Log2,
+            Sin,
+            Cos,
+            Tan,
+            Asin,
+            Acos,
+            Atan,
+            Radians,
+            Degrees,
+            Mod,
+            Pow,
+            Atan2,
+            Min,
+            Max,
+            Step,
+            Clamp,
+            Mix,
+            SmoothStep
+        };
+
+        enum class EIntOp : uint8_t
+        {
+            Add,
+            Subtract,
+            Multiply,
+            Divide,
+            Mod,
+            Negate,
+            Abs,
+            Sign,
+            Min,
+            Max,
+            Clamp
+        };
+
+        enum class ECompare : uint8_t
+        {
+            Less,
+            LessEqual,
+            Greater,
+            GreaterEqual,
+            Equal,
+            NotEqual
+        };
+
+        enum class EConvert : uint8_t
+        {
+            FloatToInt,
+            IntToFloat,
+            FloatToBool,
+            IntToBool
+        };
+
+        struct Instruction
+        {
+            EOp op = EOp::Copy;
+            uint8_t sub = 0;
+            // One bit per argument holding a single component that is used for every component of the result
+            uint8_t broadcast = 0;
+            uint32_t dst = NONE;
+            uint32_t a = NONE;
+            uint32_t b = NONE;
+            uint32_t c = NONE;
+            uint32_t count = 0;
+            int32_t imm = 0;
+        };
+
+        struct Builtin
+        {
+            EFloatOp floatOp;
+            int arity;
+            // Int version for functions GLSL also defines on ints
+            bool hasInt = false;
+            EIntOp intOp = EIntOp::Add;
+        };
+
+        const std::unordered_map<std::string, Builtin> BUILTINS = {
+            {"abs", {EFloatOp::Abs, 1, true, EIntOp::Abs}},
+            {"sign", {EFloatOp::Sign, 1, true, EIntOp::Sign}},
+            {"floor", {EFloatOp::Floor, 1}},
+            {"ceil", {EFloatOp::Ceil, 1}},
+            {"fract", {EFloatOp::Fract, 1}},
+            {"trunc", {EFloatOp::Trunc, 1}},
+            {"round", {EFloatOp::Round, 1}},
+            {"sqrt", {EFloatOp::Sqrt, 1}},
+            {"inversesqrt", {EFloatOp::InverseSqrt, 1}},
+            {"exp", {EFloatOp::Exp, 1}},
+            {"exp2", {EFloatOp::Exp2, 1}},
+            {"log", {EFloatOp::Log, 1}},
+            {"log2", {EFloatOp::Log2, 1}},
+            {"sin", {EFloatOp::Sin, 1}},
+            {"cos", {EFloatOp::Cos, 1}},
+            {"tan", {EFloatOp::Tan, 1}},
+            {"asin", {EFloatOp::Asin, 1}},
+            {"acos", {EFloatOp::Acos, 1}},
+            {"radians", {EFloatOp::Radians, 1}},
+            {"degrees", {EFloatOp::Degrees, 1}},
+            {"mod", {EFloatOp::Mod, 2}},
+            {"pow", {EFloatOp::Pow, 2}},
+            {"min", {EFloatOp::Min, 2, true, EIntOp::Min}},
+            {"max", {EFloatOp::Max, 2, true, EIntOp::Max}},
+            {"step", {EFloatOp::Step, 2}},
+            {"clamp", {EFloatOp::Clamp, 3, true, EIntOp::Clamp}},
+            {"mix", {EFloatOp::Mix, 3}},
+            {"smoothstep", {EFloatOp::SmoothStep, 3}},
+        };
+
+        const std::unordered_set<std::string> GPU_BUILTINS = {
+            "texture", "textureLod", "textureSize", "texelFetch", "dFdx", "dFdy", "fwidth"
+        };
+
+        // Component index of a swizzle letter, or -1
+        int swizzleIndex(char c)
+        {
+            for (auto set : {std::string_view{"xyzw"}, std::string_view{"rgba"}, std::string_view{"stpq"}})
+            {
+                if (auto index = set.find(c); index != std::string_view::npos) return static_cast<int>(index);
+            }
+            return -1;
+        }
+
+        void collectReferences(const std::shared_ptr<Node>& node, std::unordered_set<std::string>& names)
+        {
+            if (!node) return;
+            if (node->nodeType == NodeType::Identifier)
+            {
+                names.insert(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+            }
+            else if (node->nodeType == NodeType::Access)
+            {
+                // Members and swizzles are not references
+                collectReferences(std::dynamic_pointer_cast<AccessNode>(node)->left, names);
+                return;
+            }
+
+            for (auto& child : node->GetChildren())
+            {
+                collectReferences(child, names);
+            }
+        }
+
+        template <typename F>
+        void applyFloat1(Word* d, const Word* a, uint8_t broadcast, uint32_t count, uint32_t width, F f)
+        {
+            for (uint32_t k = 0; k < count; k++, d += CHUNK)
+            {
+                auto pa = a + (broadcast & 1 ? 0 : k * CHUNK);
+                for (uint32_t l = 0; l < width; l++) d[l].f = f(pa[l].f);
+            }
+        }
+
+        template <typename F>
+        void applyFloat2(Word* d, const Word* a, const Word* b, uint8_t broadcast, uint32_t count, uint32_t width, F f)
+        {
+            for (uint32_t k = 0; k < count; k++, d += CHUNK)
+            {
+                auto pa = a + (broadcast & 1 ? 0 : k * CHUNK);
+                auto pb = b + (broadcast & 2 ? 0 : k * CHUNK);
+                for (uint32_t l = 0; l < width; l++) d[l].f = f(pa[l].f, pb[l].f);
+            }
+        }
+
+        template <typename F>
+        void applyFloat3(Word* d, const Word* a, const Word* b, const Word* c, uint8_t broadcast, uint32_t count,
+                         uint32_t width, F f)
+        {
+            for (uint32_t k = 0; k < count; k++, d += CHUNK)
+            {
+                auto pa = a + (broadcast & 1 ? 0 : k * CHUNK);
+                auto pb = b + (broadcast & 2 ? 0 : k * CHUNK);
+                auto pc = c + (broadcast & 4 ? 0 : k * CHUNK);
+                for (uint32_t l = 0; l < width; l++) d[l].f = f(pa[l].f, pb[l].f, pc[l].f);
+            }
+        }
+
+        template <typename F>
+        void applyInt1(Word* d, const Word* a, uint8_t broadcast, uint32_t count, uint32_t width, F f)
+        {
+            for (uint32_t k = 0; k < count; k++, d += CHUNK)
+            {
+                auto pa = a + (broadcast & 1 ? 0 : k * CHUNK);
+                for (uint32_t l = 0; l < width; l++) d[l].i = f(pa[l].i);
+            }
+        }
+
+        template <typename F>
+        void applyInt2(Word* d, const Word* a, const Word* b, uint8_t broadcast, uint32_t count, uint32_t width, F f)
+        {
+            for (uint32_t k = 0; k < count; k++, d += CHUNK)
+            {
+                auto pa = a + (broadcast & 1 ? 0 : k * CHUNK);
+                auto pb = b + (broadcast & 2 ? 0 : k * CHUNK);
+                for (uint32_t l = 0; l < width; l++) d[l].i = f(pa[l].i, pb[l].i);
+            }
+        }
+
+        template <typename F>
+        void applyInt3(Word* d, const Word* a, const Word* b, const Word* c, uint8_t broadcast, uint32_t count,
+                       uint32_t width, F f)
+        {
+            for (uint32_t k = 0; k < count; k++, d += CHUNK)
+            {
+                auto pa = a + (broadcast & 1 ? 0 : k * CHUNK);
+                auto pb = b + (broadcast & 2 ? 0 : k * CHUNK);
+                auto pc = c + (broadcast & 4 ? 0 : k * CHUNK);
+                for (uint32_t l = 0; l < width; l++) d[l].i = f(pa[l].i, pb[l].i, pc[l].i);
+            }
+        }
+
+        // Determinant of the n x n minor of a column major matrix held in one lane, skipping a row and a column
+        float laneDeterminant(const float* m, uint32_t n, uint32_t stride)
+        {
+            if (n == 1) return m[0];
+            if (n == 2) return m[0] * m[stride + 1] - m[stride] * m[1];
+
+            // Expansion along the first column
+            float minor[9];
+            float result = 0;
+            for (uint32_t row = 0; row < n; row++)
+            {
+                for (uint32_t column = 1; column < n; column++)
+                {
+                    for (uint32_t r = 0, k = 0; r < n; r++)
+                    {
+                        if (r == row) continue;
+                        minor[(column - 1) * (n - 1) + k++] = m[column * stride + r];
+                    }
+                }
+                const auto cofactor = laneDeterminant(minor, n - 1, n - 1);
+                result += (row % 2 == 0 ? 1.0f : -1.0f) * m[row] * cofactor;
+            }
+            return result;
+        }
+    }
+
+    Value::Value(std::vector<uint32_t> inWords)
+    {
+        words = std::move(inWords);
+    }
+
+    Value Value::Float(std::initializer_list<float> components)
+    {
+        Value result{};
+        for (auto component : components)
+        {
+            Word word{};
+            word.f = component;
+            result.words.push_back(word.u);
+        }
+        return result;
+    }
+
+    Value Value::Int(std::initializer_list<int32_t> components)
+    {
+        Value result{};
+        for (auto component : components)
+        {
+            result.words.push_back(static_cast<uint32_t>(component));
+        }
+        return result;
+    }
+
+    Value Value::Bool(bool value)
+    {
+        return Value({value ? 1u : 0u});
+    }
+
+    float Value::GetFloat(size_t component) const
+    {
+        Word word{};
+        word.u = words.at(component);
+        return word.f;
+    }
+
+    int32_t Value::GetInt(size_t component) const
+    {
+        return static_cast<int32_t>(words.at(component));
+    }
+
+    bool Value::GetBool(size_t component) const
+    {
+        return words.at(component) != 0;
+    }
+
+    size_t Value::GetComponentCount() const
+    {
+        return words.size();
+    }
+
+    Batch::Batch(size_t inCount, size_t componentCount)
+    {
+        count = inCount;
+        words.resize(inCount * componentCount);
+    }
+
+    Value Batch::Get(size_t invocation) const
+    {
+        Value result{};
+        for (size_t component = 0; component < GetComponentCount(); component++)
+        {
+            result.words.push_back(words[component * count + invocation]);
+        }
+        return result;
+    }
+
+    void Batch::Set(size_t invocation, const Value& value)
+    {
+        if (value.GetComponentCount() != GetComponentCount())
+        {
+            throw std::runtime_error("Expected a value with " + std::to_string(GetComponentCount()) +
+                " components but got " + std::to_string(value.GetComponentCount()));
+        }
+
+        for (size_t component = 0; component < value.words.size(); component++)
+        {
+            words[component * count + invocation] = value.words[component];
+        }
+    }
+
+    size_t Batch::GetComponentCount() const
+    {
+        return count == 0 ? 0 : words.size() / count;
+    }
+
+    struct Program::State
+    {
+        struct Variable
+        {
+            uint32_t reg = NONE;
+            Type type{};
+            bool isConstant = false;
+            // Layout, block and push constant variables, which only have a value inside a draw
+            bool isInterface = false;
+        };
+
+        struct Global
+        {
+            std::shared_ptr<DeclarationNode> declaration{};
+            std::shared_ptr<Node> value{};
+            Variable variable{};
+            bool isReady = false;
+            bool isEvaluating = false;
+            std::string error{};
+        };
+
+        struct Function
+        {
+            std::shared_ptr<FunctionNode> node{};
+            std::vector<Type> parameters{};
+            std::vector<bool> isOutput{};
+            Type returnType{};
+
+            bool isCompiled = false;
+            bool isCompiling = false;
+            std::string error{};
+
+            uint32_t entry = 0;
+            uint32_t exec = NONE;
+            uint32_t returned = NONE;
+            uint32_t result = NONE;
+            std::vector<uint32_t> parameterRegs{};
+        };
+
+        struct Operand
+        {
+            uint32_t reg = NONE;
+            Type type{};
+        };
+
+        // Something that can be read or assigned, like a variable, a member or a swizzle of one
+        struct Place
+        {
+            uint32_t reg = NONE;
+            Type type{};
+            // Register holding a component offset per invocation, for indices that differ between invocations
+            uint32_t dynamic = NONE;
+            // Offsets of the selected components from reg when swizzled
+            std::vector<uint32_t> swizzle{};
+            // Registers of the whole variable, used to find values that alias it
+            uint32_t rootReg = NONE;
+            uint32_t rootSize = 0;
+            bool isAssignable = false;
+        };
+
+        std::unordered_map<std::string, StructInfo> structs{};
+        std::unordered_map<std::string, std::vector<std::unique_ptr<Function>>> functions{};
+        std::unordered_map<std::string, Global> globals{};
+        std::unordered_map<std::string, std::shared_ptr<Node>> defines{};
+        std::unordered_set<std::string> interfaces{};
+
+        std::vector<Instruction> code{};
+        std::vector<Word> registers{};
+        std::vector<Word> constants{};
+        std::unordered_map<uint32_t, uint32_t> constantIndices{};
+        uint32_t registerCount = 0;
+        uint32_t width = CHUNK;
+        std::vector<uint32_t> callStack{};
+
+        // Compilation state of the current function. Registers are allocated from a frame that starts after every
+        // other function's registers, so calls never overwrite the caller's values.
+        std::vector<std::unordered_map<std::string, Variable>> scopes{};
+        std::unordered_set<std::string> expandingDefines{};
+        uint32_t frameTop = 0;
+        uint32_t frameHigh = 0;
+        uint32_t declaredTop = NONE;
+        uint32_t exec = NONE;
+        uint32_t returned = NONE;
+        uint32_t result = NONE;
+        Type returnType{};
+        int divergence = 0;
+        bool mayHaveReturned = false;
+
+        explicit State(const std::shared_ptr<ModuleNode>& module)
+        {
+            for (auto& statement : module->statements)
+            {
+                Register(statement);
+            }
+        }
+
+        void Register(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::Struct:
+                {
+                    auto casted = std::dynamic_pointer_cast<StructNode>(node);
+                    StructInfo info{};
+                    info.name = casted->name;
+                    for (auto& declaration : casted->declarations)
+                    {
+                        Member member{};
+                        member.name = declaration->declarationName;
+                        member.type = TypeOf(declaration);
+                        member.offset = info.size;
+                        info.size += member.type.Size();
+                        info.members.push_back(member);
+                    }
+                    structs.insert_or_assign(info.name, info);
+                }
+                break;
+            case NodeType::Function:
+                {
+                    auto function = std::make_unique<Function>();
+                    function->node = std::dynamic_pointer_cast<FunctionNode>(node);
+                    functions[function->node->name].push_back(std::move(function));
+                }
+                break;
+            case NodeType::Define:
+                if (auto casted = std::dynamic_pointer_cast<DefineNode>(node))
+                {
+                    defines.insert_or_assign(casted->id, casted->expression);
+                }
+                break;
+            case NodeType::Layout:
+                if (auto casted = std::dynamic_pointer_cast<LayoutNode>(node))
+                {
+                    interfaces.insert(casted->declaration->declarationName);
+                    if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(casted->declaration))
+                    {
+                        for (auto& member : asBuffer->declarations) interfaces.insert(member->declarationName);
+                    }
+                }
+                break;
+            case NodeType::PushConstant:
+                interfaces.insert("push");
+                break;
+            case NodeType::Assign:
+                if (auto casted = std::dynamic_pointer_cast<AssignNode>(node);
+                    casted->target->nodeType == NodeType::Const)
+                {
+                    Global global{};
+                    global.declaration = std::dynamic_pointer_cast<ConstNode>(casted->target)->declaration;
+                    global.value = casted->value;
+                    globals.insert_or_assign(global.declaration->declarationName, global);
+                }
+                break;
+            default:
+                // Stage scopes and includes, which are already resolved
+                break;
+            }
+        }
+
+        Type TypeOf(const std::shared_ptr<DeclarationNode>& declaration)
+        {
+            Type result{};
+            switch (declaration->declarationType)
+            {
+            case EDeclarationType::Float:
+                result = scalarType(EBase::Float);
+                break;
+            case EDeclarationType::Int:
+                result = scalarType(EBase::Int);
+                break;
+            case EDeclarationType::Boolean:
+                result = scalarType(EBase::Bool);
+                break;
+            case EDeclarationType::Float2:
+                result = scalarType(EBase::Float, 2);
+                break;
+            case EDeclarationType::Float3:
+                result = scalarType(EBase::Float, 3);
+                break;
+            case EDeclarationType::Float4:
+                result = scalarType(EBase::Float, 4);
+                break;
+            case EDeclarationType::Int2:
+                result = scalarType(EBase::Int, 2);
+                break;
+            case EDeclarationType::Int3:
+                result = scalarType(EBase::Int, 3);
+                break;
+            case EDeclarationType::Int4:
+                result = scalarType(EBase::Int, 4);
+                break;
+            case EDeclarationType::Mat3:
+                result = scalarType(EBase::Float, 3, 3);
+                break;
+            case EDeclarationType::Mat4:
+                result = scalarType(EBase::Float, 4, 4);
+                break;
+            case EDeclarationType::Void:
+                break;
+            case EDeclarationType::Struct:
+                {
+                    auto found = structs.find(declaration->GetTypeName());
+                    if (found == structs.end())
+                    {
+                        throw std::runtime_error("Unknown type '" + declaration->GetTypeName() + "'");
+                    }
+                    result.base = EBase::Struct;
+                    result.structInfo = &found->second;
+                }
+                break;
+            default:
+                throw std::runtime_error("Type '" + declaration->GetTypeName() + "' has no value in the interpreter");
+            }
+
+            if (declaration->declarationCount == -1)
+            {
+                result.arrayLength = NONE;
+            }
+            else if (declaration->declarationCount > 1)
+            {
+                result.arrayLength = static_cast<uint32_t>(declaration->declarationCount);
+            }
+            return result;
+        }
+
+        // Registers
+
+        Word* Ptr(uint32_t reg)
+        {
+            return reg & CONSTANT_BIT
+                       ? constants.data() + static_cast<size_t>(reg & ~CONSTANT_BIT) * CHUNK
+                       : registers.data() + static_cast<size_t>(reg) * CHUNK;
+        }
+
+        void EnsureRegisters()
+        {
+            if (registers.size() < static_cast<size_t>(registerCount) * CHUNK)
+            {
+                registers.resize(static_cast<size_t>(registerCount) * CHUNK);
+            }
+        }
+
+        uint32_t Constant(uint32_t bits)
+        {
+            if (auto found = constantIndices.find(bits); found != constantIndices.end()) return found->second;
+
+            const auto index = static_cast<uint32_t>(constants.size() / CHUNK);
+            Word word{};
+            word.u = bits;
+            constants.insert(constants.end(), CHUNK, word);
+            constantIndices.emplace(bits, index | CONSTANT_BIT);
+            return index | CONSTANT_BIT;
+        }
+
+        Operand FloatConstant(float value)
+        {
+            Word word{};
+            word.f = value;
+            return {Constant(word.u), scalarType(EBase::Float)};
+        }
+
+        void BeginFrame()
+        {
+            frameTop = registerCount;
+            frameHigh = registerCount;
+            scopes.clear();
+            scopes.emplace_back();
+            divergence = 0;
+            mayHaveReturned = false;
+        }
+
+        void EndFrame()
+        {
+            registerCount = frameHigh;
+        }
+
+        uint32_t Allocate(uint32_t count)
+        {
+            const auto reg = frameTop;
+            frameTop += count;
+            frameHigh = std::max(frameHigh, frameTop);
+            return reg;
+        }
+
+        Operand Temp(const Type& type)
+        {
+            return {Allocate(type.Size()), type};
+        }
+
+        void Emit(const Instruction& instruction)
+        {
+            code.push_back(instruction);
+        }
+
+        void EmitCopy(uint32_t dst, uint32_t src, uint32_t count)
+        {
+            if (dst == src || count == 0) return;
+            Instruction in{};
+            in.op = EOp::Copy;
+            in.dst = dst;
+            in.a = src;
+            in.count = count;
+            Emit(in);
+        }
+
+        void EmitFill(uint32_t dst, uint32_t value, uint32_t count)
+        {
+            Instruction in{};
+            in.op = EOp::Fill;
+            in.dst = dst;
+            in.count = count;
+            in.imm = static_cast<int32_t>(value);
+            Emit(in);
+        }
+
+        uint32_t EmitJump(EOp op, uint32_t mask = NONE)
+        {
+            Instruction in{};
+            in.op = op;
+            in.a = mask;
+            Emit(in);
+            return static_cast<uint32_t>(code.size() - 1);
+        }
+
+        void PatchJump(uint32_t jump)
+        {
+            code[jump].imm = static_cast<int32_t>(code.size());
+        }
+
+        Operand Binary(EOp op, uint8_t sub, const Type& type, const Operand& a, const Operand& b, uint8_t broadcast = 0)
+        {
+            auto dst = Temp(type);
+            Instruction in{};
+            in.op = op;
+            in.sub = sub;
+            in.broadcast = broadcast;
+            in.dst = dst.reg;
+            in.a = a.reg;
+            in.b = b.reg;
+            in.count = type.Size();
+            Emit(in);
+            return dst;
+        }
+
+        // Scopes
+
+        const Variable* FindLocal(const std::string& name) const
+        {
+            for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+            {
+                if (auto found = it->find(name); found != it->end()) return &found->second;
+            }
+            return nullptr;
+        }
+
+        // Compiles the functions and evaluates the constants node refers to, so their code and registers never
+        // interleave with the frame compiled next
+        void Prepare(const std::shared_ptr<Node>& node)
+        {
+            std::unordered_set<std::string> names{};
+            collectReferences(node, names);
+            std::unordered_set<std::string> visitedDefines{};
+            PrepareNames(names, visitedDefines);
+        }
+
+        void PrepareNames(const std::unordered_set<std::string>& names, std::unordered_set<std::string>& visitedDefines)
+        {
+            for (auto& name : names)
+            {
+                if (auto found = functions.find(name); found != functions.end())
+                {
+                    for (auto& function : found->second)
+                    {
+                        try
+                        {
+                            CompileFunction(*function);
+                        }
+                        catch (const std::exception&)
+                        {
+                            // Recorded on the function and reported if the call is actually compiled
+                        }
+                    }
+                }
+                else if (auto global = globals.find(name); global != globals.end())
+                {
+                    try
+                    {
+                        EvaluateGlobal(global->second);
+                    }
+                    catch (const std::exception&)
+                    {
+                        // Reported again when the constant is read
+                    }
+                }
+                else if (auto define = defines.find(name);
+                    define != defines.end() && visitedDefines.insert(name).second)
+                {
+                    std::unordered_set<std::string> defineNames{};
+                    collectReferences(define->second, defineNames);
+                    PrepareNames(defineNames, visitedDefines);
+                }
+            }
+        }
+
+        // Saves everything a failed compile has to roll back
+        struct Checkpoint
+        {
+            size_t codeSize;
+            uint32_t registerCount;
+        };
+
+        void CompileFunction(Function& function)
+        {
+            if (function.isCompiled) return;
+            if (!function.error.empty()) throw std::runtime_error(function.error);
+            if (function.isCompiling)
+            {
+                throw std::runtime_error("Recursive call to '" + function.node->name + "'");
+            }
+
+            function.isCompiling = true;
+            // Callees compiled by Prepare stay compiled when this function fails, so only what follows is rolled back
+            Checkpoint checkpoint{code.size(), registerCount};
+            try
+            {
+                function.parameters.clear();
+                function.isOutput.clear();
+                for (auto& argument : function.node->arguments)
+                {
+                    auto type = TypeOf(argument->declaration);
+                    if (type.arrayLength == NONE)
+                    {
+                        throw std::runtime_error("Unsized array argument '" + argument->declaration->declarationName +
+                            "' has no value in the interpreter");
+                    }
+                    function.parameters.push_back(type);
+                    function.isOutput.push_back(!argument->isInput);
+                }
+                function.returnType = TypeOf(function.node->returnDeclaration);
+
+                Prepare(function.node->scope);
+                checkpoint = {code.size(), registerCount};
+
+                BeginFrame();
+                exec = Allocate(1);
+                returned = Allocate(1);
+                returnType = function.returnType;
+                result = returnType.base == EBase::Void ? NONE : Allocate(returnType.Size());
+                function.exec = exec;
+                function.returned = returned;
+                function.result = result;
+                function.parameterRegs.clear();
+                for (size_t i = 0; i < function.parameters.size(); i++)
+                {
+                    Variable variable{};
+                    variable.reg = Allocate(function.parameters[i].Size());
+                    variable.type = function.parameters[i];
+                    function.parameterRegs.push_back(variable.reg);
+                    scopes.back().insert_or_assign(function.node->arguments[i]->declaration->declarationName,
+                                                   variable);
+                }
+
+                function.entry = static_cast<uint32_t>(code.size());
+                EmitFill(returned, 0, 1);
+                if (result != NONE) EmitFill(result, 0, returnType.Size());
+                for (auto& statement : function.node->scope->statements)
+                {
+                    Statement(statement);
+                }
+                EmitJump(EOp::Return);
+                EndFrame();
+            }
+            catch (const std::exception& e)
+            {
+                code.resize(checkpoint.codeSize);
+                registerCount = checkpoint.registerCount;
+                function.isCompiling = false;
+                function.error = "In '" + function.node->name + "': " + e.what();
+                throw std::runtime_error(function.error);
+            }
+
+            function.isCompiling = false;
+            function.isCompiled = true;
+        }
+
+        void EvaluateGlobal(Global& global)
+        {
+            if (global.isReady) return;
+            if (!global.error.empty()) throw std::runtime_error(global.error);
+            if (global.isEvaluating)
+            {
+                throw std::runtime_error("Constant '" + global.declaration->declarationName + "' refers to itself");
+            }
+
+            global.isEvaluating = true;
+            Checkpoint checkpoint{code.size(), registerCount};
+            try
+            {
+                Prepare(global.value);
+                checkpoint = {code.size(), registerCount};
+
+                BeginFrame();
+                exec = Allocate(1);
+                returned = Allocate(1);
+                result = NONE;
+                returnType = {};
+
+                auto type = TypeOf(global.declaration);
+                auto value = Expression(global.value, &type);
+                if (type.arrayLength == NONE) type.arrayLength = value.type.arrayLength;
+                value = Convert(value, type, false);
+
+                global.variable.reg = Allocate(type.Size());
+                global.variable.type = type;
+                global.variable.isConstant = true;
+                EmitCopy(global.variable.reg, value.reg, type.Size());
+                EmitJump(EOp::Return);
+                EndFrame();
+
+                // The initializer only runs once, so its code is dropped again while its registers stay allocated
+                Run(checkpoint.codeSize, CHUNK, exec);
+                code.resize(checkpoint.codeSize);
+            }
+            catch (const std::exception& e)
+            {
+                code.resize(checkpoint.codeSize);
+                registerCount = checkpoint.registerCount;
+                global.isEvaluating = false;
+                global.error = "In '" + global.declaration->declarationName + "': " + e.what();
+                throw std::runtime_error(global.error);
+            }
+
+            global.isEvaluating = false;
+            global.isReady = true;
+        }
+
+        // Statements
+
+        void Statement(const std::shared_ptr<Node>& node)
+        {
+            const auto mark = frameTop;
+            declaredTop = NONE;
+            switch (node->nodeType)
+            {
+            case NodeType::NoOp:
+                break;
+            case NodeType::Scope:
+                Scope(std::dynamic_pointer_cast<ScopeNode>(node));
+                break;
+            case NodeType::If:
+                If(std::dynamic_pointer_cast<IfNode>(node));
+                break;
+            case NodeType::For:
+                For(std::dynamic_pointer_cast<ForNode>(node));
+                break;
+            case NodeType::Return:
+                Return(std::dynamic_pointer_cast<ReturnNode>(node));
+                break;
+            case NodeType::Discard:
+                throw std::runtime_error("discard has no meaning in the interpreter");
+            default:
+                Expression(node);
+                break;
+            }
+
+            // Temporaries die with the statement, declared variables with their scope
+            frameTop = declaredTop != NONE ? declaredTop : mark;
+            declaredTop = NONE;
+        }
+
+        void Scope(const std::shared_ptr<ScopeNode>& node)
+        {
+            const auto mark = frameTop;
+            scopes.emplace_back();
+            for (auto& statement : node->statements)
+            {
+                Statement(statement);
+            }
+            scopes.pop_back();
+            frameTop = mark;
+        }
+
+        void Branch(const std::shared_ptr<Node>& node)
+        {
+            if (node->nodeType == NodeType::Scope)
+            {
+                Scope(std::dynamic_pointer_cast<ScopeNode>(node));
+                return;
+            }
+
+            const auto mark = frameTop;
+            scopes.emplace_back();
+            Statement(node);
+            scopes.pop_back();
+            frameTop = mark;
+        }
+
+        Operand Condition(const std::shared_ptr<Node>& node)
+        {
+            auto condition = Expression(node);
+            if (!condition.type.IsScalar())
+            {
+                throw std::runtime_error("Expected a scalar condition but got " + condition.type.Name());
+            }
+            return Convert(condition, scalarType(EBase::Bool), true);
+        }
+
+        void EmitMask(EOp op, uint32_t dst, uint32_t a, uint32_t b = NONE)
+        {
+            Instruction in{};
+            in.op = op;
+            in.dst = dst;
+            in.a = a;
+            in.b = b;
+            in.count = 1;
+            Emit(in);
+        }
+
+        // exec = saved, minus the invocations that returned meanwhile
+        void RestoreExec(uint32_t saved)
+        {
+            if (!mayHaveReturned)
+            {
+                EmitCopy(exec, saved, 1);
+                return;
+            }
+
+            const auto notReturned = Allocate(1);
+            EmitMask(EOp::Not, notReturned, returned);
+            EmitMask(EOp::And, exec, saved, notReturned);
+        }
+
+        void If(const std::shared_ptr<IfNode>& node)
+        {
+            const auto condition = Condition(node->condition);
+            const auto saved = Allocate(1);
+            EmitCopy(saved, exec, 1);
+
+            divergence++;
+            EmitMask(EOp::And, exec, saved, condition.reg);
+            auto skip = EmitJump(EOp::JumpIfNone, exec);
+            Scope(node->scope);
+            PatchJump(skip);
+
+            if (node->elseNode)
+            {
+                const auto inverse = Allocate(1);
+                EmitMask(EOp::Not, inverse, condition.reg);
+                EmitMask(EOp::And, exec, saved, inverse);
+                if (mayHaveReturned)
+                {
+                    EmitMask(EOp::Not, inverse, returned);
+                    EmitMask(EOp::And, exec, exec, inverse);
+                }
+                skip = EmitJump(EOp::JumpIfNone, exec);
+                Branch(node->elseNode);
+                PatchJump(skip);
+            }
+            divergence--;
+
+            RestoreExec(saved);
+        }
+
+        void For(const std::shared_ptr<ForNode>& node)
+        {
+            const auto mark = frameTop;
+            scopes.emplace_back();
+
+            Statement(node->init);
+            frameTop = std::max(frameTop, declaredTop != NONE ? declaredTop : frameTop);
+            const auto saved = Allocate(1);
+            EmitCopy(saved, exec, 1);
+
+            divergence++;
+            const auto loop = static_cast<uint32_t>(code.size());
+            const auto iterationMark = frameTop;
+            if (node->condition->nodeType != NodeType::NoOp)
+            {
+                const auto condition = Condition(node->condition);
+                EmitMask(EOp::And, exec, exec, condition.reg);
+            }
+            const auto exit = EmitJump(EOp::JumpIfNone, exec);
+            Scope(node->scope);
+            Statement(node->update);
+            frameTop = iterationMark;
+            Instruction jump{};
+            jump.op = EOp::Jump;
+            jump.imm = static_cast<int32_t>(loop);
+            Emit(jump);
+            PatchJump(exit);
+            divergence--;
+
+            RestoreExec(saved);
+            scopes.pop_back();
+            frameTop = mark;
+        }
+
+        void Return(const std::shared_ptr<ReturnNode>& node)
+        {
+            if (result != NONE)
+            {
+                if (!node->expression || node->expression->nodeType == NodeType::NoOp)
+                {
+                    throw std::runtime_error("Expected a value to return");
+                }
+                auto value = Convert(Expression(node->expression), returnType, false);
+                Instruction store{};
+                store.op = EOp::Store;
+                store.dst = result;
+                store.a = value.reg;
+                store.c = exec;
+                store.count = returnType.Size();
+                Emit(store);
+            }
+            else if (node->expression && node->expression->nodeType != NodeType::NoOp)
+            {
+                Expression(node->expression);
+            }
+
+            // Every invocation still running returns here, so the rest of the function can be skipped
+            if (divergence == 0)
+            {
+                EmitJump(EOp::Return);
+                return;
+            }
+
+            mayHaveReturned = true;
+            EmitMask(EOp::Or, returned, returned, exec);
+            EmitFill(exec, 0, 1);
+        }
+
+        // Places
+
+        Place VariablePlace(const Variable& variable, const std::string& name)
+        {
+            if (variable.isInterface)
+            {
+                throw std::runtime_error("'" + name + "' is a shader interface variable and has no value in the "
+                    "interpreter");
+            }
+
+            Place place{};
+            place.reg = variable.reg;
+            place.type = variable.type;
+            place.rootReg = variable.reg;
+            place.rootSize = variable.type.Size();
+            place.isAssignable = !variable.isConstant;
+            return place;
+        }
+
+        Place OperandPlace(const Operand& operand)
+        {
+            Place place{};
+            place.reg = operand.reg;
+            place.type = operand.type;
+            place.rootReg = operand.reg;
+            place.rootSize = operand.type.Size();
+            return place;
+        }
+
+        Place Locate(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::Identifier:
+                {
+                    const auto& id = std::dynamic_pointer_cast<IdentifierNode>(node)->id;
+                    if (auto local = FindLocal(id)) return VariablePlace(*local, id);
+                    if (auto global = globals.find(id); global != globals.end())
+                    {
+                        EvaluateGlobal(global->second);
+                        return VariablePlace(global->second.variable, id);
+                    }
+                    if (auto define = defines.find(id); define != defines.end())
+                    {
+                        if (!expandingDefines.insert(id).second)
+                        {
+                            throw std::runtime_error("Define " + id + " refers to itself");
+                        }
+                        auto value = Expression(define->second);
+                        expandingDefines.erase(id);
+                        return OperandPlace(value);
+                    }
+                    if (interfaces.contains(id))
+                    {
+                        Variable variable{};
+                        variable.isInterface = true;
+                        return VariablePlace(variable, id);
+                    }
+                    if (id.starts_with("gl_"))
+                    {
+                        throw std::runtime_error("'" + id + "' has no value in the interpreter");
+                    }
+                    throw std::runtime_error("Unknown identifier '" + id + "'");
+                }
+            case NodeType::Precedence:
+                return Locate(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+            case NodeType::Access:
+                return Access(std::dynamic_pointer_cast<AccessNode>(node));
+            case NodeType::Index:
+                return Index(std::dynamic_pointer_cast<IndexNode>(node));
+            default:
+                return OperandPlace(Expression(node));
+            }
+        }
+
+        Place Access(const std::shared_ptr<AccessNode>& node)
+        {
+            auto place = Locate(node->left);
+            auto member = std::dynamic_pointer_cast<IdentifierNode>(node->right);
+            if (!member) throw std::runtime_error("Expected a member name after '.'");
+
+            if (place.type.base == EBase::Struct && !place.type.IsArray())
+            {
+                for (auto& candidate : place.type.structInfo->members)
+                {
+                    if (candidate.name == member->id)
+                    {
+                        place.reg += candidate.offset;
+                        place.type = candidate.type;
+                        return place;
+                    }
+                }
+                throw std::runtime_error(place.type.Name() + " has no member '" + member->id + "'");
+            }
+
+            if (!place.type.IsNumeric() || place.type.IsMatrix() || member->id.empty() || member->id.size() > 4)
+            {
+                throw std::runtime_error("Cannot access ." + member->id + " on " + place.type.Name());
+            }
+
+            std::vector<uint32_t> swizzle{};
+            for (auto c : member->id)
+            {
+                const auto index = swizzleIndex(c);
+                if (index < 0 || static_cast<uint32_t>(index) >= place.type.rows)
+                {
+                    throw std::runtime_error("Invalid swizzle ." + member->id + " on " + place.type.Name());
+                }
+                swizzle.push_back(place.swizzle.empty() ? index : place.swizzle[index]);
+            }
+
+            place.swizzle = swizzle;
+            place.type = scalarType(place.type.base, static_cast<uint32_t>(swizzle.size()));
+            return place;
+        }
+
+        Place Index(const std::shared_ptr<IndexNode>& node)
+        {
+            auto place = Locate(node->left);
+
+            Type element{};
+            uint32_t length = 0;
+            if (place.type.IsArray())
+            {
+                element = place.type.Element();
+                length = place.type.arrayLength;
+            }
+            else if (place.type.IsMatrix())
+            {
+                element = scalarType(EBase::Float, place.type.rows);
+                length = place.type.columns;
+            }
+            else if (place.type.IsVector())
+            {
+                element = scalarType(place.type.base);
+                length = place.type.rows;
+            }
+            else
+            {
+                throw std::runtime_error("Cannot index " + place.type.Name());
+            }
+            const auto stride = element.Size();
+
+            if (node->indexExpression->nodeType == NodeType::IntLiteral)
+            {
+                const auto index = std::dynamic_pointer_cast<IntegerLiteralNode>(node->indexExpression)->data;
+                if (index < 0 || static_cast<uint32_t>(index) >= length)
+                {
+                    throw std::runtime_error("Index " + std::to_string(index) + " is out of range for " +
+                        place.type.Name());
+                }
+
+                if (!place.swizzle.empty())
+                {
+                    place.swizzle = {place.swizzle[index]};
+                }
+                else
+                {
+                    place.reg += static_cast<uint32_t>(index) * stride;
+                }
+                place.type = element;
+                return place;
+            }
+
+            // Swizzled vectors are gathered first so the index applies to contiguous components
+            if (!place.swizzle.empty())
+            {
+                const auto isAssignable = place.isAssignable;
+                place = OperandPlace(Load(place));
+                if (isAssignable) throw std::runtime_error("Cannot assign through an index into a swizzle");
+            }
+
+            auto index = Expression(node->indexExpression);
+            if (!index.type.IsScalar() || index.type.base == EBase::Float)
+            {
+                throw std::runtime_error("Expected an int index but got " + index.type.Name());
+            }
+
+            const auto offset = Allocate(1);
+            Instruction in{};
+            in.op = EOp::IndexOffset;
+            in.dst = offset;
+            in.a = index.reg;
+            in.b = place.dynamic;
+            in.count = length;
+            in.imm = static_cast<int32_t>(stride);
+            Emit(in);
+
+            place.dynamic = offset;
+            place.type = element;
+            return place;
+        }
+
+        Operand Load(const Place& place)
+        {
+            if (place.dynamic == NONE)
+            {
+                if (place.swizzle.empty()) return {place.reg, place.type};
+
+                auto isContiguous = true;
+                for (size_t i = 1; i < place.swizzle.size(); i++)
+                {
+                    isContiguous = isContiguous && place.swizzle[i] == place.swizzle[0] + i;
+                }
+                if (isContiguous) return {place.reg + place.swizzle[0], place.type};
+
+                auto dst = Temp(place.type);
+                for (size_t i = 0; i < place.swizzle.size(); i++)
+                {
+                    EmitCopy(dst.reg + static_cast<uint32_t>(i), place.reg + place.swizzle[i], 1);
+                }
+                return dst;
+            }
+
+            auto dst = Temp(place.type);
+            Instruction in{};
+            in.op = EOp::LoadDynamic;
+            in.a = place.reg;
+            in.b = place.dynamic;
+            if (place.swizzle.empty())
+            {
+                in.dst = dst.reg;
+                in.count = place.type.Size();
+                Emit(in);
+                return dst;
+            }
+
+            in.count = 1;
+            for (size_t i = 0; i < place.swizzle.size(); i++)
+            {
+                in.dst = dst.reg + static_cast<uint32_t>(i);
+                in.imm = static_cast<int32_t>(place.swizzle[i]);
+                Emit(in);
+            }
+            return dst;
+        }
+
+        // Writes value to place for the running invocations
+        void Store(const Place& place, Operand value)
+        {
+            if (!place.isAssignable) throw std::runtime_error("Cannot assign to a constant or temporary value");
+            value = Convert(value, place.type, false);
+
+            // Values that alias the written variable are copied first so a write cannot feed a later one
+            const auto isSelf = value.reg == place.reg && place.swizzle.empty() && place.dynamic == NONE;
+            if (!isSelf && value.reg < place.rootReg + place.rootSize &&
+                place.rootReg < value.reg + value.type.Size())
+            {
+                auto copy = Temp(value.type);
+                EmitCopy(copy.reg, value.reg, value.type.Size());
+                value = copy;
+            }
+
+            Instruction in{};
+            in.op = place.dynamic == NONE ? EOp::Store : EOp::StoreDynamic;
+            in.dst = place.reg;
+            in.a = value.reg;
+            in.b = place.dynamic;
+            in.c = exec;
+            if (place.swizzle.empty())
+            {
+                in.count = place.type.Size();
+                Emit(in);
+                return;
+            }
+
+            in.count = 1;
+            for (size_t i = 0; i < place.swizzle.size(); i++)
+            {
+                in.a = value.reg + static_cast<uint32_t>(i);
+                if (place.dynamic == NONE)
+                {
+                    in.dst = place.reg + place.swizzle[i];
+                }
+                else
+                {
+                    in.imm = static_cast<int32_t>(place.swizzle[i]);
+                }
+                Emit(in);
+            }
+        }
+
+        // Conversions
+
+        Operand Convert(const Operand& value, const Type& to, bool isExplicit)
+        {
+            if (value.type == to) return value;
+
+            if (value.type.IsNumeric() && to.IsNumeric() && value.type.rows == to.rows &&
+                value.type.columns == to.columns)
+            {
+                if (!isExplicit && !(value.type.base == EBase::Int && to.base == EBase::Float))
+                {
+                    throw std::runtime_error("Cannot implicitly convert " + value.type.Name() + " to " + to.Name());
+                }
+                return ConvertBase(value, to.base);
+            }
+
+            throw std::runtime_error("Cannot convert " + value.type.Name() + " to " + to.Name());
+        }
+
+        Operand ConvertBase(const Operand& value, EBase to)
+        {
+            const auto from = value.type.base;
+            if (from == to) return value;
+            // Bools are stored as the ints 0 and 1
+            if (from == EBase::Bool && to == EBase::Int) return {value.reg, value.type.WithBase(to)};
+
+            EConvert conversion{};
+            if (to == EBase::Float)
+            {
+                conversion = EConvert::IntToFloat;
+            }
+            else if (to == EBase::Int)
+            {
+                conversion = EConvert::FloatToInt;
+            }
+            else
+            {
+                conversion = from == EBase::Float ? EConvert::FloatToBool : EConvert::IntToBool;
+            }
+
+            auto dst = Temp(value.type.WithBase(to));
+            Instruction in{};
+            in.op = EOp::Convert;
+            in.sub = static_cast<uint8_t>(conversion);
+            in.dst = dst.reg;
+            in.a = value.reg;
+            in.count = dst.type.Size();
+            Emit(in);
+            return dst;
+        }
+
+        // Expressions
+
+        Operand Expression(const std::shared_ptr<Node>& node, const Type* expected = nullptr)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::NoOp:
+                return {};
+            case NodeType::FloatLiteral:
+                return FloatConstant(std::dynamic_pointer_cast<FloatLiteralNode>(node)->data);
+            case NodeType::IntLiteral:
+                return {
+                    Constant(static_cast<uint32_t>(std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data)),
+                    scalarType(EBase::Int)
+                };
+            case NodeType::BooleanLiteral:
+                return {
+                    Constant(std::dynamic_pointer_cast<BooleanLiteralNode>(node)->data ? 1 : 0),
+                    scalarType(EBase::Bool)
+                };
+            case NodeType::Identifier:
+            case NodeType::Access:
+            case NodeType::Index:
+                return Load(Locate(node));
+            case NodeType::Precedence:
+                return Expression(std::dynamic_pointer_cast<PrecedenceNode>(node)->target, expected);
+            case NodeType::BinaryOp:
+                return BinaryOp(std::dynamic_pointer_cast<BinaryOpNode>(node));
+            case NodeType::Negate:
+                return Negate(Expression(std::dynamic_pointer_cast<NegateNode>(node)->target));
+            case NodeType::Assign:
+                return Assign(std::dynamic_pointer_cast<AssignNode>(node));
+            case NodeType::Declaration:
+                return Declare(std::dynamic_pointer_cast<DeclarationNode>(node), false, nullptr);
+            case NodeType::Const:
+                throw std::runtime_error("Constants must be initialized");
+            case NodeType::Call:
+                return Call(std::dynamic_pointer_cast<CallNode>(node));
+            case NodeType::ArrayLiteral:
+                return ArrayLiteral(std::dynamic_pointer_cast<ArrayLiteralNode>(node), expected);
+            case NodeType::Conditional:
+                return Conditional(std::dynamic_pointer_cast<ConditionalNode>(node));
+            case NodeType::Increment:
+                {
+                    auto casted = std::dynamic_pointer_cast<IncrementNode>(node);
+                    return Step(casted->target, casted->isPrefix, true);
+                }
+            case NodeType::Decrement:
+                {
+                    auto casted = std::dynamic_pointer_cast<DecrementNode>(node);
+                    return Step(casted->target, casted->isPrefix, false);
+                }
+            case NodeType::Discard:
+                throw std::runtime_error("discard has no meaning in the interpreter");
+            default:
+                throw std::runtime_error("Unexpected node in an expression");
+            }
+        }
+
+        Operand Assign(const std::shared_ptr<AssignNode>& node)
+        {
+            if (node->target->nodeType == NodeType::Declaration)
+            {
+                return Declare(std::dynamic_pointer_cast<DeclarationNode>(node->target), false, node->value);
+            }
+            if (node->target->nodeType == NodeType::Const)
+            {
+                return Declare(std::dynamic_pointer_cast<ConstNode>(node->target)->declaration, true, node->value);
+            }
+
+            auto place = Locate(node->target);
+            auto value = Expression(node->value, &place.type);
+            Store(place, value);
+            return Convert(value, place.type, false);
+        }
+
+        // Declares a local, registered once its initializer is compiled so the initializer still sees any
+        // variable it shadows
+        Operand Declare(const std::shared_ptr<DeclarationNode>& node, bool isConstant, const std::shared_ptr<Node>& value)
+        {
+            auto type = TypeOf(node);
+            Variable variable{};
+            variable.isConstant = isConstant;
+
+            if (value)
+            {
+                Operand initial{};
+                if (type.arrayLength == NONE)
+                {
+                    // The length comes from the initializer, so the variable is placed after it
+                    initial = Expression(value, &type);
+                    type.arrayLength = initial.type.arrayLength;
+                    variable.reg = Allocate(type.Size());
+                }
+                else
+                {
+                    variable.reg = Allocate(type.Size());
+                    initial = Expression(value, &type);
+                }
+                initial = Convert(initial, type, false);
+                EmitCopy(variable.reg, initial.reg, type.Size());
+            }
+            else
+            {
+                if (type.arrayLength == NONE)
+                {
+                    throw std::runtime_error("Unsized array '" + node->declarationName + "' needs an initializer");
+                }
+                variable.reg = Allocate(type.Size());
+                EmitFill(variable.reg, 0, type.Size());
+            }
+
+            variable.type = type;
+            declaredTop = std::max(declaredTop == NONE ? 0 : declaredTop, variable.reg + type.Size());
+            scopes.back().insert_or_assign(node->declarationName, variable);
+            return {variable.reg, type};
+        }
+
+        Operand ArrayLiteral(const std::shared_ptr<ArrayLiteralNode>& node, const Type* expected)
+        {
+            if (node->nodes.empty()) throw std::runtime_error("Empty array literal");
+
+            std::vector<Operand> elements{};
+            for (auto& element : node->nodes)
+            {
+                elements.push_back(Expression(element));
+            }
+
+            auto type = expected && expected->IsArray() ? expected->Element() : elements.front().type;
+            type.arrayLength = static_cast<uint32_t>(elements.size());
+            if (expected && expected->IsArray() && expected->arrayLength != NONE &&
+                expected->arrayLength != type.arrayLength)
+            {
+                throw std::runtime_error("Expected " + std::to_string(expected->arrayLength) + " elements but got " +
+                    std::to_string(type.arrayLength));
+            }
+
+            auto dst = Temp(type);
+            const auto stride = type.ElementSize();
+            for (size_t i = 0; i < elements.size(); i++)
+            {
+                auto element = Convert(elements[i], type.Element(), false);
+                EmitCopy(dst.reg + static_cast<uint32_t>(i) * stride, element.reg, stride);
+            }
+            return dst;
+        }
+
+        Operand Conditional(const std::shared_ptr<ConditionalNode>& node)
+        {
+            // Both sides are evaluated for every invocation, which is safe as expressions other than assignments have
+            // no side effects
+            const auto condition = Condition(node->condition);
+            auto left = Expression(node->left);
+            auto right = Expression(node->right);
+            if (left.type != right.type)
+            {
+                if (left.type.base == EBase::Int) left = Convert(left, right.type, false);
+                else right = Convert(right, left.type, false);
+            }
+
+            auto dst = Temp(left.type);
+            Instruction in{};
+            in.op = EOp::Select;
+            in.dst = dst.reg;
+            in.a = left.reg;
+            in.b = right.reg;
+            in.c = condition.reg;
+            in.count = left.type.Size();
+            Emit(in);
+            return dst;
+        }
+
+        Operand Step(const std::shared_ptr<Node>& target, bool isPrefix, bool isIncrement)
+        {
+            auto place = Locate(target);
+            if (!place.type.IsNumeric() || place.type.base == EBase::Bool)
+            {
+                throw std::runtime_error("Cannot increment or decrement " + place.type.Name());
+            }
+
+            auto current = Load(place);
+            Operand old{};
+            if (!isPrefix)
+            {
+                old = Temp(current.type);
+                EmitCopy(old.reg, current.reg, current.type.Size());
+            }
+
+            const auto isFloat = place.type.base == EBase::Float;
+            Operand one{};
+            if (isFloat)
+            {
+                one = FloatConstant(1.0f);
+            }
+            else
+            {
+                one = {Constant(1), scalarType(EBase::Int)};
+            }
+
+            const auto op = isFloat
+                                ? static_cast<uint8_t>(isIncrement ? EFloatOp::Add : EFloatOp::Subtract)
+                                : static_cast<uint8_t>(isIncrement ? EIntOp::Add : EIntOp::Subtract);
+            auto updated = Binary(isFloat ? EOp::Float : EOp::Int, op, place.type, current, one,
+                                  place.type.IsScalar() ? 0 : 2);
+            Store(place, updated);
+            return isPrefix ? updated : old;
+        }
+
+        Operand Negate(const Operand& value)
+        {
+            if (!value.type.IsNumeric() || value.type.base == EBase::Bool)
+            {
+                throw std::runtime_error("Cannot negate " + value.type.Name());
+            }
+
+            auto dst = Temp(value.type);
+            Instruction in{};
+            in.op = value.type.base == EBase::Float ? EOp::Float : EOp::Int;
+            in.sub = value.type.base == EBase::Float
+                         ? static_cast<uint8_t>(EFloatOp::Negate)
+                         : static_cast<uint8_t>(EIntOp::Negate);
+            in.dst = dst.reg;
+            in.a = value.reg;
+            in.count = value.type.Size();
+            Emit(in);
+            return dst;
+        }
+
+        Operand BinaryOp(const std::shared_ptr<BinaryOpNode>& node)
+        {
+            auto left = Expression(node->left);
+            auto right = Expression(node->right);
+
+            switch (node->op)
+            {
+            case EBinaryOp::And:
+            case EBinaryOp::Or:
+                {
+                    left = Convert(left, scalarType(EBase::Bool), false);
+                    right = Convert(right, scalarType(EBase::Bool), false);
+                    auto dst = Allocate(1);
+                    EmitMask(node->op == EBinaryOp::And ? EOp::And : EOp::Or, dst, left.reg, right.reg);
+                    return {dst, scalarType(EBase::Bool)};
+                }
+            case EBinaryOp::Not:
+                throw std::runtime_error("! not supported");
+            default:
+                break;
+            }
+
+            if (!left.type.IsNumeric() || !right.type.IsNumeric())
+            {
+                // Only equality is defined on arrays and structs
+                if ((node->op == EBinaryOp::Equal || node->op == EBinaryOp::NotEqual) && left.type == right.type)
+                {
+                    return Equal(left, right, node->op == EBinaryOp::NotEqual, true);
+                }
+                throw std::runtime_error("Cannot apply an operator to " + left.type.Name() + " and " +
+                    right.type.Name());
+            }
+
+            // Ints mixed with floats become floats
+            if (left.type.base != right.type.base)
+            {
+                if (left.type.base == EBase::Int && right.type.base == EBase::Float)
+                {
+                    left = ConvertBase(left, EBase::Float);
+                }
+                else if (left.type.base == EBase::Float && right.type.base == EBase::Int)
+                {
+                    right = ConvertBase(right, EBase::Float);
+                }
+                else
+                {
+                    throw std::runtime_error("Cannot mix " + left.type.Name() + " and " + right.type.Name());
+                }
+            }
+
+            ECompare compare{};
+            switch (node->op)
+            {
+            case EBinaryOp::Equal:
+            case EBinaryOp::NotEqual:
+                if (left.type != right.type)
+                {
+                    throw std::runtime_error("Cannot compare " + left.type.Name() + " and " + right.type.Name());
+                }
+                if (!left.type.IsScalar())
+                {
+                    return Equal(left, right, node->op == EBinaryOp::NotEqual, left.type.base != EBase::Float);
+                }
+                compare = node->op == EBinaryOp::Equal ? ECompare::Equal : ECompare::NotEqual;
+                return Compare(compare, left, right);
+            case EBinaryOp::Less:
+                return Compare(ECompare::Less, left, right);
+            case EBinaryOp::LessEqual:
+                return Compare(ECompare::LessEqual, left, right);
+            case EBinaryOp::Greater:
+                return Compare(ECompare::Greater, left, right);
+            case EBinaryOp::GreaterEqual:
+                return Compare(ECompare::GreaterEqual, left, right);
+            default:
+                break;
+            }
+
+            if (left.type.base == EBase::Bool) throw std::runtime_error("Cannot do arithmetic on bool");
+
+            // Linear algebra products
+            if (node->op == EBinaryOp::Multiply && (left.type.IsMatrix() || right.type.IsMatrix()) &&
+                !left.type.IsScalar() && !right.type.IsScalar())
+            {
+                return MatrixMultiply(left, right);
+            }
+
+            Type type{};
+            uint8_t broadcast = 0;
+            if (left.type == right.type)
+            {
+                type = left.type;
+            }
+            else if (left.type.IsScalar())
+            {
+                type = right.type;
+                broadcast = 1;
+            }
+            else if (right.type.IsScalar())
+            {
+                type = left.type;
+                broadcast = 2;
+            }
+            else
+            {
+                throw std::runtime_error("Cannot apply an operator to " + left.type.Name() + " and " +
+                    right.type.Name());
+            }
+
+            const auto isFloat = type.base == EBase::Float;
+            uint8_t sub = 0;
+            switch (node->op)
+            {
+            case EBinaryOp::Add:
+                sub = isFloat ? static_cast<uint8_t>(EFloatOp::Add) : static_cast<uint8_t>(EIntOp::Add);
+                break;
+            case EBinaryOp::Subtract:
+                sub = isFloat ? static_cast<uint8_t>(EFloatOp::Subtract) : static_cast<uint8_t>(EIntOp::Subtract);
+                break;
+            case EBinaryOp::Multiply:
+                sub = isFloat ? static_cast<uint8_t>(EFloatOp::Multiply) : static_cast<uint8_t>(EIntOp::Multiply);
+                break;
+            case EBinaryOp::Divide:
+                sub = isFloat ? static_cast<uint8_t>(EFloatOp::Divide) : static_cast<uint8_t>(EIntOp::Divide);
+                break;
+            case EBinaryOp::Mod:
+                sub = isFloat ? static_cast<uint8_t>(EFloatOp::Mod) : static_cast<uint8_t>(EIntOp::Mod);
+                break;
+            default:
+                throw std::runtime_error("Unexpected operator");
+            }
+
+            return Binary(isFloat ? EOp::Float : EOp::Int, sub, type, left, right, broadcast);
+        }
+
+        Operand Compare(ECompare compare, const Operand& left, const Operand& right)
+        {
+            if (!left.type.IsScalar() || !right.type.IsScalar())
+            {
+                throw std::runtime_error("Cannot compare " + left.type.Name() + " and " + right.type.Name());
+            }
+            return Binary(left.type.base == EBase::Float ? EOp::CompareFloat : EOp::CompareInt,
+                          static_cast<uint8_t>(compare), scalarType(EBase::Bool), left, right);
+        }
+
+        Operand Equal(const Operand& left, const Operand& right, bool isNotEqual, bool compareBits)
+        {
+            auto dst = Temp(scalarType(EBase::Bool));
+            Instruction in{};
+            in.op = EOp::Equal;
+            in.sub = compareBits ? 1 : 0;
+            in.dst = dst.reg;
+            in.a = left.reg;
+            in.b = right.reg;
+            in.count = left.type.Size();
+            in.imm = isNotEqual ? 1 : 0;
+            Emit(in);
+            return dst;
+        }
+
+        Operand MatrixMultiply(const Operand& left, const Operand& right)
+        {
+            // Vectors on the left are rows, on the right columns
+            const auto leftRows = left.type.IsMatrix() ? left.type.rows : 1;
+            const auto inner = left.type.IsMatrix() ? left.type.columns : left.type.rows;
+            const auto rightColumns = right.type.IsMatrix() ? right.type.columns : 1;
+            if (inner != right.type.rows)
+            {
+                throw std::runtime_error("Cannot multiply " + left.type.Name() + " and " + right.type.Name());
+            }
+
+            Type type{};
+            if (left.type.IsMatrix() && right.type.IsMatrix())
+            {
+                type = scalarType(EBase::Float, leftRows, rightColumns);
+            }
+            else
+            {
+                type = scalarType(EBase::Float, left.type.IsMatrix() ? leftRows : rightColumns);
+            }
+
+            auto dst = Temp(type);
+            Instruction in{};
+            in.op = EOp::MatrixMultiply;
+            in.dst = dst.reg;
+            in.a = left.reg;
+            in.b = right.reg;
+            in.c = rightColumns;
+            in.count = leftRows;
+            in.imm = static_cast<int32_t>(inner);
+            Emit(in);
+            return dst;
+        }
+
+        // Calls
+
+        Operand Call(const std::shared_ptr<CallNode>& node)
+        {
+            const auto& name = node->identifier->id;
+
+            std::vector<Operand> args{};
+            const auto isUserFunction = functions.contains(name);
+            if (!isUserFunction)
+            {
+                for (auto& arg : node->args)
+                {
+                    args.push_back(Expression(arg));
+                }
+            }
+
+            if (auto constructed = Construct(name, args))
+            {
+                return *constructed;
+            }
+
+            if (isUserFunction)
+            {
+                return CallFunction(name, node->args);
+            }
+
+            if (GPU_BUILTINS.contains(name))
+            {
+                throw std::runtime_error("'" + name + "' has no meaning in the interpreter");
+            }
+
+            return CallBuiltin(name, args);
+        }
+
+        std::optional<Operand> Construct(const std::string& name, const std::vector<Operand>& args)
+        {
+            if (auto found = structs.find(name); found != structs.end())
+            {
+                const auto& info = found->second;
+                if (args.size() != info.members.size())
+                {
+                    throw std::runtime_error(name + " has " + std::to_string(info.members.size()) +
+                        " members but got " + std::to_string(args.size()) + " arguments");
+                }
+
+                Type type{};
+                type.base = EBase::Struct;
+                type.structInfo = &info;
+                auto dst = Temp(type);
+                for (size_t i = 0; i < args.size(); i++)
+                {
+                    auto value = Convert(args[i], info.members[i].type, false);
+                    EmitCopy(dst.reg + info.members[i].offset, value.reg, value.type.Size());
+                }
+                return dst;
+            }
+
+            Type type{};
+            switch (DeclarationNode::TokenTypeToDeclarationType(Token(name, {}).type))
+            {
+            case EDeclarationType::Float:
+            case EDeclarationType::Int:
+            case EDeclarationType::Boolean:
+            case EDeclarationType::Float2:
+            case EDeclarationType::Int2:
+            case EDeclarationType::Float3:
+            case EDeclarationType::Int3:
+            case EDeclarationType::Float4:
+            case EDeclarationType::Int4:
+            case EDeclarationType::Mat3:
+            case EDeclarationType::Mat4:
+                type = TypeOf(std::make_shared<DeclarationNode>(Token(name, {}), "", 1));
+                break;
+            default:
+                return std::nullopt;
+            }
+
+            if (args.empty()) throw std::runtime_error(name + " needs arguments");
+            for (auto& arg : args)
+            {
+                if (!arg.type.IsNumeric())
+                {
+                    throw std::runtime_error("Cannot construct " + name + " from " + arg.type.Name());
+                }
+            }
+
+            auto dst = Temp(type);
+            const auto size = type.Size();
+
+            if (args.size() == 1 && args[0].type.IsScalar())
+            {
+                auto value = ConvertBase(args[0], type.base);
+                if (type.IsMatrix())
+                {
+                    EmitFill(dst.reg, 0, size);
+                    for (uint32_t i = 0; i < type.columns; i++)
+                    {
+                        EmitCopy(dst.reg + i * type.rows + i, value.reg, 1);
+                    }
+                }
+                else
+                {
+                    for (uint32_t i = 0; i < size; i++)
+                    {
+                        EmitCopy(dst.reg + i, value.reg, 1);
+                    }
+                }
+                return dst;
+            }
+
+            // Matrices resized from other matrices keep the overlap and fill the rest from the identity
+            if (args.size() == 1 && type.IsMatrix() && args[0].type.IsMatrix())
+            {
+                const auto& from = args[0].type;
+                for (uint32_t column = 0; column < type.columns; column++)
+                {
+                    for (uint32_t row = 0; row < type.rows; row++)
+                    {
+                        const auto reg = dst.reg + column * type.rows + row;
+                        if (column < from.columns && row < from.rows)
+                        {
+                            EmitCopy(reg, args[0].reg + column * from.rows + row, 1);
+                        }
+                        else
+                        {
+                            EmitFill(reg, row == column ? Value::Float({1.0f}).words[0] : 0, 1);
+                        }
+                    }
+                }
+                return dst;
+            }
+
+            // Everything else is taken component by component, dropping the components of the last argument that
+            // do not fit
+            uint32_t written = 0;
+            for (auto& arg : args)
+            {
+                if (written >= size) throw std::runtime_error("Too many arguments for " + name);
+                auto value = ConvertBase(arg, type.base);
+                const auto count = std::min(value.type.Size(), size - written);
+                EmitCopy(dst.reg + written, value.reg, count);
+                written += count;
+            }
+            if (written < size) throw std::runtime_error("Not enough arguments for " + name);
+            return dst;
+        }
+
+        // Ranks how well args match a function, or -1 when they do not
+        int MatchScore(const Function& function, const std::vector<Operand>& args)
+        {
+            if (function.parameters.size() != args.size()) return -1;
+
+            auto score = 0;
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                const auto& parameter = function.parameters[i];
+                if (args[i].type == parameter) continue;
+                if (!function.isOutput[i] && args[i].type.IsNumeric() && parameter.IsNumeric() &&
+                    args[i].type.base == EBase::Int && parameter.base == EBase::Float &&
+                    args[i].type.rows == parameter.rows && args[i].type.columns == parameter.columns)
+                {
+                    score++;
+                    continue;
+                }
+                return -1;
+            }
+            return score;
+        }
+
+        Operand CallFunction(const std::string& name, const std::vector<std::shared_ptr<Node>>& argNodes)
+        {
+            auto& candidates = functions[name];
+
+            // Out arguments are places, the rest values
+            std::vector<Place> places(argNodes.size());
+            std::vector<Operand> args(argNodes.size());
+            for (size_t i = 0; i < argNodes.size(); i++)
+            {
+                auto isOutput = false;
+                for (auto& candidate : candidates)
+                {
+                    if (candidate->node->arguments.size() == argNodes.size() &&
+                        !candidate->node->arguments[i]->isInput)
+                    {
+                        isOutput = true;
+                    }
+                }
+
+                if (isOutput)
+                {
+                    places[i] = Locate(argNodes[i]);
+                    args[i] = Load(places[i]);
+                }
+                else
+                {
+                    args[i] = Expression(argNodes[i]);
+                }
+            }
+
+            Function* best = nullptr;
+            auto bestScore = -1;
+            for (auto& candidate : candidates)
+            {
+                if (candidate->node->arguments.size() != argNodes.size()) continue;
+                CompileFunction(*candidate);
+                if (const auto score = MatchScore(*candidate, args); score >= 0 && (!best || score < bestScore))
+                {
+                    best = candidate.get();
+                    bestScore = score;
+                }
+            }
+            if (!best) throw std::runtime_error("No overload of '" + name + "' matches the arguments");
+
+            // Out parameters start from the caller's value, so invocations that skip the write keep it
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                auto value = Convert(args[i], best->parameters[i], false);
+                EmitCopy(best->parameterRegs[i], value.reg, value.type.Size());
+            }
+            EmitCopy(best->exec, exec, 1);
+
+            Instruction call{};
+            call.op = EOp::Call;
+            call.imm = static_cast<int32_t>(best->entry);
+            Emit(call);
+
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                if (!best->isOutput[i]) continue;
+                Store(places[i], {best->parameterRegs[i], best->parameters[i]});
+            }
+
+            if (best->result == NONE) return {};
+            auto dst = Temp(best->returnType);
+            EmitCopy(dst.reg, best->result, best->returnType.Size());
+            return dst;
+        }
+
+        Operand CallBuiltin(const std::string& name, std::vector<Operand> args)
+        {
+            const auto expectArgs = [&](size_t count)
+            {
+                if (args.size() != count)
+                {
+                    throw std::runtime_error(name + " takes " + std::to_string(count) + " arguments");
+                }
+                for (auto& arg : args)
+                {
+                    if (!arg.type.IsNumeric() || arg.type.base == EBase::Bool)
+                    {
+                        throw std::runtime_error(name + " does not take " + arg.type.Name());
+                    }
+                    arg = ConvertBase(arg, EBase::Float);
+                }
+            };
+
+            const auto emit = [&](EOp op, const Type& type)
+            {
+                auto dst = Temp(type);
+                Instruction in{};
+                in.op = op;
+                in.dst = dst.reg;
+                in.a = args.size() > 0 ? args[0].reg : NONE;
+                in.b = args.size() > 1 ? args[1].reg : NONE;
+                in.c = args.size() > 2 ? args[2].reg : NONE;
+                in.count = args[0].type.Size();
+                Emit(in);
+                return dst;
+            };
+
+            if (name == "atan" && args.size() == 2)
+            {
+                return ComponentWise(name, {EFloatOp::Atan2, 2}, args);
+            }
+            if (name == "atan")
+            {
+                return ComponentWise(name, {EFloatOp::Atan, 1}, args);
+            }
+            if (auto found = BUILTINS.find(name); found != BUILTINS.end())
+            {
+                return ComponentWise(name, found->second, args);
+            }
+
+            const auto scalar = scalarType(EBase::Float);
+            if (name == "dot")
+            {
+                expectArgs(2);
+                return emit(EOp::Dot, scalar);
+            }
+            if (name == "length")
+            {
+                expectArgs(1);
+                return emit(EOp::Length, scalar);
+            }
+            if (name == "distance")
+            {
+                expectArgs(2);
+                return emit(EOp::Distance, scalar);
+            }
+            if (name == "normalize")
+            {
+                expectArgs(1);
+                return emit(EOp::Normalize, args[0].type);
+            }
+            if (name == "cross")
+            {
+                expectArgs(2);
+                if (args[0].type.rows != 3) throw std::runtime_error("cross takes float3 arguments");
+                return emit(EOp::Cross, args[0].type);
+            }
+            if (name == "reflect")
+            {
+                expectArgs(2);
+                return emit(EOp::Reflect, args[0].type);
+            }
+            if (name == "refract")
+            {
+                expectArgs(3);
+                return emit(EOp::Refract, args[0].type);
+            }
+            if (name == "faceforward")
+            {
+                expectArgs(3);
+                return emit(EOp::FaceForward, args[0].type);
+            }
+            if (name == "transpose" || name == "determinant" || name == "inverse")
+            {
+                expectArgs(1);
+                if (!args[0].type.IsMatrix()) throw std::runtime_error(name + " takes a matrix");
+                auto dst = emit(name == "transpose"
+                                    ? EOp::Transpose
+                                    : name == "determinant"
+                                    ? EOp::Determinant
+                                    : EOp::Inverse, name == "determinant" ? scalar : args[0].type);
+                code.back().count = args[0].type.rows;
+                return dst;
+            }
+
+            throw std::runtime_error("Unknown function '" + name + "'");
+        }
+
+        // Builtins applied per component, where scalar arguments are used for every component
+        Operand ComponentWise(const std::string& name, const Builtin& builtin, std::vector<Operand> args)
+        {
+            if (args.size() != static_cast<size_t>(builtin.arity))
+            {
+                throw std::runtime_error(name + " takes " + std::to_string(builtin.arity) + " arguments");
+            }
+
+            Type type = args[0].type;
+            auto allInt = true;
+            for (auto& arg : args)
+            {
+                if (!arg.type.IsNumeric() || arg.type.base == EBase::Bool)
+                {
+                    throw std::runtime_error(name + " does not take " + arg.type.Name());
+                }
+                if (!arg.type.IsScalar()) type = arg.type;
+                allInt = allInt && arg.type.base == EBase::Int;
+            }
+
+            const auto useInt = allInt && builtin.hasInt;
+            type = type.WithBase(useInt ? EBase::Int : EBase::Float);
+
+            uint8_t broadcast = 0;
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                if (!useInt) args[i] = ConvertBase(args[i], EBase::Float);
+                if (args[i].type.IsScalar() && !type.IsScalar())
+                {
+                    broadcast |= static_cast<uint8_t>(1 << i);
+                }
+                else if (args[i].type.rows != type.rows || args[i].type.columns != type.columns)
+                {
+                    throw std::runtime_error(name + " cannot mix " + args[i].type.Name() + " and " + type.Name());
+                }
+            }
+
+            auto dst = Temp(type);
+            Instruction in{};
+            in.op = useInt ? EOp::Int : EOp::Float;
+            in.sub = useInt ? static_cast<uint8_t>(builtin.intOp) : static_cast<uint8_t>(builtin.floatOp);
+            in.broadcast = broadcast;
+            in.dst = dst.reg;
+            in.a = args[0].reg;
+            in.b = args.size() > 1 ? args[1].reg : NONE;
+            in.c = args.size() > 2 ? args[2].reg : NONE;
+            in.count = type.Size();
+            Emit(in);
+            return dst;
+        }
+
+        // Execution
+
+        bool Any(uint32_t mask)
+        {
+            const auto m = Ptr(mask);
+            for (uint32_t l = 0; l < width; l++)
+            {
+                if (m[l].i) return true;
+            }
+            return false;
+        }
+
+        // Runs from pc until the matching return, with the first width invocations of every register live and
+        // execMask holding which of them run
+        void Run(uint32_t pc, uint32_t inWidth, uint32_t execMask)
+        {
+            EnsureRegisters();
+            width = inWidth;
+            auto mask = Ptr(execMask);
+            for (uint32_t l = 0; l < CHUNK; l++) mask[l].i = l < width ? 1 : 0;
+
+            callStack.clear();
+            while (true)
+            {
+                const auto& in = code[pc];
+                switch (in.op)
+                {
+                case EOp::Jump:
+                    pc = static_cast<uint32_t>(in.imm);
+                    continue;
+                case EOp::JumpIfNone:
+                    if (!Any(in.a))
+                    {
+                        pc = static_cast<uint32_t>(in.imm);
+                        continue;
+                    }
+                    break;
+                case EOp::Call:
+                    callStack.push_back(pc + 1);
+                    pc = static_cast<uint32_t>(in.imm);
+                    continue;
+                case EOp::Return:
+                    if (callStack.empty()) return;
+                    pc = callStack.back();
+                    callStack.pop_back();
+                    continue;
+                default:
+                    Execute(in);
+                    break;
+                }
+                pc++;
+            }
+        }
+
+        void Execute(const Instruction& in)
+        {
+            const auto w = width;
+            auto d = in.dst != NONE ? Ptr(in.dst) : nullptr;
+            auto a = in.a != NONE ? Ptr(in.a) : nullptr;
+            auto b = in.b != NONE ? Ptr(in.b) : nullptr;
+            auto c = in.c != NONE && in.op != EOp::MatrixMultiply ? Ptr(in.c) : nullptr;
+
+            switch (in.op)
+            {
+            case EOp::Copy:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    std::memcpy(d + k * CHUNK, a + k * CHUNK, w * sizeof(Word));
+                }
+                break;
+            case EOp::Store:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pd = d + k * CHUNK;
+                    auto pa = a + k * CHUNK;
+                    for (uint32_t l = 0; l < w; l++) pd[l].u = c[l].i ? pa[l].u : pd[l].u;
+                }
+                break;
+            case EOp::Fill:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pd = d + k * CHUNK;
+                    for (uint32_t l = 0; l < w; l++) pd[l].i = in.imm;
+                }
+                break;
+            case EOp::LoadDynamic:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pd = d + k * CHUNK;
+                    for (uint32_t l = 0; l < w; l++)
+                    {
+                        pd[l] = a[(static_cast<size_t>(b[l].i) + in.imm + k) * CHUNK + l];
+                    }
+                }
+                break;
+            case EOp::StoreDynamic:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pa = a + k * CHUNK;
+                    for (uint32_t l = 0; l < w; l++)
+                    {
+                        if (c[l].i) d[(static_cast<size_t>(b[l].i) + in.imm + k) * CHUNK + l] = pa[l];
+                    }
+                }
+                break;
+            case EOp::IndexOffset:
+                {
+                    const auto last = static_cast<int32_t>(in.count) - 1;
+                    for (uint32_t l = 0; l < w; l++)
+                    {
+                        d[l].i = std::clamp(a[l].i, 0, last) * in.imm + (b ? b[l].i : 0);
+                    }
+                }
+                break;
+            case EOp::Float:
+                ExecuteFloat(in, d, a, b, c);
+                break;
+            case EOp::Int:
+                ExecuteInt(in, d, a, b, c);
+                break;
+            case EOp::CompareFloat:
+                for (uint32_t l = 0; l < w; l++)
+                {
+                    const auto x = a[l].f;
+                    const auto y = b[l].f;
+                    bool r = false;
+                    switch (static_cast<ECompare>(in.sub))
+                    {
+                    case ECompare::Less: r = x < y;
+                        break;
+                    case ECompare::LessEqual: r = x <= y;
+                        break;
+                    case ECompare::Greater: r = x > y;
+                        break;
+                    case ECompare::GreaterEqual: r = x >= y;
+                        break;
+                    case ECompare::Equal: r = x == y;
+                        break;
+                    case ECompare::NotEqual: r = x != y;
+                        break;
+                    }
+                    d[l].i = r ? 1 : 0;
+                }
+                break;
+            case EOp::CompareInt:
+                for (uint32_t l = 0; l < w; l++)
+                {
+                    const auto x = a[l].i;
+                    const auto y = b[l].i;
+                    bool r = false;
+                    switch (static_cast<ECompare>(in.sub))
+                    {
+                    case ECompare::Less: r = x < y;
+                        break;
+                    case ECompare::LessEqual: r = x <= y;
+                        break;
+                    case ECompare::Greater: r = x > y;
+                        break;
+                    case ECompare::GreaterEqual: r = x >= y;
+                        break;
+                    case ECompare::Equal: r = x == y;
+                        break;
+                    case ECompare::NotEqual: r = x != y;
+                        break;
+                    }
+                    d[l].i = r ? 1 : 0;
+                }
+                break;
+            case EOp::Equal:
+                for (uint32_t l = 0; l < w; l++) d[l].i = 1;
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pa = a + k * CHUNK;
+                    auto pb = b + k * CHUNK;
+                    for (uint32_t l = 0; l < w; l++)
+                    {
+                        const auto same = in.sub ? pa[l].u == pb[l].u : pa[l].f == pb[l].f;
+                        d[l].i = d[l].i && same;
+                    }
+                }
+                if (in.imm)
+                {
+                    for (uint32_t l = 0; l < w; l++) d[l].i = !d[l].i;
+                }
+                break;
+            case EOp::And:
+                for (uint32_t l = 0; l < w; l++) d[l].i = a[l].i && b[l].i;
+                break;
+            case EOp::Or:
+                for (uint32_t l = 0; l < w; l++) d[l].i = a[l].i || b[l].i;
+                break;
+            case EOp::Not:
+                for (uint32_t l = 0; l < w; l++) d[l].i = !a[l].i;
+                break;
+            case EOp::Convert:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pd = d + k * CHUNK;
+                    auto pa = a + k * CHUNK;
+                    switch (static_cast<EConvert>(in.sub))
+                    {
+                    case EConvert::FloatToInt:
+                        for (uint32_t l = 0; l < w; l++) pd[l].i = static_cast<int32_t>(pa[l].f);
+                        break;
+                    case EConvert::IntToFloat:
+                        for (uint32_t l = 0; l < w; l++) pd[l].f = static_cast<float>(pa[l].i);
+                        break;
+                    case EConvert::FloatToBool:
+                        for (uint32_t l = 0; l < w; l++) pd[l].i = pa[l].f != 0.0f;
+                        break;
+                    case EConvert::IntToBool:
+                        for (uint32_t l = 0; l < w; l++) pd[l].i = pa[l].i != 0;
+                        break;
+                    }
+                }
+                break;
+            case EOp::Select:
+                for (uint32_t k = 0; k < in.count; k++)
+                {
+                    auto pd = d + k * CHUNK;
+                    auto pa = a + k * CHUNK;
+                    auto pb = b + k * CHUNK;
+                    for (uint32_t l = 0; l < w; l++) pd[l] = c[l].i ? pa[l] : pb[l];
+                }
+                break;
+            case EOp::Dot:
+            case EOp::Length:
+            case EOp::Distance:
+                for (uint32_t l = 0; l < w; l++)
+                {
+                    float sum = 0;
+                    for (uint32_t k = 0; k < in.count; k++)
+                    {
+                        const auto x = a[k * CHUNK + l].f;
+                        const auto y = in.op == EOp::Dot
+                                           ? b[k * CHUNK + l].f
+                                           : in.op == EOp::Distance
+                                           ? x - b[k * CHUNK + l].f
+                                           : x;
+                        sum += in.op == EOp::Dot ? x * y : y * y;
+                    }
+                    d[l].f = in.op == EOp::Dot ? sum : std::sqrt(sum);
+                }
+                break;
+            case EOp::Normalize:
+                for (uint32_t l = 0; l < w; l++)
+                {
+                    float sum = 0;
+                    for (uint32_t k = 0; k < in.count; k++) sum += a[k * CHUNK + l].f * a[k * CHUNK + l].f;
+                    const auto scale = 1.0f / std::sqrt(sum);
+                    for (uint32_t k = 0; k < in.count; k++) d[k * CHUNK + l].f = a[k * CHUNK + l].f * scale;
+                }
+                break;
+            case EOp::Cross:
+                for (uint32_t l = 0; l < w; l++)
+                {
+                    const auto ax = a[l].f, ay = a[CHUNK + l].f, az = a[2 * CHUNK + l].f;
+                    const auto bx = b[l].f, by = b[CHUNK + l].f, bz = b[2 * CHUNK + l].f;
+                    d[l].f = ay * bz - az * by;
+                    d[CHUNK + l].f = az * bx - ax * bz;
+                    d[2 * CHUNK + l].f = ax * by - ay * bx;
+                }
+                break;
+            case EOp::Reflect:
+            case EOp::Refract:
+            case EOp::FaceForward:
+                for (uint32_t l = 0; l < w; l++)
+                {
+                    // reflect(I, N), refract(I, N, eta) and faceforward(N, I, Nref)
+                    float dotValue = 0;
+                    for (uint32_t k = 0; k < in.count; k++)
+                    {
+                        dotValue += in.op == EOp::FaceForward
+                                        ? c[k * CHUNK + l].f * b[k * CHUNK + l].f
+                                        : b[k * CHUNK + l].f * a[k * CHUNK + l].f;
+                    }
+
+                    if (in.op == EOp::Reflect)
+                    {
+                        for (uint32_t k = 0; k < in.count; k++)
+                        {
+                            d[k * CHUNK + l].f = a[k * CHUNK + l].f - 2.0f * dotValue * b[k * CHUNK + l].f;
+                        }
+                    }
+                    else if (in.op == EOp::FaceForward)
+                    {
+                        for (uint32_t k = 0; k < in.count; k++)
+                        {
+                            d[k * CHUNK + l].f = dotValue < 0.0f ? a[k * CHUNK + l].f : -a[k * CHUNK + l].f;
+                        }
+                    }
+                    else
+                    {
+                        const auto eta = c[l].f;
+                        const auto kValue = 1.0f - eta * eta * (1.0f - dotValue * dotValue);
+                        for (uint32_t k = 0; k < in.count; k++)
+                        {
+                            d[k * CHUNK + l].f = kValue < 0.0f
+                                                     ? 0.0f
+                                                     : eta * a[k * CHUNK + l].f - (eta * dotValue + std::sqrt(kValue)) *
+                                                     b[k * CHUNK + l].f;
+                        }
+                    }
+                }
+                break;
+            case EOp::MatrixMultiply:
+                {
+                    const auto rows = in.count;
+                    const auto inner = static_cast<uint32_t>(in.imm);
+                    const auto columns = in.c;
+                    for (uint32_t column = 0; column < columns; column++)
+                    {
+                        for (uint32_t row = 0; row < rows; row++)
+                        {
+                            auto pd = d + (column * rows + row) * CHUNK;
+                            for (uint32_t l = 0; l < w; l++) pd[l].f = 0;
+                            for (uint32_t p = 0; p < inner; p++)
+                            {
+                                auto pa = a + (p * rows + row) * CHUNK;
+                                auto pb = b + (column * inner + p) * CHUNK;
+                                for (uint32_t l = 0; l < w; l++) pd[l].f += pa[l].f * pb[l].f;
+                            }
+                        }
+                    }
+                }
+                break;
+            case EOp::Transpose:
+                for (uint32_t column = 0; column < in.count; column++)
+                {
+                    for (uint32_t row = 0; row < in.count; row++)
+                    {
+                        std::memcpy(d + (column * in.count + row) * CHUNK, a + (row * in.count + column) * CHUNK,
+                                    w * sizeof(Word));
+                    }
+                }
+                break;
+            case EOp::Determinant:
+            case EOp::Inverse:
+                {
+                    const auto n = in.count;
+                    float m[16];
+                    float minor[9];
+                    for (uint32_t l = 0; l < w; l++)
+                    {
+                        for (uint32_t k = 0; k < n * n; k++) m[k] = a[k * CHUNK + l].f;
+                        const auto determinant = laneDeterminant(m, n, n);
+                        if (in.op == EOp::Determinant)
+                        {
+                            d[l].f = determinant;
+                            continue;
+                        }
+
+                        // Adjugate over the determinant
+                        for (uint32_t column = 0; column < n; column++)
+                        {
+                            for (uint32_t row = 0; row < n; row++)
+                            {
+                                uint32_t k = 0;
+                                for (uint32_t mc = 0; mc < n; mc++)
+                                {
+                                    if (mc == column) continue;
+                                    for (uint32_t mr = 0; mr < n; mr++)
+                                    {
+                                        if (mr == row) continue;
+                                        minor[k++] = m[mc * n + mr];
+                                    }
+                                }
+                                const auto sign = (row + column) % 2 == 0 ? 1.0f : -1.0f;
+                                // Element (column, row) of the inverse is the cofactor of (row, column)
+                                d[(row * n + column) * CHUNK + l].f = sign * laneDeterminant(minor, n - 1, n - 1) /
+                                    determinant;
+                            }
+                        }
+                    }
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        void ExecuteFloat(const Instruction& in, Word* d, const Word* a, const Word* b, const Word* c) const
+        {
+            const auto w = width;
+            const auto n = in.count;
+            const auto s = in.broadcast;
+            switch (static_cast<EFloatOp>(in.sub))
+            {
+            case EFloatOp::Add:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return x + y; });
+                break;
+            case EFloatOp::Subtract:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return x - y; });
+                break;
+            case EFloatOp::Multiply:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return x * y; });
+                break;
+            case EFloatOp::Divide:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return x / y; });
+                break;
+            case EFloatOp::Negate:
+                applyFloat1(d, a, s, n, w, [](float x) { return -x; });
+                break;
+            case EFloatOp::Abs:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::fabs(x); });
+                break;
+            case EFloatOp::Sign:
+                applyFloat1(d, a, s, n, w, [](float x) { return x > 0.0f ? 1.0f : x < 0.0f ? -1.0f : 0.0f; });
+                break;
+            case EFloatOp::Floor:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::floor(x); });
+                break;
+            case EFloatOp::Ceil:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::ceil(x); });
+                break;
+            case EFloatOp::Fract:
+                applyFloat1(d, a, s, n, w, [](float x) { return x - std::floor(x); });
+                break;
+            case EFloatOp::Trunc:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::trunc(x); });
+                break;
+            case EFloatOp::Round:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::round(x); });
+                break;
+            case EFloatOp::Sqrt:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::sqrt(x); });
+                break;
+            case EFloatOp::InverseSqrt:
+                applyFloat1(d, a, s, n, w, [](float x) { return 1.0f / std::sqrt(x); });
+                break;
+            case EFloatOp::Exp:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::exp(x); });
+                break;
+            case EFloatOp::Exp2:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::exp2(x); });
+                break;
+            case EFloatOp::Log:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::log(x); });
+                break;
+            case EFloatOp::Log2:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::log2(x); });
+                break;
+            case EFloatOp::Sin:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::sin(x); });
+                break;
+            case EFloatOp::Cos:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::cos(x); });
+                break;
+            case EFloatOp::Tan:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::tan(x); });
+                break;
+            case EFloatOp::Asin:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::asin(x); });
+                break;
+            case EFloatOp::Acos:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::acos(x); });
+                break;
+            case EFloatOp::Atan:
+                applyFloat1(d, a, s, n, w, [](float x) { return std::atan(x); });
+                break;
+            case EFloatOp::Radians:
+                applyFloat1(d, a, s, n, w, [](float x) { return x * 0.017453292519943295f; });
+                break;
+            case EFloatOp::Degrees:
+                applyFloat1(d, a, s, n, w, [](float x) { return x * 57.29577951308232f; });
+                break;
+            case EFloatOp::Mod:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return x - y * std::floor(x / y); });
+                break;
+            case EFloatOp::Pow:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return std::pow(x, y); });
+                break;
+            case EFloatOp::Atan2:
+                applyFloat2(d, a, b, s, n, w, [](float y, float x) { return std::atan2(y, x); });
+                break;
+            case EFloatOp::Min:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return y < x ? y : x; });
+                break;
+            case EFloatOp::Max:
+                applyFloat2(d, a, b, s, n, w, [](float x, float y) { return x < y ? y : x; });
+                break;
+            case EFloatOp::Step:
+                applyFloat2(d, a, b, s, n, w, [](float edge, float x) { return x < edge ? 0.0f : 1.0f; });
+                break;
+            case EFloatOp::Clamp:
+                applyFloat3(d, a, b, c, s, n, w, [](float x, float lo, float hi)
+                {
+                    return std::min(std::max(x, lo), hi);
+                });
+                break;
+            case EFloatOp::Mix:
+                applyFloat3(d, a, b, c, s, n, w, [](float x, float y, float t) { return x * (1.0f - t) + y * t; });
+                break;
+            case EFloatOp::SmoothStep:
+                applyFloat3(d, a, b, c, s, n, w, [](float e0, float e1, float x)
+                {
+                    const auto t = std::min(std::max((x - e0) / (e1 - e0), 0.0f), 1.0f);
+                    return t * t * (3.0f - 2.0f * t);
+                });
+                break;
+            }
+        }
+
+        void ExecuteInt(const Instruction& in, Word* d, const Word* a, const Word* b, const Word* c) const
+        {
+            const auto w = width;
+            const auto n = in.count;
+            const auto s = in.broadcast;
+            // Wrapping arithmetic like GLSL, done unsigned to stay defined in C++
+            switch (static_cast<EIntOp>(in.sub))
+            {
+            case EIntOp::Add:
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y)
+                {
+                    return static_cast<int32_t>(static_cast<uint32_t>(x) + static_cast<uint32_t>(y));
+                });
+                break;
+            case EIntOp::Subtract:
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y)
+                {
+                    return static_cast<int32_t>(static_cast<uint32_t>(x) - static_cast<uint32_t>(y));
+                });
+                break;
+            case EIntOp::Multiply:
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y)
+                {
+                    return static_cast<int32_t>(static_cast<uint32_t>(x) * static_cast<uint32_t>(y));
+                });
+                break;
+            case EIntOp::Divide:
+                // Division by zero is undefined in GLSL. Inactive invocations hit it routinely, so it gives 0.
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y)
+                {
+                    return y == 0 || (y == -1 && x == INT32_MIN) ? 0 : x / y;
+                });
+                break;
+            case EIntOp::Mod:
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y)
+                {
+                    return y == 0 || y == -1 ? 0 : x % y;
+                });
+                break;
+            case EIntOp::Negate:
+                applyInt1(d, a, s, n, w, [](int32_t x)
+                {
+                    return static_cast<int32_t>(0u - static_cast<uint32_t>(x));
+                });
+                break;
+            case EIntOp::Abs:
+                applyInt1(d, a, s, n, w, [](int32_t x)
+                {
+                    return x < 0 ? static_cast<int32_t>(0u - static_cast<uint32_t>(x)) : x;
+                });
+                break;
+            case EIntOp::Sign:
+                applyInt1(d, a, s, n, w, [](int32_t x) { return x > 0 ? 1 : x < 0 ? -1 : 0; });
+                break;
+            case EIntOp::Min:
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y) { return std::min(x, y); });
+                break;
+            case EIntOp::Max:
+                applyInt2(d, a, b, s, n, w, [](int32_t x, int32_t y) { return std::max(x, y); });
+                break;
+            case EIntOp::Clamp:
+                applyInt3(d, a, b, c, s, n, w, [](int32_t x, int32_t lo, int32_t hi)
+                {
+                    return std::min(std::max(x, lo), hi);
+                });
+                break;
+            }
+        }
+
+        Function& FindFunction(const std::string& name, size_t argCount)
+        {
+            if (auto found = functions.find(name); found != functions.end())
+            {
+                for (auto& function : found->second)
+                {
+                    if (function->node->arguments.size() == argCount)
+                    {
+                        CompileFunction(*function);
+                        return *function;
+                    }
+                }
+            }
+            throw std::runtime_error("No function '" + name + "' taking " + std::to_string(argCount) + " arguments");
+        }
+
+        Value ReadValue(uint32_t reg, uint32_t size, uint32_t lane)
+        {
+            Value value{};
+            value.words.resize(size);
+            for (uint32_t k = 0; k < size; k++)
+            {
+                value.words[k] = Ptr(reg + k)[lane].u;
+            }
+            return value;
+        }
+    };
+
+    Program::Program(const std::shared_ptr<ModuleNode>& module) : _state(std::make_unique<State>(module))
+    {
+    }
+
+    Program::~Program() = default;
+    Program::Program(Program&&) noexcept = default;
+    Program& Program::operator=(Program&&) noexcept = default;
+
+    Value Program::Invoke(const std::string& function, std::vector<Value>& args)
+    {
+        std::vector<Batch> batches{};
+        batches.reserve(args.size());
+        for (auto& arg : args)
+        {
+            Batch batch{};
+            batch.count = 1;
+            batch.words = arg.words;
+            batches.push_back(std::move(batch));
+        }
+
+        auto result = InvokeBatch(function, batches, 1);
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            args[i].words = std::move(batches[i].words);
+        }
+        return Value(std::move(result.words));
+    }
+
+    Batch Program::InvokeBatch(const std::string& function, std::vector<Batch>& args, size_t count)
+    {
+        auto& state = *_state;
+        auto& target = state.FindFunction(function, args.size());
+
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            const auto size = target.parameters[i].Size();
+            // Out arguments may be left empty and are allocated here
+            if (target.isOutput[i] && args[i].words.empty()) args[i] = Batch(count, size);
+            if (args[i].count != count || args[i].words.size() != count * size)
+            {
+                throw std::runtime_error("Argument " + std::to_string(i) + " of '" + function + "' needs " +
+                    std::to_string(count) + " values of " + target.parameters[i].Name());
+            }
+        }
+
+        Batch result(count, target.returnType.Size());
+        state.EnsureRegisters();
+        for (size_t start = 0; start < count; start += CHUNK)
+        {
+            const auto width = static_cast<uint32_t>(std::min<size_t>(CHUNK, count - start));
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                for (uint32_t k = 0; k < target.parameters[i].Size(); k++)
+                {
+                    std::memcpy(state.Ptr(target.parameterRegs[i] + k), args[i].words.data() + k * count + start,
+                                width * sizeof(uint32_t));
+                }
+            }
+
+            state.Run(target.entry, width, target.exec);
+
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                if (!target.isOutput[i]) continue;
+                for (uint32_t k = 0; k < target.parameters[i].Size(); k++)
+                {
+                    std::memcpy(args[i].words.data() + k * count + start, state.Ptr(target.parameterRegs[i] + k),
+                                width * sizeof(uint32_t));
+                }
+            }
+            for (uint32_t k = 0; k < target.returnType.Size(); k++)
+            {
+                std::memcpy(result.words.data() + k * count + start, state.Ptr(target.result + k),
+                            width * sizeof(uint32_t));
+            }
+        }
+        return result;
+    }
+
+    Value Program::Evaluate(const std::shared_ptr<Node>& expression)
+    {
+        std::string typeName{};
+        return Evaluate(expression, typeName);
+    }
+
+    Value Program::Evaluate(const std::shared_ptr<Node>& expression, std::string& typeName)
+    {
+        auto& state = *_state;
+        state.Prepare(expression);
+
+        const auto codeSize = state.code.size();
+        const auto registerCount = state.registerCount;
+        try
+        {
+            state.BeginFrame();
+            state.exec = state.Allocate(1);
+            state.returned = state.Allocate(1);
+            state.result = NONE;
+            state.returnType = {};
+            auto value = state.Expression(expression);
+            state.EmitJump(EOp::Return);
+            state.EndFrame();
+
+            state.Run(static_cast<uint32_t>(codeSize), 1, state.exec);
+            auto result = state.ReadValue(value.reg, value.type.Size(), 0);
+            typeName = value.type.Name();
+
+            // The expression only runs once, so its code and registers are dropped again
+            state.code.resize(codeSize);
+            state.registerCount = registerCount;
+            return result;
+        }
+        catch (const std::exception&)
+        {
+            state.code.resize(codeSize);
+            state.registerCount = registerCount;
+            throw;
+        }
+    }
+
+    Value Program::GetConstant(const std::string& name)
+    {
+        auto& state = *_state;
+        auto found = state.globals.find(name);
+        if (found == state.globals.end()) throw std::runtime_error("No constant named '" + name + "'");
+        state.EvaluateGlobal(found->second);
+        return state.ReadValue(found->second.variable.reg, found->second.variable.type.Size(), 0);
+    }
+}
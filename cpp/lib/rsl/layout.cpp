@@ -0,0 +1,374 @@
+#include "rsl/layout.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "rsl/utils.hpp"
+
+namespace rsl
+{
+    namespace
+    {
+        uint32_t roundUp(uint32_t value, uint32_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // Components and columns of the types that can be placed in a block, or 0 columns for other types
+        std::pair<uint32_t, uint32_t> shapeOf(EDeclarationType type)
+        {
+            switch (type)
+            {
+            case EDeclarationType::Float:
+            case EDeclarationType::Int:
+            case EDeclarationType::Boolean:
+                return {1, 1};
+            case EDeclarationType::Float2:
+            case EDeclarationType::Int2:
+                return {2, 1};
+            case EDeclarationType::Float3:
+            case EDeclarationType::Int3:
+                return {3, 1};
+            case EDeclarationType::Float4:
+            case EDeclarationType::Int4:
+                return {4, 1};
+            case EDeclarationType::Mat3:
+                return {3, 3};
+            case EDeclarationType::Mat4:
+                return {4, 4};
+            default:
+                return {0, 0};
+            }
+        }
+
+        class LayoutEngine
+        {
+            ELayoutRule _rule;
+            const StructLookup& _structs;
+            // Structs being laid out, to reject structs that contain themselves
+            std::unordered_set<std::string> _active{};
+
+        public:
+            LayoutEngine(ELayoutRule inRule, const StructLookup& inStructs) : _rule(inRule), _structs(inStructs)
+            {
+            }
+
+            // Alignment of a vector with components 4 byte components
+            [[nodiscard]] uint32_t VectorAlignment(uint32_t components) const
+            {
+                if (_rule == ELayoutRule::Scalar || components == 1) return 4;
+                return components == 2 ? 8 : 16;
+            }
+
+            MemberLayout Member(const DeclarationNode& declaration)
+            {
+                MemberLayout result{};
+                result.name = declaration.declarationName;
+                result.typeName = declaration.GetTypeName();
+
+                // Element size, padded per rule when it is a struct or matrix
+                uint32_t elementSize = 0;
+                if (auto asBlock = dynamic_cast<const BlockDeclarationNode*>(&declaration))
+                {
+                    elementSize = Members(result, asBlock->declarations);
+                }
+                else if (auto asBuffer = dynamic_cast<const BufferDeclarationNode*>(&declaration))
+                {
+                    elementSize = Members(result, asBuffer->declarations);
+                }
+                else if (declaration.declarationType == EDeclarationType::Struct)
+                {
+                    // Looked up by name first, since clones of a module keep referring to the original structs
+                    std::shared_ptr<StructNode> structNode{};
+                    if (auto found = _structs.find(result.typeName); found != _structs.end())
+                    {
+                        structNode = found->second;
+                    }
+                    else if (auto asStruct = dynamic_cast<const StructDeclarationNode*>(&declaration))
+                    {
+                        structNode = asStruct->structNode;
+                    }
+                    if (!structNode) throw std::runtime_error("Unknown struct '" + result.typeName + "'");
+
+                    if (!_active.insert(structNode->name).second)
+                    {
+                        throw std::runtime_error("Struct '" + structNode->name + "' contains itself");
+                    }
+                    elementSize = Members(result, structNode->declarations);
+                    _active.erase(structNode->name);
+                }
+                else
+                {
+                    auto [components, columns] = shapeOf(declaration.declarationType);
+                    if (columns == 0)
+                    {
+                        throw std::runtime_error("'" + result.name + "' of type " + result.typeName +
+                            " cannot be placed in a block");
+                    }
+
+                    result.alignment = VectorAlignment(components);
+                    elementSize = components * 4;
+                    if (columns > 1)
+                    {
+                        // Column major, each column laid out like an array element
+                        result.matrixStride = _rule == ELayoutRule::Std140
+                                                  ? roundUp(elementSize, 16)
+                                                  : roundUp(elementSize, result.alignment);
+                        if (_rule == ELayoutRule::Std140) result.alignment = 16;
+                        elementSize = result.matrixStride * columns;
+                    }
+                }
+
+                if (declaration.declarationCount == 1)
+                {
+                    result.size = elementSize;
+                    return result;
+                }
+
+                result.arrayLength = declaration.declarationCount;
+                if (_rule == ELayoutRule::Std140) result.alignment = roundUp(result.alignment, 16);
+                result.arrayStride = _rule == ELayoutRule::Scalar
+                                         ? elementSize
+                                         : roundUp(elementSize, result.alignment);
+                result.size = declaration.declarationCount < 0
+                                  ? 0
+                                  : result.arrayStride * static_cast<uint32_t>(declaration.declarationCount);
+                return result;
+            }
+
+            // Lays declarations out as the members of parent and returns the padded size of one parent element
+            uint32_t Members(MemberLayout& parent, const std::vector<std::shared_ptr<DeclarationNode>>& declarations)
+            {
+                uint32_t offset = 0;
+                uint32_t alignment = 4;
+                for (size_t i = 0; i < declarations.size(); i++)
+                {
+                    auto member = Member(*declarations[i]);
+                    if (member.arrayLength < 0 && i != declarations.size() - 1)
+                    {
+                        throw std::runtime_error("Only the last member of " + parent.typeName + " can be unsized");
+                    }
+
+                    offset = roundUp(offset, member.alignment);
+                    member.offset = offset;
+                    offset += member.size;
+                    alignment = std::max(alignment, member.alignment);
+                    parent.members.push_back(std::move(member));
+                }
+
+                parent.alignment = _rule == ELayoutRule::Std140 ? roundUp(alignment, 16) : alignment;
+                return roundUp(offset, parent.alignment);
+            }
+        };
+
+        // Bytes of a member that hold data, leaving out every kind of padding
+        uint32_t dataSize(const MemberLayout& member)
+        {
+            uint32_t elementSize = 0;
+            if (!member.members.empty())
+            {
+                for (auto& child : member.members)
+                {
+                    elementSize += dataSize(child);
+                }
+            }
+            else
+            {
+                auto [components, columns] = shapeOf(
+                    DeclarationNode::TokenTypeToDeclarationType(Token(member.typeName, {}).type));
+                elementSize = components * columns * 4;
+            }
+
+            if (member.arrayLength < 0) return 0;
+            return elementSize * std::max(member.arrayLength, 1);
+        }
+
+        std::string padLeft(const std::string& text, size_t width)
+        {
+            return text.size() >= width ? text : std::string(width - text.size(), ' ') + text;
+        }
+
+        std::string padRight(const std::string& text, size_t width)
+        {
+            return text.size() >= width ? text : text + std::string(width - text.size(), ' ');
+        }
+
+        void formatMembers(std::string& out, const std::vector<MemberLayout>& members, uint32_t base, int depth)
+        {
+            for (auto& member : members)
+            {
+                auto type = member.typeName;
+                if (member.arrayLength < 0) type += "[]";
+                else if (member.arrayLength > 0) type += "[" + std::to_string(member.arrayLength) + "]";
+
+                out += padLeft(std::to_string(base + member.offset), 8);
+                out += padLeft(std::to_string(member.size), 8);
+                out += padLeft(std::to_string(member.alignment), 7);
+                out += padLeft(member.arrayStride ? std::to_string(member.arrayStride) : "-", 8);
+                out += padLeft(member.matrixStride ? std::to_string(member.matrixStride) : "-", 8);
+                out += "  " + std::string(static_cast<size_t>(depth) * 2, ' ');
+                out += padRight(type, 20) + " " + member.name + "\n";
+
+                // Offsets of the members of the first element
+                formatMembers(out, member.members, base + member.offset, depth + 1);
+            }
+        }
+
+        std::optional<int> parseTag(const std::unordered_map<std::string, std::string>& tags, const std::string& tag)
+        {
+            if (auto found = tags.find(tag); found != tags.end() && isInteger(found->second))
+            {
+                return parseInt(found->second);
+            }
+            return std::nullopt;
+        }
+    }
+
+    uint32_t BlockLayout::GetPadding() const
+    {
+        uint32_t data = 0;
+        for (auto& member : members)
+        {
+            data += dataSize(member);
+        }
+        return size - data;
+    }
+
+    const ResourceReflection* Reflection::Find(const std::string& name) const
+    {
+        for (auto& resource : resources)
+        {
+            if (resource.name == name) return &resource;
+        }
+        return nullptr;
+    }
+
+    ELayoutRule layoutRuleOf(const std::unordered_map<std::string, std::string>& tags, ELayoutRule fallback)
+    {
+        if (tags.contains("scalar")) return ELayoutRule::Scalar;
+        if (tags.contains("std430")) return ELayoutRule::Std430;
+        if (tags.contains("std140")) return ELayoutRule::Std140;
+        return fallback;
+    }
+
+    std::string_view layoutRuleName(ELayoutRule rule)
+    {
+        switch (rule)
+        {
+        case ELayoutRule::Std140:
+            return "std140";
+        case ELayoutRule::Std430:
+            return "std430";
+        case ELayoutRule::Scalar:
+            return "scalar";
+        }
+        return "";
+    }
+
+    MemberLayout layoutOf(const DeclarationNode& declaration, ELayoutRule rule, const StructLookup& structs)
+    {
+        return LayoutEngine(rule, structs).Member(declaration);
+    }
+
+    BlockLayout layoutOf(const std::string& name, const std::vector<std::shared_ptr<DeclarationNode>>& declarations,
+                         ELayoutRule rule, const StructLookup& structs)
+    {
+        MemberLayout block{};
+        block.typeName = name;
+        const auto size = LayoutEngine(rule, structs).Members(block, declarations);
+
+        BlockLayout result{};
+        result.name = name;
+        result.rule = rule;
+        result.size = size;
+        result.alignment = block.alignment;
+        result.members = std::move(block.members);
+        return result;
+    }
+
+    Reflection reflect(const std::shared_ptr<ModuleNode>& module)
+    {
+        StructLookup structs{};
+        for (auto& statement : module->statements)
+        {
+            if (auto asStruct = std::dynamic_pointer_cast<StructNode>(statement))
+            {
+                structs.insert_or_assign(asStruct->name, asStruct);
+            }
+        }
+
+        Reflection result{};
+        for (auto& statement : module->statements)
+        {
+            if (auto asPushConstant = std::dynamic_pointer_cast<PushConstantNode>(statement))
+            {
+                ResourceReflection resource{};
+                resource.name = "push";
+                resource.type = EResourceType::PushConstant;
+                resource.layout = layoutOf("push", asPushConstant->declarations,
+                                           layoutRuleOf(asPushConstant->tags, ELayoutRule::Std430), structs);
+                result.resources.push_back(std::move(resource));
+                continue;
+            }
+
+            auto asLayout = std::dynamic_pointer_cast<LayoutNode>(statement);
+            if (!asLayout) continue;
+
+            if (asLayout->layoutType == ELayoutType::Input || asLayout->layoutType == ELayoutType::Output)
+            {
+                InterfaceReflection variable{};
+                variable.name = asLayout->declaration->declarationName;
+                variable.typeName = asLayout->declaration->GetTypeName();
+                variable.location = parseTag(asLayout->tags, "location").value_or(-1);
+                variable.component = parseTag(asLayout->tags, "component").value_or(0);
+                variable.arrayLength = asLayout->declaration->declarationCount == 1
+                                           ? 0
+                                           : asLayout->declaration->declarationCount;
+                variable.isFlat = asLayout->tags.contains("$flat");
+                (asLayout->layoutType == ELayoutType::Input ? result.inputs : result.outputs).push_back(
+                    std::move(variable));
+                continue;
+            }
+
+            ResourceReflection resource{};
+            resource.name = asLayout->declaration->declarationName;
+            resource.set = parseTag(asLayout->tags, "set").value_or(0);
+            resource.binding = parseTag(asLayout->tags, "binding").value_or(0);
+            resource.isReadonly = asLayout->layoutType == ELayoutType::Readonly;
+
+            if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(asLayout->declaration))
+            {
+                // Readonly blocks are storage buffers
+                resource.type = resource.isReadonly ? EResourceType::StorageBuffer : EResourceType::UniformBlock;
+                resource.layout = layoutOf(asBlock->declarationName, asBlock->declarations,
+                                           layoutRuleOf(asLayout->tags, resource.isReadonly
+                                                                            ? ELayoutRule::Std430
+                                                                            : ELayoutRule::Std140), structs);
+            }
+            else if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(asLayout->declaration))
+            {
+                resource.type = EResourceType::StorageBuffer;
+                resource.layout = layoutOf(asBuffer->declarationName, asBuffer->declarations,
+                                           layoutRuleOf(asLayout->tags, ELayoutRule::Std430), structs);
+            }
+            else
+            {
+                resource.type = EResourceType::Opaque;
+            }
+            result.resources.push_back(std::move(resource));
+        }
+        return result;
+    }
+
+    std::string formatLayout(const BlockLayout& layout)
+    {
+        std::string out = layout.name + " (" + std::string(layoutRuleName(layout.rule)) + ", " +
+            std::to_string(layout.size) + " bytes, " + std::to_string(layout.alignment) + " byte aligned, " +
+            std::to_string(layout.GetPadding()) + " bytes of padding)\n";
+        out += "  offset    size  align  stride  matrix  type\n";
+        formatMembers(out, layout.members, 0, 0);
+        return out;
+    }
+}
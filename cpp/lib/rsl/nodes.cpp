@@ -1,7 +1,11 @@
 #include "rsl/nodes.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <map>
 #include <stdexcept>
 
+#include "rsl/layout.hpp"
 #include "rsl/utils.hpp"
 
 namespace rsl
@@ -11,7 +15,7 @@ namespace rsl
         size_t seed = static_cast<size_t>(nodeType);
         for (const auto& child : GetChildren())
         {
-            seed = hashCombine(seed, child->ComputeHash());
+            seed = hashCombine(seed, child ? child->ComputeHash() : 0);
         }
         return seed;
     }
@@ -21,11 +25,29 @@ namespace rsl
         nodeType = inNodeType;
     }
 
+    bool Node::HasSameFields(const Node& other) const
+    {
+        return nodeType == other.nodeType;
+    }
+
     size_t Node::ComputeHash() const
     {
         return ComputeSelfHash();
     }
 
+    bool Node::IsSameAs(const Node& other) const
+    {
+        if (!HasSameFields(other)) return false;
+
+        const auto children = GetChildren();
+        const auto otherChildren = other.GetChildren();
+        return std::ranges::equal(children, otherChildren, [](const std::shared_ptr<Node>& a,
+                                                               const std::shared_ptr<Node>& b)
+        {
+            return a && b ? a->IsSameAs(*b) : a == b;
+        });
+    }
+
     ModuleNode::ModuleNode(const std::vector<std::shared_ptr<Node>>& inStatements) : Node(NodeType::Module)
     {
         statements = inStatements;
@@ -103,34 +125,12 @@ namespace rsl
         declarationCount = inDeclarationCount;
     }
 
-    uint64_t DeclarationNode::GetSize() const
+    uint64_t DeclarationNode::GetSize(ELayoutRule rule) const
     {
-        switch (declarationType)
-        {
-        case EDeclarationType::Struct:
-            throw std::runtime_error("Node with type 'Struct' must use class 'StructDeclarationNode'");
-        case EDeclarationType::Float:
-        case EDeclarationType::Int:
-            return static_cast<uint64_t>(4) * declarationCount;
-        case EDeclarationType::Float2:
-        case EDeclarationType::Int2:
-            return static_cast<uint64_t>(8) * declarationCount;
-        case EDeclarationType::Float3:
-        case EDeclarationType::Int3:
-            return static_cast<uint64_t>(12) * declarationCount;
-        case EDeclarationType::Float4:
-        case EDeclarationType::Int4:
-            return static_cast<uint64_t>(16) * declarationCount;
-        case EDeclarationType::Mat3:
-            return static_cast<uint64_t>(12) * 3 * declarationCount;
-        case EDeclarationType::Mat4:
-            return static_cast<uint64_t>(16) * 4 * declarationCount;
-        default:
-            throw std::runtime_error("Unknown Declaration Size");
-        }
+        return layoutOf(*this, rule).size;
     }
 
-    std::string DeclarationNode::GetTypeName()
+    std::string DeclarationNode::GetTypeName() const
     {
         switch (declarationType)
         {
@@ -181,14 +181,16 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), declarationType, declarationName, declarationCount);
     }
 
-    uint64_t StructNode::GetSize() const
+    bool DeclarationNode::HasSameFields(const Node& other) const
     {
-        uint64_t size = 0;
-        for (auto& declarationNode : declarations)
-        {
-            size += declarationNode->GetSize();
-        }
-        return size;
+        const auto asDeclaration = dynamic_cast<const DeclarationNode*>(&other);
+        return asDeclaration && Node::HasSameFields(other) && declarationType == asDeclaration->declarationType &&
+            declarationName == asDeclaration->declarationName && declarationCount == asDeclaration->declarationCount;
+    }
+
+    uint64_t StructNode::GetSize(ELayoutRule rule) const
+    {
+        return layoutOf(name, declarations, rule).size;
     }
 
     StructNode::StructNode(const std::string& inName,
@@ -214,13 +216,13 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), name);
     }
 
-    uint64_t StructDeclarationNode::GetSize() const
+    bool StructNode::HasSameFields(const Node& other) const
     {
-        if (!structNode) throw std::runtime_error("Struct Reference Is Invalid");
-        return structNode->GetSize() * declarationCount;
+        const auto asStruct = dynamic_cast<const StructNode*>(&other);
+        return asStruct && Node::HasSameFields(other) && name == asStruct->name;
     }
 
-    std::string StructDeclarationNode::GetTypeName()
+    std::string StructDeclarationNode::GetTypeName() const
     {
         return structName;
     }
@@ -256,6 +258,13 @@ namespace rsl
         return hashCombine(DeclarationNode::ComputeSelfHash(), structName);
     }
 
+    bool StructDeclarationNode::HasSameFields(const Node& other) const
+    {
+        const auto asStructDeclaration = dynamic_cast<const StructDeclarationNode*>(&other);
+        return asStructDeclaration && DeclarationNode::HasSameFields(other) &&
+            structName == asStructDeclaration->structName;
+    }
+
     BufferDeclarationNode::BufferDeclarationNode(const std::string& inName, const int& inCount,
                                                  const std::vector<std::shared_ptr<DeclarationNode>>& inDeclarations):
         DeclarationNode(EDeclarationType::Block, inName, inCount)
@@ -274,32 +283,12 @@ namespace rsl
         return r;
     }
 
-    std::string BufferDeclarationNode::GetTypeName()
+    std::string BufferDeclarationNode::GetTypeName() const
     {
         return "buffer";
     }
 
-    uint64_t BufferDeclarationNode::GetSize() const
-    {
-        uint64_t size = 0;
-        for (auto& declarationNode : declarations)
-        {
-            size += declarationNode->GetSize();
-        }
-        return size * declarationCount;
-    }
-
-    uint64_t BlockDeclarationNode::GetSize() const
-    {
-        uint64_t size = 0;
-        for (auto& declarationNode : declarations)
-        {
-            size += declarationNode->GetSize();
-        }
-        return size * declarationCount;
-    }
-
-    std::string BlockDeclarationNode::GetTypeName()
+    std::string BlockDeclarationNode::GetTypeName() const
     {
         return "_block_" + declarationName;
     }
@@ -407,6 +396,12 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), static_cast<int>(op));
     }
 
+    bool BinaryOpNode::HasSameFields(const Node& other) const
+    {
+        const auto asBinaryOp = dynamic_cast<const BinaryOpNode*>(&other);
+        return asBinaryOp && Node::HasSameFields(other) && op == asBinaryOp->op;
+    }
+
     FunctionArgumentNode::FunctionArgumentNode(bool inIsInput,
                                                const std::shared_ptr<DeclarationNode>& inDeclaration) : Node(
         NodeType::FunctionArgument)
@@ -420,6 +415,17 @@ namespace rsl
         return {declaration};
     }
 
+    size_t FunctionArgumentNode::ComputeSelfHash() const
+    {
+        return hashCombine(Node::ComputeSelfHash(), isInput);
+    }
+
+    bool FunctionArgumentNode::HasSameFields(const Node& other) const
+    {
+        const auto asFunctionArgument = dynamic_cast<const FunctionArgumentNode*>(&other);
+        return asFunctionArgument && Node::HasSameFields(other) && isInput == asFunctionArgument->isInput;
+    }
+
 
     FunctionNode::FunctionNode(const std::shared_ptr<DeclarationNode>& inReturnDeclaration, const std::string& inName,
                                const std::vector<std::shared_ptr<FunctionArgumentNode>>& inArguments,
@@ -441,6 +447,17 @@ namespace rsl
         return children;
     }
 
+    size_t FunctionNode::ComputeSelfHash() const
+    {
+        return hashCombine(Node::ComputeSelfHash(), name);
+    }
+
+    bool FunctionNode::HasSameFields(const Node& other) const
+    {
+        const auto asFunction = dynamic_cast<const FunctionNode*>(&other);
+        return asFunction && Node::HasSameFields(other) && name == asFunction->name;
+    }
+
     IdentifierNode::IdentifierNode(const std::string& inId) : Node(NodeType::Identifier)
     {
         id = inId;
@@ -456,6 +473,12 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), id);
     }
 
+    bool IdentifierNode::HasSameFields(const Node& other) const
+    {
+        const auto asIdentifier = dynamic_cast<const IdentifierNode*>(&other);
+        return asIdentifier && Node::HasSameFields(other) && id == asIdentifier->id;
+    }
+
     AccessNode::AccessNode(const std::shared_ptr<Node>& inLeft, const std::shared_ptr<Node>& inRight) : Node(
         NodeType::Access)
     {
@@ -500,6 +523,17 @@ namespace rsl
         return {};
     }
 
+    size_t IntegerLiteralNode::ComputeSelfHash() const
+    {
+        return hashCombine(Node::ComputeSelfHash(), data);
+    }
+
+    bool IntegerLiteralNode::HasSameFields(const Node& other) const
+    {
+        const auto asIntegerLiteral = dynamic_cast<const IntegerLiteralNode*>(&other);
+        return asIntegerLiteral && Node::HasSameFields(other) && data == asIntegerLiteral->data;
+    }
+
     BooleanLiteralNode::BooleanLiteralNode(const bool& inData) : Node(NodeType::BooleanLiteral)
     {
         data = inData;
@@ -510,6 +544,17 @@ namespace rsl
         return {};
     }
 
+    size_t BooleanLiteralNode::ComputeSelfHash() const
+    {
+        return hashCombine(Node::ComputeSelfHash(), data);
+    }
+
+    bool BooleanLiteralNode::HasSameFields(const Node& other) const
+    {
+        const auto asBooleanLiteral = dynamic_cast<const BooleanLiteralNode*>(&other);
+        return asBooleanLiteral && Node::HasSameFields(other) && data == asBooleanLiteral->data;
+    }
+
     FloatLiteralNode::FloatLiteralNode(const float& inData) : Node(NodeType::FloatLiteral)
     {
         data = inData;
@@ -520,6 +565,18 @@ namespace rsl
         return {};
     }
 
+    size_t FloatLiteralNode::ComputeSelfHash() const
+    {
+        return hashCombine(Node::ComputeSelfHash(), data);
+    }
+
+    bool FloatLiteralNode::HasSameFields(const Node& other) const
+    {
+        const auto asFloat = dynamic_cast<const FloatLiteralNode*>(&other);
+        return asFloat && Node::HasSameFields(other) &&
+            std::bit_cast<uint32_t>(data) == std::bit_cast<uint32_t>(asFloat->data);
+    }
+
     CallNode::CallNode(const std::shared_ptr<IdentifierNode>& inIdentifier,
                        const std::vector<std::shared_ptr<Node>>& inArgs) : Node(NodeType::Call)
     {
@@ -550,6 +607,12 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), isPrefix);
     }
 
+    bool IncrementNode::HasSameFields(const Node& other) const
+    {
+        const auto asIncrement = dynamic_cast<const IncrementNode*>(&other);
+        return asIncrement && Node::HasSameFields(other) && isPrefix == asIncrement->isPrefix;
+    }
+
     DecrementNode::DecrementNode(bool inIsPrefix, const std::shared_ptr<Node>& inTarget) : Node(NodeType::Decrement)
     {
         isPrefix = inIsPrefix;
@@ -566,6 +629,12 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), isPrefix);
     }
 
+    bool DecrementNode::HasSameFields(const Node& other) const
+    {
+        const auto asDecrement = dynamic_cast<const DecrementNode*>(&other);
+        return asDecrement && Node::HasSameFields(other) && isPrefix == asDecrement->isPrefix;
+    }
+
     NegateNode::NegateNode(const std::shared_ptr<Node>& inTarget) : Node(NodeType::Negate)
     {
         target = inTarget;
@@ -644,13 +713,20 @@ namespace rsl
     size_t LayoutNode::ComputeSelfHash() const
     {
         std::string tagsStr{};
-        for (auto& [fst, snd] : tags)
+        for (auto& [fst, snd] : std::map(tags.begin(), tags.end()))
         {
             tagsStr += fst + "-" + snd;
         }
         return hashCombine(Node::ComputeSelfHash(), static_cast<int>(layoutType), tagsStr);
     }
 
+    bool LayoutNode::HasSameFields(const Node& other) const
+    {
+        const auto asLayout = dynamic_cast<const LayoutNode*>(&other);
+        return asLayout && Node::HasSameFields(other) && layoutType == asLayout->layoutType &&
+            tags == asLayout->tags;
+    }
+
     PushConstantNode::PushConstantNode(const std::vector<std::shared_ptr<DeclarationNode>>& inDeclarations,
                                        const std::unordered_map<std::string, std::string>& inTags) : Node(
         NodeType::PushConstant)
@@ -671,22 +747,22 @@ namespace rsl
     size_t PushConstantNode::ComputeSelfHash() const
     {
         std::string tagsStr{};
-        for (auto& [fst, snd] : tags)
+        for (auto& [fst, snd] : std::map(tags.begin(), tags.end()))
         {
             tagsStr += fst + "-" + snd;
         }
         return hashCombine(Node::ComputeSelfHash(), tagsStr);
     }
 
-    size_t PushConstantNode::GetSize() const
+    bool PushConstantNode::HasSameFields(const Node& other) const
     {
-        size_t size = 0;
-        for (auto& declarationNode : declarations)
-        {
-            size += declarationNode->GetSize();
-        }
+        const auto asPushConstant = dynamic_cast<const PushConstantNode*>(&other);
+        return asPushConstant && Node::HasSameFields(other) && tags == asPushConstant->tags;
+    }
 
-        return size;
+    size_t PushConstantNode::GetSize() const
+    {
+        return layoutOf("push", declarations, layoutRuleOf(tags, ELayoutRule::Std430)).size;
     }
 
     DefineNode::DefineNode(const std::string& identifier, const std::shared_ptr<Node>& inExpression) : Node(
@@ -706,6 +782,12 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), id);
     }
 
+    bool DefineNode::HasSameFields(const Node& other) const
+    {
+        const auto asDefine = dynamic_cast<const DefineNode*>(&other);
+        return asDefine && Node::HasSameFields(other) && id == asDefine->id;
+    }
+
     IncludeNode::IncludeNode(const std::string& inSourceFile, const std::string& inTargetFile) : Node(NodeType::Include)
     {
         sourceFile = inSourceFile;
@@ -722,6 +804,13 @@ namespace rsl
         return hashCombine(Node::ComputeSelfHash(), sourceFile, targetFile);
     }
 
+    bool IncludeNode::HasSameFields(const Node& other) const
+    {
+        const auto asInclude = dynamic_cast<const IncludeNode*>(&other);
+        return asInclude && Node::HasSameFields(other) && sourceFile == asInclude->sourceFile &&
+            targetFile == asInclude->targetFile;
+    }
+
     ConditionalNode::ConditionalNode(const std::shared_ptr<Node>& inCondition, const std::shared_ptr<Node>& inLeft,
                                      const std::shared_ptr<Node>& inRight) : Node(NodeType::Conditional)
     {
@@ -780,4 +869,10 @@ namespace rsl
     {
         return hashCombine(Node::ComputeSelfHash(), static_cast<int>(scopeType));
     }
+
+    bool NamedScopeNode::HasSameFields(const Node& other) const
+    {
+        const auto asNamedScope = dynamic_cast<const NamedScopeNode*>(&other);
+        return asNamedScope && Node::HasSameFields(other) && scopeType == asNamedScope->scopeType;
+    }
 }
@@ -228,6 +228,18 @@ namespace rsl
             }
         }
 
+        if (input.NotEmpty() && input.Front().type == TokenType::OpIncrement)
+        {
+            input.RemoveFront();
+            return std::make_shared<IncrementNode>(false, left);
+        }
+
+        if (input.NotEmpty() && input.Front().type == TokenType::OpDecrement)
+        {
+            input.RemoveFront();
+            return std::make_shared<DecrementNode>(false, left);
+        }
+
         return left;
     }
 
@@ -389,15 +401,15 @@ namespace rsl
 
         withinParen.ExpectFront(TokenType::OpenParen).RemoveFront();
 
-        input.ExpectFront(TokenType::CloseParen).RemoveBack();
+        input.ExpectFront(TokenType::CloseParen).RemoveFront();
 
-        auto initTokens = consumeTokensTill(withinParen, setOf(TokenType::Colon));
+        auto initTokens = consumeTokensTill(withinParen, setOf(TokenType::StatementEnd));
 
-        withinParen.ExpectFront(TokenType::Colon).RemoveFront();
+        withinParen.ExpectFront(TokenType::StatementEnd).RemoveFront();
 
-        auto condTokens = consumeTokensTill(withinParen, setOf(TokenType::Colon));
+        auto condTokens = consumeTokensTill(withinParen, setOf(TokenType::StatementEnd));
 
-        withinParen.ExpectFront(TokenType::Colon).RemoveFront();
+        withinParen.ExpectFront(TokenType::StatementEnd).RemoveFront();
 
         auto updateTokens = withinParen;
 
@@ -765,63 +777,56 @@ namespace rsl
                                               args, parseScope(input));
     }
 
+    std::shared_ptr<Node> parseTopLevelStatement(TokenList& input)
+    {
+        switch (input.Front().type)
+        {
+        case TokenType::FragmentScope:
+        case TokenType::VertexScope:
+            return parseNamedScope(input);
+        case TokenType::Include:
+            return parseInclude(input);
+        case TokenType::Define:
+            return parseDefine(input);
+        case TokenType::Layout:
+            return parseLayout(input);
+        case TokenType::TypeStruct:
+            return parseStruct(input);
+        case TokenType::Const:
+            {
+                auto tokens = consumeTokensTill(input, setOf(TokenType::StatementEnd));
+                input.ExpectFront(TokenType::StatementEnd).RemoveFront();
+                return parseExpression(tokens);
+            }
+        case TokenType::PushConstant:
+            return parsePushConstant(input);
+        case TokenType::TypeVoid:
+        case TokenType::TypeFloat:
+        case TokenType::TypeFloat2:
+        case TokenType::TypeFloat3:
+        case TokenType::TypeFloat4:
+        case TokenType::TypeInt:
+        case TokenType::TypeInt2:
+        case TokenType::TypeInt3:
+        case TokenType::TypeInt4:
+        case TokenType::TypeBoolean:
+        case TokenType::TypeMat3:
+        case TokenType::TypeMat4:
+        case TokenType::Unknown:
+            return parseFunction(input);
+        default:
+            throw std::runtime_error("Unexpected Token type");
+        }
+    }
+
     std::shared_ptr<ModuleNode> parse(TokenList& input)
     {
         if (input.Empty()) return std::make_shared<ModuleNode>(std::vector<std::shared_ptr<Node>>{});
 
-        auto file = input.Front().value;
-
         std::vector<std::shared_ptr<Node>> statements{};
         while (input.NotEmpty())
         {
-            switch (input.Front().type)
-            {
-            case TokenType::FragmentScope:
-            case TokenType::VertexScope:
-                statements.push_back(parseNamedScope(input));
-                break;
-            case TokenType::Include:
-                statements.push_back(parseInclude(input));
-                break;
-            case TokenType::Define:
-                statements.push_back(parseDefine(input));
-                break;
-            case TokenType::Layout:
-                statements.push_back(parseLayout(input));
-                break;
-            case TokenType::TypeStruct:
-                statements.push_back(parseStruct(input));
-                break;
-            case TokenType::Const:
-                {
-                    auto tokens = consumeTokensTill(input, setOf(TokenType::StatementEnd));
-                    input.ExpectFront(TokenType::StatementEnd).RemoveFront();
-                    statements.push_back(parseExpression(tokens));
-                }
-                break;
-            case TokenType::PushConstant:
-                {
-                    statements.push_back(parsePushConstant(input));
-                }
-                break;
-            case TokenType::TypeVoid:
-            case TokenType::TypeFloat:
-            case TokenType::TypeFloat2:
-            case TokenType::TypeFloat3:
-            case TokenType::TypeFloat4:
-            case TokenType::TypeInt:
-            case TokenType::TypeInt2:
-            case TokenType::TypeInt3:
-            case TokenType::TypeInt4:
-            case TokenType::TypeBoolean:
-            case TokenType::TypeMat3:
-            case TokenType::TypeMat4:
-            case TokenType::Unknown:
-                statements.push_back(parseFunction(input));
-                break;
-            default:
-                throw std::runtime_error("Unexpected Token type");
-            }
+            statements.push_back(parseTopLevelStatement(input));
         }
 
         return std::make_shared<ModuleNode>(statements);
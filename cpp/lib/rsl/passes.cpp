@@ -0,0 +1,4305 @@
+#include "rsl/passes.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "rsl/interpreter.hpp"
+#include "rsl/utils.hpp"
+
+namespace rsl
+{
+    namespace
+    {
+        // GLSL keywords, reserved words and builtin functions short enough to be produced by NextName
+        const std::unordered_set<std::string_view> RESERVED_NAMES = {
+            "do", "if", "in", "asm", "for", "int", "out", "abs", "all", "any", "cos", "dot", "exp", "fma", "log",
+            "max", "min", "mix", "mod", "not", "pow", "sin", "tan", "bool", "case", "cast", "else", "enum", "flat",
+            "goto", "half", "long", "lowp", "mat2", "mat3", "mat4", "this", "true", "uint", "vec2", "vec3", "vec4",
+            "void", "acos", "asin", "atan", "ceil", "cosh", "exp2", "log2", "sign", "sinh", "sqrt", "step", "tanh",
+            "bvec2", "bvec3", "bvec4", "ivec2", "ivec3", "ivec4", "uvec2", "uvec3", "uvec4", "dvec2", "dvec3",
+            "dvec4", "fract", "floor", "round", "trunc", "equal", "false", "float", "inout", "while"
+        };
+
+        constexpr std::string_view FIRST_CHARS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        constexpr std::string_view NEXT_CHARS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+        class IdentifierShortener
+        {
+            // Every name that appears anywhere in the module, so a new name never captures an existing reference
+            std::unordered_set<std::string> _taken{};
+            // Names a define refers to. Defines are substituted textually so these must keep their spelling.
+            std::unordered_set<std::string> _kept{};
+            std::unordered_map<std::string, std::string> _functions{};
+            std::vector<std::unordered_map<std::string, std::string>> _scopes{};
+            size_t _nextIndex = 0;
+
+            static std::string NameForIndex(size_t index)
+            {
+                std::string name{FIRST_CHARS[index % FIRST_CHARS.size()]};
+                index /= FIRST_CHARS.size();
+                while (index > 0)
+                {
+                    index--;
+                    name += NEXT_CHARS[index % NEXT_CHARS.size()];
+                    index /= NEXT_CHARS.size();
+                }
+                return name;
+            }
+
+            std::string NextName()
+            {
+                while (true)
+                {
+                    auto name = NameForIndex(_nextIndex++);
+                    if (!_taken.contains(name) && !RESERVED_NAMES.contains(name)) return name;
+                }
+            }
+
+            void Collect(const std::shared_ptr<ModuleNode>& module)
+            {
+                walk(module, [this](const std::shared_ptr<Node>& node)
+                {
+                    if (!node) return false;
+
+                    switch (node->nodeType)
+                    {
+                    case NodeType::Identifier:
+                        _taken.insert(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                        break;
+                    case NodeType::Declaration:
+                        {
+                            auto asDeclaration = std::dynamic_pointer_cast<DeclarationNode>(node);
+                            _taken.insert(asDeclaration->declarationName);
+                            _taken.insert(asDeclaration->GetTypeName());
+                        }
+                        break;
+                    case NodeType::Function:
+                        _taken.insert(std::dynamic_pointer_cast<FunctionNode>(node)->name);
+                        break;
+                    case NodeType::Struct:
+                        _taken.insert(std::dynamic_pointer_cast<StructNode>(node)->name);
+                        break;
+                    case NodeType::Define:
+                        {
+                            auto asDefine = std::dynamic_pointer_cast<DefineNode>(node);
+                            _taken.insert(asDefine->id);
+                            walk(asDefine->expression, [this](const std::shared_ptr<Node>& child)
+                            {
+                                if (child && child->nodeType == NodeType::Identifier)
+                                {
+                                    _kept.insert(std::dynamic_pointer_cast<IdentifierNode>(child)->id);
+                                }
+                                return child != nullptr;
+                            });
+                        }
+                        return false;
+                    default:
+                        break;
+                    }
+
+                    return true;
+                });
+            }
+
+            void Declare(const std::shared_ptr<DeclarationNode>& declaration)
+            {
+                if (declaration->declarationName.empty()) return;
+
+                auto& name = declaration->declarationName;
+                auto newName = _kept.contains(name) ? name : NextName();
+                _scopes.back().insert_or_assign(name, newName);
+                name = newName;
+            }
+
+            void RenameExpression(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Identifier:
+                    {
+                        auto asIdentifier = std::dynamic_pointer_cast<IdentifierNode>(node);
+                        for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it)
+                        {
+                            if (auto found = it->find(asIdentifier->id); found != it->end())
+                            {
+                                asIdentifier->id = found->second;
+                                return;
+                            }
+                        }
+                    }
+                    break;
+                case NodeType::Declaration:
+                    Declare(std::dynamic_pointer_cast<DeclarationNode>(node));
+                    break;
+                case NodeType::Const:
+                    Declare(std::dynamic_pointer_cast<ConstNode>(node)->declaration);
+                    break;
+                case NodeType::Assign:
+                    {
+                        // A declaration's scope starts after its initializer
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(node);
+                        RenameExpression(asAssign->value);
+                        RenameExpression(asAssign->target);
+                    }
+                    break;
+                case NodeType::Call:
+                    {
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        if (auto found = _functions.find(asCall->identifier->id); found != _functions.end())
+                        {
+                            asCall->identifier->id = found->second;
+                        }
+
+                        for (auto& arg : asCall->args)
+                        {
+                            RenameExpression(arg);
+                        }
+                    }
+                    break;
+                case NodeType::Access:
+                    // The right side is a member or swizzle
+                    RenameExpression(std::dynamic_pointer_cast<AccessNode>(node)->left);
+                    break;
+                case NodeType::Scope:
+                    RenameScope(std::dynamic_pointer_cast<ScopeNode>(node));
+                    break;
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(node);
+                        RenameExpression(asIf->condition);
+                        RenameScope(asIf->scope);
+                        RenameExpression(asIf->elseNode);
+                    }
+                    break;
+                case NodeType::For:
+                    {
+                        auto asFor = std::dynamic_pointer_cast<ForNode>(node);
+                        _scopes.emplace_back();
+                        RenameExpression(asFor->init);
+                        RenameExpression(asFor->condition);
+                        RenameExpression(asFor->update);
+                        RenameScope(asFor->scope);
+                        _scopes.pop_back();
+                    }
+                    break;
+                default:
+                    for (auto& child : node->GetChildren())
+                    {
+                        RenameExpression(child);
+                    }
+                    break;
+                }
+            }
+
+            void RenameScope(const std::shared_ptr<ScopeNode>& scope)
+            {
+                if (!scope) return;
+
+                _scopes.emplace_back();
+                for (auto& statement : scope->statements)
+                {
+                    RenameExpression(statement);
+                }
+                _scopes.pop_back();
+            }
+
+            static bool IsGlobalVariable(const std::shared_ptr<Node>& statement)
+            {
+                switch (statement->nodeType)
+                {
+                case NodeType::Const:
+                    return true;
+                case NodeType::Declaration:
+                    return std::dynamic_pointer_cast<DeclarationNode>(statement)->declarationType !=
+                        EDeclarationType::Block;
+                case NodeType::Assign:
+                    return IsGlobalVariable(std::dynamic_pointer_cast<AssignNode>(statement)->target);
+                default:
+                    return false;
+                }
+            }
+
+        public:
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                Collect(module);
+
+                for (auto& statement : module->statements)
+                {
+                    if (statement->nodeType != NodeType::Function) continue;
+
+                    auto& name = std::dynamic_pointer_cast<FunctionNode>(statement)->name;
+                    if (name == "main" || _kept.contains(name) || _functions.contains(name)) continue;
+                    _functions.emplace(name, NextName());
+                }
+
+                // Globals are declared as they are reached so a function only sees the ones declared before it
+                _scopes.emplace_back();
+                const auto globalsStart = _nextIndex;
+                size_t globalCount = 0;
+                for (auto& statement : module->statements)
+                {
+                    if (IsGlobalVariable(statement)) globalCount++;
+                }
+
+                auto nextGlobal = globalsStart;
+                const auto firstLocal = globalsStart + globalCount;
+                for (auto& statement : module->statements)
+                {
+                    if (IsGlobalVariable(statement))
+                    {
+                        _nextIndex = nextGlobal;
+                        RenameExpression(statement);
+                        nextGlobal = _nextIndex;
+                        continue;
+                    }
+
+                    if (statement->nodeType != NodeType::Function) continue;
+
+                    auto asFunction = std::dynamic_pointer_cast<FunctionNode>(statement);
+                    if (auto found = _functions.find(asFunction->name); found != _functions.end())
+                    {
+                        asFunction->name = found->second;
+                    }
+
+                    // Locals of different functions never meet, so every function starts from the same name
+                    _nextIndex = std::max(firstLocal, nextGlobal);
+                    _scopes.emplace_back();
+                    for (auto& argument : asFunction->arguments)
+                    {
+                        Declare(argument->declaration);
+                    }
+                    RenameScope(asFunction->scope);
+                    _scopes.pop_back();
+                }
+            }
+        };
+
+        // Binding strength of the operator at the root of node as GLSL parses it. Higher binds tighter. A define
+        // expands to arbitrary text so a reference to one is treated as binding loosest.
+        int precedenceOf(const std::shared_ptr<Node>& node, const std::unordered_set<std::string>& defines)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::Identifier:
+                return defines.contains(std::dynamic_pointer_cast<IdentifierNode>(node)->id) ? 0 : 17;
+            case NodeType::Assign:
+                return 1;
+            case NodeType::Conditional:
+                return 2;
+            case NodeType::BinaryOp:
+                switch (std::dynamic_pointer_cast<BinaryOpNode>(node)->op)
+                {
+                case EBinaryOp::Or:
+                    return 3;
+                case EBinaryOp::And:
+                    return 5;
+                case EBinaryOp::Equal:
+                case EBinaryOp::NotEqual:
+                    return 9;
+                case EBinaryOp::Less:
+                case EBinaryOp::LessEqual:
+                case EBinaryOp::Greater:
+                case EBinaryOp::GreaterEqual:
+                    return 10;
+                case EBinaryOp::Add:
+                case EBinaryOp::Subtract:
+                    return 12;
+                case EBinaryOp::Multiply:
+                case EBinaryOp::Divide:
+                case EBinaryOp::Mod:
+                    return 13;
+                case EBinaryOp::Not:
+                    return 15;
+                }
+                return 0;
+            case NodeType::Negate:
+                return 15;
+            case NodeType::Increment:
+                return std::dynamic_pointer_cast<IncrementNode>(node)->isPrefix ? 15 : 16;
+            case NodeType::Decrement:
+                return std::dynamic_pointer_cast<DecrementNode>(node)->isPrefix ? 15 : 16;
+            case NodeType::Call:
+            case NodeType::Access:
+            case NodeType::Index:
+                return 16;
+            default:
+                return 17;
+            }
+        }
+
+        constexpr int UNARY_OPERAND = 15;
+        constexpr int POSTFIX_OPERAND = 16;
+
+        // Whether node is written starting with a minus, which would read as a decrement right after a unary minus
+        bool startsWithMinus(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::Negate:
+                return true;
+            case NodeType::Decrement:
+                return std::dynamic_pointer_cast<DecrementNode>(node)->isPrefix;
+            case NodeType::FloatLiteral:
+                return std::signbit(std::dynamic_pointer_cast<FloatLiteralNode>(node)->data);
+            case NodeType::IntLiteral:
+                return std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data < 0;
+            default:
+                return false;
+            }
+        }
+
+        // Drops parentheses around node while its contents bind at least as tightly as minPrecedence requires,
+        // then does the same for its operands
+        std::shared_ptr<Node> removeParentheses(std::shared_ptr<Node> node, int minPrecedence,
+                                                const std::unordered_set<std::string>& defines)
+        {
+            if (!node) return node;
+
+            while (node->nodeType == NodeType::Precedence)
+            {
+                auto target = std::dynamic_pointer_cast<PrecedenceNode>(node)->target;
+                if (!target || precedenceOf(target, defines) < minPrecedence) break;
+                node = target;
+            }
+
+            switch (node->nodeType)
+            {
+            case NodeType::Define:
+                return node;
+            case NodeType::BinaryOp:
+                {
+                    // Every binary operator is left associative
+                    auto asBinaryOp = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                    const auto precedence = precedenceOf(node, defines);
+                    asBinaryOp->left = removeParentheses(asBinaryOp->left, precedence, defines);
+                    asBinaryOp->right = removeParentheses(asBinaryOp->right, precedence + 1, defines);
+                }
+                break;
+            case NodeType::Assign:
+                {
+                    auto asAssign = std::dynamic_pointer_cast<AssignNode>(node);
+                    asAssign->target = removeParentheses(asAssign->target, UNARY_OPERAND, defines);
+                    asAssign->value = removeParentheses(asAssign->value, 0, defines);
+                }
+                break;
+            case NodeType::Conditional:
+                {
+                    auto asConditional = std::dynamic_pointer_cast<ConditionalNode>(node);
+                    asConditional->condition = removeParentheses(asConditional->condition, 3, defines);
+                    asConditional->left = removeParentheses(asConditional->left, 0, defines);
+                    asConditional->right = removeParentheses(asConditional->right, 2, defines);
+                }
+                break;
+            case NodeType::Negate:
+                {
+                    auto asNegate = std::dynamic_pointer_cast<NegateNode>(node);
+                    asNegate->target = removeParentheses(asNegate->target, UNARY_OPERAND, defines);
+                    if (asNegate->target && startsWithMinus(asNegate->target))
+                    {
+                        asNegate->target = std::make_shared<PrecedenceNode>(asNegate->target);
+                    }
+                }
+                break;
+            case NodeType::Increment:
+                {
+                    auto asIncrement = std::dynamic_pointer_cast<IncrementNode>(node);
+                    asIncrement->target = removeParentheses(asIncrement->target,
+                                                            asIncrement->isPrefix ? UNARY_OPERAND : POSTFIX_OPERAND,
+                                                            defines);
+                }
+                break;
+            case NodeType::Decrement:
+                {
+                    auto asDecrement = std::dynamic_pointer_cast<DecrementNode>(node);
+                    asDecrement->target = removeParentheses(asDecrement->target,
+                                                            asDecrement->isPrefix ? UNARY_OPERAND : POSTFIX_OPERAND,
+                                                            defines);
+                }
+                break;
+            case NodeType::Access:
+                {
+                    auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                    asAccess->left = removeParentheses(asAccess->left, POSTFIX_OPERAND, defines);
+                }
+                break;
+            case NodeType::Index:
+                {
+                    auto asIndex = std::dynamic_pointer_cast<IndexNode>(node);
+                    asIndex->left = removeParentheses(asIndex->left, POSTFIX_OPERAND, defines);
+                    asIndex->indexExpression = removeParentheses(asIndex->indexExpression, 0, defines);
+                }
+                break;
+            default:
+                // Statements, arguments, array elements and parenthesized expressions accept anything
+                transformChildren(node, [&defines](const std::shared_ptr<Node>& child)
+                {
+                    return removeParentheses(child, 0, defines);
+                });
+                break;
+            }
+
+            return node;
+        }
+
+        using Declarations = std::vector<std::shared_ptr<DeclarationNode>>;
+
+        uint32_t roundUp(uint32_t value, uint32_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // Places members one at a time, taking the most aligned member that needs no padding at the current offset
+        // so smaller members fill the gaps left by larger ones
+        std::vector<size_t> gapFillingOrder(const std::vector<MemberLayout>& members)
+        {
+            std::vector<size_t> remaining(members.size());
+            for (size_t i = 0; i < remaining.size(); i++) remaining[i] = i;
+
+            std::vector<size_t> order{};
+            uint32_t offset = 0;
+            while (!remaining.empty())
+            {
+                auto best = remaining.end();
+                auto bestFits = false;
+                for (auto it = remaining.begin(); it != remaining.end(); ++it)
+                {
+                    const auto& member = members[*it];
+                    const auto fits = roundUp(offset, member.alignment) == offset;
+                    if (best == remaining.end() || (fits && !bestFits) || (fits == bestFits &&
+                        std::pair(member.alignment, member.size) > std::pair(members[*best].alignment,
+                                                                             members[*best].size)))
+                    {
+                        best = it;
+                        bestFits = fits;
+                    }
+                }
+
+                offset = roundUp(offset, members[*best].alignment) + members[*best].size;
+                order.push_back(*best);
+                remaining.erase(best);
+            }
+            return order;
+        }
+
+        // Order of declarations with the smallest total size under rules. The original order wins ties, and an
+        // unsized array stays last.
+        std::vector<size_t> smallestOrder(const std::string& name, const Declarations& declarations,
+                                          const std::vector<ELayoutRule>& rules, const StructLookup& structs)
+        {
+            const auto hasUnsized = !declarations.empty() && declarations.back()->declarationCount == -1;
+            const auto count = declarations.size() - (hasUnsized ? 1 : 0);
+
+            std::vector<size_t> identity(count);
+            for (size_t i = 0; i < count; i++) identity[i] = i;
+
+            std::vector<std::vector<size_t>> candidates{identity};
+            for (auto rule : rules)
+            {
+                std::vector<MemberLayout> members{};
+                for (size_t i = 0; i < count; i++)
+                {
+                    members.push_back(layoutOf(*declarations[i], rule, structs));
+                }
+
+                auto byAlignment = identity;
+                std::stable_sort(byAlignment.begin(), byAlignment.end(), [&members](size_t a, size_t b)
+                {
+                    return members[a].alignment > members[b].alignment;
+                });
+                candidates.push_back(byAlignment);
+                candidates.push_back(gapFillingOrder(members));
+            }
+
+            std::vector<size_t> best{};
+            uint64_t bestSize = 0;
+            for (auto& candidate : candidates)
+            {
+                if (hasUnsized) candidate.push_back(count);
+
+                Declarations ordered{};
+                for (auto index : candidate) ordered.push_back(declarations[index]);
+
+                uint64_t size = 0;
+                for (auto rule : rules)
+                {
+                    size += layoutOf(name, ordered, rule, structs).size;
+                }
+
+                if (best.empty() || size < bestSize)
+                {
+                    best = candidate;
+                    bestSize = size;
+                }
+            }
+            return best;
+        }
+
+        // Reorders declarations and returns whether anything moved
+        bool applyOrder(Declarations& declarations, const std::vector<size_t>& order)
+        {
+            Declarations ordered{};
+            auto moved = false;
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                ordered.push_back(declarations[order[i]]);
+                moved = moved || order[i] != i;
+            }
+            declarations = ordered;
+            return moved;
+        }
+
+        // A uniform block, storage buffer or push constant whose layout the host has to follow
+        struct HostBlock
+        {
+            std::string name{};
+            Declarations* declarations = nullptr;
+            ELayoutRule rule = ELayoutRule::Std140;
+        };
+
+        std::vector<HostBlock> collectHostBlocks(const std::shared_ptr<ModuleNode>& module)
+        {
+            std::vector<HostBlock> result{};
+            for (auto& statement : module->statements)
+            {
+                if (auto asPushConstant = std::dynamic_pointer_cast<PushConstantNode>(statement))
+                {
+                    result.push_back({
+                        "push", &asPushConstant->declarations, layoutRuleOf(asPushConstant->tags, ELayoutRule::Std430)
+                    });
+                }
+                else if (auto asLayout = std::dynamic_pointer_cast<LayoutNode>(statement))
+                {
+                    const auto isReadonly = asLayout->layoutType == ELayoutType::Readonly;
+                    if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(asLayout->declaration))
+                    {
+                        result.push_back({
+                            asBlock->declarationName, &asBlock->declarations,
+                            layoutRuleOf(asLayout->tags, isReadonly ? ELayoutRule::Std430 : ELayoutRule::Std140)
+                        });
+                    }
+                    else if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(asLayout->declaration))
+                    {
+                        result.push_back({
+                            asBuffer->declarationName, &asBuffer->declarations,
+                            layoutRuleOf(asLayout->tags, ELayoutRule::Std430)
+                        });
+                    }
+                }
+            }
+            return result;
+        }
+
+        // Types that can be written as literals, which are also the constructors that can be folded
+        const std::unordered_set<std::string> LITERAL_TYPES = {
+            "float", "int", "bool", "float2", "float3", "float4", "int2", "int3", "int4", "mat3", "mat4"
+        };
+
+        // Builtins without side effects that the interpreter evaluates the same way the GPU does
+        const std::unordered_set<std::string> FOLDABLE_BUILTINS = {
+            "abs", "sign", "floor", "ceil", "fract", "trunc", "round", "sqrt", "inversesqrt", "exp", "exp2", "log",
+            "log2", "sin", "cos", "tan", "asin", "acos", "atan", "radians", "degrees", "pow", "mod", "step", "min",
+            "max", "clamp", "mix", "smoothstep", "dot", "length", "distance", "normalize", "cross", "reflect",
+            "refract", "faceforward", "transpose", "determinant", "inverse"
+        };
+
+        bool isLiteral(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::FloatLiteral:
+            case NodeType::IntLiteral:
+            case NodeType::BooleanLiteral:
+                return true;
+            case NodeType::Negate:
+                {
+                    auto target = std::dynamic_pointer_cast<NegateNode>(node)->target;
+                    return target->nodeType == NodeType::FloatLiteral || target->nodeType == NodeType::IntLiteral;
+                }
+            default:
+                return false;
+            }
+        }
+
+        // Literals and constructors of literals, the forms folded values are written back as
+        bool isConstant(const std::shared_ptr<Node>& node)
+        {
+            if (isLiteral(node)) return true;
+            if (node->nodeType != NodeType::Call) return false;
+
+            auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+            return LITERAL_TYPES.contains(asCall->identifier->id) && std::ranges::all_of(asCall->args, isConstant);
+        }
+
+        std::shared_ptr<Node> makeScalar(char base, uint32_t word)
+        {
+            std::shared_ptr<Node> magnitude{};
+            auto negative = false;
+            switch (base)
+            {
+            case 'b':
+                return std::make_shared<BooleanLiteralNode>(word != 0);
+            case 'i':
+                {
+                    const auto value = std::bit_cast<int32_t>(word);
+                    if (value == INT_MIN) return {};
+                    magnitude = std::make_shared<IntegerLiteralNode>(value < 0 ? -value : value);
+                    negative = value < 0;
+                }
+                break;
+            default:
+                {
+                    const auto value = std::bit_cast<float>(word);
+                    if (!std::isfinite(value)) return {};
+                    magnitude = std::make_shared<FloatLiteralNode>(std::fabs(value));
+                    negative = std::signbit(value);
+                }
+                break;
+            }
+            return negative ? std::make_shared<NegateNode>(magnitude) : magnitude;
+        }
+
+        // Writes value back as a literal of typeName, or returns null when it cannot be written as one
+        std::shared_ptr<Node> makeLiteral(const std::string& typeName, const interp::Value& value)
+        {
+            if (!LITERAL_TYPES.contains(typeName) || value.words.empty()) return {};
+
+            const auto base = typeName[0] == 'm' ? 'f' : typeName[0];
+            if (value.words.size() == 1) return makeScalar(base, value.words[0]);
+
+            // Constructors taking a single scalar fill vectors with it and matrices along the diagonal
+            std::optional<uint32_t> fill{};
+            if (typeName[0] == 'm')
+            {
+                const auto size = typeName[3] - '0';
+                fill = value.words[0];
+                for (size_t i = 0; i < value.words.size() && fill; i++)
+                {
+                    const auto onDiagonal = static_cast<int>(i) % size == static_cast<int>(i) / size;
+                    // 0.0 and -0.0 are both zero off the diagonal
+                    if (onDiagonal ? value.words[i] != *fill : (value.words[i] & 0x7fffffff) != 0) fill.reset();
+                }
+            }
+            else if (std::ranges::all_of(value.words, [&value](uint32_t word) { return word == value.words[0]; }))
+            {
+                fill = value.words[0];
+            }
+
+            std::vector<std::shared_ptr<Node>> args{};
+            for (auto word : fill ? std::vector{*fill} : value.words)
+            {
+                auto arg = makeScalar(base, word);
+                if (!arg) return {};
+                args.push_back(arg);
+            }
+            return std::make_shared<CallNode>(std::make_shared<IdentifierNode>(typeName), args);
+        }
+
+        class ConstantFolder
+        {
+            interp::Program _program{std::make_shared<ModuleNode>(std::vector<std::shared_ptr<Node>>{})};
+            // Constant value of each name in scope, null for names that are not constant or hide a constant
+            std::vector<std::unordered_map<std::string, std::shared_ptr<Node>>> _scopes{};
+            // Defines are substituted textually so they win over any declaration
+            std::unordered_map<std::string, std::shared_ptr<Node>> _defines{};
+
+        public:
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                _scopes.emplace_back();
+                for (auto& statement : module->statements)
+                {
+                    if (auto asDefine = std::dynamic_pointer_cast<DefineNode>(statement))
+                    {
+                        asDefine->expression = Fold(asDefine->expression);
+                        _defines.insert_or_assign(asDefine->id,
+                                                  isConstant(asDefine->expression) ? asDefine->expression : nullptr);
+                        continue;
+                    }
+                    statement = Fold(statement);
+                }
+                _scopes.pop_back();
+            }
+
+        private:
+            std::shared_ptr<Node> Lookup(const std::string& id) const
+            {
+                if (auto found = _defines.find(id); found != _defines.end()) return found->second;
+                for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it)
+                {
+                    if (auto found = it->find(id); found != it->end()) return found->second;
+                }
+                return {};
+            }
+
+            void Hide(const std::string& name)
+            {
+                _scopes.back().insert_or_assign(name, nullptr);
+            }
+
+            // Records a const declaration, converting its value to the declared type so every use keeps that type
+            void Declare(const std::shared_ptr<DeclarationNode>& declaration, const std::shared_ptr<Node>& value)
+            {
+                Hide(declaration->declarationName);
+                const auto typeName = declaration->GetTypeName();
+                if (declaration->declarationCount != 1 || !isConstant(value) || typeName.starts_with("mat") ||
+                    !LITERAL_TYPES.contains(typeName))
+                {
+                    return;
+                }
+
+                if (auto converted = Evaluate(std::make_shared<CallNode>(std::make_shared<IdentifierNode>(typeName),
+                                                                         std::vector{value})))
+                {
+                    _scopes.back().insert_or_assign(declaration->declarationName, converted);
+                }
+            }
+
+            std::shared_ptr<Node> Evaluate(const std::shared_ptr<Node>& node)
+            {
+                try
+                {
+                    std::string typeName{};
+                    auto value = _program.Evaluate(node, typeName);
+                    return makeLiteral(typeName, value);
+                }
+                catch (const std::exception&)
+                {
+                    // Left for the GPU compiler to report or evaluate
+                    return {};
+                }
+            }
+
+            [[nodiscard]] bool CanEvaluate(const std::shared_ptr<Node>& node)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::BinaryOp:
+                    {
+                        auto asBinaryOp = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                        if (asBinaryOp->op == EBinaryOp::Not || !isConstant(asBinaryOp->left) ||
+                            !isConstant(asBinaryOp->right))
+                        {
+                            return false;
+                        }
+
+                        // Integer division by zero is undefined, so it is left as written
+                        if (asBinaryOp->op != EBinaryOp::Divide && asBinaryOp->op != EBinaryOp::Mod) return true;
+                        std::string typeName{};
+                        auto divisor = _program.Evaluate(asBinaryOp->right, typeName);
+                        return typeName.starts_with("float") || typeName.starts_with("mat") ||
+                            std::ranges::none_of(divisor.words, [](uint32_t word) { return word == 0; });
+                    }
+                case NodeType::Negate:
+                    return !isLiteral(node) && isConstant(std::dynamic_pointer_cast<NegateNode>(node)->target);
+                case NodeType::Call:
+                    {
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        return (LITERAL_TYPES.contains(asCall->identifier->id) ||
+                                FOLDABLE_BUILTINS.contains(asCall->identifier->id)) &&
+                            std::ranges::all_of(asCall->args, isConstant);
+                    }
+                case NodeType::Access:
+                    {
+                        auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                        return isConstant(asAccess->left) && asAccess->right->nodeType == NodeType::Identifier;
+                    }
+                default:
+                    return false;
+                }
+            }
+
+            std::shared_ptr<Node> TryEvaluate(const std::shared_ptr<Node>& node)
+            {
+                if (!CanEvaluate(node)) return node;
+                auto result = Evaluate(node);
+                return result ? result : node;
+            }
+
+            void FoldScope(const std::shared_ptr<ScopeNode>& scope)
+            {
+                _scopes.emplace_back();
+                FoldStatements(scope->statements);
+                _scopes.pop_back();
+            }
+
+            void FoldStatements(std::vector<std::shared_ptr<Node>>& statements)
+            {
+                std::vector<std::shared_ptr<Node>> result{};
+                for (auto& statement : statements)
+                {
+                    auto folded = Fold(statement);
+                    if (!folded) continue;
+
+                    // Nested scopes that declare nothing, usually left by a folded if, are merged into this one
+                    if (auto asScope = std::dynamic_pointer_cast<ScopeNode>(folded); asScope &&
+                        std::ranges::none_of(asScope->statements, [](const std::shared_ptr<Node>& child)
+                        {
+                            auto target = child->nodeType == NodeType::Assign
+                                              ? std::dynamic_pointer_cast<AssignNode>(child)->target
+                                              : child;
+                            return std::dynamic_pointer_cast<DeclarationNode>(target) ||
+                                target->nodeType == NodeType::Const;
+                        }))
+                    {
+                        result.insert(result.end(), asScope->statements.begin(), asScope->statements.end());
+                        continue;
+                    }
+                    result.push_back(folded);
+                }
+                statements = result;
+            }
+
+            // Returns the folded node, or null for statements that were removed
+            std::shared_ptr<Node> Fold(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return node;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Struct:
+                case NodeType::Include:
+                case NodeType::PushConstant:
+                case NodeType::Define:
+                    return node;
+                case NodeType::Layout:
+                    Hide(std::dynamic_pointer_cast<LayoutNode>(node)->declaration->declarationName);
+                    return node;
+                case NodeType::Declaration:
+                    Hide(std::dynamic_pointer_cast<DeclarationNode>(node)->declarationName);
+                    return node;
+                case NodeType::Const:
+                    Hide(std::dynamic_pointer_cast<ConstNode>(node)->declaration->declarationName);
+                    return node;
+                case NodeType::Scope:
+                    FoldScope(std::dynamic_pointer_cast<ScopeNode>(node));
+                    return node;
+                case NodeType::NamedScope:
+                    FoldScope(std::dynamic_pointer_cast<NamedScopeNode>(node)->scope);
+                    return node;
+                case NodeType::Function:
+                    {
+                        auto asFunction = std::dynamic_pointer_cast<FunctionNode>(node);
+                        Hide(asFunction->name);
+                        _scopes.emplace_back();
+                        for (auto& argument : asFunction->arguments)
+                        {
+                            Hide(argument->declaration->declarationName);
+                        }
+                        FoldStatements(asFunction->scope->statements);
+                        _scopes.pop_back();
+                        return node;
+                    }
+                case NodeType::For:
+                    {
+                        auto asFor = std::dynamic_pointer_cast<ForNode>(node);
+                        _scopes.emplace_back();
+                        asFor->init = Fold(asFor->init);
+                        asFor->condition = Fold(asFor->condition);
+                        asFor->update = Fold(asFor->update);
+                        FoldScope(asFor->scope);
+                        _scopes.pop_back();
+                        return node;
+                    }
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(node);
+                        asIf->condition = Fold(asIf->condition);
+                        if (asIf->condition->nodeType == NodeType::BooleanLiteral)
+                        {
+                            if (std::dynamic_pointer_cast<BooleanLiteralNode>(asIf->condition)->data)
+                            {
+                                FoldScope(asIf->scope);
+                                return asIf->scope;
+                            }
+                            return Fold(asIf->elseNode);
+                        }
+
+                        FoldScope(asIf->scope);
+                        asIf->elseNode = Fold(asIf->elseNode);
+                        return node;
+                    }
+                case NodeType::Conditional:
+                    {
+                        auto asConditional = std::dynamic_pointer_cast<ConditionalNode>(node);
+                        asConditional->condition = Fold(asConditional->condition);
+                        if (asConditional->condition->nodeType == NodeType::BooleanLiteral)
+                        {
+                            return Fold(std::dynamic_pointer_cast<BooleanLiteralNode>(asConditional->condition)->data
+                                            ? asConditional->left
+                                            : asConditional->right);
+                        }
+                        asConditional->left = Fold(asConditional->left);
+                        asConditional->right = Fold(asConditional->right);
+                        return node;
+                    }
+                case NodeType::Assign:
+                    {
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(node);
+                        asAssign->value = Fold(asAssign->value);
+                        if (auto asConst = std::dynamic_pointer_cast<ConstNode>(asAssign->target))
+                        {
+                            Declare(asConst->declaration, asAssign->value);
+                        }
+                        else
+                        {
+                            asAssign->target = Fold(asAssign->target);
+                        }
+                        return node;
+                    }
+                case NodeType::Identifier:
+                    {
+                        auto value = Lookup(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                        return value ? cloneNode(value) : node;
+                    }
+                case NodeType::Call:
+                    {
+                        // The callee is a name rather than a value, so only the arguments are folded
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        for (auto& arg : asCall->args)
+                        {
+                            arg = Fold(arg);
+                        }
+                        return TryEvaluate(node);
+                    }
+                case NodeType::Access:
+                    {
+                        // Members and swizzles on the right are names rather than values
+                        auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                        asAccess->left = Fold(asAccess->left);
+                        auto result = TryEvaluate(node);
+                        if (result == node && asAccess->left->nodeType == NodeType::Negate)
+                        {
+                            asAccess->left = std::make_shared<PrecedenceNode>(asAccess->left);
+                        }
+                        return result;
+                    }
+                case NodeType::Precedence:
+                    {
+                        auto asPrecedence = std::dynamic_pointer_cast<PrecedenceNode>(node);
+                        asPrecedence->target = Fold(asPrecedence->target);
+                        // Negated literals keep their parentheses, the operator outside may bind tighter
+                        if (isConstant(asPrecedence->target) && asPrecedence->target->nodeType != NodeType::Negate)
+                        {
+                            return asPrecedence->target;
+                        }
+                        return node;
+                    }
+                default:
+                    transformChildren(node, [this](const std::shared_ptr<Node>& child) { return Fold(child); });
+                    return TryEvaluate(node);
+                }
+            }
+        };
+
+        bool hasMain(const std::shared_ptr<ModuleNode>& module)
+        {
+            return std::ranges::any_of(module->statements, [](const std::shared_ptr<Node>& statement)
+            {
+                return statement->nodeType == NodeType::Function &&
+                    std::dynamic_pointer_cast<FunctionNode>(statement)->name == "main";
+            });
+        }
+
+        // Name other statements use to refer to a top level statement, or nullopt for statements that are always kept.
+        // Inputs and outputs are kept since they form the interface with the other stage and the pipeline.
+        std::optional<std::string> referenceNameOf(const std::shared_ptr<Node>& statement)
+        {
+            switch (statement->nodeType)
+            {
+            case NodeType::Function:
+                return std::dynamic_pointer_cast<FunctionNode>(statement)->name;
+            case NodeType::Struct:
+                return std::dynamic_pointer_cast<StructNode>(statement)->name;
+            case NodeType::Const:
+                return std::dynamic_pointer_cast<ConstNode>(statement)->declaration->declarationName;
+            case NodeType::Declaration:
+                return std::dynamic_pointer_cast<DeclarationNode>(statement)->declarationName;
+            case NodeType::Assign:
+                // Initialized globals and consts
+                return referenceNameOf(std::dynamic_pointer_cast<AssignNode>(statement)->target);
+            case NodeType::Define:
+                return std::dynamic_pointer_cast<DefineNode>(statement)->id;
+            case NodeType::PushConstant:
+                return "push";
+            case NodeType::Layout:
+                {
+                    auto asLayout = std::dynamic_pointer_cast<LayoutNode>(statement);
+                    if (asLayout->layoutType == ELayoutType::Input || asLayout->layoutType == ELayoutType::Output)
+                    {
+                        return std::nullopt;
+                    }
+                    return asLayout->declaration->declarationName;
+                }
+            default:
+                return std::nullopt;
+            }
+        }
+
+        // Every name statement refers to. Locals that shadow a global keep it alive, which is only conservative.
+        void collectReferences(const std::shared_ptr<Node>& statement, std::vector<std::string>& names)
+        {
+            walk(statement, [&names](const std::shared_ptr<Node>& node)
+            {
+                if (!node) return false;
+
+                if (node->nodeType == NodeType::Identifier)
+                {
+                    names.push_back(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                }
+                else if (node->nodeType == NodeType::Declaration)
+                {
+                    names.push_back(std::dynamic_pointer_cast<DeclarationNode>(node)->GetTypeName());
+                }
+                return true;
+            });
+        }
+
+        // Name of the variable statement assigns as a whole, or nullptr when it is not such an assignment
+        const std::string* storedName(const std::shared_ptr<Node>& statement)
+        {
+            if (statement->nodeType != NodeType::Assign) return nullptr;
+            auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+            if (asAssign->target->nodeType != NodeType::Identifier) return nullptr;
+            return &std::dynamic_pointer_cast<IdentifierNode>(asAssign->target)->id;
+        }
+
+        // Counts every identifier that is read. The target of a store is not a read, anything else naming a variable
+        // is, including partial stores and out arguments.
+        void countReads(const std::shared_ptr<Node>& node, std::unordered_map<std::string, int>& reads)
+        {
+            if (!node) return;
+
+            if (storedName(node))
+            {
+                countReads(std::dynamic_pointer_cast<AssignNode>(node)->value, reads);
+                return;
+            }
+            if (node->nodeType == NodeType::Identifier)
+            {
+                reads[std::dynamic_pointer_cast<IdentifierNode>(node)->id]++;
+                return;
+            }
+            for (auto& child : node->GetChildren()) countReads(child, reads);
+        }
+
+        // Calls to functions of the module may write out arguments and globals, builtins and constructors do not
+        bool isPure(const std::shared_ptr<Node>& expression, const std::unordered_set<std::string>& functions)
+        {
+            auto pure = true;
+            walk(expression, [&](const std::shared_ptr<Node>& node)
+            {
+                if (!node || !pure) return false;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Assign:
+                case NodeType::Increment:
+                case NodeType::Decrement:
+                    pure = false;
+                    break;
+                case NodeType::Call:
+                    pure = !functions.contains(std::dynamic_pointer_cast<CallNode>(node)->identifier->id);
+                    break;
+                default:
+                    break;
+                }
+                return pure;
+            });
+            return pure;
+        }
+
+        // Every scope nested in nodes, collected first so they can be edited afterwards
+        std::vector<std::shared_ptr<ScopeNode>> nestedScopes(const std::vector<std::shared_ptr<Node>>& nodes)
+        {
+            std::vector<std::shared_ptr<ScopeNode>> scopes{};
+            for (auto& node : nodes)
+            {
+                walk(node, [&scopes](const std::shared_ptr<Node>& child)
+                {
+                    if (!child) return false;
+                    if (child->nodeType == NodeType::Scope) scopes.push_back(std::dynamic_pointer_cast<ScopeNode>(child));
+                    return true;
+                });
+            }
+            return scopes;
+        }
+
+        class DeadStoreRemover
+        {
+            std::unordered_set<std::string> _functions{};
+            bool _changed = false;
+
+            // Whether the stores to name in nodes can be dropped without losing a side effect
+            [[nodiscard]] bool CanDropStores(const std::vector<std::shared_ptr<Node>>& nodes,
+                                             const std::string& name) const
+            {
+                auto pure = true;
+                for (auto& node : nodes)
+                {
+                    walk(node, [&](const std::shared_ptr<Node>& child)
+                    {
+                        if (!child || !pure) return false;
+                        if (auto stored = storedName(child); stored && *stored == name)
+                        {
+                            pure = isPure(std::dynamic_pointer_cast<AssignNode>(child)->value, _functions);
+                        }
+                        return pure;
+                    });
+                }
+                return pure;
+            }
+
+            void DropStores(std::vector<std::shared_ptr<Node>>& statements, size_t first, const std::string& name)
+            {
+                auto isDeadStore = [&name](const std::shared_ptr<Node>& statement)
+                {
+                    auto stored = storedName(statement);
+                    return stored && *stored == name;
+                };
+
+                const std::vector region(statements.begin() + static_cast<std::ptrdiff_t>(first), statements.end());
+                for (auto& scope : nestedScopes(region)) std::erase_if(scope->statements, isDeadStore);
+
+                const auto end = std::remove_if(statements.begin() + static_cast<std::ptrdiff_t>(first),
+                                                statements.end(), isDeadStore);
+                statements.erase(end, statements.end());
+                _changed = true;
+            }
+
+            // Removes the locals of scope that are never read along with every store to them
+            void RemoveLocals(const std::shared_ptr<ScopeNode>& scope)
+            {
+                auto& statements = scope->statements;
+                for (size_t i = 0; i < statements.size(); i++)
+                {
+                    std::shared_ptr<DeclarationNode> declaration{};
+                    std::shared_ptr<Node> initializer{};
+                    if (auto asAssign = std::dynamic_pointer_cast<AssignNode>(statements[i]))
+                    {
+                        declaration = std::dynamic_pointer_cast<DeclarationNode>(asAssign->target);
+                        initializer = asAssign->value;
+                    }
+                    else
+                    {
+                        declaration = std::dynamic_pointer_cast<DeclarationNode>(statements[i]);
+                    }
+                    if (!declaration || (initializer && !isPure(initializer, _functions))) continue;
+
+                    const auto name = declaration->declarationName;
+                    const std::vector rest(statements.begin() + static_cast<std::ptrdiff_t>(i) + 1, statements.end());
+                    std::unordered_map<std::string, int> reads{};
+                    for (auto& statement : rest) countReads(statement, reads);
+                    if (reads.contains(name) || !CanDropStores(rest, name)) continue;
+
+                    // Stores to a shadowing local of the same name are dropped too, it is never read either
+                    DropStores(statements, i + 1, name);
+                    statements.erase(statements.begin() + static_cast<std::ptrdiff_t>(i));
+                    i--;
+                }
+            }
+
+        public:
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                for (auto& statement : module->statements)
+                {
+                    if (statement->nodeType == NodeType::Function)
+                    {
+                        _functions.insert(std::dynamic_pointer_cast<FunctionNode>(statement)->name);
+                    }
+                }
+
+                do
+                {
+                    _changed = false;
+
+                    // Private globals, which are left for removeUnusedDeclarations once nothing stores to them
+                    std::unordered_map<std::string, int> reads{};
+                    countReads(module, reads);
+                    for (auto& statement : module->statements)
+                    {
+                        auto declaration = std::dynamic_pointer_cast<DeclarationNode>(statement);
+                        if (auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement))
+                        {
+                            declaration = std::dynamic_pointer_cast<DeclarationNode>(asAssign->target);
+                        }
+                        if (!declaration || reads.contains(declaration->declarationName)) continue;
+
+                        const auto name = declaration->declarationName;
+                        std::vector<std::shared_ptr<Node>> functions{};
+                        std::ranges::copy_if(module->statements, std::back_inserter(functions),
+                                             [](const std::shared_ptr<Node>& node)
+                                             {
+                                                 return node->nodeType == NodeType::Function;
+                                             });
+                        if (!CanDropStores(functions, name)) continue;
+
+                        for (auto& scope : nestedScopes(functions))
+                        {
+                            const auto count = scope->statements.size();
+                            std::erase_if(scope->statements, [&name](const std::shared_ptr<Node>& node)
+                            {
+                                auto stored = storedName(node);
+                                return stored && *stored == name;
+                            });
+                            _changed |= scope->statements.size() != count;
+                        }
+                    }
+
+                    for (auto& scope : nestedScopes(module->statements)) RemoveLocals(scope);
+                }
+                while (_changed);
+            }
+        };
+
+        const std::string* tagOf(const std::shared_ptr<LayoutNode>& layout, const std::string& tag)
+        {
+            auto found = layout->tags.find(tag);
+            return found == layout->tags.end() ? nullptr : &found->second;
+        }
+
+        std::vector<std::shared_ptr<LayoutNode>> layoutsOf(const std::shared_ptr<ModuleNode>& module, ELayoutType type)
+        {
+            std::vector<std::shared_ptr<LayoutNode>> result{};
+            for (auto& statement : module->statements)
+            {
+                if (auto asLayout = std::dynamic_pointer_cast<LayoutNode>(statement); asLayout && asLayout->layoutType ==
+                    type)
+                {
+                    result.push_back(asLayout);
+                }
+            }
+            return result;
+        }
+
+        // Fragment input receiving output. Interfaces are matched by location, or by name for varyings declared
+        // without one.
+        std::shared_ptr<LayoutNode> matchingInput(const std::vector<std::shared_ptr<LayoutNode>>& inputs,
+                                                  const std::shared_ptr<LayoutNode>& output)
+        {
+            const auto location = tagOf(output, "location");
+            for (auto& input : inputs)
+            {
+                const auto inputLocation = tagOf(input, "location");
+                if (location && inputLocation ? *location == *inputLocation
+                        : output->declaration->declarationName == input->declaration->declarationName)
+                {
+                    return input;
+                }
+            }
+            return {};
+        }
+
+        struct Varying
+        {
+            std::shared_ptr<LayoutNode> output{};
+            std::shared_ptr<LayoutNode> input{};
+            // Components of a single location, 0 for varyings that take whole locations
+            uint32_t components = 0;
+            uint32_t locations = 1;
+            bool isInt = false;
+            bool isFlat = false;
+        };
+
+        // Shape of a varying of declaration, or nullopt for types that cannot be one
+        std::optional<Varying> varyingOf(const DeclarationNode& declaration)
+        {
+            Varying result{};
+            switch (declaration.declarationType)
+            {
+            case EDeclarationType::Int:
+            case EDeclarationType::Int2:
+            case EDeclarationType::Int3:
+            case EDeclarationType::Int4:
+                result.isInt = true;
+                [[fallthrough]];
+            case EDeclarationType::Float:
+            case EDeclarationType::Float2:
+            case EDeclarationType::Float3:
+            case EDeclarationType::Float4:
+                result.components = static_cast<uint32_t>(declaration.GetSize()) / 4;
+                break;
+            case EDeclarationType::Mat3:
+                result.locations = 3;
+                break;
+            case EDeclarationType::Mat4:
+                result.locations = 4;
+                break;
+            default:
+                return std::nullopt;
+            }
+
+            // Every element of an array takes its own locations
+            if (declaration.declarationCount < 1) return std::nullopt;
+            if (declaration.declarationCount > 1)
+            {
+                result.locations *= static_cast<uint32_t>(declaration.declarationCount);
+                result.components = 0;
+            }
+            return result;
+        }
+
+        void placeVarying(const Varying& varying, uint32_t location, uint32_t component)
+        {
+            for (auto& layout : {varying.output, varying.input})
+            {
+                layout->tags.insert_or_assign("location", std::to_string(location));
+                if (component == 0) layout->tags.erase("component");
+                else layout->tags.insert_or_assign("component", std::to_string(component));
+                if (varying.isFlat) layout->tags.insert_or_assign("$flat", "");
+            }
+        }
+
+        // Removes the inputs of module that are never read
+        void removeUnreadInputs(const std::shared_ptr<ModuleNode>& module)
+        {
+            std::unordered_map<std::string, int> reads{};
+            countReads(module, reads);
+            std::erase_if(module->statements, [&reads](const std::shared_ptr<Node>& statement)
+            {
+                auto asLayout = std::dynamic_pointer_cast<LayoutNode>(statement);
+                return asLayout && asLayout->layoutType == ELayoutType::Input &&
+                    !reads.contains(asLayout->declaration->declarationName);
+            });
+        }
+
+        bool containsReturn(const std::shared_ptr<Node>& node)
+        {
+            auto found = false;
+            walk(node, [&found](const std::shared_ptr<Node>& child)
+            {
+                if (!child || found) return false;
+                found = child->nodeType == NodeType::Return;
+                return !found;
+            });
+            return found;
+        }
+
+        bool alwaysReturns(const std::vector<std::shared_ptr<Node>>& statements)
+        {
+            if (statements.empty()) return false;
+            if (statements.back()->nodeType == NodeType::Return) return true;
+            if (statements.back()->nodeType != NodeType::If) return false;
+
+            auto asIf = std::dynamic_pointer_cast<IfNode>(statements.back());
+            auto asElse = std::dynamic_pointer_cast<ScopeNode>(asIf->elseNode);
+            return asElse && alwaysReturns(asIf->scope->statements) && alwaysReturns(asElse->statements);
+        }
+
+        // Rewrites statements so nothing runs after a return, which lets every return become an assignment. The
+        // statements after an if are moved into the branch that does not return, and nested scopes are flattened, so
+        // locals must already have unique names. Fails for returns in loops and for statements that would have to be
+        // copied into both branches of an if.
+        bool lowerReturns(std::vector<std::shared_ptr<Node>>& statements)
+        {
+            for (size_t i = 0; i < statements.size(); i++)
+            {
+                auto statement = statements[i];
+                if (statement->nodeType == NodeType::Return)
+                {
+                    statements.resize(i + 1);
+                    return true;
+                }
+                if (!containsReturn(statement)) continue;
+
+                const std::vector rest(statements.begin() + static_cast<std::ptrdiff_t>(i) + 1, statements.end());
+                statements.resize(i);
+                switch (statement->nodeType)
+                {
+                case NodeType::Scope:
+                    {
+                        auto& inner = std::dynamic_pointer_cast<ScopeNode>(statement)->statements;
+                        statements.insert(statements.end(), inner.begin(), inner.end());
+                        statements.insert(statements.end(), rest.begin(), rest.end());
+                        i--;
+                    }
+                    break;
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(statement);
+                        auto thenStatements = asIf->scope->statements;
+                        std::vector<std::shared_ptr<Node>> elseStatements{};
+                        if (auto asElse = std::dynamic_pointer_cast<ScopeNode>(asIf->elseNode))
+                        {
+                            elseStatements = asElse->statements;
+                        }
+                        else if (asIf->elseNode)
+                        {
+                            elseStatements.push_back(asIf->elseNode);
+                        }
+                        if (!lowerReturns(thenStatements) || !lowerReturns(elseStatements)) return false;
+
+                        if (!rest.empty())
+                        {
+                            const auto thenReturns = alwaysReturns(thenStatements);
+                            if (!thenReturns && !alwaysReturns(elseStatements)) return false;
+
+                            auto& fallthrough = thenReturns ? elseStatements : thenStatements;
+                            fallthrough.insert(fallthrough.end(), rest.begin(), rest.end());
+                            if (!lowerReturns(fallthrough)) return false;
+                        }
+
+                        statements.push_back(std::make_shared<IfNode>(
+                            asIf->condition, std::make_shared<ScopeNode>(thenStatements),
+                            elseStatements.empty()
+                                ? std::shared_ptr<Node>{}
+                                : std::make_shared<ScopeNode>(elseStatements)));
+                        return true;
+                    }
+                default:
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Replaces the returns of lowered statements with stores to result, or drops them when result is empty
+        void replaceReturns(std::vector<std::shared_ptr<Node>>& statements, const std::string& result)
+        {
+            for (auto& statement : statements)
+            {
+                if (auto asReturn = std::dynamic_pointer_cast<ReturnNode>(statement))
+                {
+                    statement = result.empty() || !asReturn->expression
+                                    ? std::shared_ptr<Node>{}
+                                    : std::make_shared<AssignNode>(std::make_shared<IdentifierNode>(result),
+                                                                   asReturn->expression);
+                }
+                else if (auto asIf = std::dynamic_pointer_cast<IfNode>(statement))
+                {
+                    replaceReturns(asIf->scope->statements, result);
+                    if (auto asElse = std::dynamic_pointer_cast<ScopeNode>(asIf->elseNode))
+                    {
+                        replaceReturns(asElse->statements, result);
+                    }
+                }
+            }
+            std::erase(statements, nullptr);
+        }
+
+        // Variable an assignment target or out argument ultimately writes
+        std::shared_ptr<IdentifierNode> rootOf(std::shared_ptr<Node> node)
+        {
+            while (node)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::Identifier:
+                    return std::dynamic_pointer_cast<IdentifierNode>(node);
+                case NodeType::Access:
+                    node = std::dynamic_pointer_cast<AccessNode>(node)->left;
+                    break;
+                case NodeType::Index:
+                    node = std::dynamic_pointer_cast<IndexNode>(node)->left;
+                    break;
+                case NodeType::Precedence:
+                    node = std::dynamic_pointer_cast<PrecedenceNode>(node)->target;
+                    break;
+                default:
+                    return {};
+                }
+            }
+            return {};
+        }
+
+        // A variable or a member or swizzle of one, which reads the same wherever it is evaluated
+        bool isMemberPath(const std::shared_ptr<Node>& node)
+        {
+            if (node->nodeType == NodeType::Identifier) return true;
+            if (node->nodeType != NodeType::Access) return false;
+
+            auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+            return asAccess->right->nodeType == NodeType::Identifier && isMemberPath(asAccess->left);
+        }
+
+        // Nodes that GLSL parses the same anywhere in an expression
+        std::shared_ptr<Node> parenthesize(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::Identifier:
+            case NodeType::Call:
+            case NodeType::Access:
+            case NodeType::Index:
+            case NodeType::Precedence:
+            case NodeType::FloatLiteral:
+            case NodeType::IntLiteral:
+            case NodeType::BooleanLiteral:
+                return node;
+            default:
+                return std::make_shared<PrecedenceNode>(node);
+            }
+        }
+
+        // Replaces the identifiers named in substitutions with a copy of their value
+        std::shared_ptr<Node> substitute(const std::shared_ptr<Node>& node,
+                                         const std::unordered_map<std::string, std::shared_ptr<Node>>& substitutions)
+        {
+            if (!node) return node;
+
+            switch (node->nodeType)
+            {
+            case NodeType::Identifier:
+                if (auto found = substitutions.find(std::dynamic_pointer_cast<IdentifierNode>(node)->id); found !=
+                    substitutions.end())
+                {
+                    return parenthesize(cloneNode(found->second));
+                }
+                return node;
+            case NodeType::Access:
+                {
+                    // The right side is a member or swizzle
+                    auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                    asAccess->left = substitute(asAccess->left, substitutions);
+                    return node;
+                }
+            case NodeType::Call:
+                {
+                    auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                    for (auto& arg : asCall->args) arg = substitute(arg, substitutions);
+                    return node;
+                }
+            default:
+                transformChildren(node, [&substitutions](const std::shared_ptr<Node>& child)
+                {
+                    return substitute(child, substitutions);
+                });
+                return node;
+            }
+        }
+
+        std::shared_ptr<Node> replaceNode(const std::shared_ptr<Node>& node, const std::shared_ptr<Node>& target,
+                                          const std::shared_ptr<Node>& replacement)
+        {
+            if (node == target) return replacement;
+            if (!node) return node;
+
+            transformChildren(node, [&](const std::shared_ptr<Node>& child)
+            {
+                return replaceNode(child, target, replacement);
+            });
+            return node;
+        }
+
+        // Renames the locals of a function body as they are declared and records the names it uses without
+        // declaring, which a local of the caller must not capture
+        class LocalRenamer
+        {
+            std::function<std::string(const std::string&)> _rename{};
+            std::vector<std::unordered_map<std::string, std::string>> _scopes{{}};
+
+        public:
+            std::unordered_set<std::string> freeNames{};
+
+            explicit LocalRenamer(const std::function<std::string(const std::string&)>& inRename) : _rename(inRename)
+            {
+            }
+
+            void Declare(const std::shared_ptr<DeclarationNode>& declaration)
+            {
+                if (declaration->declarationName.empty()) return;
+
+                auto name = _rename(declaration->declarationName);
+                _scopes.back().insert_or_assign(declaration->declarationName, name);
+                declaration->declarationName = name;
+            }
+
+            void Rename(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Identifier:
+                    {
+                        auto asIdentifier = std::dynamic_pointer_cast<IdentifierNode>(node);
+                        for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it)
+                        {
+                            if (auto found = it->find(asIdentifier->id); found != it->end())
+                            {
+                                asIdentifier->id = found->second;
+                                return;
+                            }
+                        }
+                        freeNames.insert(asIdentifier->id);
+                    }
+                    break;
+                case NodeType::Declaration:
+                    Declare(std::dynamic_pointer_cast<DeclarationNode>(node));
+                    break;
+                case NodeType::Const:
+                    Declare(std::dynamic_pointer_cast<ConstNode>(node)->declaration);
+                    break;
+                case NodeType::Assign:
+                    {
+                        // A declaration's scope starts after its initializer
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(node);
+                        Rename(asAssign->value);
+                        Rename(asAssign->target);
+                    }
+                    break;
+                case NodeType::Call:
+                    {
+                        // A local named after a function hides it
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        freeNames.insert(asCall->identifier->id);
+                        for (auto& arg : asCall->args) Rename(arg);
+                    }
+                    break;
+                case NodeType::Access:
+                    Rename(std::dynamic_pointer_cast<AccessNode>(node)->left);
+                    break;
+                case NodeType::Scope:
+                    _scopes.emplace_back();
+                    for (auto& statement : std::dynamic_pointer_cast<ScopeNode>(node)->statements) Rename(statement);
+                    _scopes.pop_back();
+                    break;
+                case NodeType::For:
+                    {
+                        auto asFor = std::dynamic_pointer_cast<ForNode>(node);
+                        _scopes.emplace_back();
+                        Rename(asFor->init);
+                        Rename(asFor->condition);
+                        Rename(asFor->update);
+                        Rename(asFor->scope);
+                        _scopes.pop_back();
+                    }
+                    break;
+                default:
+                    for (auto& child : node->GetChildren()) Rename(child);
+                    break;
+                }
+            }
+
+            // Arguments and the outermost statements of a body share a scope
+            void RenameFunction(const std::shared_ptr<FunctionNode>& function)
+            {
+                for (auto& argument : function->arguments) Declare(argument->declaration);
+                for (auto& statement : function->scope->statements) Rename(statement);
+            }
+        };
+
+        class Inliner
+        {
+            struct Callee
+            {
+                std::shared_ptr<FunctionNode> function{};
+                size_t calls = 0;
+                bool analyzed = false;
+                bool canInline = false;
+                // The body is a single return of an expression of in arguments, which can replace the call as is
+                bool isExpression = false;
+                std::unordered_set<std::string> freeNames{};
+            };
+
+            const InlineOptions& _options;
+            std::unordered_map<std::string, Callee> _callees{};
+            std::unordered_set<std::string> _overloaded{};
+            std::unordered_set<std::string> _functionNames{};
+            std::unordered_map<std::string, std::vector<std::string>> _defines{};
+            // Every name in the module, so a renamed local never captures or shadows anything
+            std::unordered_set<std::string> _taken{};
+            std::string _caller{};
+            std::unordered_set<std::string> _callerNames{};
+
+            std::string Fresh(const std::string& base)
+            {
+                auto name = base;
+                for (size_t i = 1; _taken.contains(name); i++) name = base + std::to_string(i);
+                _taken.insert(name);
+                return name;
+            }
+
+            // Analyzed on first use, after the callee's own calls were inlined
+            Callee* Analyze(const std::string& name)
+            {
+                auto found = _callees.find(name);
+                if (found == _callees.end() || _overloaded.contains(name)) return nullptr;
+
+                auto& callee = found->second;
+                if (callee.analyzed) return &callee;
+                callee.analyzed = true;
+
+                auto& function = callee.function;
+                if (name == "main" || _options.never.contains(name) ||
+                    function->returnDeclaration->declarationCount != 1)
+                {
+                    return &callee;
+                }
+
+                size_t cost = 0;
+                walk(function->scope, [&cost](const std::shared_ptr<Node>& node)
+                {
+                    if (node) cost++;
+                    return node != nullptr;
+                });
+                if (!_options.always.contains(name) && cost > _options.threshold && callee.calls > 1) return &callee;
+
+                auto copy = clone(function);
+                LocalRenamer renamer([](const std::string& local) { return local; });
+                renamer.RenameFunction(copy);
+                callee.canInline = lowerReturns(copy->scope->statements);
+                callee.freeNames = std::move(renamer.freeNames);
+
+                // Defines expand where they are used, so the names they refer to must not be captured either
+                std::vector pending(callee.freeNames.begin(), callee.freeNames.end());
+                while (!pending.empty())
+                {
+                    auto define = _defines.find(pending.back());
+                    pending.pop_back();
+                    if (define == _defines.end()) continue;
+                    for (auto& reference : define->second)
+                    {
+                        if (callee.freeNames.insert(reference).second) pending.push_back(reference);
+                    }
+                }
+
+                auto& statements = function->scope->statements;
+                callee.isExpression = statements.size() == 1 && statements[0]->nodeType == NodeType::Return &&
+                    std::dynamic_pointer_cast<ReturnNode>(statements[0])->expression &&
+                    std::ranges::all_of(function->arguments, [](const std::shared_ptr<FunctionArgumentNode>& argument)
+                    {
+                        return argument->isInput;
+                    });
+                return &callee;
+            }
+
+            Callee* Inlinable(const std::shared_ptr<CallNode>& call)
+            {
+                auto name = call->identifier->id;
+                if (name == _caller) return nullptr;
+
+                auto callee = Analyze(name);
+                if (!callee || !callee->canInline || callee->function->arguments.size() != call->args.size())
+                {
+                    return nullptr;
+                }
+                for (auto& freeName : callee->freeNames)
+                {
+                    if (_callerNames.contains(freeName)) return nullptr;
+                }
+                return callee;
+            }
+
+            [[nodiscard]] bool IsFunction(const std::shared_ptr<CallNode>& call) const
+            {
+                return _callees.contains(call->identifier->id);
+            }
+
+            [[nodiscard]] bool IsPure(const std::shared_ptr<Node>& expression) const
+            {
+                return isPure(expression, _functionNames);
+            }
+
+            // Replaces call with the returned expression when that evaluates every argument the same number of times
+            // and in the same order as the call would
+            std::shared_ptr<Node> InlineExpression(const std::shared_ptr<CallNode>& call)
+            {
+                auto callee = Inlinable(call);
+                if (!callee || !callee->isExpression) return call;
+
+                auto& function = callee->function;
+                auto expression = std::dynamic_pointer_cast<ReturnNode>(function->scope->statements[0])->expression;
+                if (!IsPure(expression)) return call;
+
+                std::unordered_map<std::string, int> uses{};
+                countReads(expression, uses);
+
+                std::unordered_map<std::string, std::shared_ptr<Node>> substitutions{};
+                for (size_t i = 0; i < call->args.size(); i++)
+                {
+                    auto& arg = call->args[i];
+                    auto& name = function->arguments[i]->declaration->declarationName;
+                    // Other arguments are moved to where the expression uses them, or dropped when it does not
+                    const auto isTrivial = isLiteral(arg) || isMemberPath(arg);
+                    if (!isTrivial && (!IsPure(arg) || uses[name] > 1)) return call;
+                    substitutions.emplace(name, arg);
+                }
+
+                return parenthesize(substitute(cloneNode(expression), substitutions));
+            }
+
+            // Statements running the body of callee for call, storing the returned value in result
+            std::vector<std::shared_ptr<Node>> Expand(const std::shared_ptr<CallNode>& call, const Callee& callee,
+                                                      const std::string& result)
+            {
+                auto function = clone(callee.function);
+                LocalRenamer renamer([this, &function](const std::string& local)
+                {
+                    return Fresh(function->name + "_" + local);
+                });
+                renamer.RenameFunction(function);
+
+                auto body = function->scope->statements;
+                lowerReturns(body);
+                replaceReturns(body, result);
+
+                std::unordered_map<std::string, int> argumentNames{};
+                std::unordered_set<std::string> outRoots{};
+                for (size_t i = 0; i < call->args.size(); i++)
+                {
+                    countReads(call->args[i], argumentNames);
+                    if (function->arguments[i]->isInput) continue;
+                    if (auto root = rootOf(call->args[i])) outRoots.insert(root->id);
+                }
+
+                std::vector<std::shared_ptr<Node>> statements{};
+                std::vector<std::shared_ptr<Node>> copies{};
+                std::unordered_map<std::string, std::shared_ptr<Node>> substitutions{};
+                for (size_t i = 0; i < call->args.size(); i++)
+                {
+                    auto& arg = call->args[i];
+                    auto& declaration = function->arguments[i]->declaration;
+                    // A variable or member the body does not use directly can stand in for the argument, as long as
+                    // no out argument of the call writes it too
+                    auto root = rootOf(arg);
+                    const auto isAlias = root && isMemberPath(arg) && !callee.freeNames.contains(root->id);
+
+                    if (function->arguments[i]->isInput)
+                    {
+                        if ((isLiteral(arg) || (isAlias && !outRoots.contains(root->id))) &&
+                            !IsWritten(body, declaration->declarationName))
+                        {
+                            substitutions.emplace(declaration->declarationName, arg);
+                        }
+                        else
+                        {
+                            statements.push_back(std::make_shared<AssignNode>(declaration, arg));
+                        }
+                    }
+                    else if (isAlias && argumentNames[root->id] == 1)
+                    {
+                        substitutions.emplace(declaration->declarationName, arg);
+                    }
+                    else
+                    {
+                        statements.push_back(declaration);
+                        copies.push_back(std::make_shared<AssignNode>(
+                            arg, std::make_shared<IdentifierNode>(declaration->declarationName)));
+                    }
+                }
+
+                for (auto& statement : body) statements.push_back(substitute(statement, substitutions));
+                statements.insert(statements.end(), copies.begin(), copies.end());
+                return statements;
+            }
+
+            // Whether statements may write name, counting it passed to a function as possibly being an out argument
+            [[nodiscard]] bool IsWritten(const std::vector<std::shared_ptr<Node>>& statements,
+                                         const std::string& name) const
+            {
+                auto written = false;
+                auto writes = [&name](const std::shared_ptr<Node>& target)
+                {
+                    auto root = rootOf(target);
+                    return root && root->id == name;
+                };
+                for (auto& statement : statements)
+                {
+                    walk(statement, [&](const std::shared_ptr<Node>& node)
+                    {
+                        if (!node || written) return false;
+                        switch (node->nodeType)
+                        {
+                        case NodeType::Assign:
+                            written = writes(std::dynamic_pointer_cast<AssignNode>(node)->target);
+                            break;
+                        case NodeType::Increment:
+                            written = writes(std::dynamic_pointer_cast<IncrementNode>(node)->target);
+                            break;
+                        case NodeType::Decrement:
+                            written = writes(std::dynamic_pointer_cast<DecrementNode>(node)->target);
+                            break;
+                        case NodeType::Call:
+                            {
+                                auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                                written = IsFunction(asCall) && std::ranges::any_of(asCall->args, writes);
+                            }
+                            break;
+                        default:
+                            break;
+                        }
+                        return !written;
+                    });
+                }
+                return written;
+            }
+
+            // Collects the calls evaluated unconditionally by node in evaluation order. Fails when moving them in
+            // front of the statement would reorder them with another effect of it.
+            bool CollectHoisted(const std::shared_ptr<Node>& node, std::vector<std::shared_ptr<CallNode>>& calls,
+                                bool isConditional)
+            {
+                if (!node) return true;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Call:
+                    {
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        for (auto& arg : asCall->args)
+                        {
+                            if (!CollectHoisted(arg, calls, isConditional)) return false;
+                        }
+                        if (!IsFunction(asCall)) return true;
+                        if (isConditional || !Inlinable(asCall)) return false;
+                        calls.push_back(asCall);
+                        return true;
+                    }
+                case NodeType::Assign:
+                case NodeType::Increment:
+                case NodeType::Decrement:
+                    return false;
+                case NodeType::Conditional:
+                    {
+                        auto asConditional = std::dynamic_pointer_cast<ConditionalNode>(node);
+                        return CollectHoisted(asConditional->condition, calls, isConditional) &&
+                            CollectHoisted(asConditional->left, calls, true) &&
+                            CollectHoisted(asConditional->right, calls, true);
+                    }
+                case NodeType::BinaryOp:
+                    {
+                        auto asBinaryOp = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                        const auto isShortCircuit = asBinaryOp->op == EBinaryOp::And || asBinaryOp->op == EBinaryOp::Or;
+                        return CollectHoisted(asBinaryOp->left, calls, isConditional) &&
+                            CollectHoisted(asBinaryOp->right, calls, isConditional || isShortCircuit);
+                    }
+                case NodeType::Access:
+                    return CollectHoisted(std::dynamic_pointer_cast<AccessNode>(node)->left, calls, isConditional);
+                default:
+                    return std::ranges::all_of(node->GetChildren(), [&](const std::shared_ptr<Node>& child)
+                    {
+                        return CollectHoisted(child, calls, isConditional);
+                    });
+                }
+            }
+
+            // Expressions of statement that run before it completes, in order
+            static std::vector<std::shared_ptr<Node>> HoistableParts(const std::shared_ptr<Node>& statement)
+            {
+                switch (statement->nodeType)
+                {
+                case NodeType::Assign:
+                    {
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+                        return {asAssign->target, asAssign->value};
+                    }
+                case NodeType::Return:
+                    return {std::dynamic_pointer_cast<ReturnNode>(statement)->expression};
+                case NodeType::If:
+                    return {std::dynamic_pointer_cast<IfNode>(statement)->condition};
+                case NodeType::Call:
+                    return {statement};
+                default:
+                    return {};
+                }
+            }
+
+            std::shared_ptr<Node> InlineExpressions(const std::shared_ptr<Node>& node)
+            {
+                if (!node || node->nodeType == NodeType::Scope) return node;
+
+                transformChildren(node, [this](const std::shared_ptr<Node>& child)
+                {
+                    return InlineExpressions(child);
+                });
+                if (node->nodeType != NodeType::Call) return node;
+                return InlineExpression(std::dynamic_pointer_cast<CallNode>(node));
+            }
+
+            void InlineNested(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Scope:
+                    InlineStatements(std::dynamic_pointer_cast<ScopeNode>(node)->statements);
+                    break;
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(node);
+                        InlineStatements(asIf->scope->statements);
+                        InlineNested(asIf->elseNode);
+                    }
+                    break;
+                case NodeType::For:
+                    InlineStatements(std::dynamic_pointer_cast<ForNode>(node)->scope->statements);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            void InlineStatements(std::vector<std::shared_ptr<Node>>& statements)
+            {
+                size_t i = 0;
+                while (i < statements.size())
+                {
+                    InlineNested(statements[i]);
+                    statements[i] = InlineExpressions(statements[i]);
+
+                    auto statement = statements[i];
+                    std::vector<std::shared_ptr<CallNode>> calls{};
+                    if (!std::ranges::all_of(HoistableParts(statement), [&](const std::shared_ptr<Node>& part)
+                    {
+                        return CollectHoisted(part, calls, false);
+                    }) || calls.empty())
+                    {
+                        i++;
+                        continue;
+                    }
+
+                    std::vector<std::shared_ptr<Node>> expanded{};
+                    auto replaced = false;
+                    for (auto& call : calls)
+                    {
+                        auto& callee = *Inlinable(call);
+                        auto& returnDeclaration = callee.function->returnDeclaration;
+                        const auto isVoid = returnDeclaration->declarationType == EDeclarationType::Void;
+
+                        // A declaration initialized by the call receives the returned value directly
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+                        if (auto asDeclaration = asAssign
+                                                     ? std::dynamic_pointer_cast<DeclarationNode>(asAssign->target)
+                                                     : nullptr; asDeclaration && asAssign->value == call)
+                        {
+                            expanded.push_back(asDeclaration);
+                            auto body = Expand(call, callee, asDeclaration->declarationName);
+                            expanded.insert(expanded.end(), body.begin(), body.end());
+                            replaced = true;
+                            continue;
+                        }
+
+                        // The value of a call made for its effects is dropped
+                        if (statement == call)
+                        {
+                            auto body = Expand(call, callee, {});
+                            expanded.insert(expanded.end(), body.begin(), body.end());
+                            replaced = true;
+                            continue;
+                        }
+
+                        std::string result{};
+                        if (!isVoid)
+                        {
+                            result = Fresh(callee.function->name + "_result");
+                            auto declaration = clone(returnDeclaration);
+                            declaration->declarationName = result;
+                            expanded.push_back(declaration);
+                        }
+                        auto body = Expand(call, callee, result);
+                        expanded.insert(expanded.end(), body.begin(), body.end());
+                        statement = replaceNode(statement, call, std::make_shared<IdentifierNode>(result));
+                    }
+
+                    if (!replaced) expanded.push_back(statement);
+                    statements.erase(statements.begin() + static_cast<std::ptrdiff_t>(i));
+                    statements.insert(statements.begin() + static_cast<std::ptrdiff_t>(i), expanded.begin(),
+                                      expanded.end());
+                    // Inlined bodies already had their own calls inlined
+                    i += expanded.size();
+                }
+            }
+
+        public:
+            explicit Inliner(const InlineOptions& inOptions) : _options(inOptions)
+            {
+            }
+
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                walk(module, [this](const std::shared_ptr<Node>& node)
+                {
+                    if (!node) return false;
+
+                    switch (node->nodeType)
+                    {
+                    case NodeType::Identifier:
+                        _taken.insert(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                        break;
+                    case NodeType::Declaration:
+                        _taken.insert(std::dynamic_pointer_cast<DeclarationNode>(node)->declarationName);
+                        break;
+                    case NodeType::Function:
+                        {
+                            auto asFunction = std::dynamic_pointer_cast<FunctionNode>(node);
+                            _taken.insert(asFunction->name);
+                            _functionNames.insert(asFunction->name);
+                            if (!_callees.try_emplace(asFunction->name, Callee{asFunction}).second)
+                            {
+                                _overloaded.insert(asFunction->name);
+                            }
+                        }
+                        break;
+                    case NodeType::Call:
+                        if (auto found = _callees.find(std::dynamic_pointer_cast<CallNode>(node)->identifier->id);
+                            found != _callees.end())
+                        {
+                            found->second.calls++;
+                        }
+                        break;
+                    case NodeType::Define:
+                        {
+                            auto asDefine = std::dynamic_pointer_cast<DefineNode>(node);
+                            _taken.insert(asDefine->id);
+                            auto& references = _defines[asDefine->id];
+                            walk(asDefine->expression, [&references](const std::shared_ptr<Node>& child)
+                            {
+                                if (child && child->nodeType == NodeType::Identifier)
+                                {
+                                    references.push_back(std::dynamic_pointer_cast<IdentifierNode>(child)->id);
+                                }
+                                return child != nullptr;
+                            });
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                    return true;
+                });
+
+                // Functions are declared before they are called, so callees are inlined into before their callers
+                for (auto& statement : module->statements)
+                {
+                    auto asFunction = std::dynamic_pointer_cast<FunctionNode>(statement);
+                    if (!asFunction) continue;
+
+                    _caller = asFunction->name;
+                    _callerNames.clear();
+                    walk(asFunction, [this](const std::shared_ptr<Node>& node)
+                    {
+                        if (!node) return false;
+                        if (node->nodeType == NodeType::Declaration)
+                        {
+                            _callerNames.insert(std::dynamic_pointer_cast<DeclarationNode>(node)->declarationName);
+                        }
+                        return true;
+                    });
+                    InlineStatements(asFunction->scope->statements);
+                }
+            }
+        };
+
+        // Whether a and b are the same expression, compared node by node after their hashes matched
+        bool sameExpression(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b)
+        {
+            if (!a || !b) return a == b;
+            if (a->nodeType != b->nodeType) return false;
+
+            switch (a->nodeType)
+            {
+            case NodeType::Identifier:
+                return std::dynamic_pointer_cast<IdentifierNode>(a)->id ==
+                    std::dynamic_pointer_cast<IdentifierNode>(b)->id;
+            case NodeType::FloatLiteral:
+                return std::bit_cast<uint32_t>(std::dynamic_pointer_cast<FloatLiteralNode>(a)->data) ==
+                    std::bit_cast<uint32_t>(std::dynamic_pointer_cast<FloatLiteralNode>(b)->data);
+            case NodeType::IntLiteral:
+                return std::dynamic_pointer_cast<IntegerLiteralNode>(a)->data ==
+                    std::dynamic_pointer_cast<IntegerLiteralNode>(b)->data;
+            case NodeType::BooleanLiteral:
+                return std::dynamic_pointer_cast<BooleanLiteralNode>(a)->data ==
+                    std::dynamic_pointer_cast<BooleanLiteralNode>(b)->data;
+            case NodeType::BinaryOp:
+                if (std::dynamic_pointer_cast<BinaryOpNode>(a)->op != std::dynamic_pointer_cast<BinaryOpNode>(b)->op)
+                {
+                    return false;
+                }
+                break;
+            case NodeType::Access:
+            case NodeType::Index:
+            case NodeType::Call:
+            case NodeType::Negate:
+            case NodeType::Precedence:
+            case NodeType::Conditional:
+                break;
+            default:
+                return false;
+            }
+
+            auto aChildren = a->GetChildren();
+            auto bChildren = b->GetChildren();
+            return std::ranges::equal(aChildren, bChildren, sameExpression);
+        }
+
+        // Type of an expression, with the members of the struct or block it is
+        struct ValueType
+        {
+            std::string name{};
+            int count = 1;
+            const std::vector<std::shared_ptr<DeclarationNode>>* members = nullptr;
+        };
+
+        // Components of a scalar or vector type, 0 for anything else
+        int componentsOf(const std::string& typeName)
+        {
+            if (typeName == "float" || typeName == "int" || typeName == "bool") return 1;
+            if ((typeName.starts_with("float") || typeName.starts_with("int")) && typeName.back() >= '2' &&
+                typeName.back() <= '4')
+            {
+                return typeName.back() - '0';
+            }
+            return 0;
+        }
+
+        std::string vectorOf(const std::string& base, int components)
+        {
+            return components == 1 ? base : base + std::to_string(components);
+        }
+
+        // Types of the builtin variables either stage can use
+        const std::unordered_map<std::string, std::string> BUILTIN_VARIABLES = {
+            {"gl_Position", "float4"}, {"gl_PointSize", "float"}, {"gl_VertexIndex", "int"},
+            {"gl_InstanceIndex", "int"}, {"gl_FragCoord", "float4"}, {"gl_FrontFacing", "bool"},
+            {"gl_FragDepth", "float"}
+        };
+
+        // Tells the type of expressions while the statements of a module are visited in order, with every name
+        // declared as it comes into scope
+        class ExpressionTyper
+        {
+        protected:
+            std::unordered_map<std::string, std::vector<std::shared_ptr<FunctionNode>>> _functions{};
+            std::unordered_set<std::string> _globals{};
+            std::unordered_map<std::string, std::shared_ptr<StructNode>> _structs{};
+            std::unordered_map<std::string, std::shared_ptr<Node>> _defines{};
+            // Type of each name in scope, nullopt for names whose type cannot be declared or hide another
+            std::vector<std::unordered_map<std::string, std::optional<ValueType>>> _scopes{};
+
+            [[nodiscard]] bool IsOutArgument(const std::string& function, size_t index) const
+            {
+                auto found = _functions.find(function);
+                if (found == _functions.end()) return false;
+                return std::ranges::any_of(found->second, [index](const std::shared_ptr<FunctionNode>& overload)
+                {
+                    return index < overload->arguments.size() && !overload->arguments[index]->isInput;
+                });
+            }
+
+            std::optional<ValueType> TypeOfDeclaration(const std::shared_ptr<DeclarationNode>& declaration) const
+            {
+                const auto count = declaration->declarationCount;
+                if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(declaration))
+                {
+                    return ValueType{asBlock->GetTypeName(), count, &asBlock->declarations};
+                }
+                if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(declaration))
+                {
+                    return ValueType{asBuffer->GetTypeName(), count, &asBuffer->declarations};
+                }
+                if (declaration->declarationType == EDeclarationType::Struct)
+                {
+                    auto name = declaration->GetTypeName();
+                    if (auto found = _structs.find(name); found != _structs.end())
+                    {
+                        return ValueType{name, count, &found->second->declarations};
+                    }
+                    auto asStruct = std::dynamic_pointer_cast<StructDeclarationNode>(declaration);
+                    if (!asStruct || !asStruct->structNode) return std::nullopt;
+                    return ValueType{name, count, &asStruct->structNode->declarations};
+                }
+                return ValueType{declaration->GetTypeName(), count};
+            }
+
+            void Declare(const std::shared_ptr<DeclarationNode>& declaration)
+            {
+                _scopes.back().insert_or_assign(declaration->declarationName, TypeOfDeclaration(declaration));
+                if (_scopes.size() == 1) _globals.insert(declaration->declarationName);
+            }
+
+            void DeclareStatement(const std::shared_ptr<Node>& statement)
+            {
+                if (!statement) return;
+
+                auto target = statement->nodeType == NodeType::Assign
+                                  ? std::dynamic_pointer_cast<AssignNode>(statement)->target
+                                  : statement;
+                if (auto asConst = std::dynamic_pointer_cast<ConstNode>(target)) target = asConst->declaration;
+                if (auto asDeclaration = std::dynamic_pointer_cast<DeclarationNode>(target)) Declare(asDeclaration);
+            }
+
+            [[nodiscard]] std::optional<ValueType> Lookup(const std::string& id) const
+            {
+                for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it)
+                {
+                    if (auto found = it->find(id); found != it->end()) return found->second;
+                }
+                if (auto builtin = BUILTIN_VARIABLES.find(id); builtin != BUILTIN_VARIABLES.end())
+                {
+                    return ValueType{builtin->second};
+                }
+                if (auto define = _defines.find(id); define != _defines.end()) return TypeOf(define->second);
+                return std::nullopt;
+            }
+
+            [[nodiscard]] static std::optional<ValueType> Swizzle(const ValueType& type, const std::string& swizzle)
+            {
+                const auto components = componentsOf(type.name);
+                if (components < 2 || swizzle.empty() || swizzle.size() > 4) return std::nullopt;
+
+                for (auto set : {std::string_view("xyzw"), std::string_view("rgba"), std::string_view("stpq")})
+                {
+                    if (std::ranges::all_of(swizzle, [&](char c)
+                    {
+                        const auto index = set.find(c);
+                        return index != std::string_view::npos && static_cast<int>(index) < components;
+                    }))
+                    {
+                        return ValueType{
+                            vectorOf(type.name.starts_with("int") ? "int" : "float", static_cast<int>(swizzle.size()))
+                        };
+                    }
+                }
+                return std::nullopt;
+            }
+
+            [[nodiscard]] std::optional<ValueType> TypeOfBinaryOp(const std::shared_ptr<BinaryOpNode>& node) const
+            {
+                switch (node->op)
+                {
+                case EBinaryOp::Multiply:
+                case EBinaryOp::Divide:
+                case EBinaryOp::Add:
+                case EBinaryOp::Subtract:
+                case EBinaryOp::Mod:
+                    break;
+                default:
+                    return ValueType{"bool"};
+                }
+
+                auto left = TypeOf(node->left);
+                auto right = TypeOf(node->right);
+                if (!left || !right || left->count != 1 || right->count != 1) return std::nullopt;
+
+                const auto leftIsMatrix = left->name == "mat3" || left->name == "mat4";
+                const auto rightIsMatrix = right->name == "mat3" || right->name == "mat4";
+                const auto leftComponents = componentsOf(left->name);
+                const auto rightComponents = componentsOf(right->name);
+                if ((!leftIsMatrix && leftComponents == 0) || (!rightIsMatrix && rightComponents == 0) ||
+                    left->name == "bool" || right->name == "bool")
+                {
+                    return std::nullopt;
+                }
+
+                // Matrices transform vectors on either side
+                if (leftIsMatrix && rightComponents > 1) return ValueType{vectorOf("float", rightComponents)};
+                if (rightIsMatrix && leftComponents > 1) return ValueType{vectorOf("float", leftComponents)};
+                if (leftIsMatrix) return left;
+                if (rightIsMatrix) return right;
+
+                const auto isFloat = left->name.starts_with("float") || right->name.starts_with("float");
+                return ValueType{vectorOf(isFloat ? "float" : "int", std::max(leftComponents, rightComponents))};
+            }
+
+            [[nodiscard]] std::optional<ValueType> TypeOfCall(const std::shared_ptr<CallNode>& node) const
+            {
+                auto& name = node->identifier->id;
+                auto& args = node->args;
+                if (auto found = _functions.find(name); found != _functions.end())
+                {
+                    std::shared_ptr<FunctionNode> match{};
+                    for (auto& overload : found->second)
+                    {
+                        if (overload->arguments.size() != args.size()) continue;
+                        if (match) return std::nullopt;
+                        match = overload;
+                    }
+                    return match ? TypeOfDeclaration(match->returnDeclaration) : std::nullopt;
+                }
+
+                if (LITERAL_TYPES.contains(name)) return ValueType{name};
+                if (auto found = _structs.find(name); found != _structs.end())
+                {
+                    return ValueType{name, 1, &found->second->declarations};
+                }
+                if (name == "dot" || name == "length" || name == "distance" || name == "determinant")
+                {
+                    return ValueType{"float"};
+                }
+                if (name == "texture" || name == "textureLod" || name == "texelFetch") return ValueType{"float4"};
+                if (name == "textureSize") return ValueType{"int2"};
+                if (args.empty()) return std::nullopt;
+
+                // The edges of step and smoothstep may be scalars for a vector value
+                auto type = name == "step" || name == "smoothstep" ? TypeOf(args.back()) : TypeOf(args.front());
+                if (!FOLDABLE_BUILTINS.contains(name) && name != "dFdx" && name != "dFdy" && name != "fwidth")
+                {
+                    return std::nullopt;
+                }
+                // Only these have int overloads, ints passed to the others are converted to floats
+                if (type && type->name.starts_with("int") && name != "abs" && name != "sign" && name != "min" &&
+                    name != "max" && name != "clamp")
+                {
+                    return ValueType{vectorOf("float", componentsOf(type->name))};
+                }
+                return type;
+            }
+
+            // Type of expression in the current scope, or nullopt when it cannot be told
+            [[nodiscard]] std::optional<ValueType> TypeOf(const std::shared_ptr<Node>& node) const
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::FloatLiteral:
+                    return ValueType{"float"};
+                case NodeType::IntLiteral:
+                    return ValueType{"int"};
+                case NodeType::BooleanLiteral:
+                    return ValueType{"bool"};
+                case NodeType::Identifier:
+                    return Lookup(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                case NodeType::Precedence:
+                    return TypeOf(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+                case NodeType::Negate:
+                    return TypeOf(std::dynamic_pointer_cast<NegateNode>(node)->target);
+                case NodeType::Conditional:
+                    return TypeOf(std::dynamic_pointer_cast<ConditionalNode>(node)->left);
+                case NodeType::BinaryOp:
+                    return TypeOfBinaryOp(std::dynamic_pointer_cast<BinaryOpNode>(node));
+                case NodeType::Call:
+                    return TypeOfCall(std::dynamic_pointer_cast<CallNode>(node));
+                case NodeType::Access:
+                    {
+                        auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                        auto left = TypeOf(asAccess->left);
+                        if (!left || left->count != 1 || asAccess->right->nodeType != NodeType::Identifier)
+                        {
+                            return std::nullopt;
+                        }
+
+                        auto& right = std::dynamic_pointer_cast<IdentifierNode>(asAccess->right)->id;
+                        if (!left->members) return Swizzle(*left, right);
+                        for (auto& member : *left->members)
+                        {
+                            if (member->declarationName == right) return TypeOfDeclaration(member);
+                        }
+                        return std::nullopt;
+                    }
+                case NodeType::Index:
+                    {
+                        auto left = TypeOf(std::dynamic_pointer_cast<IndexNode>(node)->left);
+                        if (!left) return std::nullopt;
+                        if (left->count != 1) return ValueType{left->name, 1, left->members};
+                        if (left->name == "mat3" || left->name == "mat4")
+                        {
+                            return ValueType{vectorOf("float", left->name.back() - '0')};
+                        }
+                        if (componentsOf(left->name) > 1)
+                        {
+                            return ValueType{left->name.starts_with("int") ? "int" : "float"};
+                        }
+                        return std::nullopt;
+                    }
+                default:
+                    return std::nullopt;
+                }
+            }
+
+            // Declares a statement of the module other than a function
+            void DeclareGlobal(const std::shared_ptr<Node>& statement)
+            {
+                switch (statement->nodeType)
+                {
+                case NodeType::Struct:
+                    {
+                        auto asStruct = std::dynamic_pointer_cast<StructNode>(statement);
+                        _structs.insert_or_assign(asStruct->name, asStruct);
+                    }
+                    break;
+                case NodeType::Define:
+                    {
+                        auto asDefine = std::dynamic_pointer_cast<DefineNode>(statement);
+                        _defines.insert_or_assign(asDefine->id, asDefine->expression);
+                    }
+                    break;
+                case NodeType::Layout:
+                    Declare(std::dynamic_pointer_cast<LayoutNode>(statement)->declaration);
+                    break;
+                case NodeType::PushConstant:
+                    {
+                        auto asPushConstant = std::dynamic_pointer_cast<PushConstantNode>(statement);
+                        _scopes.back().insert_or_assign("push", ValueType{"push", 1, &asPushConstant->declarations});
+                        _globals.insert("push");
+                    }
+                    break;
+                default:
+                    DeclareStatement(statement);
+                    break;
+                }
+            }
+        };
+
+        // Hoists expressions evaluated more than once in a scope into a local computed once. Expressions are grouped by
+        // their structural hash, and an occurrence reuses the local only while nothing the expression reads has been
+        // written since. Occurrences in branches and nested scopes may reuse it but never compute it.
+        class CommonSubexpressionEliminator : ExpressionTyper
+        {
+            struct Occurrence
+            {
+                std::shared_ptr<Node> expression{};
+                // Node replaced by the local, which also covers any parentheses around the expression
+                std::shared_ptr<Node> slot{};
+                size_t statement = 0;
+                // Evaluated whenever its statement is, rather than in a branch or a nested scope of it
+                bool isUnconditional = false;
+                bool isNested = false;
+            };
+
+            struct Writes
+            {
+                std::unordered_set<std::string> names{};
+                // Set by calls to functions that write globals
+                bool everything = false;
+            };
+
+            // What a statement changes, to tell which values computed before it are still current
+            struct Effects
+            {
+                Writes writes{};
+                // Writes made while evaluating the parts of the statement outside its nested scopes, before its own
+                // store or call
+                Writes directWrites{};
+                std::string declared{};
+                std::unordered_set<std::string> nestedDeclared{};
+            };
+
+            std::unordered_set<std::string> _writesGlobals{};
+            // Functions that write globals or out arguments, whose calls are never hoisted
+            std::unordered_set<std::string> _impure{};
+            std::unordered_set<std::string> _taken{};
+
+            std::string Fresh(const std::string& base)
+            {
+                auto name = base;
+                for (size_t i = 1; _taken.contains(name); i++) name = base + std::to_string(i);
+                _taken.insert(name);
+                return name;
+            }
+
+            void CollectWrites(const std::shared_ptr<Node>& node, Writes& writes) const
+            {
+                walk(node, [&](const std::shared_ptr<Node>& child)
+                {
+                    if (!child) return false;
+
+                    std::shared_ptr<Node> target{};
+                    switch (child->nodeType)
+                    {
+                    case NodeType::Assign:
+                        target = std::dynamic_pointer_cast<AssignNode>(child)->target;
+                        // Declarations are tracked separately, they do not change the variable they may hide
+                        if (std::dynamic_pointer_cast<DeclarationNode>(target) || target->nodeType == NodeType::Const)
+                        {
+                            target.reset();
+                        }
+                        break;
+                    case NodeType::Increment:
+                        target = std::dynamic_pointer_cast<IncrementNode>(child)->target;
+                        break;
+                    case NodeType::Decrement:
+                        target = std::dynamic_pointer_cast<DecrementNode>(child)->target;
+                        break;
+                    case NodeType::Call:
+                        {
+                            auto asCall = std::dynamic_pointer_cast<CallNode>(child);
+                            if (_writesGlobals.contains(asCall->identifier->id)) writes.everything = true;
+                            for (size_t i = 0; i < asCall->args.size(); i++)
+                            {
+                                if (!IsOutArgument(asCall->identifier->id, i)) continue;
+                                if (auto root = rootOf(asCall->args[i])) writes.names.insert(root->id);
+                                else writes.everything = true;
+                            }
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+
+                    if (target)
+                    {
+                        if (auto root = rootOf(target)) writes.names.insert(root->id);
+                        else writes.everything = true;
+                    }
+                    return true;
+                });
+            }
+
+            [[nodiscard]] bool WritesGlobals(const std::shared_ptr<FunctionNode>& function) const
+            {
+                Writes writes{};
+                CollectWrites(function->scope, writes);
+                return writes.everything || std::ranges::any_of(writes.names, [this](const std::string& name)
+                {
+                    return _globals.contains(name);
+                });
+            }
+
+            // Every name expression reads, including those of the defines it uses
+            [[nodiscard]] std::unordered_set<std::string> ReadNames(const std::shared_ptr<Node>& expression) const
+            {
+                std::unordered_set<std::string> names{};
+                std::vector pending{expression};
+                while (!pending.empty())
+                {
+                    auto node = pending.back();
+                    pending.pop_back();
+                    walk(node, [&](const std::shared_ptr<Node>& child)
+                    {
+                        if (!child) return false;
+                        if (child->nodeType != NodeType::Identifier) return true;
+
+                        auto& id = std::dynamic_pointer_cast<IdentifierNode>(child)->id;
+                        if (!names.insert(id).second) return true;
+                        if (auto define = _defines.find(id); define != _defines.end()) pending.push_back(define->second);
+                        return true;
+                    });
+                }
+                return names;
+            }
+
+            // Expressions worth computing once. Variables, their members and swizzles and literals cost nothing.
+            [[nodiscard]] bool IsCandidate(const std::shared_ptr<Node>& node) const
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::BinaryOp:
+                case NodeType::Call:
+                case NodeType::Index:
+                case NodeType::Conditional:
+                    break;
+                case NodeType::Negate:
+                    if (isLiteral(node) || isMemberPath(std::dynamic_pointer_cast<NegateNode>(node)->target))
+                    {
+                        return false;
+                    }
+                    break;
+                case NodeType::Access:
+                    if (isMemberPath(node)) return false;
+                    break;
+                default:
+                    return false;
+                }
+                return !isConstant(node) && isPure(node, _impure);
+            }
+
+            void Collect(const std::shared_ptr<Node>& node, size_t statement, bool isUnconditional, bool isNested,
+                         std::vector<Occurrence>& occurrences) const
+            {
+                if (!node) return;
+
+                auto expression = node;
+                while (expression->nodeType == NodeType::Precedence)
+                {
+                    expression = std::dynamic_pointer_cast<PrecedenceNode>(expression)->target;
+                }
+                if (IsCandidate(expression))
+                {
+                    occurrences.push_back({expression, node, statement, isUnconditional && !isNested, isNested});
+                }
+
+                switch (expression->nodeType)
+                {
+                case NodeType::Access:
+                    Collect(std::dynamic_pointer_cast<AccessNode>(expression)->left, statement, isUnconditional,
+                            isNested, occurrences);
+                    return;
+                case NodeType::Call:
+                    {
+                        // Out arguments are written rather than read
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(expression);
+                        for (size_t i = 0; i < asCall->args.size(); i++)
+                        {
+                            if (IsOutArgument(asCall->identifier->id, i)) continue;
+                            Collect(asCall->args[i], statement, isUnconditional, isNested, occurrences);
+                        }
+                    }
+                    return;
+                case NodeType::BinaryOp:
+                    {
+                        // The right side of && and || is only evaluated depending on the left
+                        auto asBinaryOp = std::dynamic_pointer_cast<BinaryOpNode>(expression);
+                        const auto isShortCircuit = asBinaryOp->op == EBinaryOp::And || asBinaryOp->op == EBinaryOp::Or;
+                        Collect(asBinaryOp->left, statement, isUnconditional, isNested, occurrences);
+                        Collect(asBinaryOp->right, statement, isUnconditional && !isShortCircuit, isNested,
+                                occurrences);
+                    }
+                    return;
+                case NodeType::Conditional:
+                    {
+                        auto asConditional = std::dynamic_pointer_cast<ConditionalNode>(expression);
+                        Collect(asConditional->condition, statement, isUnconditional, isNested, occurrences);
+                        Collect(asConditional->left, statement, false, isNested, occurrences);
+                        Collect(asConditional->right, statement, false, isNested, occurrences);
+                    }
+                    return;
+                case NodeType::Assign:
+                    // Targets are written rather than read
+                    Collect(std::dynamic_pointer_cast<AssignNode>(expression)->value, statement, isUnconditional,
+                            isNested, occurrences);
+                    return;
+                case NodeType::Increment:
+                case NodeType::Decrement:
+                case NodeType::Declaration:
+                case NodeType::Const:
+                    return;
+                default:
+                    for (auto& child : expression->GetChildren())
+                    {
+                        Collect(child, statement, isUnconditional, isNested, occurrences);
+                    }
+                }
+            }
+
+            // Parts of statement evaluated before its nested scopes, and the nested scopes with any for header
+            static std::pair<std::vector<std::shared_ptr<Node>>, std::vector<std::shared_ptr<Node>>> PartsOf(
+                const std::shared_ptr<Node>& statement)
+            {
+                switch (statement->nodeType)
+                {
+                case NodeType::Assign:
+                    return {{std::dynamic_pointer_cast<AssignNode>(statement)->value}, {}};
+                case NodeType::Return:
+                    return {{std::dynamic_pointer_cast<ReturnNode>(statement)->expression}, {}};
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(statement);
+                        return {{asIf->condition}, {asIf->scope, asIf->elseNode}};
+                    }
+                case NodeType::Call:
+                    {
+                        auto& args = std::dynamic_pointer_cast<CallNode>(statement)->args;
+                        return {{args.begin(), args.end()}, {}};
+                    }
+                case NodeType::For:
+                case NodeType::Scope:
+                    return {{}, {statement}};
+                default:
+                    return {};
+                }
+            }
+
+            Effects EffectsOf(const std::shared_ptr<Node>& statement) const
+            {
+                Effects effects{};
+                CollectWrites(statement, effects.writes);
+
+                auto [direct, nested] = PartsOf(statement);
+                for (auto& part : direct) CollectWrites(part, effects.directWrites);
+                for (auto& part : nested)
+                {
+                    walk(part, [&effects](const std::shared_ptr<Node>& node)
+                    {
+                        if (!node) return false;
+                        if (node->nodeType == NodeType::Declaration)
+                        {
+                            effects.nestedDeclared.insert(
+                                std::dynamic_pointer_cast<DeclarationNode>(node)->declarationName);
+                        }
+                        return true;
+                    });
+                }
+
+                auto target = statement->nodeType == NodeType::Assign
+                                  ? std::dynamic_pointer_cast<AssignNode>(statement)->target
+                                  : statement;
+                if (auto asConst = std::dynamic_pointer_cast<ConstNode>(target)) target = asConst->declaration;
+                if (auto asDeclaration = std::dynamic_pointer_cast<DeclarationNode>(target))
+                {
+                    effects.declared = asDeclaration->declarationName;
+                }
+                return effects;
+            }
+
+            // The statement the local is computed before and the occurrences that can use it, empty when fewer than
+            // two can
+            static std::pair<size_t, std::vector<const Occurrence*>> UsableOccurrences(
+                const std::vector<const Occurrence*>& group, const std::vector<Effects>& effects,
+                const std::unordered_set<std::string>& reads)
+            {
+                const auto touches = [&reads](const Writes& writes)
+                {
+                    return writes.everything || std::ranges::any_of(reads, [&writes](const std::string& name)
+                    {
+                        return writes.names.contains(name);
+                    });
+                };
+
+                std::optional<size_t> anchor{};
+                std::vector<const Occurrence*> usable{};
+                size_t next = 0;
+                for (auto i = group.front()->statement; i < effects.size() && next < group.size(); i++)
+                {
+                    auto& effect = effects[i];
+                    const auto first = next;
+                    while (next < group.size() && group[next]->statement == i) next++;
+
+                    if (!anchor && !touches(effect.directWrites) &&
+                        std::any_of(group.begin() + static_cast<std::ptrdiff_t>(first),
+                                    group.begin() + static_cast<std::ptrdiff_t>(next),
+                                    [](const Occurrence* occurrence) { return occurrence->isUnconditional; }))
+                    {
+                        anchor = i;
+                    }
+
+                    if (anchor)
+                    {
+                        const auto nestedUsable = !touches(effect.writes) && std::ranges::none_of(
+                            reads, [&effect](const std::string& name) { return effect.nestedDeclared.contains(name); });
+                        for (auto j = first; j < next; j++)
+                        {
+                            if (group[j]->isNested ? nestedUsable : !touches(effect.directWrites))
+                            {
+                                usable.push_back(group[j]);
+                            }
+                        }
+                    }
+
+                    // The value computed before this statement is stale after it
+                    if (touches(effect.writes) || reads.contains(effect.declared))
+                    {
+                        if (usable.size() > 1) break;
+                        anchor.reset();
+                        usable.clear();
+                    }
+                }
+
+                if (!anchor || usable.size() < 2) return {};
+                return {*anchor, usable};
+            }
+
+            [[nodiscard]] std::optional<ValueType> TypeBefore(const std::shared_ptr<Node>& expression,
+                                                              const std::vector<std::shared_ptr<Node>>& statements,
+                                                              size_t index)
+            {
+                _scopes.emplace_back();
+                for (size_t i = 0; i < index; i++) DeclareStatement(statements[i]);
+                auto type = TypeOf(expression);
+                _scopes.pop_back();
+                return type;
+            }
+
+            // Hoists the largest expression used more than once, returns false when there is none
+            bool EliminateOne(std::vector<std::shared_ptr<Node>>& statements)
+            {
+                std::vector<Occurrence> occurrences{};
+                std::vector<Effects> effects{};
+                for (size_t i = 0; i < statements.size(); i++)
+                {
+                    effects.push_back(EffectsOf(statements[i]));
+                    auto [direct, nested] = PartsOf(statements[i]);
+                    for (auto& part : direct) Collect(part, i, true, false, occurrences);
+                    for (auto& part : nested) Collect(part, i, false, true, occurrences);
+                }
+
+                // Occurrences with the same hash are split into groups of equal expressions
+                std::unordered_map<size_t, std::vector<std::vector<const Occurrence*>>> buckets{};
+                for (auto& occurrence : occurrences)
+                {
+                    auto& groups = buckets[occurrence.expression->ComputeHash()];
+                    auto group = std::ranges::find_if(groups, [&](const std::vector<const Occurrence*>& candidate)
+                    {
+                        return sameExpression(candidate.front()->expression, occurrence.expression);
+                    });
+                    if (group == groups.end()) groups.push_back({&occurrence});
+                    else group->push_back(&occurrence);
+                }
+
+                size_t bestSize = 0;
+                size_t bestAnchor = 0;
+                std::vector<const Occurrence*> best{};
+                ValueType bestType{};
+                for (auto& [hash, groups] : buckets)
+                {
+                    for (auto& group : groups)
+                    {
+                        if (group.size() < 2) continue;
+
+                        auto& expression = group.front()->expression;
+                        size_t size = 0;
+                        walk(expression, [&size](const std::shared_ptr<Node>& node)
+                        {
+                            if (node) size++;
+                            return node != nullptr;
+                        });
+                        if (size < bestSize || (size == bestSize && group.front()->statement >= bestAnchor)) continue;
+
+                        auto [anchor, usable] = UsableOccurrences(group, effects, ReadNames(expression));
+                        if (usable.empty()) continue;
+
+                        auto type = TypeBefore(expression, statements, anchor);
+                        if (!type || type->count != 1 ||
+                            (!LITERAL_TYPES.contains(type->name) && !_structs.contains(type->name)))
+                        {
+                            continue;
+                        }
+
+                        bestSize = size;
+                        bestAnchor = anchor;
+                        best = std::move(usable);
+                        bestType = *type;
+                    }
+                }
+                if (best.empty()) return false;
+
+                // A local initialized with the expression already holds it while it is not written or hidden
+                if (auto asAssign = std::dynamic_pointer_cast<AssignNode>(statements[bestAnchor]); asAssign &&
+                    asAssign->value == best.front()->slot)
+                {
+                    auto asDeclaration = std::dynamic_pointer_cast<DeclarationNode>(asAssign->target);
+                    if (asDeclaration && asDeclaration->declarationCount == 1 &&
+                        asDeclaration->GetTypeName() == bestType.name &&
+                        std::all_of(effects.begin() + static_cast<std::ptrdiff_t>(bestAnchor) + 1,
+                                    effects.begin() + static_cast<std::ptrdiff_t>(best.back()->statement) + 1,
+                                    [&](const Effects& effect)
+                                    {
+                                        return !effect.writes.names.contains(asDeclaration->declarationName) &&
+                                            !effect.nestedDeclared.contains(asDeclaration->declarationName);
+                                    }))
+                    {
+                        for (auto occurrence : best | std::views::drop(1))
+                        {
+                            auto& statement = statements[occurrence->statement];
+                            statement = replaceNode(statement, occurrence->slot,
+                                                    std::make_shared<IdentifierNode>(asDeclaration->declarationName));
+                        }
+                        return true;
+                    }
+                }
+
+                auto name = Fresh("cse");
+                auto value = cloneNode(best.front()->expression);
+                for (auto occurrence : best)
+                {
+                    auto& statement = statements[occurrence->statement];
+                    statement = replaceNode(statement, occurrence->slot, std::make_shared<IdentifierNode>(name));
+                }
+
+                std::shared_ptr<DeclarationNode> declaration{};
+                if (_structs.contains(bestType.name))
+                {
+                    declaration = std::make_shared<StructDeclarationNode>(bestType.name, name, 1);
+                }
+                else
+                {
+                    declaration = std::make_shared<DeclarationNode>(Token(bestType.name, {}), name, 1);
+                }
+                statements.insert(statements.begin() + static_cast<std::ptrdiff_t>(bestAnchor),
+                                  std::make_shared<AssignNode>(declaration, value));
+                return true;
+            }
+
+            void EliminateNested(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Scope:
+                    EliminateIn(std::dynamic_pointer_cast<ScopeNode>(node)->statements);
+                    break;
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(node);
+                        EliminateIn(asIf->scope->statements);
+                        EliminateNested(asIf->elseNode);
+                    }
+                    break;
+                case NodeType::For:
+                    {
+                        auto asFor = std::dynamic_pointer_cast<ForNode>(node);
+                        _scopes.emplace_back();
+                        DeclareStatement(asFor->init);
+                        EliminateIn(asFor->scope->statements);
+                        _scopes.pop_back();
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            void EliminateIn(std::vector<std::shared_ptr<Node>>& statements)
+            {
+                while (EliminateOne(statements))
+                {
+                }
+
+                _scopes.emplace_back();
+                for (auto& statement : statements)
+                {
+                    EliminateNested(statement);
+                    DeclareStatement(statement);
+                }
+                _scopes.pop_back();
+            }
+
+        public:
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                walk(module, [this](const std::shared_ptr<Node>& node)
+                {
+                    if (!node) return false;
+
+                    switch (node->nodeType)
+                    {
+                    case NodeType::Identifier:
+                        _taken.insert(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                        break;
+                    case NodeType::Declaration:
+                        _taken.insert(std::dynamic_pointer_cast<DeclarationNode>(node)->declarationName);
+                        break;
+                    case NodeType::Function:
+                        _taken.insert(std::dynamic_pointer_cast<FunctionNode>(node)->name);
+                        break;
+                    case NodeType::Struct:
+                        _taken.insert(std::dynamic_pointer_cast<StructNode>(node)->name);
+                        break;
+                    case NodeType::Define:
+                        _taken.insert(std::dynamic_pointer_cast<DefineNode>(node)->id);
+                        break;
+                    default:
+                        break;
+                    }
+                    return true;
+                });
+
+                _scopes.emplace_back();
+                for (auto& statement : module->statements)
+                {
+                    switch (statement->nodeType)
+                    {
+                    case NodeType::Function:
+                        {
+                            // Functions are declared before they are called, so their callees are already known
+                            auto asFunction = std::dynamic_pointer_cast<FunctionNode>(statement);
+                            _functions[asFunction->name].push_back(asFunction);
+                            if (WritesGlobals(asFunction)) _writesGlobals.insert(asFunction->name);
+                            if (_writesGlobals.contains(asFunction->name) ||
+                                std::ranges::any_of(asFunction->arguments,
+                                                    [](const std::shared_ptr<FunctionArgumentNode>& argument)
+                                                    {
+                                                        return !argument->isInput;
+                                                    }))
+                            {
+                                _impure.insert(asFunction->name);
+                            }
+
+                            _scopes.emplace_back();
+                            for (auto& argument : asFunction->arguments) Declare(argument->declaration);
+                            EliminateIn(asFunction->scope->statements);
+                            _scopes.pop_back();
+                        }
+                        break;
+                    default:
+                        DeclareGlobal(statement);
+                        break;
+                    }
+                }
+                _scopes.pop_back();
+            }
+        };
+
+        // Value of an integer literal, negated or in parentheses
+        std::optional<int64_t> intLiteralOf(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::IntLiteral:
+                return std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data;
+            case NodeType::Negate:
+                if (auto value = intLiteralOf(std::dynamic_pointer_cast<NegateNode>(node)->target)) return -*value;
+                return std::nullopt;
+            case NodeType::Precedence:
+                return intLiteralOf(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+            default:
+                return std::nullopt;
+            }
+        }
+
+        bool isIdentifier(const std::shared_ptr<Node>& node, const std::string& name)
+        {
+            return node->nodeType == NodeType::Identifier && std::dynamic_pointer_cast<IdentifierNode>(node)->id == name;
+        }
+
+        // Replaces reads of the names in substitutions throughout statements, stopping where a declaration hides them
+        void substituteInScope(std::vector<std::shared_ptr<Node>>& statements,
+                               const std::unordered_map<std::string, std::shared_ptr<Node>>& substitutions);
+
+        // Same for a single statement, returns false once it declared one of the names
+        bool substituteInStatement(std::shared_ptr<Node>& statement,
+                                   const std::unordered_map<std::string, std::shared_ptr<Node>>& substitutions)
+        {
+            if (!statement) return true;
+
+            const auto hides = [&substitutions](const std::shared_ptr<Node>& node)
+            {
+                auto target = node->nodeType == NodeType::Assign
+                                  ? std::dynamic_pointer_cast<AssignNode>(node)->target
+                                  : node;
+                if (auto asConst = std::dynamic_pointer_cast<ConstNode>(target)) target = asConst->declaration;
+                auto asDeclaration = std::dynamic_pointer_cast<DeclarationNode>(target);
+                return asDeclaration && substitutions.contains(asDeclaration->declarationName);
+            };
+
+            switch (statement->nodeType)
+            {
+            case NodeType::Scope:
+                substituteInScope(std::dynamic_pointer_cast<ScopeNode>(statement)->statements, substitutions);
+                return true;
+            case NodeType::If:
+                {
+                    auto asIf = std::dynamic_pointer_cast<IfNode>(statement);
+                    asIf->condition = substitute(asIf->condition, substitutions);
+                    substituteInScope(asIf->scope->statements, substitutions);
+                    substituteInStatement(asIf->elseNode, substitutions);
+                    return true;
+                }
+            case NodeType::For:
+                {
+                    // A variable declared by the init only hides the names inside the loop
+                    auto asFor = std::dynamic_pointer_cast<ForNode>(statement);
+                    if (!substituteInStatement(asFor->init, substitutions)) return true;
+
+                    asFor->condition = substitute(asFor->condition, substitutions);
+                    asFor->update = substitute(asFor->update, substitutions);
+                    substituteInScope(asFor->scope->statements, substitutions);
+                    return true;
+                }
+            case NodeType::Assign:
+                {
+                    auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+                    asAssign->value = substitute(asAssign->value, substitutions);
+                    if (hides(statement)) return false;
+                    asAssign->target = substitute(asAssign->target, substitutions);
+                    return true;
+                }
+            default:
+                if (hides(statement)) return false;
+                statement = substitute(statement, substitutions);
+                return true;
+            }
+        }
+
+        void substituteInScope(std::vector<std::shared_ptr<Node>>& statements,
+                               const std::unordered_map<std::string, std::shared_ptr<Node>>& substitutions)
+        {
+            for (auto& statement : statements)
+            {
+                if (!substituteInStatement(statement, substitutions)) return;
+            }
+        }
+
+        class LoopUnroller
+        {
+            // A for over an int declared by its init, stepping by a constant towards a constant bound
+            struct Induction
+            {
+                std::string name{};
+                int64_t start = 0;
+                int64_t step = 0;
+                size_t iterations = 0;
+            };
+
+            // Loops running longer than this are never unrolled, so counting their iterations stays cheap
+            static constexpr size_t MAX_COUNTED_ITERATIONS = 1 << 16;
+
+            const UnrollOptions& _options;
+            std::unordered_set<std::string> _functions{};
+
+            // Whether body may write name, directly or through an out argument
+            [[nodiscard]] bool Writes(const std::shared_ptr<Node>& body, const std::string& name) const
+            {
+                auto writes = false;
+                walk(body, [&](const std::shared_ptr<Node>& node)
+                {
+                    if (!node || writes) return false;
+
+                    switch (node->nodeType)
+                    {
+                    case NodeType::Assign:
+                        {
+                            auto root = rootOf(std::dynamic_pointer_cast<AssignNode>(node)->target);
+                            writes = root && root->id == name;
+                        }
+                        break;
+                    case NodeType::Increment:
+                        {
+                            auto root = rootOf(std::dynamic_pointer_cast<IncrementNode>(node)->target);
+                            writes = !root || root->id == name;
+                        }
+                        break;
+                    case NodeType::Decrement:
+                        {
+                            auto root = rootOf(std::dynamic_pointer_cast<DecrementNode>(node)->target);
+                            writes = !root || root->id == name;
+                        }
+                        break;
+                    case NodeType::Call:
+                        {
+                            auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                            if (!_functions.contains(asCall->identifier->id)) break;
+                            writes = std::ranges::any_of(asCall->args, [&name](const std::shared_ptr<Node>& arg)
+                            {
+                                auto root = rootOf(arg);
+                                return root && root->id == name;
+                            });
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                    return !writes;
+                });
+                return writes;
+            }
+
+            [[nodiscard]] std::optional<Induction> InductionOf(const std::shared_ptr<ForNode>& loop) const
+            {
+                auto init = std::dynamic_pointer_cast<AssignNode>(loop->init);
+                auto declaration = init ? std::dynamic_pointer_cast<DeclarationNode>(init->target) : nullptr;
+                if (!declaration || declaration->declarationType != EDeclarationType::Int ||
+                    declaration->declarationCount != 1)
+                {
+                    return std::nullopt;
+                }
+
+                Induction induction{declaration->declarationName};
+                auto start = intLiteralOf(init->value);
+                if (!start) return std::nullopt;
+                induction.start = *start;
+
+                auto& name = induction.name;
+                switch (loop->update->nodeType)
+                {
+                case NodeType::Increment:
+                    if (!isIdentifier(std::dynamic_pointer_cast<IncrementNode>(loop->update)->target, name))
+                    {
+                        return std::nullopt;
+                    }
+                    induction.step = 1;
+                    break;
+                case NodeType::Decrement:
+                    if (!isIdentifier(std::dynamic_pointer_cast<DecrementNode>(loop->update)->target, name))
+                    {
+                        return std::nullopt;
+                    }
+                    induction.step = -1;
+                    break;
+                case NodeType::Assign:
+                    {
+                        // i = i + c, i = c + i and i = i - c
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(loop->update);
+                        auto value = std::dynamic_pointer_cast<BinaryOpNode>(asAssign->value);
+                        if (!isIdentifier(asAssign->target, name) || !value) return std::nullopt;
+
+                        std::optional<int64_t> step{};
+                        if (value->op == EBinaryOp::Add && isIdentifier(value->right, name))
+                        {
+                            step = intLiteralOf(value->left);
+                        }
+                        else if ((value->op == EBinaryOp::Add || value->op == EBinaryOp::Subtract) &&
+                            isIdentifier(value->left, name))
+                        {
+                            step = intLiteralOf(value->right);
+                            if (step && value->op == EBinaryOp::Subtract) step = -*step;
+                        }
+                        if (!step) return std::nullopt;
+                        induction.step = *step;
+                    }
+                    break;
+                default:
+                    return std::nullopt;
+                }
+                if (induction.step == 0) return std::nullopt;
+
+                // The bound may be on either side
+                auto condition = std::dynamic_pointer_cast<BinaryOpNode>(loop->condition);
+                if (!condition) return std::nullopt;
+                auto op = condition->op;
+                std::optional<int64_t> bound{};
+                if (isIdentifier(condition->left, name))
+                {
+                    bound = intLiteralOf(condition->right);
+                }
+                else if (isIdentifier(condition->right, name))
+                {
+                    bound = intLiteralOf(condition->left);
+                    switch (op)
+                    {
+                    case EBinaryOp::Less:
+                        op = EBinaryOp::Greater;
+                        break;
+                    case EBinaryOp::LessEqual:
+                        op = EBinaryOp::GreaterEqual;
+                        break;
+                    case EBinaryOp::Greater:
+                        op = EBinaryOp::Less;
+                        break;
+                    case EBinaryOp::GreaterEqual:
+                        op = EBinaryOp::LessEqual;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                if (!bound) return std::nullopt;
+
+                const auto holds = [op, bound = *bound](int64_t value)
+                {
+                    switch (op)
+                    {
+                    case EBinaryOp::Less:
+                        return value < bound;
+                    case EBinaryOp::LessEqual:
+                        return value <= bound;
+                    case EBinaryOp::Greater:
+                        return value > bound;
+                    case EBinaryOp::GreaterEqual:
+                        return value >= bound;
+                    case EBinaryOp::NotEqual:
+                        return value != bound;
+                    default:
+                        return false;
+                    }
+                };
+                if (op != EBinaryOp::Less && op != EBinaryOp::LessEqual && op != EBinaryOp::Greater &&
+                    op != EBinaryOp::GreaterEqual && op != EBinaryOp::NotEqual)
+                {
+                    return std::nullopt;
+                }
+
+                // Counted rather than computed, which also rejects loops that would overflow or never end
+                for (auto value = induction.start; holds(value); value += induction.step)
+                {
+                    if (induction.iterations++ == MAX_COUNTED_ITERATIONS || value < INT_MIN || value > INT_MAX)
+                    {
+                        return std::nullopt;
+                    }
+                }
+
+                if (Writes(loop->scope, name)) return std::nullopt;
+                return induction;
+            }
+
+            // A copy of the loop body with the induction variable replaced by value
+            static std::vector<std::shared_ptr<Node>> Iteration(const std::shared_ptr<ForNode>& loop,
+                                                                const std::string& name,
+                                                                const std::shared_ptr<Node>& value)
+            {
+                auto copy = clone(loop->scope);
+                substituteInScope(copy->statements, {{name, value}});
+                if (std::ranges::any_of(copy->statements, [](const std::shared_ptr<Node>& statement)
+                {
+                    auto target = statement->nodeType == NodeType::Assign
+                                      ? std::dynamic_pointer_cast<AssignNode>(statement)->target
+                                      : statement;
+                    return std::dynamic_pointer_cast<DeclarationNode>(target) || target->nodeType == NodeType::Const;
+                }))
+                {
+                    // Locals of each iteration stay apart
+                    return {copy};
+                }
+                return copy->statements;
+            }
+
+            static std::shared_ptr<Node> IntLiteral(int64_t value)
+            {
+                std::shared_ptr<Node> literal = std::make_shared<IntegerLiteralNode>(
+                    static_cast<int>(value < 0 ? -value : value));
+                return value < 0 ? std::make_shared<NegateNode>(literal) : literal;
+            }
+
+            // The statements replacing loop, or nullopt to keep it
+            std::optional<std::vector<std::shared_ptr<Node>>> Unroll(const std::shared_ptr<ForNode>& loop)
+            {
+                auto induction = InductionOf(loop);
+                if (!induction) return std::nullopt;
+
+                size_t size = 0;
+                walk(loop->scope, [&size](const std::shared_ptr<Node>& node)
+                {
+                    if (node) size++;
+                    return node != nullptr;
+                });
+
+                std::vector<std::shared_ptr<Node>> result{};
+                auto& name = induction->name;
+                if (induction->iterations <= _options.maxIterations &&
+                    induction->iterations * size <= _options.maxSize)
+                {
+                    for (size_t i = 0; i < induction->iterations; i++)
+                    {
+                        auto value = induction->start + static_cast<int64_t>(i) * induction->step;
+                        auto iteration = Iteration(loop, name, IntLiteral(value));
+                        result.insert(result.end(), iteration.begin(), iteration.end());
+                    }
+                    // Inner loops bounded by the variable have constant bounds in each copy
+                    UnrollIn(result);
+                    return result;
+                }
+
+                // Otherwise the body is repeated as many times as evenly divides the iterations
+                auto factor = std::min(_options.partialFactor, _options.maxSize / std::max<size_t>(size, 1));
+                while (factor > 1 && induction->iterations % factor != 0) factor--;
+                if (factor < 2) return std::nullopt;
+
+                auto scope = std::make_shared<ScopeNode>(std::vector<std::shared_ptr<Node>>{});
+                for (size_t i = 0; i < factor; i++)
+                {
+                    std::vector<std::shared_ptr<Node>> iteration{};
+                    if (i == 0)
+                    {
+                        iteration = Iteration(loop, name, std::make_shared<IdentifierNode>(name));
+                    }
+                    else
+                    {
+                        auto offset = std::make_shared<BinaryOpNode>(std::make_shared<IdentifierNode>(name),
+                                                                     IntLiteral(static_cast<int64_t>(i) *
+                                                                                induction->step),
+                                                                     EBinaryOp::Add);
+                        iteration = Iteration(loop, name, offset);
+                    }
+                    scope->statements.insert(scope->statements.end(), iteration.begin(), iteration.end());
+                }
+
+                auto update = std::make_shared<AssignNode>(
+                    std::make_shared<IdentifierNode>(name),
+                    std::make_shared<BinaryOpNode>(std::make_shared<IdentifierNode>(name),
+                                                   IntLiteral(static_cast<int64_t>(factor) * induction->step),
+                                                   EBinaryOp::Add));
+                return std::vector<std::shared_ptr<Node>>{
+                    std::make_shared<ForNode>(loop->init, loop->condition, update, scope)
+                };
+            }
+
+            void UnrollNested(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Scope:
+                    UnrollIn(std::dynamic_pointer_cast<ScopeNode>(node)->statements);
+                    break;
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(node);
+                        UnrollIn(asIf->scope->statements);
+                        UnrollNested(asIf->elseNode);
+                    }
+                    break;
+                case NodeType::For:
+                    UnrollIn(std::dynamic_pointer_cast<ForNode>(node)->scope->statements);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            // Inner loops are unrolled first so the size of an outer loop includes them
+            void UnrollIn(std::vector<std::shared_ptr<Node>>& statements)
+            {
+                std::vector<std::shared_ptr<Node>> result{};
+                for (auto& statement : statements)
+                {
+                    UnrollNested(statement);
+                    auto asFor = std::dynamic_pointer_cast<ForNode>(statement);
+                    auto unrolled = asFor ? Unroll(asFor) : std::nullopt;
+                    if (unrolled) result.insert(result.end(), unrolled->begin(), unrolled->end());
+                    else result.push_back(statement);
+                }
+                statements = result;
+            }
+
+        public:
+            explicit LoopUnroller(const UnrollOptions& inOptions) : _options(inOptions)
+            {
+            }
+
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                for (auto& statement : module->statements)
+                {
+                    if (auto asFunction = std::dynamic_pointer_cast<FunctionNode>(statement))
+                    {
+                        _functions.insert(asFunction->name);
+                    }
+                }
+                for (auto& statement : module->statements)
+                {
+                    if (auto asFunction = std::dynamic_pointer_cast<FunctionNode>(statement))
+                    {
+                        UnrollIn(asFunction->scope->statements);
+                    }
+                }
+            }
+        };
+
+        // Value of a scalar literal, negated, in parentheses or splat by a vector constructor
+        std::optional<double> scalarValueOf(const std::shared_ptr<Node>& node)
+        {
+            switch (node->nodeType)
+            {
+            case NodeType::FloatLiteral:
+                return std::dynamic_pointer_cast<FloatLiteralNode>(node)->data;
+            case NodeType::IntLiteral:
+                return static_cast<double>(std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data);
+            case NodeType::BooleanLiteral:
+                return std::dynamic_pointer_cast<BooleanLiteralNode>(node)->data ? 1.0 : 0.0;
+            case NodeType::Negate:
+                if (auto value = scalarValueOf(std::dynamic_pointer_cast<NegateNode>(node)->target)) return -*value;
+                return std::nullopt;
+            case NodeType::Precedence:
+                return scalarValueOf(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+            case NodeType::Call:
+                {
+                    auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                    // Matrices put a single value on the diagonal only
+                    if (!LITERAL_TYPES.contains(asCall->identifier->id) || componentsOf(asCall->identifier->id) == 0 ||
+                        asCall->args.size() != 1)
+                    {
+                        return std::nullopt;
+                    }
+                    return scalarValueOf(asCall->args.front());
+                }
+            default:
+                return std::nullopt;
+            }
+        }
+
+        // Node without the parentheses around it, for places that take any expression
+        std::shared_ptr<Node> unparenthesize(std::shared_ptr<Node> node)
+        {
+            while (node && node->nodeType == NodeType::Precedence)
+            {
+                node = std::dynamic_pointer_cast<PrecedenceNode>(node)->target;
+            }
+            return node;
+        }
+
+        // Rewrites operators and builtin calls into cheaper forms that give the same value. Each rule checks the
+        // types involved so the rewritten expression keeps the type of the original.
+        class ExpressionSimplifier : ExpressionTyper
+        {
+            // Whether each int local in scope is known never to be negative
+            std::vector<std::unordered_map<std::string, bool>> _nonNegative{};
+            // Names the function being simplified writes after declaring them, or declares more than once
+            std::unordered_set<std::string> _reassigned{};
+            // Functions of the module, whose calls may have side effects
+            std::unordered_set<std::string> _calls{};
+            std::unordered_set<std::string> _defineNames{};
+
+            void PushScope()
+            {
+                _scopes.emplace_back();
+                _nonNegative.emplace_back();
+            }
+
+            void PopScope()
+            {
+                _scopes.pop_back();
+                _nonNegative.pop_back();
+            }
+
+            [[nodiscard]] std::unordered_set<std::string> Reassigned(const std::shared_ptr<FunctionNode>& function) const
+            {
+                std::unordered_set<std::string> declared{};
+                std::unordered_set<std::string> reassigned{};
+                const auto write = [&reassigned](const std::shared_ptr<Node>& target)
+                {
+                    if (auto root = rootOf(target)) reassigned.insert(root->id);
+                };
+                walk(function->scope, [&](const std::shared_ptr<Node>& node)
+                {
+                    if (!node) return false;
+
+                    switch (node->nodeType)
+                    {
+                    case NodeType::Declaration:
+                        {
+                            auto& name = std::dynamic_pointer_cast<DeclarationNode>(node)->declarationName;
+                            if (!declared.insert(name).second) reassigned.insert(name);
+                        }
+                        break;
+                    case NodeType::Assign:
+                        write(std::dynamic_pointer_cast<AssignNode>(node)->target);
+                        break;
+                    case NodeType::Increment:
+                        write(std::dynamic_pointer_cast<IncrementNode>(node)->target);
+                        break;
+                    case NodeType::Decrement:
+                        write(std::dynamic_pointer_cast<DecrementNode>(node)->target);
+                        break;
+                    case NodeType::Call:
+                        {
+                            auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                            for (size_t i = 0; i < asCall->args.size(); i++)
+                            {
+                                if (IsOutArgument(asCall->identifier->id, i)) write(asCall->args[i]);
+                            }
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                    return true;
+                });
+                return reassigned;
+            }
+
+            // Whether an int expression can be shown never to be negative. Sums and products may overflow, so only
+            // quotients and remainders of values that are not negative count.
+            [[nodiscard]] bool IsNonNegative(const std::shared_ptr<Node>& node) const
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::IntLiteral:
+                    return true;
+                case NodeType::Precedence:
+                    return IsNonNegative(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+                case NodeType::Identifier:
+                    {
+                        auto& id = std::dynamic_pointer_cast<IdentifierNode>(node)->id;
+                        for (auto it = _nonNegative.rbegin(); it != _nonNegative.rend(); ++it)
+                        {
+                            if (auto found = it->find(id); found != it->end()) return found->second;
+                        }
+                        return id == "gl_VertexIndex" || id == "gl_InstanceIndex";
+                    }
+                case NodeType::BinaryOp:
+                    {
+                        auto asBinaryOp = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                        return (asBinaryOp->op == EBinaryOp::Divide || asBinaryOp->op == EBinaryOp::Mod) &&
+                            IsNonNegative(asBinaryOp->left) && IsNonNegative(asBinaryOp->right);
+                    }
+                default:
+                    return false;
+                }
+            }
+
+            void DeclareLocal(const std::shared_ptr<Node>& statement)
+            {
+                if (!statement) return;
+                DeclareStatement(statement);
+
+                auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+                auto target = asAssign ? asAssign->target : statement;
+                if (auto asConst = std::dynamic_pointer_cast<ConstNode>(target)) target = asConst->declaration;
+                auto declaration = std::dynamic_pointer_cast<DeclarationNode>(target);
+                if (!declaration) return;
+
+                _nonNegative.back().insert_or_assign(
+                    declaration->declarationName,
+                    asAssign && declaration->declarationType == EDeclarationType::Int &&
+                    declaration->declarationCount == 1 && !_reassigned.contains(declaration->declarationName) &&
+                    IsNonNegative(asAssign->value));
+            }
+
+            // Node placed where an operand binding at least minPrecedence is needed, in parentheses if it binds looser
+            [[nodiscard]] std::shared_ptr<Node> Fit(const std::shared_ptr<Node>& node, int minPrecedence) const
+            {
+                if (precedenceOf(node, _defineNames) >= minPrecedence) return node;
+                return std::make_shared<PrecedenceNode>(node);
+            }
+
+            [[nodiscard]] bool HasType(const std::shared_ptr<Node>& node, const std::string& typeName) const
+            {
+                auto type = TypeOf(node);
+                return type && type->count == 1 && type->name == typeName;
+            }
+
+            // Operand when the other side of the operator is the identity splat, provided nothing about the type
+            // changes. The other side is a literal, so dropping it has no effect to lose.
+            [[nodiscard]] std::shared_ptr<Node> WithoutIdentity(const std::shared_ptr<BinaryOpNode>& node,
+                                                                const std::shared_ptr<Node>& operand,
+                                                                const std::shared_ptr<Node>& other,
+                                                                double identity) const
+            {
+                if (scalarValueOf(other) != identity) return {};
+
+                auto type = TypeOf(node);
+                return type && HasType(operand, type->name) ? operand : nullptr;
+            }
+
+            std::shared_ptr<Node> SimplifyBinaryOp(const std::shared_ptr<BinaryOpNode>& node) const
+            {
+                std::shared_ptr<Node> result{};
+                switch (node->op)
+                {
+                case EBinaryOp::Multiply:
+                    result = WithoutIdentity(node, node->left, node->right, 1.0);
+                    if (!result) result = WithoutIdentity(node, node->right, node->left, 1.0);
+                    break;
+                case EBinaryOp::Add:
+                    result = WithoutIdentity(node, node->left, node->right, 0.0);
+                    if (!result) result = WithoutIdentity(node, node->right, node->left, 0.0);
+                    break;
+                case EBinaryOp::Subtract:
+                    result = WithoutIdentity(node, node->left, node->right, 0.0);
+                    break;
+                case EBinaryOp::Divide:
+                    {
+                        result = WithoutIdentity(node, node->left, node->right, 1.0);
+                        if (result) break;
+
+                        // GLSL allows division 2.5 ULP of error, which a multiplication by the rounded reciprocal
+                        // stays within. Powers of two have exact reciprocals and give the same result.
+                        auto divisor = unparenthesize(node->right);
+                        auto magnitude = divisor->nodeType == NodeType::Negate
+                                             ? std::dynamic_pointer_cast<NegateNode>(divisor)->target
+                                             : divisor;
+                        auto type = TypeOf(node->left);
+                        if (magnitude->nodeType != NodeType::FloatLiteral || !type || type->count != 1 ||
+                            (!type->name.starts_with("float") && !type->name.starts_with("mat")))
+                        {
+                            break;
+                        }
+
+                        const auto reciprocal = 1.0f / static_cast<float>(*scalarValueOf(divisor));
+                        if (!std::isnormal(reciprocal)) break;
+                        return std::make_shared<BinaryOpNode>(node->left,
+                                                              makeScalar('f', std::bit_cast<uint32_t>(reciprocal)),
+                                                              EBinaryOp::Multiply);
+                    }
+                default:
+                    break;
+                }
+                return result ? result : node;
+            }
+
+            // pow with a small constant exponent as multiplications, or sqrt for halves
+            [[nodiscard]] std::shared_ptr<Node> ExpandPow(const std::shared_ptr<CallNode>& node) const
+            {
+                auto& base = node->args[0];
+                auto exponent = scalarValueOf(node->args[1]);
+                auto type = TypeOf(base);
+                // Ints are converted by pow but would not be by an operator
+                if (!exponent || !type || type->count != 1 || !type->name.starts_with("float") ||
+                    !isPure(base, _calls))
+                {
+                    return {};
+                }
+
+                const auto call = [](const std::string& name, const std::shared_ptr<Node>& arg)
+                {
+                    return std::make_shared<CallNode>(std::make_shared<IdentifierNode>(name),
+                                                      std::vector<std::shared_ptr<Node>>{arg});
+                };
+                const auto multiply = [](const std::shared_ptr<Node>& left, const std::shared_ptr<Node>& right)
+                {
+                    return std::make_shared<BinaryOpNode>(left, right, EBinaryOp::Multiply);
+                };
+                const auto copy = [&base] { return parenthesize(cloneNode(base)); };
+
+                if (*exponent == 0.5) return call("sqrt", base);
+                if (*exponent == -0.5) return call("inversesqrt", base);
+                if (*exponent == 1.0) return base;
+                if (*exponent == 2.0) return multiply(copy(), copy());
+                if (*exponent == 3.0) return multiply(multiply(copy(), copy()), copy());
+                if (*exponent == 4.0)
+                {
+                    // The repeated square is left for common subexpression elimination to compute once
+                    return multiply(multiply(copy(), copy()), std::make_shared<PrecedenceNode>(multiply(copy(), copy())));
+                }
+                return {};
+            }
+
+            // Conversions of values to the type they already have, and int conversions of mod and floor over ints,
+            // which GLSL computes in floats
+            [[nodiscard]] std::shared_ptr<Node> SimplifyConversion(const std::shared_ptr<CallNode>& node) const
+            {
+                auto& typeName = node->identifier->id;
+                auto& arg = node->args.front();
+                auto inner = std::dynamic_pointer_cast<CallNode>(unparenthesize(arg));
+
+                // The int quotient is already whole, floor only converted it to a float
+                if (inner && inner->identifier->id == "floor" && inner->args.size() == 1 &&
+                    typeName.starts_with("int") && HasType(inner->args.front(), typeName))
+                {
+                    return inner->args.front();
+                }
+
+                // A remainder of a value that is not negative by a positive divisor matches the floored mod
+                if (inner && inner->identifier->id == "mod" && inner->args.size() == 2 && typeName == "int" &&
+                    HasType(inner->args[0], "int") && intLiteralOf(inner->args[1]).value_or(0) > 0 &&
+                    IsNonNegative(inner->args[0]))
+                {
+                    return std::make_shared<BinaryOpNode>(Fit(inner->args[0], 13), Fit(inner->args[1], 14),
+                                                          EBinaryOp::Mod);
+                }
+
+                return HasType(arg, typeName) ? arg : nullptr;
+            }
+
+            std::shared_ptr<Node> SimplifyCall(const std::shared_ptr<CallNode>& node) const
+            {
+                auto& name = node->identifier->id;
+                auto& args = node->args;
+                if (_functions.contains(name)) return node;
+
+                std::shared_ptr<Node> result{};
+                if (LITERAL_TYPES.contains(name) && componentsOf(name) > 0 && args.size() == 1)
+                {
+                    result = SimplifyConversion(node);
+                }
+                else if (name == "pow" && args.size() == 2)
+                {
+                    result = ExpandPow(node);
+                }
+                else if (name == "mix" && args.size() == 3)
+                {
+                    // Selecting one side drops the other, which must not have side effects
+                    auto weight = scalarValueOf(args[2]);
+                    if (weight == 0.0 && isPure(args[1], _calls)) result = args[0];
+                    if (weight == 1.0 && isPure(args[0], _calls)) result = args[1];
+                }
+                return result ? result : node;
+            }
+
+            // Returns the simplified node, which may bind looser than the original. Operands are simplified before the
+            // operator that uses them and put in parentheses where the simplified form needs them.
+            std::shared_ptr<Node> Simplify(const std::shared_ptr<Node>& node)
+            {
+                if (!node) return node;
+
+                switch (node->nodeType)
+                {
+                case NodeType::Declaration:
+                case NodeType::Const:
+                    return node;
+                case NodeType::Scope:
+                    PushScope();
+                    SimplifyStatements(std::dynamic_pointer_cast<ScopeNode>(node)->statements);
+                    PopScope();
+                    return node;
+                case NodeType::If:
+                    {
+                        auto asIf = std::dynamic_pointer_cast<IfNode>(node);
+                        asIf->condition = unparenthesize(Simplify(asIf->condition));
+                        Simplify(asIf->scope);
+                        asIf->elseNode = Simplify(asIf->elseNode);
+                        return node;
+                    }
+                case NodeType::For:
+                    {
+                        auto asFor = std::dynamic_pointer_cast<ForNode>(node);
+                        PushScope();
+                        asFor->init = Simplify(asFor->init);
+                        DeclareLocal(asFor->init);
+                        asFor->condition = unparenthesize(Simplify(asFor->condition));
+                        asFor->update = Simplify(asFor->update);
+                        Simplify(asFor->scope);
+                        PopScope();
+                        return node;
+                    }
+                case NodeType::Assign:
+                    {
+                        auto asAssign = std::dynamic_pointer_cast<AssignNode>(node);
+                        asAssign->value = unparenthesize(Simplify(asAssign->value));
+                        asAssign->target = Simplify(asAssign->target);
+                        return node;
+                    }
+                case NodeType::Return:
+                    {
+                        auto asReturn = std::dynamic_pointer_cast<ReturnNode>(node);
+                        asReturn->expression = unparenthesize(Simplify(asReturn->expression));
+                        return node;
+                    }
+                case NodeType::Access:
+                    {
+                        // Members and swizzles on the right are names rather than values
+                        auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                        asAccess->left = Fit(Simplify(asAccess->left), POSTFIX_OPERAND);
+                        return node;
+                    }
+                case NodeType::Index:
+                    {
+                        auto asIndex = std::dynamic_pointer_cast<IndexNode>(node);
+                        asIndex->left = Fit(Simplify(asIndex->left), POSTFIX_OPERAND);
+                        asIndex->indexExpression = unparenthesize(Simplify(asIndex->indexExpression));
+                        return node;
+                    }
+                case NodeType::Precedence:
+                    {
+                        auto asPrecedence = std::dynamic_pointer_cast<PrecedenceNode>(node);
+                        asPrecedence->target = unparenthesize(Simplify(asPrecedence->target));
+                        auto result = parenthesize(asPrecedence->target);
+                        return result == asPrecedence->target ? result : node;
+                    }
+                case NodeType::Call:
+                    {
+                        // The callee is a name rather than a value, so only the arguments are simplified
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        for (auto& arg : asCall->args) arg = unparenthesize(Simplify(arg));
+                        return SimplifyCall(asCall);
+                    }
+                case NodeType::BinaryOp:
+                    {
+                        // Every binary operator is left associative
+                        auto asBinaryOp = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                        const auto precedence = precedenceOf(node, _defineNames);
+                        asBinaryOp->left = Fit(Simplify(asBinaryOp->left), precedence);
+                        asBinaryOp->right = Fit(Simplify(asBinaryOp->right), precedence + 1);
+                        return SimplifyBinaryOp(asBinaryOp);
+                    }
+                case NodeType::Negate:
+                    {
+                        auto asNegate = std::dynamic_pointer_cast<NegateNode>(node);
+                        asNegate->target = Fit(Simplify(asNegate->target), UNARY_OPERAND);
+                        return node;
+                    }
+                default:
+                    transformChildren(node, [this](const std::shared_ptr<Node>& child)
+                    {
+                        auto result = Simplify(child);
+                        return result == child ? result : parenthesize(result);
+                    });
+                    return node;
+                }
+            }
+
+            // Whether statement assigns a variable to itself and does nothing
+            [[nodiscard]] bool IsSelfAssignment(const std::shared_ptr<Node>& statement) const
+            {
+                auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+                return asAssign && asAssign->target && asAssign->value &&
+                    asAssign->target->nodeType != NodeType::Declaration && isPure(asAssign->target, _calls) &&
+                    asAssign->target->IsSameAs(*unparenthesize(asAssign->value));
+            }
+
+            void SimplifyStatements(std::vector<std::shared_ptr<Node>>& statements)
+            {
+                for (auto it = statements.begin(); it != statements.end();)
+                {
+                    auto statement = Simplify(*it);
+                    if (IsSelfAssignment(statement))
+                    {
+                        it = statements.erase(it);
+                        continue;
+                    }
+
+                    *it = statement;
+                    DeclareLocal(statement);
+                    ++it;
+                }
+            }
+
+        public:
+            void Run(const std::shared_ptr<ModuleNode>& module)
+            {
+                PushScope();
+                for (auto& statement : module->statements)
+                {
+                    auto asFunction = std::dynamic_pointer_cast<FunctionNode>(statement);
+                    if (!asFunction)
+                    {
+                        if (auto asDefine = std::dynamic_pointer_cast<DefineNode>(statement))
+                        {
+                            _defineNames.insert(asDefine->id);
+                        }
+                        DeclareGlobal(statement);
+                        continue;
+                    }
+
+                    // Functions are declared before they are called, so their callees are already known
+                    _functions[asFunction->name].push_back(asFunction);
+                    _calls.insert(asFunction->name);
+                    _reassigned = Reassigned(asFunction);
+
+                    PushScope();
+                    for (auto& argument : asFunction->arguments)
+                    {
+                        Declare(argument->declaration);
+                        _nonNegative.back().insert_or_assign(argument->declaration->declarationName, false);
+                    }
+                    SimplifyStatements(asFunction->scope->statements);
+                    PopScope();
+                }
+                PopScope();
+            }
+        };
+    }
+
+    void shortenIdentifiers(const std::shared_ptr<ModuleNode>& module)
+    {
+        IdentifierShortener().Run(module);
+    }
+
+    void removeRedundantParentheses(const std::shared_ptr<ModuleNode>& module)
+    {
+        std::unordered_set<std::string> defines{};
+        for (auto& statement : module->statements)
+        {
+            if (statement->nodeType == NodeType::Define)
+            {
+                defines.insert(std::dynamic_pointer_cast<DefineNode>(statement)->id);
+            }
+        }
+
+        for (auto& statement : module->statements)
+        {
+            statement = removeParentheses(statement, 0, defines);
+        }
+    }
+
+    std::vector<MemberReorder> reorderMembers(const std::shared_ptr<ModuleNode>& module)
+    {
+        StructLookup structs{};
+        for (auto& statement : module->statements)
+        {
+            if (auto asStruct = std::dynamic_pointer_cast<StructNode>(statement))
+            {
+                structs.insert_or_assign(asStruct->name, asStruct);
+            }
+        }
+
+        auto blocks = collectHostBlocks(module);
+        std::vector<MemberReorder> result{};
+        for (auto& block : blocks)
+        {
+            result.push_back({block.name, block.rule, layoutOf(block.name, *block.declarations, block.rule, structs).size});
+        }
+
+        // Structs come first since blocks contain them. A struct can be used by blocks of either rule, and by both
+        // stages which are compiled separately, so it is ordered for std140 and std430 together instead of for the
+        // blocks that happen to use it.
+        std::unordered_map<std::string, std::vector<size_t>> permutations{};
+        for (auto& statement : module->statements)
+        {
+            auto asStruct = std::dynamic_pointer_cast<StructNode>(statement);
+            if (!asStruct) continue;
+
+            auto order = smallestOrder(asStruct->name, asStruct->declarations,
+                                       {ELayoutRule::Std140, ELayoutRule::Std430}, structs);
+            if (applyOrder(asStruct->declarations, order))
+            {
+                permutations.emplace(asStruct->name, order);
+            }
+        }
+
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            auto& block = blocks[i];
+            applyOrder(*block.declarations, smallestOrder(block.name, *block.declarations, {block.rule}, structs));
+            result[i].sizeAfter = layoutOf(block.name, *block.declarations, block.rule, structs).size;
+        }
+
+        // Constructor arguments follow the new member order
+        if (!permutations.empty())
+        {
+            walk(module, [&permutations](const std::shared_ptr<Node>& node)
+            {
+                if (!node) return false;
+                if (node->nodeType != NodeType::Call) return true;
+
+                auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                if (auto found = permutations.find(asCall->identifier->id); found != permutations.end() &&
+                    found->second.size() == asCall->args.size())
+                {
+                    std::vector<std::shared_ptr<Node>> args{};
+                    for (auto index : found->second) args.push_back(asCall->args[index]);
+                    asCall->args = args;
+                }
+                return true;
+            });
+        }
+
+        resolveReferences(module);
+        return result;
+    }
+
+    void foldConstants(const std::shared_ptr<ModuleNode>& module)
+    {
+        ConstantFolder().Run(module);
+    }
+
+    void removeUnusedDeclarations(const std::shared_ptr<ModuleNode>& module)
+    {
+        auto& statements = module->statements;
+        if (!hasMain(module)) return;
+
+        // Overloads share a name, so a name can refer to several statements
+        std::unordered_map<std::string, std::vector<size_t>> declared{};
+        std::vector<bool> used(statements.size(), false);
+        std::vector<size_t> pending{};
+        for (size_t i = 0; i < statements.size(); i++)
+        {
+            auto name = referenceNameOf(statements[i]);
+            if (!name || *name == "main")
+            {
+                used[i] = true;
+                pending.push_back(i);
+            }
+            else
+            {
+                declared[*name].push_back(i);
+            }
+        }
+
+        std::vector<std::string> names{};
+        while (!pending.empty())
+        {
+            auto index = pending.back();
+            pending.pop_back();
+
+            names.clear();
+            collectReferences(statements[index], names);
+            for (auto& name : names)
+            {
+                auto found = declared.find(name);
+                if (found == declared.end()) continue;
+
+                for (auto target : found->second)
+                {
+                    if (used[target]) continue;
+                    used[target] = true;
+                    pending.push_back(target);
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<Node>> kept{};
+        for (size_t i = 0; i < statements.size(); i++)
+        {
+            if (used[i]) kept.push_back(statements[i]);
+        }
+        statements = kept;
+    }
+
+    void removeDeadStores(const std::shared_ptr<ModuleNode>& module)
+    {
+        DeadStoreRemover().Run(module);
+    }
+
+    void linkStages(const std::shared_ptr<ModuleNode>& vertex, const std::shared_ptr<ModuleNode>& fragment)
+    {
+        if (!hasMain(vertex) || !hasMain(fragment)) return;
+
+        // Reads from code that is never called or only feeds dead stores do not count
+        for (auto& module : {vertex, fragment})
+        {
+            removeDeadStores(module);
+            removeUnusedDeclarations(module);
+            removeUnreadInputs(module);
+        }
+
+        const auto inputs = layoutsOf(fragment, ELayoutType::Input);
+
+        // Outputs nothing consumes become private globals, removed along with their stores when those are pure and
+        // kept when they are passed as out arguments
+        auto demoted = false;
+        for (auto& statement : vertex->statements)
+        {
+            auto asLayout = std::dynamic_pointer_cast<LayoutNode>(statement);
+            if (!asLayout || asLayout->layoutType != ELayoutType::Output || matchingInput(inputs, asLayout)) continue;
+
+            statement = asLayout->declaration;
+            demoted = true;
+        }
+
+        if (demoted)
+        {
+            removeDeadStores(vertex);
+            removeUnusedDeclarations(vertex);
+        }
+    }
+
+    void packVaryings(const std::shared_ptr<ModuleNode>& vertex, const std::shared_ptr<ModuleNode>& fragment)
+    {
+        if (!hasMain(vertex) || !hasMain(fragment)) return;
+
+        const auto inputs = layoutsOf(fragment, ELayoutType::Input);
+        std::vector<Varying> varyings{};
+        for (auto& output : layoutsOf(vertex, ELayoutType::Output))
+        {
+            auto varying = varyingOf(*output->declaration);
+            auto input = matchingInput(inputs, output);
+            // Inputs without an output are undefined already, moving them could make them alias a real varying
+            if (!varying || !input || !varyingOf(*input->declaration)) return;
+
+            varying->output = output;
+            varying->input = input;
+            varying->isFlat = varying->isInt || output->tags.contains("$flat") || input->tags.contains("$flat");
+            varyings.push_back(*varying);
+        }
+        if (varyings.size() != inputs.size()) return;
+
+        uint32_t nextLocation = 0;
+        for (auto& varying : varyings)
+        {
+            if (varying.components != 0) continue;
+            placeVarying(varying, nextLocation, 0);
+            nextLocation += varying.locations;
+        }
+
+        // First fit by decreasing size
+        std::vector<Varying*> packed{};
+        for (auto& varying : varyings)
+        {
+            if (varying.components != 0) packed.push_back(&varying);
+        }
+        std::ranges::stable_sort(packed, [](const Varying* a, const Varying* b)
+        {
+            return a->components > b->components;
+        });
+
+        struct Slot
+        {
+            uint32_t location = 0;
+            uint32_t used = 0;
+            bool isInt = false;
+            bool isFlat = false;
+        };
+        std::vector<Slot> slots{};
+        for (auto varying : packed)
+        {
+            auto slot = std::ranges::find_if(slots, [varying](const Slot& candidate)
+            {
+                return candidate.isInt == varying->isInt && candidate.isFlat == varying->isFlat &&
+                    candidate.used + varying->components <= 4;
+            });
+            if (slot == slots.end())
+            {
+                slots.push_back({nextLocation++, 0, varying->isInt, varying->isFlat});
+                slot = slots.end() - 1;
+            }
+
+            placeVarying(*varying, slot->location, slot->used);
+            slot->used += varying->components;
+        }
+    }
+
+    void inlineFunctions(const std::shared_ptr<ModuleNode>& module, const InlineOptions& options)
+    {
+        Inliner(options).Run(module);
+    }
+
+    void eliminateCommonSubexpressions(const std::shared_ptr<ModuleNode>& module)
+    {
+        CommonSubexpressionEliminator().Run(module);
+    }
+
+    void unrollLoops(const std::shared_ptr<ModuleNode>& module, const UnrollOptions& options)
+    {
+        LoopUnroller(options).Run(module);
+    }
+
+    void simplifyExpressions(const std::shared_ptr<ModuleNode>& module)
+    {
+        ExpressionSimplifier().Run(module);
+    }
+}
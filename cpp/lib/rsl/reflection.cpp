@@ -0,0 +1,308 @@
+#include "rsl/reflection.hpp"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace rsl
+{
+    namespace
+    {
+        constexpr size_t HEADER_WORDS = 8;
+        constexpr size_t RESOURCE_WORDS = 10;
+        constexpr size_t MEMBER_WORDS = 10;
+        constexpr size_t INTERFACE_WORDS = 6;
+
+        // Sections in the order they are stored, also the header word holding their count
+        constexpr size_t RESOURCES = 3;
+        constexpr size_t MEMBERS = 4;
+        constexpr size_t INPUTS = 5;
+        constexpr size_t OUTPUTS = 6;
+        constexpr size_t STRINGS = 7;
+
+        class BlobBuilder
+        {
+            std::vector<uint32_t> _resources{};
+            std::vector<uint32_t> _members{};
+            std::vector<uint32_t> _inputs{};
+            std::vector<uint32_t> _outputs{};
+            std::string _strings{};
+            std::unordered_map<std::string, uint32_t> _stringOffsets{};
+
+            uint32_t String(const std::string& text)
+            {
+                if (auto found = _stringOffsets.find(text); found != _stringOffsets.end()) return found->second;
+
+                const auto offset = static_cast<uint32_t>(_strings.size());
+                _strings += text;
+                _strings += '\0';
+                _stringOffsets.emplace(text, offset);
+                return offset;
+            }
+
+            // Reserves consecutive records for members before recursing, so siblings stay next to each other
+            uint32_t Members(const std::vector<MemberLayout>& members)
+            {
+                const auto first = static_cast<uint32_t>(_members.size() / MEMBER_WORDS);
+                _members.resize(_members.size() + members.size() * MEMBER_WORDS);
+                for (size_t i = 0; i < members.size(); i++)
+                {
+                    auto& member = members[i];
+                    const auto children = Members(member.members);
+                    const uint32_t record[MEMBER_WORDS] = {
+                        String(member.name), String(member.typeName), member.offset, member.size, member.alignment,
+                        static_cast<uint32_t>(member.arrayLength), member.arrayStride, member.matrixStride, children,
+                        static_cast<uint32_t>(member.members.size())
+                    };
+                    std::memcpy(&_members[(first + i) * MEMBER_WORDS], record, sizeof(record));
+                }
+                return first;
+            }
+
+            void Interface(std::vector<uint32_t>& section, const InterfaceReflection& variable)
+            {
+                section.insert(section.end(), {
+                                   String(variable.name), String(variable.typeName),
+                                   static_cast<uint32_t>(variable.location), static_cast<uint32_t>(variable.component),
+                                   static_cast<uint32_t>(variable.arrayLength), variable.isFlat ? 1u : 0u
+                               });
+            }
+
+            static void Words(Writer& out, const std::vector<uint32_t>& words)
+            {
+                for (auto word : words)
+                {
+                    const char bytes[4] = {
+                        static_cast<char>(word & 0xff), static_cast<char>(word >> 8 & 0xff),
+                        static_cast<char>(word >> 16 & 0xff), static_cast<char>(word >> 24 & 0xff)
+                    };
+                    out << std::string_view(bytes, 4);
+                }
+            }
+
+        public:
+            void Build(const Reflection& reflection)
+            {
+                for (auto& resource : reflection.resources)
+                {
+                    auto& layout = resource.layout;
+                    const auto first = Members(layout.members);
+                    _resources.insert(_resources.end(), {
+                                          String(resource.name), static_cast<uint32_t>(resource.type),
+                                          static_cast<uint32_t>(resource.set), static_cast<uint32_t>(resource.binding),
+                                          resource.isReadonly ? 1u : 0u, static_cast<uint32_t>(layout.rule),
+                                          layout.size, layout.alignment, first,
+                                          static_cast<uint32_t>(layout.members.size())
+                                      });
+                }
+
+                for (auto& input : reflection.inputs) Interface(_inputs, input);
+                for (auto& output : reflection.outputs) Interface(_outputs, output);
+            }
+
+            void Write(Writer& out, EScopeType stage) const
+            {
+                Words(out, {
+                          REFLECTION_MAGIC, REFLECTION_VERSION, static_cast<uint32_t>(stage),
+                          static_cast<uint32_t>(_resources.size() / RESOURCE_WORDS),
+                          static_cast<uint32_t>(_members.size() / MEMBER_WORDS),
+                          static_cast<uint32_t>(_inputs.size() / INTERFACE_WORDS),
+                          static_cast<uint32_t>(_outputs.size() / INTERFACE_WORDS),
+                          static_cast<uint32_t>(_strings.size())
+                      });
+                Words(out, _resources);
+                Words(out, _members);
+                Words(out, _inputs);
+                Words(out, _outputs);
+                out << _strings;
+            }
+        };
+    }
+
+    void writeReflection(Writer& out, const Reflection& reflection, EScopeType stage)
+    {
+        BlobBuilder builder{};
+        builder.Build(reflection);
+        builder.Write(out, stage);
+    }
+
+    std::string writeReflection(const Reflection& reflection, EScopeType stage)
+    {
+        Writer out{};
+        writeReflection(out, reflection, stage);
+        return out.Take();
+    }
+
+    ReflectionReader::ReflectionReader(const void* data, size_t size) : _data(static_cast<const uint8_t*>(data)),
+                                                                          _size(size)
+    {
+        _valid = _data && Validate();
+    }
+
+    ReflectionReader::ReflectionReader(std::string_view data) : ReflectionReader(data.data(), data.size())
+    {
+    }
+
+    uint32_t ReflectionReader::Word(size_t index) const
+    {
+        auto bytes = _data + index * 4;
+        return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+            static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+    }
+
+    size_t ReflectionReader::RecordStart(size_t section) const
+    {
+        auto start = HEADER_WORDS;
+        if (section > RESOURCES) start += Word(RESOURCES) * RESOURCE_WORDS;
+        if (section > MEMBERS) start += Word(MEMBERS) * MEMBER_WORDS;
+        if (section > INPUTS) start += Word(INPUTS) * INTERFACE_WORDS;
+        if (section > OUTPUTS) start += Word(OUTPUTS) * INTERFACE_WORDS;
+        return start;
+    }
+
+    std::string_view ReflectionReader::String(uint32_t offset) const
+    {
+        return reinterpret_cast<const char*>(_data + RecordStart(STRINGS) * 4 + offset);
+    }
+
+    bool ReflectionReader::Validate() const
+    {
+        if (_size < HEADER_WORDS * 4 || Word(0) != REFLECTION_MAGIC || Word(1) != REFLECTION_VERSION ||
+            Word(2) > static_cast<uint32_t>(EScopeType::Vertex))
+        {
+            return false;
+        }
+
+        // Counts are checked in 64 bits so a corrupt header cannot wrap around
+        const uint64_t words = HEADER_WORDS + static_cast<uint64_t>(Word(RESOURCES)) * RESOURCE_WORDS +
+            static_cast<uint64_t>(Word(MEMBERS)) * MEMBER_WORDS +
+            (static_cast<uint64_t>(Word(INPUTS)) + Word(OUTPUTS)) * INTERFACE_WORDS;
+        const uint64_t stringsSize = Word(STRINGS);
+        if (words * 4 + stringsSize != _size) return false;
+        if (stringsSize > 0 && _data[_size - 1] != '\0') return false;
+
+        const auto validString = [&](uint32_t offset) { return offset < stringsSize; };
+        const auto validRange = [&](uint32_t first, uint32_t count)
+        {
+            return static_cast<uint64_t>(first) + count <= Word(MEMBERS);
+        };
+
+        for (size_t i = 0, start = RecordStart(RESOURCES); i < Word(RESOURCES); i++, start += RESOURCE_WORDS)
+        {
+            if (!validString(Word(start)) || Word(start + 1) > static_cast<uint32_t>(EResourceType::Opaque) ||
+                Word(start + 5) > static_cast<uint32_t>(ELayoutRule::Scalar) ||
+                !validRange(Word(start + 8), Word(start + 9)))
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0, start = RecordStart(MEMBERS); i < Word(MEMBERS); i++, start += MEMBER_WORDS)
+        {
+            if (!validString(Word(start)) || !validString(Word(start + 1)) ||
+                !validRange(Word(start + 8), Word(start + 9)))
+            {
+                return false;
+            }
+        }
+
+        const auto interfaceCount = static_cast<size_t>(Word(INPUTS)) + Word(OUTPUTS);
+        for (size_t i = 0, start = RecordStart(INPUTS); i < interfaceCount; i++, start += INTERFACE_WORDS)
+        {
+            if (!validString(Word(start)) || !validString(Word(start + 1))) return false;
+        }
+
+        return true;
+    }
+
+    bool ReflectionReader::IsValid() const
+    {
+        return _valid;
+    }
+
+    EScopeType ReflectionReader::GetStage() const
+    {
+        return _valid ? static_cast<EScopeType>(Word(2)) : EScopeType::Fragment;
+    }
+
+    uint32_t ReflectionReader::GetResourceCount() const
+    {
+        return _valid ? Word(RESOURCES) : 0;
+    }
+
+    ResourceInfo ReflectionReader::GetResource(uint32_t index) const
+    {
+        const auto start = RecordStart(RESOURCES) + index * RESOURCE_WORDS;
+        ResourceInfo result{};
+        result.name = String(Word(start));
+        result.type = static_cast<EResourceType>(Word(start + 1));
+        result.set = static_cast<int>(Word(start + 2));
+        result.binding = static_cast<int>(Word(start + 3));
+        result.isReadonly = Word(start + 4) != 0;
+        result.rule = static_cast<ELayoutRule>(Word(start + 5));
+        result.size = Word(start + 6);
+        result.alignment = Word(start + 7);
+        result.firstMember = Word(start + 8);
+        result.memberCount = Word(start + 9);
+        return result;
+    }
+
+    int ReflectionReader::FindResource(std::string_view name) const
+    {
+        for (uint32_t i = 0; i < GetResourceCount(); i++)
+        {
+            if (String(Word(RecordStart(RESOURCES) + i * RESOURCE_WORDS)) == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    uint32_t ReflectionReader::GetMemberCount() const
+    {
+        return _valid ? Word(MEMBERS) : 0;
+    }
+
+    MemberInfo ReflectionReader::GetMember(uint32_t index) const
+    {
+        const auto start = RecordStart(MEMBERS) + index * MEMBER_WORDS;
+        MemberInfo result{};
+        result.name = String(Word(start));
+        result.typeName = String(Word(start + 1));
+        result.offset = Word(start + 2);
+        result.size = Word(start + 3);
+        result.alignment = Word(start + 4);
+        result.arrayLength = static_cast<int>(Word(start + 5));
+        result.arrayStride = Word(start + 6);
+        result.matrixStride = Word(start + 7);
+        result.firstMember = Word(start + 8);
+        result.memberCount = Word(start + 9);
+        return result;
+    }
+
+    uint32_t ReflectionReader::GetInputCount() const
+    {
+        return _valid ? Word(INPUTS) : 0;
+    }
+
+    InterfaceInfo ReflectionReader::GetInput(uint32_t index) const
+    {
+        const auto start = RecordStart(INPUTS) + index * INTERFACE_WORDS;
+        return {
+            String(Word(start)), String(Word(start + 1)), static_cast<int>(Word(start + 2)),
+            static_cast<int>(Word(start + 3)), static_cast<int>(Word(start + 4)), Word(start + 5) != 0
+        };
+    }
+
+    uint32_t ReflectionReader::GetOutputCount() const
+    {
+        return _valid ? Word(OUTPUTS) : 0;
+    }
+
+    InterfaceInfo ReflectionReader::GetOutput(uint32_t index) const
+    {
+        const auto start = RecordStart(OUTPUTS) + index * INTERFACE_WORDS;
+        return {
+            String(Word(start)), String(Word(start + 1)), static_cast<int>(Word(start + 2)),
+            static_cast<int>(Word(start + 3)), static_cast<int>(Word(start + 4)), Word(start + 5) != 0
+        };
+    }
+}
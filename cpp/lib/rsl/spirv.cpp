@@ -0,0 +1,2918 @@
+#include "rsl/spirv.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <deque>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "rsl/utils.hpp"
+
+namespace rsl::spirv
+{
+    namespace
+    {
+        // Enumerants from the SPIR-V and GLSL.std.450 specifications
+        constexpr uint32_t CAPABILITY_SHADER = 1;
+        constexpr uint32_t CAPABILITY_SAMPLED_IMAGE_ARRAY_DYNAMIC_INDEXING = 29;
+        constexpr uint32_t CAPABILITY_IMAGE_QUERY = 50;
+        constexpr uint32_t ADDRESSING_LOGICAL = 0;
+        constexpr uint32_t MEMORY_MODEL_GLSL450 = 1;
+        constexpr uint32_t EXECUTION_MODEL_VERTEX = 0;
+        constexpr uint32_t EXECUTION_MODEL_FRAGMENT = 4;
+        constexpr uint32_t EXECUTION_MODE_ORIGIN_UPPER_LEFT = 7;
+        constexpr uint32_t EXECUTION_MODE_DEPTH_REPLACING = 12;
+        constexpr uint32_t DECORATION_BLOCK = 2;
+        constexpr uint32_t DECORATION_BUFFER_BLOCK = 3;
+        constexpr uint32_t DECORATION_COL_MAJOR = 5;
+        constexpr uint32_t DECORATION_ARRAY_STRIDE = 6;
+        constexpr uint32_t DECORATION_MATRIX_STRIDE = 7;
+        constexpr uint32_t DECORATION_BUILTIN = 11;
+        constexpr uint32_t DECORATION_FLAT = 14;
+        constexpr uint32_t DECORATION_NON_WRITABLE = 24;
+        constexpr uint32_t DECORATION_LOCATION = 30;
+        constexpr uint32_t DECORATION_COMPONENT = 31;
+        constexpr uint32_t DECORATION_BINDING = 33;
+        constexpr uint32_t DECORATION_DESCRIPTOR_SET = 34;
+        constexpr uint32_t DECORATION_OFFSET = 35;
+        constexpr uint32_t BUILTIN_POSITION = 0;
+        constexpr uint32_t BUILTIN_POINT_SIZE = 1;
+        constexpr uint32_t BUILTIN_FRAG_COORD = 15;
+        constexpr uint32_t BUILTIN_FRONT_FACING = 17;
+        constexpr uint32_t BUILTIN_FRAG_DEPTH = 22;
+        constexpr uint32_t BUILTIN_VERTEX_INDEX = 42;
+        constexpr uint32_t BUILTIN_INSTANCE_INDEX = 43;
+        constexpr uint32_t DIM_2D = 1;
+        constexpr uint32_t IMAGE_OPERANDS_LOD = 2;
+
+        namespace glsl450
+        {
+            constexpr uint32_t Round = 1;
+            constexpr uint32_t Trunc = 3;
+            constexpr uint32_t FAbs = 4;
+            constexpr uint32_t SAbs = 5;
+            constexpr uint32_t FSign = 6;
+            constexpr uint32_t SSign = 7;
+            constexpr uint32_t Floor = 8;
+            constexpr uint32_t Ceil = 9;
+            constexpr uint32_t Fract = 10;
+            constexpr uint32_t Radians = 11;
+            constexpr uint32_t Degrees = 12;
+            constexpr uint32_t Sin = 13;
+            constexpr uint32_t Cos = 14;
+            constexpr uint32_t Tan = 15;
+            constexpr uint32_t Asin = 16;
+            constexpr uint32_t Acos = 17;
+            constexpr uint32_t Atan = 18;
+            constexpr uint32_t Sinh = 19;
+            constexpr uint32_t Cosh = 20;
+            constexpr uint32_t Tanh = 21;
+            constexpr uint32_t Atan2 = 25;
+            constexpr uint32_t Pow = 26;
+            constexpr uint32_t Exp = 27;
+            constexpr uint32_t Log = 28;
+            constexpr uint32_t Exp2 = 29;
+            constexpr uint32_t Log2 = 30;
+            constexpr uint32_t Sqrt = 31;
+            constexpr uint32_t InverseSqrt = 32;
+            constexpr uint32_t Determinant = 33;
+            constexpr uint32_t MatrixInverse = 34;
+            constexpr uint32_t FMin = 37;
+            constexpr uint32_t SMin = 39;
+            constexpr uint32_t FMax = 40;
+            constexpr uint32_t SMax = 42;
+            constexpr uint32_t FClamp = 43;
+            constexpr uint32_t SClamp = 45;
+            constexpr uint32_t FMix = 46;
+            constexpr uint32_t Step = 48;
+            constexpr uint32_t SmoothStep = 49;
+            constexpr uint32_t Fma = 50;
+            constexpr uint32_t Length = 66;
+            constexpr uint32_t Distance = 67;
+            constexpr uint32_t Cross = 68;
+            constexpr uint32_t Normalize = 69;
+            constexpr uint32_t FaceForward = 70;
+            constexpr uint32_t Reflect = 71;
+            constexpr uint32_t Refract = 72;
+        }
+
+        // Component wise builtins. An int instruction of 0 means arguments are converted to float.
+        struct ComponentWiseBuiltin
+        {
+            uint32_t floatInstruction;
+            uint32_t intInstruction;
+            size_t argCount;
+        };
+
+        const std::unordered_map<std::string_view, ComponentWiseBuiltin> COMPONENT_WISE_BUILTINS = {
+            {"abs", {glsl450::FAbs, glsl450::SAbs, 1}},
+            {"sign", {glsl450::FSign, glsl450::SSign, 1}},
+            {"floor", {glsl450::Floor, 0, 1}},
+            {"ceil", {glsl450::Ceil, 0, 1}},
+            {"fract", {glsl450::Fract, 0, 1}},
+            {"round", {glsl450::Round, 0, 1}},
+            {"trunc", {glsl450::Trunc, 0, 1}},
+            {"radians", {glsl450::Radians, 0, 1}},
+            {"degrees", {glsl450::Degrees, 0, 1}},
+            {"sin", {glsl450::Sin, 0, 1}},
+            {"cos", {glsl450::Cos, 0, 1}},
+            {"tan", {glsl450::Tan, 0, 1}},
+            {"asin", {glsl450::Asin, 0, 1}},
+            {"acos", {glsl450::Acos, 0, 1}},
+            {"sinh", {glsl450::Sinh, 0, 1}},
+            {"cosh", {glsl450::Cosh, 0, 1}},
+            {"tanh", {glsl450::Tanh, 0, 1}},
+            {"pow", {glsl450::Pow, 0, 2}},
+            {"exp", {glsl450::Exp, 0, 1}},
+            {"log", {glsl450::Log, 0, 1}},
+            {"exp2", {glsl450::Exp2, 0, 1}},
+            {"log2", {glsl450::Log2, 0, 1}},
+            {"sqrt", {glsl450::Sqrt, 0, 1}},
+            {"inversesqrt", {glsl450::InverseSqrt, 0, 1}},
+            {"min", {glsl450::FMin, glsl450::SMin, 2}},
+            {"max", {glsl450::FMax, glsl450::SMax, 2}},
+            {"clamp", {glsl450::FClamp, glsl450::SClamp, 3}},
+            {"mix", {glsl450::FMix, 0, 3}},
+            {"step", {glsl450::Step, 0, 2}},
+            {"smoothstep", {glsl450::SmoothStep, 0, 3}},
+            {"fma", {glsl450::Fma, 0, 3}},
+        };
+
+        // GLSL spellings accepted as constructors alongside the rsl type names
+        const std::unordered_map<std::string_view, EDeclarationType> GLSL_TYPE_NAMES = {
+            {"vec2", EDeclarationType::Float2},
+            {"vec3", EDeclarationType::Float3},
+            {"vec4", EDeclarationType::Float4},
+            {"ivec2", EDeclarationType::Int2},
+            {"ivec3", EDeclarationType::Int3},
+            {"ivec4", EDeclarationType::Int4},
+        };
+
+        enum class ETypeKind
+        {
+            Void,
+            Bool,
+            Int,
+            Float,
+            Vector,
+            Matrix,
+            Array,
+            RuntimeArray,
+            Struct,
+            Image,
+            Sampler,
+            SampledImage
+        };
+
+        // Explicit layout a type is decorated with. Types used by blocks are distinct from the undecorated types used
+        // by Function and Private variables, and values are converted member by member between the two.
+        enum class ELayoutRule
+        {
+            None,
+            Std140,
+            Std430,
+            Scalar
+        };
+
+        struct Type
+        {
+            ETypeKind kind = ETypeKind::Void;
+            uint32_t id = 0;
+            // Component of a vector, column of a matrix or element of an array
+            const Type* element = nullptr;
+            // Components of a vector, columns of a matrix or length of an array
+            uint32_t count = 0;
+            std::string name{};
+            std::vector<const Type*> members{};
+            std::vector<std::string> memberNames{};
+            ELayoutRule layout = ELayoutRule::None;
+            uint32_t size = 0;
+            uint32_t alignment = 0;
+            // Array stride of an array with a layout
+            uint32_t stride = 0;
+            std::vector<uint32_t> offsets{};
+
+            [[nodiscard]] bool IsScalar() const
+            {
+                return kind == ETypeKind::Bool || kind == ETypeKind::Int || kind == ETypeKind::Float;
+            }
+
+            // Scalar type of a scalar, vector or matrix
+            [[nodiscard]] const Type* Component() const
+            {
+                if (IsScalar()) return this;
+                if (kind == ETypeKind::Vector) return element;
+                if (kind == ETypeKind::Matrix) return element->element;
+                return nullptr;
+            }
+
+            [[nodiscard]] uint32_t ComponentCount() const
+            {
+                return kind == ETypeKind::Vector ? count : 1;
+            }
+
+            [[nodiscard]] bool IsNumeric() const
+            {
+                auto component = Component();
+                return component && component->kind != ETypeKind::Bool;
+            }
+
+            [[nodiscard]] bool IsFloat() const
+            {
+                auto component = Component();
+                return component && component->kind == ETypeKind::Float;
+            }
+
+            [[nodiscard]] bool IsInt() const
+            {
+                auto component = Component();
+                return component && component->kind == ETypeKind::Int;
+            }
+
+            [[nodiscard]] bool IsBool() const
+            {
+                auto component = Component();
+                return component && component->kind == ETypeKind::Bool;
+            }
+
+            [[nodiscard]] bool IsScalarOrVector() const
+            {
+                return IsScalar() || kind == ETypeKind::Vector;
+            }
+        };
+
+        struct Value
+        {
+            uint32_t id = 0;
+            const Type* type = nullptr;
+        };
+
+        struct Pointer
+        {
+            uint32_t id = 0;
+            // Type of the object pointed to, before any swizzle
+            const Type* type = nullptr;
+            StorageClass storage = StorageClass::Function;
+            // Components selected by a swizzle of more than one component. Empty when the whole object is addressed.
+            std::vector<uint32_t> swizzle{};
+        };
+
+        struct Variable
+        {
+            uint32_t id = 0;
+            const Type* type = nullptr;
+            StorageClass storage = StorageClass::Function;
+            // Members of a block declared without an instance name are addressed through the block variable
+            std::optional<uint32_t> member{};
+        };
+
+        struct Function
+        {
+            std::shared_ptr<FunctionNode> node{};
+            uint32_t id = 0;
+            const Type* returnType = nullptr;
+            std::vector<const Type*> parameterTypes{};
+            bool queued = false;
+        };
+
+        uint32_t roundUp(uint32_t value, uint32_t alignment)
+        {
+            return alignment == 0 ? value : (value + alignment - 1) / alignment * alignment;
+        }
+
+        std::optional<uint32_t> swizzleComponent(char c)
+        {
+            switch (c)
+            {
+            case 'x':
+            case 'r':
+            case 's':
+                return 0;
+            case 'y':
+            case 'g':
+            case 't':
+                return 1;
+            case 'z':
+            case 'b':
+            case 'p':
+                return 2;
+            case 'w':
+            case 'a':
+            case 'q':
+                return 3;
+            default:
+                return std::nullopt;
+            }
+        }
+
+        std::optional<std::vector<uint32_t>> parseSwizzle(const std::string& id, uint32_t componentCount)
+        {
+            if (id.empty() || id.size() > 4) return std::nullopt;
+
+            std::vector<uint32_t> components{};
+            for (auto c : id)
+            {
+                auto component = swizzleComponent(c);
+                if (!component || *component >= componentCount) return std::nullopt;
+                components.push_back(*component);
+            }
+            return components;
+        }
+
+        std::optional<uint32_t> parseTag(const std::unordered_map<std::string, std::string>& tags,
+                                         const std::string& tag)
+        {
+            if (auto found = tags.find(tag); found != tags.end() && isInteger(found->second))
+            {
+                return static_cast<uint32_t>(parseInt(found->second));
+            }
+            return std::nullopt;
+        }
+
+        class Generator
+        {
+            EScopeType _scopeType;
+            uint32_t _nextId = 1;
+
+            std::vector<uint32_t> _capabilities{};
+            std::vector<uint32_t> _imports{};
+            std::vector<uint32_t> _debug{};
+            std::vector<uint32_t> _annotations{};
+            std::vector<uint32_t> _globals{};
+            std::vector<uint32_t> _functions{};
+
+            std::unordered_set<uint32_t> _enabledCapabilities{};
+            uint32_t _glsl450 = 0;
+
+            std::deque<Type> _types{};
+            std::unordered_map<std::string, const Type*> _typeCache{};
+            std::map<std::pair<StorageClass, uint32_t>, uint32_t> _pointerTypes{};
+            std::map<std::vector<uint32_t>, uint32_t> _functionTypes{};
+            std::map<std::vector<uint32_t>, uint32_t> _constants{};
+            // Bits of every scalar constant, so conversions of literals fold to new constants
+            std::unordered_map<uint32_t, uint32_t> _scalarConstants{};
+
+            std::unordered_map<std::string, std::shared_ptr<StructNode>> _structs{};
+            std::unordered_map<std::string, std::shared_ptr<Node>> _defines{};
+            std::unordered_set<std::string> _expandingDefines{};
+            std::unordered_map<std::string, std::vector<Function>> _userFunctions{};
+            std::vector<Function*> _functionQueue{};
+
+            std::vector<std::unordered_map<std::string, Variable>> _scopes{};
+            std::unordered_map<std::string, Variable> _builtins{};
+            std::vector<uint32_t> _interface{};
+            // Private globals whose initializers are not constant are assigned at the start of main
+            std::vector<std::pair<Pointer, std::shared_ptr<Node>>> _globalInitializers{};
+            bool _writesDepth = false;
+
+            // State of the function being generated. Variables must come first in the entry block so they are kept
+            // apart from the body until the function ends.
+            std::vector<uint32_t> _variables{};
+            std::vector<uint32_t> _body{};
+            uint32_t _currentLabel = 0;
+            bool _terminated = false;
+            const Type* _returnType = nullptr;
+
+        public:
+            explicit Generator(EScopeType scopeType) : _scopeType(scopeType)
+            {
+            }
+
+            uint32_t NewId()
+            {
+                return _nextId++;
+            }
+
+            static void Emit(std::vector<uint32_t>& section, Op op, const std::vector<uint32_t>& operands)
+            {
+                section.push_back(static_cast<uint32_t>(operands.size() + 1) << 16 | static_cast<uint32_t>(op));
+                section.insert(section.end(), operands.begin(), operands.end());
+            }
+
+            static void AppendString(std::vector<uint32_t>& operands, std::string_view text)
+            {
+                // Null terminated and padded to a whole word
+                for (size_t i = 0; i < text.size() + 1; i += 4)
+                {
+                    uint32_t word = 0;
+                    for (size_t j = 0; j < 4 && i + j < text.size(); j++)
+                    {
+                        word |= static_cast<uint32_t>(static_cast<unsigned char>(text[i + j])) << (j * 8);
+                    }
+                    operands.push_back(word);
+                }
+            }
+
+            void EnableCapability(uint32_t capability)
+            {
+                if (_enabledCapabilities.insert(capability).second) Emit(_capabilities, Op::Capability, {capability});
+            }
+
+            void EmitName(uint32_t id, std::string_view name)
+            {
+                std::vector<uint32_t> operands{id};
+                AppendString(operands, name);
+                Emit(_debug, Op::Name, operands);
+            }
+
+            uint32_t GetGlsl450()
+            {
+                if (_glsl450 == 0)
+                {
+                    _glsl450 = NewId();
+                    std::vector<uint32_t> operands{_glsl450};
+                    AppendString(operands, "GLSL.std.450");
+                    Emit(_imports, Op::ExtInstImport, operands);
+                }
+                return _glsl450;
+            }
+
+            // Types
+
+            const Type* Intern(const std::string& key, Type type, Op op, const std::vector<uint32_t>& operands)
+            {
+                if (auto found = _typeCache.find(key); found != _typeCache.end()) return found->second;
+
+                type.id = NewId();
+                std::vector<uint32_t> typeOperands{type.id};
+                typeOperands.insert(typeOperands.end(), operands.begin(), operands.end());
+                Emit(_globals, op, typeOperands);
+
+                auto& stored = _types.emplace_back(std::move(type));
+                _typeCache.emplace(key, &stored);
+                return &stored;
+            }
+
+            const Type* VoidType()
+            {
+                return Intern("void", {ETypeKind::Void}, Op::TypeVoid, {});
+            }
+
+            const Type* BoolType()
+            {
+                return Intern("bool", {ETypeKind::Bool}, Op::TypeBool, {});
+            }
+
+            const Type* IntType()
+            {
+                return Intern("int", {ETypeKind::Int}, Op::TypeInt, {32, 1});
+            }
+
+            const Type* FloatType()
+            {
+                return Intern("float", {ETypeKind::Float}, Op::TypeFloat, {32});
+            }
+
+            const Type* VectorType(const Type* component, uint32_t count)
+            {
+                if (count == 1) return component;
+
+                Type type{ETypeKind::Vector};
+                type.element = component;
+                type.count = count;
+                return Intern("vector" + std::to_string(component->id) + "x" + std::to_string(count), type,
+                              Op::TypeVector, {component->id, count});
+            }
+
+            const Type* MatrixType(uint32_t columns)
+            {
+                Type type{ETypeKind::Matrix};
+                type.element = VectorType(FloatType(), columns);
+                type.count = columns;
+                return Intern("matrix" + std::to_string(columns), type, Op::TypeMatrix, {type.element->id, columns});
+            }
+
+            const Type* SampledImageType()
+            {
+                Type image{ETypeKind::Image};
+                image.element = FloatType();
+                auto imageType = Intern("image2D", image, Op::TypeImage, {image.element->id, DIM_2D, 0, 0, 0, 1, 0});
+
+                Type type{ETypeKind::SampledImage};
+                type.element = imageType;
+                return Intern("sampledImage2D", type, Op::TypeSampledImage, {imageType->id});
+            }
+
+            const Type* ImageType()
+            {
+                return SampledImageType()->element;
+            }
+
+            const Type* SamplerType()
+            {
+                return Intern("sampler", {ETypeKind::Sampler}, Op::TypeSampler, {});
+            }
+
+            // Same shape as type with its components replaced by component
+            const Type* WithComponent(const Type* type, const Type* component)
+            {
+                return VectorType(component, type->ComponentCount());
+            }
+
+            std::pair<uint32_t, uint32_t> SizeAndAlignment(const Type* type, ELayoutRule rule)
+            {
+                switch (type->kind)
+                {
+                case ETypeKind::Int:
+                case ETypeKind::Float:
+                    return {4, 4};
+                case ETypeKind::Vector:
+                    return {4 * type->count, rule == ELayoutRule::Scalar ? 4 : (type->count == 2 ? 8 : 16)};
+                case ETypeKind::Matrix:
+                    {
+                        const auto stride = MatrixStride(type, rule);
+                        const auto columnAlignment = SizeAndAlignment(type->element, rule).second;
+                        return {stride * type->count, rule == ELayoutRule::Std140 ? 16 : columnAlignment};
+                    }
+                case ETypeKind::Array:
+                case ETypeKind::RuntimeArray:
+                case ETypeKind::Struct:
+                    return {type->size, type->alignment};
+                default:
+                    throw std::runtime_error("Type " + TypeName(type) + " cannot be used in a block");
+                }
+            }
+
+            uint32_t MatrixStride(const Type* type, ELayoutRule rule)
+            {
+                auto [size, alignment] = SizeAndAlignment(type->element, rule);
+                return rule == ELayoutRule::Std140 ? roundUp(size, 16) : roundUp(size, alignment);
+            }
+
+            const Type* ArrayType(const Type* element, int count, ELayoutRule layout)
+            {
+                Type type{count < 0 ? ETypeKind::RuntimeArray : ETypeKind::Array};
+                type.element = element;
+                type.layout = layout;
+
+                const auto key = (count < 0 ? "runtime" : "array" + std::to_string(count)) + "of" +
+                    std::to_string(element->id) + "layout" + std::to_string(static_cast<int>(layout));
+                if (auto found = _typeCache.find(key); found != _typeCache.end()) return found->second;
+
+                if (layout != ELayoutRule::None)
+                {
+                    auto [size, alignment] = SizeAndAlignment(element, layout);
+                    switch (layout)
+                    {
+                    case ELayoutRule::Std140:
+                        type.alignment = std::max(alignment, 16u);
+                        type.stride = roundUp(size, type.alignment);
+                        break;
+                    case ELayoutRule::Std430:
+                        type.alignment = alignment;
+                        type.stride = roundUp(size, alignment);
+                        break;
+                    default:
+                        type.alignment = alignment;
+                        type.stride = size;
+                        break;
+                    }
+                    type.size = count < 0 ? 0 : type.stride * count;
+                }
+
+                const Type* result;
+                if (count < 0)
+                {
+                    result = Intern(key, type, Op::TypeRuntimeArray, {element->id});
+                }
+                else
+                {
+                    type.count = static_cast<uint32_t>(count);
+                    result = Intern(key, type, Op::TypeArray, {element->id, Constant(IntType(), count)});
+                }
+
+                if (layout != ELayoutRule::None)
+                {
+                    Emit(_annotations, Op::Decorate, {result->id, DECORATION_ARRAY_STRIDE, result->stride});
+                }
+                return result;
+            }
+
+            const Type* StructType(const std::string& name, const std::vector<std::shared_ptr<DeclarationNode>>& members,
+                                   ELayoutRule layout)
+            {
+                const auto key = "struct" + name + "layout" + std::to_string(static_cast<int>(layout));
+                if (auto found = _typeCache.find(key); found != _typeCache.end()) return found->second;
+
+                Type type{ETypeKind::Struct};
+                type.name = name;
+                type.layout = layout;
+                for (auto& member : members)
+                {
+                    type.members.push_back(TypeOf(member, layout));
+                    type.memberNames.push_back(member->declarationName);
+                }
+
+                if (layout != ELayoutRule::None)
+                {
+                    uint32_t offset = 0;
+                    uint32_t alignment = 4;
+                    for (size_t i = 0; i < type.members.size(); i++)
+                    {
+                        if (type.members[i]->kind == ETypeKind::RuntimeArray && i != type.members.size() - 1)
+                        {
+                            throw std::runtime_error("Only the last member of " + name + " can be unsized");
+                        }
+
+                        auto [memberSize, memberAlignment] = SizeAndAlignment(type.members[i], layout);
+                        offset = roundUp(offset, memberAlignment);
+                        type.offsets.push_back(offset);
+                        offset += memberSize;
+                        alignment = std::max(alignment, memberAlignment);
+                    }
+
+                    type.alignment = layout == ELayoutRule::Std140 ? roundUp(alignment, 16) : alignment;
+                    type.size = roundUp(offset, type.alignment);
+                }
+
+                std::vector<uint32_t> memberIds{};
+                for (auto member : type.members)
+                {
+                    memberIds.push_back(member->id);
+                }
+
+                auto result = Intern(key, type, Op::TypeStruct, memberIds);
+
+                EmitName(result->id, name);
+                for (uint32_t i = 0; i < result->members.size(); i++)
+                {
+                    std::vector<uint32_t> operands{result->id, i};
+                    AppendString(operands, result->memberNames[i]);
+                    Emit(_debug, Op::MemberName, operands);
+
+                    if (layout == ELayoutRule::None) continue;
+
+                    Emit(_annotations, Op::MemberDecorate, {result->id, i, DECORATION_OFFSET, result->offsets[i]});
+
+                    auto matrix = result->members[i];
+                    while (matrix->kind == ETypeKind::Array || matrix->kind == ETypeKind::RuntimeArray)
+                    {
+                        matrix = matrix->element;
+                    }
+                    if (matrix->kind == ETypeKind::Matrix)
+                    {
+                        Emit(_annotations, Op::MemberDecorate, {result->id, i, DECORATION_COL_MAJOR});
+                        Emit(_annotations, Op::MemberDecorate, {
+                                 result->id, i, DECORATION_MATRIX_STRIDE, MatrixStride(matrix, layout)
+                             });
+                    }
+                }
+
+                return result;
+            }
+
+            const Type* BaseType(EDeclarationType declarationType)
+            {
+                switch (declarationType)
+                {
+                case EDeclarationType::Float:
+                    return FloatType();
+                case EDeclarationType::Int:
+                    return IntType();
+                case EDeclarationType::Float2:
+                    return VectorType(FloatType(), 2);
+                case EDeclarationType::Int2:
+                    return VectorType(IntType(), 2);
+                case EDeclarationType::Float3:
+                    return VectorType(FloatType(), 3);
+                case EDeclarationType::Int3:
+                    return VectorType(IntType(), 3);
+                case EDeclarationType::Float4:
+                    return VectorType(FloatType(), 4);
+                case EDeclarationType::Int4:
+                    return VectorType(IntType(), 4);
+                case EDeclarationType::Mat3:
+                    return MatrixType(3);
+                case EDeclarationType::Mat4:
+                    return MatrixType(4);
+                case EDeclarationType::Boolean:
+                    return BoolType();
+                case EDeclarationType::Void:
+                    return VoidType();
+                case EDeclarationType::Sampler:
+                    return SamplerType();
+                case EDeclarationType::Texture2D:
+                    return ImageType();
+                case EDeclarationType::Sampler2D:
+                    return SampledImageType();
+                default:
+                    return nullptr;
+                }
+            }
+
+            const Type* NamedStructType(const std::string& name, ELayoutRule layout)
+            {
+                auto found = _structs.find(name);
+                if (found == _structs.end()) throw std::runtime_error("Unknown type '" + name + "'");
+                return StructType(name, found->second->declarations, layout);
+            }
+
+            // Type of a declaration without its array dimension
+            const Type* ElementTypeOf(const std::shared_ptr<DeclarationNode>& declaration, ELayoutRule layout)
+            {
+                switch (declaration->declarationType)
+                {
+                case EDeclarationType::Struct:
+                    return NamedStructType(declaration->GetTypeName(), layout);
+                case EDeclarationType::Block:
+                case EDeclarationType::Buffer:
+                    throw std::runtime_error("Blocks can only be declared with a layout");
+                default:
+                    return BaseType(declaration->declarationType);
+                }
+            }
+
+            const Type* TypeOf(const std::shared_ptr<DeclarationNode>& declaration, ELayoutRule layout,
+                               const std::shared_ptr<Node>& initializer = {})
+            {
+                auto element = ElementTypeOf(declaration, layout);
+
+                if (declaration->declarationCount == -1)
+                {
+                    if (initializer && initializer->nodeType == NodeType::ArrayLiteral)
+                    {
+                        auto asArray = std::dynamic_pointer_cast<ArrayLiteralNode>(initializer);
+                        return ArrayType(element, static_cast<int>(asArray->nodes.size()), layout);
+                    }
+                    return ArrayType(element, -1, layout);
+                }
+
+                return declaration->declarationCount > 1
+                           ? ArrayType(element, declaration->declarationCount, layout)
+                           : element;
+            }
+
+            uint32_t PointerType(StorageClass storage, const Type* type)
+            {
+                auto [it, inserted] = _pointerTypes.try_emplace({storage, type->id}, 0);
+                if (inserted)
+                {
+                    it->second = NewId();
+                    Emit(_globals, Op::TypePointer, {it->second, static_cast<uint32_t>(storage), type->id});
+                }
+                return it->second;
+            }
+
+            uint32_t FunctionType(const Type* returnType, const std::vector<const Type*>& parameterTypes)
+            {
+                std::vector<uint32_t> key{returnType->id};
+                for (auto parameterType : parameterTypes)
+                {
+                    key.push_back(PointerType(StorageClass::Function, parameterType));
+                }
+
+                auto [it, inserted] = _functionTypes.try_emplace(key, 0);
+                if (inserted)
+                {
+                    it->second = NewId();
+                    std::vector<uint32_t> operands{it->second};
+                    operands.insert(operands.end(), key.begin(), key.end());
+                    Emit(_globals, Op::TypeFunction, operands);
+                }
+                return it->second;
+            }
+
+            std::string TypeName(const Type* type)
+            {
+                switch (type->kind)
+                {
+                case ETypeKind::Void:
+                    return "void";
+                case ETypeKind::Bool:
+                    return "bool";
+                case ETypeKind::Int:
+                    return "int";
+                case ETypeKind::Float:
+                    return "float";
+                case ETypeKind::Vector:
+                    return TypeName(type->element) + std::to_string(type->count);
+                case ETypeKind::Matrix:
+                    return "mat" + std::to_string(type->count);
+                case ETypeKind::Array:
+                    return TypeName(type->element) + "[" + std::to_string(type->count) + "]";
+                case ETypeKind::RuntimeArray:
+                    return TypeName(type->element) + "[]";
+                case ETypeKind::Struct:
+                    return type->name;
+                case ETypeKind::Image:
+                    return "texture2D";
+                case ETypeKind::Sampler:
+                    return "sampler";
+                case ETypeKind::SampledImage:
+                    return "sampler2D";
+                }
+                return "";
+            }
+
+            // Constants
+
+            uint32_t Constant(const Type* type, uint32_t bits)
+            {
+                std::vector<uint32_t> key{type->id, bits};
+                auto [it, inserted] = _constants.try_emplace(key, 0);
+                if (inserted)
+                {
+                    it->second = NewId();
+                    if (type->kind == ETypeKind::Bool)
+                    {
+                        Emit(_globals, bits ? Op::ConstantTrue : Op::ConstantFalse, {type->id, it->second});
+                    }
+                    else
+                    {
+                        Emit(_globals, Op::Constant, {type->id, it->second, bits});
+                    }
+                    _scalarConstants.emplace(it->second, bits);
+                }
+                return it->second;
+            }
+
+            uint32_t Constant(const Type* type, int value)
+            {
+                return Constant(type, static_cast<uint32_t>(value));
+            }
+
+            uint32_t Constant(const Type* type, float value)
+            {
+                return Constant(type, std::bit_cast<uint32_t>(value));
+            }
+
+            uint32_t CompositeConstant(const Type* type, const std::vector<uint32_t>& constituents)
+            {
+                // Tagged so composites never collide with scalar keys
+                std::vector<uint32_t> key{type->id, 0xffffffff};
+                key.insert(key.end(), constituents.begin(), constituents.end());
+                auto [it, inserted] = _constants.try_emplace(key, 0);
+                if (inserted)
+                {
+                    it->second = NewId();
+                    std::vector<uint32_t> operands{type->id, it->second};
+                    operands.insert(operands.end(), constituents.begin(), constituents.end());
+                    Emit(_globals, Op::ConstantComposite, operands);
+                }
+                return it->second;
+            }
+
+            // Constant with every component of a scalar or vector type set to value
+            uint32_t SplatConstant(const Type* type, float value)
+            {
+                auto component = type->Component();
+                auto scalar = component->kind == ETypeKind::Float
+                                  ? Constant(component, value)
+                                  : Constant(component, static_cast<int>(value));
+                if (type->IsScalar()) return scalar;
+                return CompositeConstant(type, std::vector<uint32_t>(type->count, scalar));
+            }
+
+            // Evaluates node as a constant of expected type when it is built only from literals
+            std::optional<Value> TryConstant(const std::shared_ptr<Node>& node, const Type* expected)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::FloatLiteral:
+                    {
+                        auto data = std::dynamic_pointer_cast<FloatLiteralNode>(node)->data;
+                        if (expected && expected->kind == ETypeKind::Int)
+                        {
+                            return std::nullopt;
+                        }
+                        return Value{Constant(FloatType(), data), FloatType()};
+                    }
+                case NodeType::IntLiteral:
+                    {
+                        auto data = std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data;
+                        if (expected && expected->kind == ETypeKind::Float)
+                        {
+                            return Value{Constant(FloatType(), static_cast<float>(data)), FloatType()};
+                        }
+                        return Value{Constant(IntType(), data), IntType()};
+                    }
+                case NodeType::BooleanLiteral:
+                    return Value{
+                        Constant(BoolType(), std::dynamic_pointer_cast<BooleanLiteralNode>(node)->data ? 1u : 0u),
+                        BoolType()
+                    };
+                case NodeType::Precedence:
+                    return TryConstant(std::dynamic_pointer_cast<PrecedenceNode>(node)->target, expected);
+                case NodeType::Negate:
+                    {
+                        auto target = std::dynamic_pointer_cast<NegateNode>(node)->target;
+                        if (target->nodeType == NodeType::FloatLiteral &&
+                            (!expected || expected->kind == ETypeKind::Float))
+                        {
+                            auto data = std::dynamic_pointer_cast<FloatLiteralNode>(target)->data;
+                            return Value{Constant(FloatType(), -data), FloatType()};
+                        }
+                        if (target->nodeType == NodeType::IntLiteral)
+                        {
+                            auto data = std::dynamic_pointer_cast<IntegerLiteralNode>(target)->data;
+                            if (expected && expected->kind == ETypeKind::Float)
+                            {
+                                return Value{Constant(FloatType(), -static_cast<float>(data)), FloatType()};
+                            }
+                            return Value{Constant(IntType(), -data), IntType()};
+                        }
+                        return std::nullopt;
+                    }
+                case NodeType::ArrayLiteral:
+                    {
+                        if (!expected || expected->kind != ETypeKind::Array) return std::nullopt;
+
+                        auto asArray = std::dynamic_pointer_cast<ArrayLiteralNode>(node);
+                        if (asArray->nodes.size() != expected->count) return std::nullopt;
+
+                        std::vector<uint32_t> constituents{};
+                        for (auto& element : asArray->nodes)
+                        {
+                            auto constant = TryConstant(element, expected->element);
+                            if (!constant || constant->type != expected->element) return std::nullopt;
+                            constituents.push_back(constant->id);
+                        }
+                        return Value{CompositeConstant(expected, constituents), expected};
+                    }
+                case NodeType::Call:
+                    {
+                        // Vector constructors from scalar literals
+                        auto asCall = std::dynamic_pointer_cast<CallNode>(node);
+                        auto type = ConstructorType(asCall->identifier->id);
+                        if (!type || type->kind != ETypeKind::Vector) return std::nullopt;
+
+                        std::vector<uint32_t> constituents{};
+                        for (auto& arg : asCall->args)
+                        {
+                            auto constant = TryConstant(arg, type->element);
+                            if (!constant || constant->type != type->element) return std::nullopt;
+                            constituents.push_back(constant->id);
+                        }
+
+                        if (constituents.size() == 1)
+                        {
+                            constituents.resize(type->count, constituents.front());
+                        }
+                        if (constituents.size() != type->count) return std::nullopt;
+
+                        return Value{CompositeConstant(type, constituents), type};
+                    }
+                default:
+                    return std::nullopt;
+                }
+            }
+
+            // Instructions
+
+            Value EmitValue(Op op, const Type* type, const std::vector<uint32_t>& operands)
+            {
+                auto id = NewId();
+                std::vector<uint32_t> allOperands{type->id, id};
+                allOperands.insert(allOperands.end(), operands.begin(), operands.end());
+                Emit(_body, op, allOperands);
+                return {id, type};
+            }
+
+            Value EmitExtended(uint32_t instruction, const Type* type, const std::vector<Value>& args)
+            {
+                std::vector<uint32_t> operands{GetGlsl450(), instruction};
+                for (auto& arg : args)
+                {
+                    operands.push_back(arg.id);
+                }
+                return EmitValue(Op::ExtInst, type, operands);
+            }
+
+            void BeginBlock(uint32_t label)
+            {
+                Emit(_body, Op::Label, {label});
+                _currentLabel = label;
+                _terminated = false;
+            }
+
+            void Terminate(Op op, const std::vector<uint32_t>& operands = {})
+            {
+                Emit(_body, op, operands);
+                _terminated = true;
+            }
+
+            uint32_t NewVariable(const Type* type, const std::string& name = "")
+            {
+                auto id = NewId();
+                Emit(_variables, Op::Variable, {
+                         PointerType(StorageClass::Function, type), id,
+                         static_cast<uint32_t>(StorageClass::Function)
+                     });
+                if (!name.empty()) EmitName(id, name);
+                return id;
+            }
+
+            Value Load(const Pointer& pointer)
+            {
+                auto loaded = EmitValue(Op::Load, pointer.type, {pointer.id});
+                if (pointer.swizzle.empty()) return loaded;
+                return Swizzle(loaded, pointer.swizzle);
+            }
+
+            void Store(const Pointer& pointer, Value value)
+            {
+                if (pointer.storage == StorageClass::Uniform || pointer.storage == StorageClass::PushConstant ||
+                    pointer.storage == StorageClass::UniformConstant || pointer.storage == StorageClass::Input)
+                {
+                    throw std::runtime_error("Cannot assign to a read only variable");
+                }
+
+                if (pointer.swizzle.empty())
+                {
+                    value = Convert(value, pointer.type);
+                    Emit(_body, Op::Store, {pointer.id, value.id});
+                    return;
+                }
+
+                // Writes through a swizzle merge the new components into the current vector
+                value = Convert(value, VectorType(pointer.type->element, static_cast<uint32_t>(pointer.swizzle.size())));
+                auto current = EmitValue(Op::Load, pointer.type, {pointer.id});
+
+                std::vector<uint32_t> operands{current.id, value.id};
+                for (uint32_t i = 0; i < pointer.type->count; i++)
+                {
+                    auto found = std::ranges::find(pointer.swizzle, i);
+                    operands.push_back(found == pointer.swizzle.end()
+                                           ? i
+                                           : pointer.type->count + static_cast<uint32_t>(found - pointer.swizzle.
+                                               begin()));
+                }
+                auto merged = EmitValue(Op::VectorShuffle, pointer.type, operands);
+                Emit(_body, Op::Store, {pointer.id, merged.id});
+            }
+
+            Value Swizzle(const Value& value, const std::vector<uint32_t>& components)
+            {
+                if (components.size() == 1)
+                {
+                    return EmitValue(Op::CompositeExtract, value.type->element, {value.id, components.front()});
+                }
+
+                std::vector<uint32_t> operands{value.id, value.id};
+                operands.insert(operands.end(), components.begin(), components.end());
+                return EmitValue(Op::VectorShuffle,
+                                 VectorType(value.type->element, static_cast<uint32_t>(components.size())),
+                                 operands);
+            }
+
+            Value Splat(const Value& scalar, const Type* vectorType)
+            {
+                if (vectorType->IsScalar()) return scalar;
+                return EmitValue(Op::CompositeConstruct, vectorType, std::vector<uint32_t>(vectorType->count, scalar.id));
+            }
+
+            Value Convert(const Value& value, const Type* target)
+            {
+                if (value.type == target) return value;
+
+                const auto source = value.type;
+
+                if (auto constant = _scalarConstants.find(value.id); constant != _scalarConstants.end() &&
+                    target->IsScalarOrVector())
+                {
+                    auto bits = constant->second;
+                    auto component = target->Component();
+                    uint32_t converted;
+                    if (source->kind == component->kind) converted = value.id;
+                    else if (component->kind == ETypeKind::Bool) converted = Constant(component, bits != 0 ? 1u : 0u);
+                    else if (source->kind == ETypeKind::Int && component->kind == ETypeKind::Float)
+                    {
+                        converted = Constant(component, static_cast<float>(static_cast<int>(bits)));
+                    }
+                    else if (source->kind == ETypeKind::Float && component->kind == ETypeKind::Int)
+                    {
+                        converted = Constant(component, static_cast<int>(std::bit_cast<float>(bits)));
+                    }
+                    else
+                    {
+                        converted = Constant(component, bits != 0 ? 1 : 0);
+                    }
+
+                    if (target->IsScalar()) return {converted, target};
+                    return {CompositeConstant(target, std::vector<uint32_t>(target->count, converted)), target};
+                }
+
+                if (source->IsScalarOrVector() && target->IsScalarOrVector())
+                {
+                    if (source->IsScalar() && !target->IsScalar())
+                    {
+                        return Splat(Convert(value, target->element), target);
+                    }
+
+                    if (source->ComponentCount() == target->ComponentCount())
+                    {
+                        if (target->IsBool())
+                        {
+                            auto zero = SplatConstant(source, 0.0f);
+                            return EmitValue(source->IsFloat() ? Op::FOrdNotEqual : Op::INotEqual, target,
+                                             {value.id, zero});
+                        }
+                        if (source->IsBool())
+                        {
+                            return EmitValue(Op::Select, target, {
+                                                 value.id, SplatConstant(target, 1.0f), SplatConstant(target, 0.0f)
+                                             });
+                        }
+                        if (source->IsInt() && target->IsFloat())
+                        {
+                            return EmitValue(Op::ConvertSToF, target, {value.id});
+                        }
+                        if (source->IsFloat() && target->IsInt())
+                        {
+                            return EmitValue(Op::ConvertFToS, target, {value.id});
+                        }
+                    }
+                }
+
+                if (source->kind == ETypeKind::Struct && target->kind == ETypeKind::Struct &&
+                    source->name == target->name)
+                {
+                    std::vector<uint32_t> members{};
+                    for (uint32_t i = 0; i < target->members.size(); i++)
+                    {
+                        auto member = EmitValue(Op::CompositeExtract, source->members[i], {value.id, i});
+                        members.push_back(Convert(member, target->members[i]).id);
+                    }
+                    return EmitValue(Op::CompositeConstruct, target, members);
+                }
+
+                if (source->kind == ETypeKind::Array && target->kind == ETypeKind::Array &&
+                    source->count == target->count)
+                {
+                    std::vector<uint32_t> elements{};
+                    for (uint32_t i = 0; i < target->count; i++)
+                    {
+                        auto element = EmitValue(Op::CompositeExtract, source->element, {value.id, i});
+                        elements.push_back(Convert(element, target->element).id);
+                    }
+                    return EmitValue(Op::CompositeConstruct, target, elements);
+                }
+
+                throw std::runtime_error("Cannot convert " + TypeName(source) + " to " + TypeName(target));
+            }
+
+            // Declarations
+
+            std::optional<Variable> FindVariable(const std::string& name)
+            {
+                for (auto it = _scopes.rbegin(); it != _scopes.rend(); ++it)
+                {
+                    if (auto found = it->find(name); found != it->end()) return found->second;
+                }
+                return FindBuiltin(name);
+            }
+
+            std::optional<Variable> FindBuiltin(const std::string& name)
+            {
+                if (auto found = _builtins.find(name); found != _builtins.end()) return found->second;
+
+                const Type* type = nullptr;
+                StorageClass storage = StorageClass::Input;
+                uint32_t builtin = 0;
+                const auto isVertex = _scopeType == EScopeType::Vertex;
+
+                if (name == "gl_Position" && isVertex)
+                {
+                    type = VectorType(FloatType(), 4);
+                    storage = StorageClass::Output;
+                    builtin = BUILTIN_POSITION;
+                }
+                else if (name == "gl_PointSize" && isVertex)
+                {
+                    type = FloatType();
+                    storage = StorageClass::Output;
+                    builtin = BUILTIN_POINT_SIZE;
+                }
+                else if (name == "gl_VertexIndex" && isVertex)
+                {
+                    type = IntType();
+                    builtin = BUILTIN_VERTEX_INDEX;
+                }
+                else if (name == "gl_InstanceIndex" && isVertex)
+                {
+                    type = IntType();
+                    builtin = BUILTIN_INSTANCE_INDEX;
+                }
+                else if (name == "gl_FragCoord" && !isVertex)
+                {
+                    type = VectorType(FloatType(), 4);
+                    builtin = BUILTIN_FRAG_COORD;
+                }
+                else if (name == "gl_FrontFacing" && !isVertex)
+                {
+                    type = BoolType();
+                    builtin = BUILTIN_FRONT_FACING;
+                }
+                else if (name == "gl_FragDepth" && !isVertex)
+                {
+                    type = FloatType();
+                    storage = StorageClass::Output;
+                    builtin = BUILTIN_FRAG_DEPTH;
+                    _writesDepth = true;
+                }
+                else
+                {
+                    return std::nullopt;
+                }
+
+                Variable variable{NewGlobal(type, storage, name), type, storage};
+                Emit(_annotations, Op::Decorate, {variable.id, DECORATION_BUILTIN, builtin});
+                _interface.push_back(variable.id);
+                _builtins.emplace(name, variable);
+                return variable;
+            }
+
+            uint32_t NewGlobal(const Type* type, StorageClass storage, const std::string& name,
+                               std::optional<uint32_t> initializer = std::nullopt)
+            {
+                auto id = NewId();
+                std::vector<uint32_t> operands{PointerType(storage, type), id, static_cast<uint32_t>(storage)};
+                if (initializer) operands.push_back(*initializer);
+                Emit(_globals, Op::Variable, operands);
+                if (!name.empty()) EmitName(id, name);
+                return id;
+            }
+
+            void DeclareGlobal(const std::string& name, const Variable& variable)
+            {
+                if (!_scopes.front().try_emplace(name, variable).second)
+                {
+                    throw std::runtime_error("'" + name + "' is already declared");
+                }
+            }
+
+            static ELayoutRule LayoutRuleOf(const std::unordered_map<std::string, std::string>& tags,
+                                            ELayoutRule fallback)
+            {
+                if (tags.contains("scalar")) return ELayoutRule::Scalar;
+                if (tags.contains("std430")) return ELayoutRule::Std430;
+                if (tags.contains("std140")) return ELayoutRule::Std140;
+                return fallback;
+            }
+
+            void DecorateResource(uint32_t id, const std::unordered_map<std::string, std::string>& tags)
+            {
+                Emit(_annotations, Op::Decorate, {id, DECORATION_DESCRIPTOR_SET, parseTag(tags, "set").value_or(0)});
+                Emit(_annotations, Op::Decorate, {id, DECORATION_BINDING, parseTag(tags, "binding").value_or(0)});
+            }
+
+            // Declares every member of a block without an instance name as a global
+            void DeclareBlock(const std::string& name, const std::vector<std::shared_ptr<DeclarationNode>>& members,
+                              const Type* type, StorageClass storage, uint32_t id, bool anonymous)
+            {
+                if (!anonymous)
+                {
+                    DeclareGlobal(name, {id, type, storage});
+                    return;
+                }
+
+                for (uint32_t i = 0; i < members.size(); i++)
+                {
+                    DeclareGlobal(members[i]->declarationName, {id, type, storage, i});
+                }
+            }
+
+            void GenerateLayout(const std::shared_ptr<LayoutNode>& node)
+            {
+                auto declaration = node->declaration;
+
+                switch (node->layoutType)
+                {
+                case ELayoutType::Input:
+                case ELayoutType::Output:
+                    {
+                        const auto storage = node->layoutType == ELayoutType::Input
+                                                 ? StorageClass::Input
+                                                 : StorageClass::Output;
+                        auto type = TypeOf(declaration, ELayoutRule::None);
+                        if (type->IsBool()) throw std::runtime_error("Stage inputs and outputs cannot be bool");
+
+                        auto id = NewGlobal(type, storage, declaration->declarationName);
+                        if (auto location = parseTag(node->tags, "location"))
+                        {
+                            Emit(_annotations, Op::Decorate, {id, DECORATION_LOCATION, *location});
+                        }
+                        else
+                        {
+                            throw std::runtime_error(declaration->declarationName + " needs a location");
+                        }
+                        if (auto component = parseTag(node->tags, "component"))
+                        {
+                            Emit(_annotations, Op::Decorate, {id, DECORATION_COMPONENT, *component});
+                        }
+
+                        // Vulkan requires integer fragment inputs to be flat
+                        if (node->tags.contains("$flat") || (storage == StorageClass::Input &&
+                            _scopeType == EScopeType::Fragment && type->IsInt()))
+                        {
+                            Emit(_annotations, Op::Decorate, {id, DECORATION_FLAT});
+                        }
+
+                        _interface.push_back(id);
+                        DeclareGlobal(declaration->declarationName, {id, type, storage});
+                    }
+                    break;
+                case ELayoutType::Uniform:
+                case ELayoutType::Readonly:
+                    {
+                        if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(declaration))
+                        {
+                            const auto readonly = node->layoutType == ELayoutType::Readonly;
+                            auto type = StructType(asBlock->GetTypeName(), asBlock->declarations,
+                                                   LayoutRuleOf(node->tags, readonly
+                                                                                ? ELayoutRule::Std430
+                                                                                : ELayoutRule::Std140));
+                            Emit(_annotations, Op::Decorate, {
+                                     type->id, readonly ? DECORATION_BUFFER_BLOCK : DECORATION_BLOCK
+                                 });
+                            if (readonly)
+                            {
+                                for (uint32_t i = 0; i < type->members.size(); i++)
+                                {
+                                    Emit(_annotations, Op::MemberDecorate, {type->id, i, DECORATION_NON_WRITABLE});
+                                }
+                            }
+
+                            auto id = NewGlobal(type, StorageClass::Uniform, asBlock->declarationName);
+                            DecorateResource(id, node->tags);
+                            DeclareBlock(asBlock->declarationName, asBlock->declarations, type, StorageClass::Uniform,
+                                         id, false);
+                        }
+                        else if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(declaration))
+                        {
+                            auto type = StructType("_buffer_" + asBuffer->declarationName, asBuffer->declarations,
+                                                   LayoutRuleOf(node->tags, ELayoutRule::Std430));
+                            Emit(_annotations, Op::Decorate, {type->id, DECORATION_BUFFER_BLOCK});
+                            if (node->layoutType == ELayoutType::Readonly)
+                            {
+                                for (uint32_t i = 0; i < type->members.size(); i++)
+                                {
+                                    Emit(_annotations, Op::MemberDecorate, {type->id, i, DECORATION_NON_WRITABLE});
+                                }
+                            }
+
+                            auto id = NewGlobal(type, StorageClass::Uniform, asBuffer->declarationName);
+                            DecorateResource(id, node->tags);
+                            DeclareBlock(asBuffer->declarationName, asBuffer->declarations, type,
+                                         StorageClass::Uniform, id, true);
+                        }
+                        else
+                        {
+                            auto type = TypeOf(declaration, ELayoutRule::None);
+                            auto opaque = type;
+                            while (opaque->kind == ETypeKind::Array || opaque->kind == ETypeKind::RuntimeArray)
+                            {
+                                opaque = opaque->element;
+                            }
+
+                            if (opaque->kind != ETypeKind::SampledImage && opaque->kind != ETypeKind::Image &&
+                                opaque->kind != ETypeKind::Sampler)
+                            {
+                                throw std::runtime_error(
+                                    "Uniform " + declaration->declarationName + " must be a block, texture or sampler");
+                            }
+
+                            auto id = NewGlobal(type, StorageClass::UniformConstant, declaration->declarationName);
+                            DecorateResource(id, node->tags);
+                            DeclareGlobal(declaration->declarationName, {id, type, StorageClass::UniformConstant});
+                        }
+                    }
+                    break;
+                }
+            }
+
+            void GeneratePushConstant(const std::shared_ptr<PushConstantNode>& node)
+            {
+                auto type = StructType("constant", node->declarations, LayoutRuleOf(node->tags, ELayoutRule::Std430));
+                Emit(_annotations, Op::Decorate, {type->id, DECORATION_BLOCK});
+                auto id = NewGlobal(type, StorageClass::PushConstant, "push");
+                DeclareGlobal("push", {id, type, StorageClass::PushConstant});
+            }
+
+            void GenerateGlobal(const std::shared_ptr<DeclarationNode>& declaration,
+                                const std::shared_ptr<Node>& initializer)
+            {
+                auto type = TypeOf(declaration, ELayoutRule::None, initializer);
+                if (type->kind == ETypeKind::RuntimeArray)
+                {
+                    throw std::runtime_error(declaration->declarationName + " needs a size or an initializer");
+                }
+
+                std::optional<Value> constant{};
+                if (initializer) constant = TryConstant(initializer, type);
+                if (constant && constant->type != type) constant.reset();
+
+                auto id = NewGlobal(type, StorageClass::Private, declaration->declarationName,
+                                    constant ? std::optional(constant->id) : std::nullopt);
+                Pointer pointer{id, type, StorageClass::Private};
+                if (initializer && !constant) _globalInitializers.emplace_back(pointer, initializer);
+                DeclareGlobal(declaration->declarationName, {id, type, StorageClass::Private});
+            }
+
+            static std::shared_ptr<DeclarationNode> AsDeclaration(const std::shared_ptr<Node>& node)
+            {
+                if (node->nodeType == NodeType::Const) return std::dynamic_pointer_cast<ConstNode>(node)->declaration;
+                if (node->nodeType == NodeType::Declaration) return std::dynamic_pointer_cast<DeclarationNode>(node);
+                return nullptr;
+            }
+
+            // Expressions
+
+            const Type* ConstructorType(const std::string& id)
+            {
+                if (auto found = GLSL_TYPE_NAMES.find(id); found != GLSL_TYPE_NAMES.end())
+                {
+                    return BaseType(found->second);
+                }
+
+                if (auto type = Token::KEYWORDS_TO_TOKENS.find(id); type != Token::KEYWORDS_TO_TOKENS.end())
+                {
+                    auto declarationType = DeclarationNode::TokenTypeToDeclarationType(type->second);
+                    if (declarationType != EDeclarationType::Struct && declarationType != EDeclarationType::Void &&
+                        declarationType != EDeclarationType::Buffer)
+                    {
+                        return BaseType(declarationType);
+                    }
+                    return nullptr;
+                }
+
+                if (_structs.contains(id)) return NamedStructType(id, ELayoutRule::None);
+                return nullptr;
+            }
+
+            Pointer MemberPointer(const Pointer& base, uint32_t index, const Type* type)
+            {
+                auto id = NewId();
+                Emit(_body, Op::AccessChain, {
+                         PointerType(base.storage, type), id, base.id, Constant(IntType(), static_cast<int>(index))
+                     });
+                return {id, type, base.storage};
+            }
+
+            Pointer VariablePointer(const Variable& variable)
+            {
+                Pointer pointer{variable.id, variable.type, variable.storage};
+                if (!variable.member) return pointer;
+                return MemberPointer(pointer, *variable.member, variable.type->members[*variable.member]);
+            }
+
+            // Address of node when it names memory, or nothing when it is a temporary value
+            std::optional<Pointer> TryPointer(const std::shared_ptr<Node>& node)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::Identifier:
+                    {
+                        auto variable = FindVariable(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+                        if (!variable) return std::nullopt;
+                        return VariablePointer(*variable);
+                    }
+                case NodeType::Precedence:
+                    return TryPointer(std::dynamic_pointer_cast<PrecedenceNode>(node)->target);
+                case NodeType::Access:
+                    {
+                        auto asAccess = std::dynamic_pointer_cast<AccessNode>(node);
+                        auto base = TryPointer(asAccess->left);
+                        if (!base) return std::nullopt;
+                        return AccessPointer(*base, asAccess->right);
+                    }
+                case NodeType::Index:
+                    {
+                        auto asIndex = std::dynamic_pointer_cast<IndexNode>(node);
+                        auto base = TryPointer(asIndex->left);
+                        if (!base) return std::nullopt;
+                        if (!base->swizzle.empty()) throw std::runtime_error("Cannot index a swizzle");
+
+                        const Type* elementType;
+                        switch (base->type->kind)
+                        {
+                        case ETypeKind::Array:
+                        case ETypeKind::RuntimeArray:
+                        case ETypeKind::Vector:
+                        case ETypeKind::Matrix:
+                            elementType = base->type->element;
+                            break;
+                        default:
+                            throw std::runtime_error("Cannot index " + TypeName(base->type));
+                        }
+
+                        auto index = Convert(GenerateExpression(asIndex->indexExpression), IntType());
+                        if (base->storage == StorageClass::UniformConstant && !_scalarConstants.contains(index.id))
+                        {
+                            EnableCapability(CAPABILITY_SAMPLED_IMAGE_ARRAY_DYNAMIC_INDEXING);
+                        }
+                        auto id = NewId();
+                        Emit(_body, Op::AccessChain, {
+                                 PointerType(base->storage, elementType), id, base->id, index.id
+                             });
+                        return Pointer{id, elementType, base->storage};
+                    }
+                default:
+                    return std::nullopt;
+                }
+            }
+
+            Pointer GeneratePointer(const std::shared_ptr<Node>& node)
+            {
+                if (auto pointer = TryPointer(node)) return *pointer;
+                throw std::runtime_error("Expression cannot be assigned to");
+            }
+
+            static std::string MemberName(const std::shared_ptr<Node>& node)
+            {
+                if (node->nodeType != NodeType::Identifier) throw std::runtime_error("Expected a member name");
+                return std::dynamic_pointer_cast<IdentifierNode>(node)->id;
+            }
+
+            Pointer AccessPointer(const Pointer& base, const std::shared_ptr<Node>& right)
+            {
+                auto name = MemberName(right);
+
+                if (base.type->kind == ETypeKind::Struct)
+                {
+                    auto found = std::ranges::find(base.type->memberNames, name);
+                    if (found == base.type->memberNames.end())
+                    {
+                        throw std::runtime_error(base.type->name + " has no member " + name);
+                    }
+                    auto index = static_cast<uint32_t>(found - base.type->memberNames.begin());
+                    return MemberPointer(base, index, base.type->members[index]);
+                }
+
+                if (base.type->kind == ETypeKind::Vector)
+                {
+                    auto components = parseSwizzle(name, base.type->count);
+                    if (!components) throw std::runtime_error("Invalid swizzle " + name);
+
+                    if (!base.swizzle.empty())
+                    {
+                        for (auto& component : *components)
+                        {
+                            if (component >= base.swizzle.size()) throw std::runtime_error("Invalid swizzle " + name);
+                            component = base.swizzle[component];
+                        }
+                    }
+
+                    if (components->size() == 1)
+                    {
+                        auto id = NewId();
+                        Emit(_body, Op::AccessChain, {
+                                 PointerType(base.storage, base.type->element), id, base.id,
+                                 Constant(IntType(), static_cast<int>(components->front()))
+                             });
+                        return {id, base.type->element, base.storage};
+                    }
+
+                    return {base.id, base.type, base.storage, *components};
+                }
+
+                throw std::runtime_error("Cannot access " + name + " of " + TypeName(base.type));
+            }
+
+            Value GenerateAccess(const std::shared_ptr<AccessNode>& node)
+            {
+                // The parser binds a leading '-' to the first primary, so -a.b arrives as (-a).b. GLSL reads it as
+                // -(a.b), which is what is generated here.
+                if (node->left->nodeType == NodeType::Negate)
+                {
+                    auto asNegate = std::dynamic_pointer_cast<NegateNode>(node->left);
+                    return GenerateNegate(std::make_shared<NegateNode>(
+                        std::make_shared<AccessNode>(asNegate->target, node->right)));
+                }
+
+                if (auto pointer = TryPointer(node)) return Load(*pointer);
+
+                auto left = GenerateExpression(node->left);
+                auto name = MemberName(node->right);
+
+                if (left.type->kind == ETypeKind::Struct)
+                {
+                    auto found = std::ranges::find(left.type->memberNames, name);
+                    if (found == left.type->memberNames.end())
+                    {
+                        throw std::runtime_error(left.type->name + " has no member " + name);
+                    }
+                    auto index = static_cast<uint32_t>(found - left.type->memberNames.begin());
+                    return EmitValue(Op::CompositeExtract, left.type->members[index], {left.id, index});
+                }
+
+                if (left.type->kind == ETypeKind::Vector)
+                {
+                    auto components = parseSwizzle(name, left.type->count);
+                    if (!components) throw std::runtime_error("Invalid swizzle " + name);
+                    return Swizzle(left, *components);
+                }
+
+                throw std::runtime_error("Cannot access " + name + " of " + TypeName(left.type));
+            }
+
+            Value GenerateIndex(const std::shared_ptr<IndexNode>& node)
+            {
+                if (auto pointer = TryPointer(node)) return Load(*pointer);
+
+                auto left = GenerateExpression(node->left);
+                if (left.type->kind != ETypeKind::Array && left.type->kind != ETypeKind::Vector &&
+                    left.type->kind != ETypeKind::Matrix)
+                {
+                    throw std::runtime_error("Cannot index " + TypeName(left.type));
+                }
+
+                if (node->indexExpression->nodeType == NodeType::IntLiteral)
+                {
+                    auto index = std::dynamic_pointer_cast<IntegerLiteralNode>(node->indexExpression)->data;
+                    return EmitValue(Op::CompositeExtract, left.type->element, {left.id, static_cast<uint32_t>(index)});
+                }
+
+                // Dynamic indexing needs memory, so temporaries are spilled to a variable
+                Pointer temporary{NewVariable(left.type), left.type, StorageClass::Function};
+                Emit(_body, Op::Store, {temporary.id, left.id});
+                auto index = Convert(GenerateExpression(node->indexExpression), IntType());
+                auto id = NewId();
+                Emit(_body, Op::AccessChain, {
+                         PointerType(StorageClass::Function, left.type->element), id, temporary.id, index.id
+                     });
+                return Load({id, left.type->element, StorageClass::Function});
+            }
+
+            Value GenerateIdentifier(const std::shared_ptr<IdentifierNode>& node)
+            {
+                if (auto variable = FindVariable(node->id)) return Load(VariablePointer(*variable));
+
+                if (auto define = _defines.find(node->id); define != _defines.end())
+                {
+                    if (!_expandingDefines.insert(node->id).second)
+                    {
+                        throw std::runtime_error("Define " + node->id + " refers to itself");
+                    }
+                    auto value = GenerateExpression(define->second);
+                    _expandingDefines.erase(node->id);
+                    return value;
+                }
+
+                throw std::runtime_error("Unknown identifier '" + node->id + "'");
+            }
+
+            // Brings two numeric operands to the same component type, converting int to float as GLSL does
+            void PromoteComponents(Value& left, Value& right)
+            {
+                if (!left.type->IsNumeric() || !right.type->IsNumeric())
+                {
+                    throw std::runtime_error("Arithmetic on " + TypeName(left.type) + " and " + TypeName(right.type));
+                }
+
+                if (left.type->IsInt() && right.type->IsFloat())
+                {
+                    left = Convert(left, WithComponent(left.type, FloatType()));
+                }
+                else if (left.type->IsFloat() && right.type->IsInt())
+                {
+                    right = Convert(right, WithComponent(right.type, FloatType()));
+                }
+            }
+
+            static Op ArithmeticOp(EBinaryOp op, bool isFloat)
+            {
+                switch (op)
+                {
+                case EBinaryOp::Add:
+                    return isFloat ? Op::FAdd : Op::IAdd;
+                case EBinaryOp::Subtract:
+                    return isFloat ? Op::FSub : Op::ISub;
+                case EBinaryOp::Multiply:
+                    return isFloat ? Op::FMul : Op::IMul;
+                case EBinaryOp::Divide:
+                    return isFloat ? Op::FDiv : Op::SDiv;
+                case EBinaryOp::Mod:
+                    return isFloat ? Op::FMod : Op::SMod;
+                default:
+                    throw std::runtime_error("Not an arithmetic operator");
+                }
+            }
+
+            // Applies op to each column of a matrix. other is a matrix of the same type or a scalar.
+            Value ColumnWise(EBinaryOp op, const Value& matrix, const std::optional<Value>& other, bool matrixOnLeft)
+            {
+                std::vector<uint32_t> columns{};
+                const auto columnType = matrix.type->element;
+                for (uint32_t i = 0; i < matrix.type->count; i++)
+                {
+                    auto column = EmitValue(Op::CompositeExtract, columnType, {matrix.id, i});
+                    if (!other)
+                    {
+                        columns.push_back(EmitValue(Op::FNegate, columnType, {column.id}).id);
+                        continue;
+                    }
+
+                    auto otherColumn = other->type->kind == ETypeKind::Matrix
+                                           ? EmitValue(Op::CompositeExtract, columnType, {other->id, i})
+                                           : Splat(*other, columnType);
+                    auto [left, right] = matrixOnLeft ? std::pair(column, otherColumn) : std::pair(otherColumn, column);
+                    columns.push_back(EmitValue(ArithmeticOp(op, true), columnType, {left.id, right.id}).id);
+                }
+                return EmitValue(Op::CompositeConstruct, matrix.type, columns);
+            }
+
+            Value Arithmetic(EBinaryOp op, Value left, Value right)
+            {
+                PromoteComponents(left, right);
+
+                const auto leftKind = left.type->kind;
+                const auto rightKind = right.type->kind;
+
+                if (op == EBinaryOp::Multiply)
+                {
+                    if (leftKind == ETypeKind::Matrix && rightKind == ETypeKind::Matrix)
+                    {
+                        return EmitValue(Op::MatrixTimesMatrix, right.type, {left.id, right.id});
+                    }
+                    if (leftKind == ETypeKind::Matrix && rightKind == ETypeKind::Vector)
+                    {
+                        return EmitValue(Op::MatrixTimesVector, left.type->element, {left.id, right.id});
+                    }
+                    if (leftKind == ETypeKind::Vector && rightKind == ETypeKind::Matrix)
+                    {
+                        return EmitValue(Op::VectorTimesMatrix, VectorType(FloatType(), right.type->count),
+                                         {left.id, right.id});
+                    }
+                    if (leftKind == ETypeKind::Matrix && right.type->IsScalar())
+                    {
+                        return EmitValue(Op::MatrixTimesScalar, left.type, {left.id, right.id});
+                    }
+                    if (left.type->IsScalar() && rightKind == ETypeKind::Matrix)
+                    {
+                        return EmitValue(Op::MatrixTimesScalar, right.type, {right.id, left.id});
+                    }
+                    if (left.type->IsFloat() && leftKind == ETypeKind::Vector && right.type->IsScalar())
+                    {
+                        return EmitValue(Op::VectorTimesScalar, left.type, {left.id, right.id});
+                    }
+                    if (right.type->IsFloat() && rightKind == ETypeKind::Vector && left.type->IsScalar())
+                    {
+                        return EmitValue(Op::VectorTimesScalar, right.type, {right.id, left.id});
+                    }
+                }
+
+                if (leftKind == ETypeKind::Matrix)
+                {
+                    return ColumnWise(op, left, right, true);
+                }
+                if (rightKind == ETypeKind::Matrix)
+                {
+                    return ColumnWise(op, right, left, false);
+                }
+
+                if (left.type->IsScalar() && rightKind == ETypeKind::Vector)
+                {
+                    left = Splat(left, right.type);
+                }
+                else if (leftKind == ETypeKind::Vector && right.type->IsScalar())
+                {
+                    right = Splat(right, left.type);
+                }
+
+                if (left.type != right.type)
+                {
+                    throw std::runtime_error("Arithmetic on " + TypeName(left.type) + " and " + TypeName(right.type));
+                }
+
+                return EmitValue(ArithmeticOp(op, left.type->IsFloat()), left.type, {left.id, right.id});
+            }
+
+            Value Compare(EBinaryOp op, Value left, Value right)
+            {
+                if (left.type->IsBool() && right.type->IsBool())
+                {
+                    if (op != EBinaryOp::Equal && op != EBinaryOp::NotEqual)
+                    {
+                        throw std::runtime_error("bool values can only be compared for equality");
+                    }
+                }
+                else
+                {
+                    PromoteComponents(left, right);
+                }
+
+                if (left.type->IsScalar() && !right.type->IsScalar()) left = Splat(left, right.type);
+                if (right.type->IsScalar() && !left.type->IsScalar()) right = Splat(right, left.type);
+
+                if (left.type != right.type || !left.type->IsScalarOrVector())
+                {
+                    throw std::runtime_error("Cannot compare " + TypeName(left.type) + " and " + TypeName(right.type));
+                }
+
+                if (!left.type->IsScalar() && op != EBinaryOp::Equal && op != EBinaryOp::NotEqual)
+                {
+                    throw std::runtime_error("Relational operators only apply to scalars");
+                }
+
+                const auto isFloat = left.type->IsFloat();
+                const auto isBool = left.type->IsBool();
+                Op compare;
+                switch (op)
+                {
+                case EBinaryOp::Equal:
+                    compare = isBool ? Op::LogicalEqual : isFloat ? Op::FOrdEqual : Op::IEqual;
+                    break;
+                case EBinaryOp::NotEqual:
+                    compare = isBool ? Op::LogicalNotEqual : isFloat ? Op::FOrdNotEqual : Op::INotEqual;
+                    break;
+                case EBinaryOp::Less:
+                    compare = isFloat ? Op::FOrdLessThan : Op::SLessThan;
+                    break;
+                case EBinaryOp::LessEqual:
+                    compare = isFloat ? Op::FOrdLessThanEqual : Op::SLessThanEqual;
+                    break;
+                case EBinaryOp::Greater:
+                    compare = isFloat ? Op::FOrdGreaterThan : Op::SGreaterThan;
+                    break;
+                case EBinaryOp::GreaterEqual:
+                    compare = isFloat ? Op::FOrdGreaterThanEqual : Op::SGreaterThanEqual;
+                    break;
+                default:
+                    throw std::runtime_error("Not a comparison operator");
+                }
+
+                auto result = EmitValue(compare, WithComponent(left.type, BoolType()), {left.id, right.id});
+                if (result.type->IsScalar()) return result;
+
+                // Vectors are equal when every component is
+                return EmitValue(op == EBinaryOp::Equal ? Op::All : Op::Any, BoolType(), {result.id});
+            }
+
+            // Whether evaluating node can change state, so it must not be evaluated eagerly or more than once. Only
+            // user functions can have side effects among calls.
+            bool HasSideEffects(const std::shared_ptr<Node>& node) const
+            {
+                auto result = false;
+                walk(node, [this, &result](const std::shared_ptr<Node>& child)
+                {
+                    if (!child || result) return false;
+
+                    switch (child->nodeType)
+                    {
+                    case NodeType::Assign:
+                    case NodeType::Increment:
+                    case NodeType::Decrement:
+                    case NodeType::Discard:
+                        result = true;
+                        return false;
+                    case NodeType::Call:
+                        result = _userFunctions.contains(std::dynamic_pointer_cast<CallNode>(child)->identifier->id);
+                        return !result;
+                    default:
+                        return true;
+                    }
+                });
+                return result;
+            }
+
+            Value GenerateLogical(const std::shared_ptr<BinaryOpNode>& node)
+            {
+                auto left = Convert(GenerateExpression(node->left), BoolType());
+                const auto isAnd = node->op == EBinaryOp::And;
+
+                if (!HasSideEffects(node->right))
+                {
+                    auto right = Convert(GenerateExpression(node->right), BoolType());
+                    return EmitValue(isAnd ? Op::LogicalAnd : Op::LogicalOr, BoolType(), {left.id, right.id});
+                }
+
+                // The right side only runs when it decides the result
+                const auto leftLabel = _currentLabel;
+                const auto rightLabel = NewId();
+                const auto mergeLabel = NewId();
+                Emit(_body, Op::SelectionMerge, {mergeLabel, 0});
+                Terminate(Op::BranchConditional, {
+                              left.id, isAnd ? rightLabel : mergeLabel, isAnd ? mergeLabel : rightLabel
+                          });
+
+                BeginBlock(rightLabel);
+                auto right = Convert(GenerateExpression(node->right), BoolType());
+                const auto rightEndLabel = _currentLabel;
+                Terminate(Op::Branch, {mergeLabel});
+
+                BeginBlock(mergeLabel);
+                return EmitValue(Op::Phi, BoolType(), {left.id, leftLabel, right.id, rightEndLabel});
+            }
+
+            Value GenerateBinaryOp(const std::shared_ptr<BinaryOpNode>& node)
+            {
+                switch (node->op)
+                {
+                case EBinaryOp::And:
+                case EBinaryOp::Or:
+                    return GenerateLogical(node);
+                case EBinaryOp::Not:
+                    throw std::runtime_error("! not supported");
+                case EBinaryOp::Add:
+                case EBinaryOp::Subtract:
+                case EBinaryOp::Multiply:
+                case EBinaryOp::Divide:
+                case EBinaryOp::Mod:
+                    {
+                        auto left = GenerateExpression(node->left);
+                        auto right = GenerateExpression(node->right);
+                        return Arithmetic(node->op, left, right);
+                    }
+                default:
+                    {
+                        auto left = GenerateExpression(node->left);
+                        auto right = GenerateExpression(node->right);
+                        return Compare(node->op, left, right);
+                    }
+                }
+            }
+
+            Value GenerateNegate(const std::shared_ptr<NegateNode>& node)
+            {
+                if (auto constant = TryConstant(node, nullptr)) return *constant;
+
+                auto value = GenerateExpression(node->target);
+                if (value.type->kind == ETypeKind::Matrix) return ColumnWise(EBinaryOp::Subtract, value, {}, true);
+                if (!value.type->IsNumeric()) throw std::runtime_error("Cannot negate " + TypeName(value.type));
+                return EmitValue(value.type->IsFloat() ? Op::FNegate : Op::SNegate, value.type, {value.id});
+            }
+
+            Value GenerateStep(const std::shared_ptr<Node>& target, bool isPrefix, bool increment)
+            {
+                auto pointer = GeneratePointer(target);
+                auto old = Load(pointer);
+                if (!old.type->IsNumeric() || old.type->kind == ETypeKind::Matrix)
+                {
+                    throw std::runtime_error("Cannot increment " + TypeName(old.type));
+                }
+
+                Value one{SplatConstant(old.type, 1.0f), old.type};
+                auto updated = EmitValue(ArithmeticOp(increment ? EBinaryOp::Add : EBinaryOp::Subtract,
+                                                      old.type->IsFloat()), old.type, {old.id, one.id});
+                Store(pointer, updated);
+                return isPrefix ? updated : old;
+            }
+
+            Value GenerateConditional(const std::shared_ptr<ConditionalNode>& node)
+            {
+                auto condition = Convert(GenerateExpression(node->condition), BoolType());
+
+                if (!HasSideEffects(node->left) && !HasSideEffects(node->right))
+                {
+                    auto left = GenerateExpression(node->left);
+                    auto right = GenerateExpression(node->right);
+                    if (left.type->IsScalarOrVector() && right.type->IsScalarOrVector())
+                    {
+                        if (left.type->IsNumeric() && right.type->IsNumeric()) PromoteComponents(left, right);
+                        right = Convert(right, left.type);
+                        // SPIR-V 1.0 selects vectors with a vector of conditions
+                        auto selector = Splat(condition, WithComponent(left.type, BoolType()));
+                        return EmitValue(Op::Select, left.type, {selector.id, left.id, right.id});
+                    }
+                }
+
+                // Anything else goes through a variable so only the chosen side is evaluated
+                const auto leftLabel = NewId();
+                const auto rightLabel = NewId();
+                const auto mergeLabel = NewId();
+                Emit(_body, Op::SelectionMerge, {mergeLabel, 0});
+                Terminate(Op::BranchConditional, {condition.id, leftLabel, rightLabel});
+
+                BeginBlock(leftLabel);
+                auto left = GenerateExpression(node->left);
+                Pointer result{NewVariable(left.type), left.type, StorageClass::Function};
+                Store(result, left);
+                Terminate(Op::Branch, {mergeLabel});
+
+                BeginBlock(rightLabel);
+                Store(result, GenerateExpression(node->right));
+                Terminate(Op::Branch, {mergeLabel});
+
+                BeginBlock(mergeLabel);
+                return Load(result);
+            }
+
+            Value GenerateArrayLiteral(const std::shared_ptr<ArrayLiteralNode>& node, const Type* expected)
+            {
+                if (!expected || expected->kind != ETypeKind::Array)
+                {
+                    throw std::runtime_error("Array literals can only initialize arrays");
+                }
+                if (node->nodes.size() != expected->count)
+                {
+                    throw std::runtime_error("Expected " + std::to_string(expected->count) + " elements but got " +
+                        std::to_string(node->nodes.size()));
+                }
+
+                if (auto constant = TryConstant(node, expected)) return *constant;
+
+                std::vector<uint32_t> elements{};
+                for (auto& element : node->nodes)
+                {
+                    elements.push_back(Convert(GenerateExpression(element, expected->element), expected->element).id);
+                }
+                return EmitValue(Op::CompositeConstruct, expected, elements);
+            }
+
+            // Components of value as separate scalars, converted to component
+            std::vector<uint32_t> Flatten(const Value& value, const Type* component)
+            {
+                if (value.type->IsScalar()) return {Convert(value, component).id};
+
+                if (value.type->kind == ETypeKind::Vector)
+                {
+                    auto converted = Convert(value, WithComponent(value.type, component));
+                    std::vector<uint32_t> components{};
+                    for (uint32_t i = 0; i < value.type->count; i++)
+                    {
+                        components.push_back(EmitValue(Op::CompositeExtract, component, {converted.id, i}).id);
+                    }
+                    return components;
+                }
+
+                if (value.type->kind == ETypeKind::Matrix)
+                {
+                    std::vector<uint32_t> components{};
+                    for (uint32_t i = 0; i < value.type->count; i++)
+                    {
+                        auto column = EmitValue(Op::CompositeExtract, value.type->element, {value.id, i});
+                        auto columnComponents = Flatten(column, component);
+                        components.insert(components.end(), columnComponents.begin(), columnComponents.end());
+                    }
+                    return components;
+                }
+
+                throw std::runtime_error("Cannot construct from " + TypeName(value.type));
+            }
+
+            Value GenerateConstructor(const Type* type, const std::vector<std::shared_ptr<Node>>& argNodes,
+                                      const std::shared_ptr<Node>& node)
+            {
+                if (auto constant = TryConstant(node, nullptr); constant && constant->type == type) return *constant;
+
+                std::vector<Value> args{};
+                for (auto& arg : argNodes)
+                {
+                    args.push_back(GenerateExpression(arg));
+                }
+
+                if (type->kind == ETypeKind::Struct)
+                {
+                    if (args.size() != type->members.size())
+                    {
+                        throw std::runtime_error(type->name + " has " + std::to_string(type->members.size()) +
+                            " members");
+                    }
+
+                    std::vector<uint32_t> members{};
+                    for (size_t i = 0; i < args.size(); i++)
+                    {
+                        members.push_back(Convert(args[i], type->members[i]).id);
+                    }
+                    return EmitValue(Op::CompositeConstruct, type, members);
+                }
+
+                if (args.empty()) throw std::runtime_error("Constructor of " + TypeName(type) + " needs arguments");
+
+                if (type->IsScalar())
+                {
+                    auto arg = args.front();
+                    if (!arg.type->IsScalar())
+                    {
+                        if (!arg.type->IsScalarOrVector()) throw std::runtime_error("Cannot convert to scalar");
+                        arg = EmitValue(Op::CompositeExtract, arg.type->element, {arg.id, 0});
+                    }
+                    return Convert(arg, type);
+                }
+
+                if (type->kind == ETypeKind::Vector)
+                {
+                    if (args.size() == 1 && args.front().type->IsScalar()) return Convert(args.front(), type);
+
+                    if (args.size() == 1 && args.front().type->kind == ETypeKind::Vector &&
+                        args.front().type->count >= type->count)
+                    {
+                        auto arg = Convert(args.front(), WithComponent(args.front().type, type->element));
+                        if (arg.type->count == type->count) return arg;
+
+                        std::vector<uint32_t> components(type->count);
+                        for (uint32_t i = 0; i < type->count; i++) components[i] = i;
+                        return Swizzle(arg, components);
+                    }
+
+                    std::vector<uint32_t> components{};
+                    for (auto& arg : args)
+                    {
+                        auto argComponents = Flatten(arg, type->element);
+                        components.insert(components.end(), argComponents.begin(), argComponents.end());
+                    }
+                    if (components.size() < type->count)
+                    {
+                        throw std::runtime_error("Not enough components to construct " + TypeName(type));
+                    }
+                    components.resize(type->count);
+                    return EmitValue(Op::CompositeConstruct, type, components);
+                }
+
+                if (type->kind == ETypeKind::Matrix)
+                {
+                    const auto columnType = type->element;
+                    const auto size = type->count;
+
+                    if (args.size() == 1 && args.front().type->IsScalar())
+                    {
+                        // Diagonal matrix
+                        auto diagonal = Convert(args.front(), FloatType());
+                        auto zero = Constant(FloatType(), 0.0f);
+                        std::vector<uint32_t> columns{};
+                        for (uint32_t i = 0; i < size; i++)
+                        {
+                            std::vector<uint32_t> components(size, zero);
+                            components[i] = diagonal.id;
+                            columns.push_back(EmitValue(Op::CompositeConstruct, columnType, components).id);
+                        }
+                        return EmitValue(Op::CompositeConstruct, type, columns);
+                    }
+
+                    if (args.size() == 1 && args.front().type->kind == ETypeKind::Matrix)
+                    {
+                        // Takes the upper left of a larger matrix and fills the rest of a larger one with identity
+                        auto source = args.front();
+                        std::vector<uint32_t> columns{};
+                        for (uint32_t i = 0; i < size; i++)
+                        {
+                            std::vector<uint32_t> components{};
+                            std::optional<Value> column{};
+                            if (i < source.type->count)
+                            {
+                                column = EmitValue(Op::CompositeExtract, source.type->element, {source.id, i});
+                            }
+                            for (uint32_t j = 0; j < size; j++)
+                            {
+                                if (column && j < source.type->count)
+                                {
+                                    components.push_back(EmitValue(Op::CompositeExtract, FloatType(),
+                                                                   {column->id, j}).id);
+                                }
+                                else
+                                {
+                                    components.push_back(Constant(FloatType(), i == j ? 1.0f : 0.0f));
+                                }
+                            }
+                            columns.push_back(EmitValue(Op::CompositeConstruct, columnType, components).id);
+                        }
+                        return EmitValue(Op::CompositeConstruct, type, columns);
+                    }
+
+                    std::vector<uint32_t> components{};
+                    for (auto& arg : args)
+                    {
+                        auto argComponents = Flatten(arg, FloatType());
+                        components.insert(components.end(), argComponents.begin(), argComponents.end());
+                    }
+                    if (components.size() != size * size)
+                    {
+                        throw std::runtime_error("Wrong number of components to construct " + TypeName(type));
+                    }
+
+                    std::vector<uint32_t> columns{};
+                    for (uint32_t i = 0; i < size; i++)
+                    {
+                        std::vector<uint32_t> column(components.begin() + i * size,
+                                                     components.begin() + (i + 1) * size);
+                        columns.push_back(EmitValue(Op::CompositeConstruct, columnType, column).id);
+                    }
+                    return EmitValue(Op::CompositeConstruct, type, columns);
+                }
+
+                throw std::runtime_error("Cannot construct " + TypeName(type));
+            }
+
+            static bool ParameterAccepts(const Type* parameter, const Type* argument)
+            {
+                if (parameter == argument) return true;
+                // int arguments convert to float parameters
+                return parameter->IsScalarOrVector() && argument->IsScalarOrVector() && parameter->IsFloat() &&
+                    argument->IsInt() && parameter->ComponentCount() == argument->ComponentCount();
+            }
+
+            Function* ResolveOverload(const std::string& name, std::vector<Function>& overloads,
+                                      const std::vector<const Type*>& argTypes)
+            {
+                Function* convertible = nullptr;
+                for (auto& function : overloads)
+                {
+                    if (function.parameterTypes.size() != argTypes.size()) continue;
+
+                    auto exact = true;
+                    auto accepts = true;
+                    for (size_t i = 0; i < argTypes.size(); i++)
+                    {
+                        exact = exact && function.parameterTypes[i] == argTypes[i];
+                        accepts = accepts && (ParameterAccepts(function.parameterTypes[i], argTypes[i]) ||
+                            (argTypes[i]->name == function.parameterTypes[i]->name && !argTypes[i]->name.empty()) ||
+                            (argTypes[i]->kind == ETypeKind::Array && function.parameterTypes[i]->kind ==
+                                ETypeKind::Array && argTypes[i]->count == function.parameterTypes[i]->count));
+                    }
+
+                    if (exact) return &function;
+                    if (accepts && !convertible) convertible = &function;
+                }
+
+                if (!convertible) throw std::runtime_error("No overload of " + name + " matches its arguments");
+                return convertible;
+            }
+
+            Value GenerateUserCall(const std::string& name, std::vector<Function>& overloads,
+                                   const std::vector<std::shared_ptr<Node>>& argNodes)
+            {
+                // Arguments that name memory are kept as pointers until the overload says which are outputs
+                std::vector<std::optional<Pointer>> pointers{};
+                std::vector<std::optional<Value>> values{};
+                std::vector<const Type*> argTypes{};
+                for (auto& arg : argNodes)
+                {
+                    auto pointer = TryPointer(arg);
+                    if (pointer)
+                    {
+                        pointers.push_back(pointer);
+                        values.emplace_back();
+                        argTypes.push_back(pointer->swizzle.empty()
+                                               ? pointer->type
+                                               : VectorType(pointer->type->element,
+                                                            static_cast<uint32_t>(pointer->swizzle.size())));
+                    }
+                    else
+                    {
+                        auto value = GenerateExpression(arg);
+                        pointers.emplace_back();
+                        values.push_back(value);
+                        argTypes.push_back(value.type);
+                    }
+                }
+
+                auto function = ResolveOverload(name, overloads, argTypes);
+                Enqueue(*function);
+
+                // Parameters are passed as Function variables so uniform and swizzled arguments work too
+                std::vector<uint32_t> parameters{};
+                for (size_t i = 0; i < argNodes.size(); i++)
+                {
+                    const auto parameterType = function->parameterTypes[i];
+                    Pointer temporary{NewVariable(parameterType), parameterType, StorageClass::Function};
+                    parameters.push_back(temporary.id);
+
+                    if (function->node->arguments[i]->isInput)
+                    {
+                        Store(temporary, values[i] ? *values[i] : Load(*pointers[i]));
+                    }
+                    else if (!pointers[i])
+                    {
+                        throw std::runtime_error("Argument " + std::to_string(i + 1) + " of " + name +
+                            " is an output and must be assignable");
+                    }
+                }
+
+                std::vector<uint32_t> operands{function->id};
+                operands.insert(operands.end(), parameters.begin(), parameters.end());
+                auto result = EmitValue(Op::FunctionCall, function->returnType, operands);
+
+                for (size_t i = 0; i < argNodes.size(); i++)
+                {
+                    if (function->node->arguments[i]->isInput) continue;
+                    Store(*pointers[i], Load({parameters[i], function->parameterTypes[i], StorageClass::Function}));
+                }
+
+                return result;
+            }
+
+            // Shape shared by the arguments of a component wise builtin: the widest vector, float unless every
+            // argument is int and the builtin has an int form
+            const Type* ComponentWiseType(const std::vector<Value>& args, bool allowInt)
+            {
+                uint32_t count = 1;
+                auto isFloat = !allowInt;
+                for (auto& arg : args)
+                {
+                    if (!arg.type->IsNumeric() || !arg.type->IsScalarOrVector())
+                    {
+                        throw std::runtime_error("Expected a scalar or vector but got " + TypeName(arg.type));
+                    }
+                    count = std::max(count, arg.type->ComponentCount());
+                    isFloat = isFloat || arg.type->IsFloat();
+                }
+                return VectorType(isFloat ? FloatType() : IntType(), count);
+            }
+
+            std::vector<Value> ConvertAll(std::vector<Value> args, const Type* type)
+            {
+                for (auto& arg : args)
+                {
+                    arg = Convert(arg, type);
+                }
+                return args;
+            }
+
+            void RequireFragment(const std::string& name)
+            {
+                if (_scopeType != EScopeType::Fragment)
+                {
+                    throw std::runtime_error(name + " is only available in fragment shaders");
+                }
+            }
+
+            std::optional<Value> GenerateBuiltinCall(const std::string& name,
+                                                     const std::vector<std::shared_ptr<Node>>& argNodes)
+            {
+                std::vector<Value> args{};
+                auto requireArgs = [&](size_t count)
+                {
+                    if (argNodes.size() != count)
+                    {
+                        throw std::runtime_error(name + " takes " + std::to_string(count) + " arguments");
+                    }
+                    for (auto& arg : argNodes)
+                    {
+                        args.push_back(GenerateExpression(arg));
+                    }
+                };
+
+                auto floatType = [&](const Value& value)
+                {
+                    if (!value.type->IsNumeric() || !value.type->IsScalarOrVector())
+                    {
+                        throw std::runtime_error(name + " expects float arguments");
+                    }
+                    return WithComponent(value.type, FloatType());
+                };
+
+                if (auto builtin = COMPONENT_WISE_BUILTINS.find(name); builtin != COMPONENT_WISE_BUILTINS.end())
+                {
+                    auto& info = builtin->second;
+                    // atan has a two argument form
+                    if (name == "atan" && argNodes.size() == 2)
+                    {
+                        requireArgs(2);
+                        auto type = ComponentWiseType(args, false);
+                        return EmitExtended(glsl450::Atan2, type, ConvertAll(args, type));
+                    }
+
+                    requireArgs(info.argCount);
+                    auto type = ComponentWiseType(args, info.intInstruction != 0);
+                    return EmitExtended(type->IsFloat() ? info.floatInstruction : info.intInstruction, type,
+                                        ConvertAll(args, type));
+                }
+
+                if (name == "atan")
+                {
+                    requireArgs(1);
+                    auto type = ComponentWiseType(args, false);
+                    return EmitExtended(glsl450::Atan, type, ConvertAll(args, type));
+                }
+
+                if (name == "mod")
+                {
+                    requireArgs(2);
+                    auto type = ComponentWiseType(args, false);
+                    args = ConvertAll(args, type);
+                    return EmitValue(Op::FMod, type, {args[0].id, args[1].id});
+                }
+
+                if (name == "dot")
+                {
+                    requireArgs(2);
+                    auto type = ComponentWiseType(args, false);
+                    args = ConvertAll(args, type);
+                    if (type->IsScalar()) return EmitValue(Op::FMul, type, {args[0].id, args[1].id});
+                    return EmitValue(Op::Dot, FloatType(), {args[0].id, args[1].id});
+                }
+
+                if (name == "length" || name == "normalize")
+                {
+                    requireArgs(1);
+                    auto type = floatType(args[0]);
+                    return EmitExtended(name == "length" ? glsl450::Length : glsl450::Normalize,
+                                        name == "length" ? FloatType() : type, {Convert(args[0], type)});
+                }
+
+                if (name == "distance" || name == "cross" || name == "reflect")
+                {
+                    requireArgs(2);
+                    auto type = ComponentWiseType(args, false);
+                    const auto instruction = name == "distance"
+                                                 ? glsl450::Distance
+                                                 : name == "cross"
+                                                 ? glsl450::Cross
+                                                 : glsl450::Reflect;
+                    return EmitExtended(instruction, name == "distance" ? FloatType() : type, ConvertAll(args, type));
+                }
+
+                if (name == "faceforward")
+                {
+                    requireArgs(3);
+                    auto type = ComponentWiseType(args, false);
+                    return EmitExtended(glsl450::FaceForward, type, ConvertAll(args, type));
+                }
+
+                if (name == "refract")
+                {
+                    requireArgs(3);
+                    auto type = ComponentWiseType({args[0], args[1]}, false);
+                    return EmitExtended(glsl450::Refract, type, {
+                                            Convert(args[0], type), Convert(args[1], type),
+                                            Convert(args[2], FloatType())
+                                        });
+                }
+
+                if (name == "inverse" || name == "determinant" || name == "transpose")
+                {
+                    requireArgs(1);
+                    if (args[0].type->kind != ETypeKind::Matrix) throw std::runtime_error(name + " expects a matrix");
+                    if (name == "transpose") return EmitValue(Op::Transpose, args[0].type, {args[0].id});
+                    return name == "inverse"
+                               ? EmitExtended(glsl450::MatrixInverse, args[0].type, args)
+                               : EmitExtended(glsl450::Determinant, FloatType(), args);
+                }
+
+                if (name == "dFdx" || name == "dFdy" || name == "fwidth")
+                {
+                    RequireFragment(name);
+                    requireArgs(1);
+                    auto type = floatType(args[0]);
+                    const auto op = name == "dFdx" ? Op::DPdx : name == "dFdy" ? Op::DPdy : Op::Fwidth;
+                    return EmitValue(op, type, {Convert(args[0], type).id});
+                }
+
+                if (name == "any" || name == "all" || name == "not")
+                {
+                    requireArgs(1);
+                    if (!args[0].type->IsBool() || args[0].type->kind != ETypeKind::Vector)
+                    {
+                        throw std::runtime_error(name + " expects a bool vector");
+                    }
+                    if (name == "not") return EmitValue(Op::LogicalNot, args[0].type, {args[0].id});
+                    return EmitValue(name == "any" ? Op::Any : Op::All, BoolType(), {args[0].id});
+                }
+
+                if (name == "texture" || name == "textureLod")
+                {
+                    requireArgs(name == "texture" ? 2 : 3);
+                    if (args[0].type->kind != ETypeKind::SampledImage)
+                    {
+                        throw std::runtime_error(name + " expects a sampler2D");
+                    }
+
+                    auto result = VectorType(FloatType(), 4);
+                    auto coordinate = Convert(args[1], VectorType(FloatType(), 2));
+
+                    // Implicit derivatives only exist in fragment shaders
+                    if (name == "texture" && _scopeType == EScopeType::Fragment)
+                    {
+                        return EmitValue(Op::ImageSampleImplicitLod, result, {args[0].id, coordinate.id});
+                    }
+
+                    auto lod = name == "texture"
+                                   ? Value{Constant(FloatType(), 0.0f), FloatType()}
+                                   : Convert(args[2], FloatType());
+                    return EmitValue(Op::ImageSampleExplicitLod, result, {
+                                         args[0].id, coordinate.id, IMAGE_OPERANDS_LOD, lod.id
+                                     });
+                }
+
+                if (name == "textureSize")
+                {
+                    requireArgs(2);
+                    if (args[0].type->kind != ETypeKind::SampledImage)
+                    {
+                        throw std::runtime_error(name + " expects a sampler2D");
+                    }
+
+                    EnableCapability(CAPABILITY_IMAGE_QUERY);
+                    auto image = EmitValue(Op::Image, ImageType(), {args[0].id});
+                    return EmitValue(Op::ImageQuerySizeLod, VectorType(IntType(), 2), {
+                                         image.id, Convert(args[1], IntType()).id
+                                     });
+                }
+
+                return std::nullopt;
+            }
+
+            Value GenerateCall(const std::shared_ptr<CallNode>& node)
+            {
+                const auto& name = node->identifier->id;
+
+                if (auto type = ConstructorType(name)) return GenerateConstructor(type, node->args, node);
+
+                if (auto found = _userFunctions.find(name); found != _userFunctions.end())
+                {
+                    return GenerateUserCall(name, found->second, node->args);
+                }
+
+                if (auto result = GenerateBuiltinCall(name, node->args)) return *result;
+
+                throw std::runtime_error("Unknown function '" + name + "'");
+            }
+
+            Value GenerateExpression(const std::shared_ptr<Node>& node, const Type* expected = nullptr)
+            {
+                switch (node->nodeType)
+                {
+                case NodeType::FloatLiteral:
+                case NodeType::IntLiteral:
+                case NodeType::BooleanLiteral:
+                    return *TryConstant(node, nullptr);
+                case NodeType::Identifier:
+                    return GenerateIdentifier(std::dynamic_pointer_cast<IdentifierNode>(node));
+                case NodeType::Precedence:
+                    return GenerateExpression(std::dynamic_pointer_cast<PrecedenceNode>(node)->target, expected);
+                case NodeType::BinaryOp:
+                    return GenerateBinaryOp(std::dynamic_pointer_cast<BinaryOpNode>(node));
+                case NodeType::Negate:
+                    return GenerateNegate(std::dynamic_pointer_cast<NegateNode>(node));
+                case NodeType::Increment:
+                    {
+                        auto asIncrement = std::dynamic_pointer_cast<IncrementNode>(node);
+                        return GenerateStep(asIncrement->target, asIncrement->isPrefix, true);
+                    }
+                case NodeType::Decrement:
+                    {
+                        auto asDecrement = std::dynamic_pointer_cast<DecrementNode>(node);
+                        return GenerateStep(asDecrement->target, asDecrement->isPrefix, false);
+                    }
+                case NodeType::Access:
+                    return GenerateAccess(std::dynamic_pointer_cast<AccessNode>(node));
+                case NodeType::Index:
+                    return GenerateIndex(std::dynamic_pointer_cast<IndexNode>(node));
+                case NodeType::Call:
+                    return GenerateCall(std::dynamic_pointer_cast<CallNode>(node));
+                case NodeType::Conditional:
+                    return GenerateConditional(std::dynamic_pointer_cast<ConditionalNode>(node));
+                case NodeType::ArrayLiteral:
+                    return GenerateArrayLiteral(std::dynamic_pointer_cast<ArrayLiteralNode>(node), expected);
+                case NodeType::Assign:
+                    return GenerateAssign(std::dynamic_pointer_cast<AssignNode>(node));
+                default:
+                    throw std::runtime_error("Expression cannot be lowered to SPIR-V");
+                }
+            }
+
+            // Statements
+
+            Pointer DeclareLocal(const std::shared_ptr<DeclarationNode>& declaration,
+                                 const std::shared_ptr<Node>& initializer = {})
+            {
+                auto type = TypeOf(declaration, ELayoutRule::None, initializer);
+                if (type->kind == ETypeKind::RuntimeArray)
+                {
+                    throw std::runtime_error(declaration->declarationName + " needs a size or an initializer");
+                }
+                if (type->kind == ETypeKind::Void) throw std::runtime_error("Variables cannot be void");
+
+                auto id = NewVariable(type, declaration->declarationName);
+                _scopes.back().insert_or_assign(declaration->declarationName,
+                                                Variable{id, type, StorageClass::Function});
+                return {id, type, StorageClass::Function};
+            }
+
+            Value GenerateAssign(const std::shared_ptr<AssignNode>& node)
+            {
+                if (auto declaration = AsDeclaration(node->target))
+                {
+                    // The initializer is evaluated before the name it declares is in scope
+                    auto type = TypeOf(declaration, ELayoutRule::None, node->value);
+                    auto value = Convert(GenerateExpression(node->value, type), type);
+                    auto pointer = DeclareLocal(declaration, node->value);
+                    Store(pointer, value);
+                    return value;
+                }
+
+                auto value = GenerateExpression(node->value);
+                auto pointer = GeneratePointer(node->target);
+                Store(pointer, value);
+                return value;
+            }
+
+            void GenerateScope(const std::shared_ptr<ScopeNode>& node)
+            {
+                _scopes.emplace_back();
+                for (auto& statement : node->statements)
+                {
+                    GenerateStatement(statement);
+                }
+                _scopes.pop_back();
+            }
+
+            void GenerateIf(const std::shared_ptr<IfNode>& node)
+            {
+                auto condition = Convert(GenerateExpression(node->condition), BoolType());
+
+                const auto thenLabel = NewId();
+                const auto mergeLabel = NewId();
+                const auto elseLabel = node->elseNode ? NewId() : mergeLabel;
+
+                Emit(_body, Op::SelectionMerge, {mergeLabel, 0});
+                Terminate(Op::BranchConditional, {condition.id, thenLabel, elseLabel});
+
+                BeginBlock(thenLabel);
+                GenerateScope(node->scope);
+                if (!_terminated) Terminate(Op::Branch, {mergeLabel});
+
+                if (node->elseNode)
+                {
+                    BeginBlock(elseLabel);
+                    if (node->elseNode->nodeType == NodeType::If)
+                    {
+                        GenerateIf(std::dynamic_pointer_cast<IfNode>(node->elseNode));
+                    }
+                    else
+                    {
+                        GenerateScope(std::dynamic_pointer_cast<ScopeNode>(node->elseNode));
+                    }
+                    if (!_terminated) Terminate(Op::Branch, {mergeLabel});
+                }
+
+                BeginBlock(mergeLabel);
+            }
+
+            void GenerateFor(const std::shared_ptr<ForNode>& node)
+            {
+                _scopes.emplace_back();
+                GenerateStatement(node->init);
+
+                const auto headerLabel = NewId();
+                const auto conditionLabel = NewId();
+                const auto bodyLabel = NewId();
+                const auto continueLabel = NewId();
+                const auto mergeLabel = NewId();
+
+                Terminate(Op::Branch, {headerLabel});
+
+                BeginBlock(headerLabel);
+                Emit(_body, Op::LoopMerge, {mergeLabel, continueLabel, 0});
+                Terminate(Op::Branch, {conditionLabel});
+
+                BeginBlock(conditionLabel);
+                if (node->condition->nodeType == NodeType::NoOp)
+                {
+                    Terminate(Op::Branch, {bodyLabel});
+                }
+                else
+                {
+                    auto condition = Convert(GenerateExpression(node->condition), BoolType());
+                    Terminate(Op::BranchConditional, {condition.id, bodyLabel, mergeLabel});
+                }
+
+                BeginBlock(bodyLabel);
+                GenerateScope(node->scope);
+                if (!_terminated) Terminate(Op::Branch, {continueLabel});
+
+                BeginBlock(continueLabel);
+                if (node->update->nodeType != NodeType::NoOp) GenerateExpression(node->update);
+                Terminate(Op::Branch, {headerLabel});
+
+                BeginBlock(mergeLabel);
+                _scopes.pop_back();
+            }
+
+            void GenerateReturn(const std::shared_ptr<ReturnNode>& node)
+            {
+                if (!node->expression || node->expression->nodeType == NodeType::NoOp)
+                {
+                    if (_returnType->kind != ETypeKind::Void) throw std::runtime_error("Missing return value");
+                    Terminate(Op::Return);
+                    return;
+                }
+
+                if (_returnType->kind == ETypeKind::Void)
+                {
+                    throw std::runtime_error("Cannot return a value from a void function");
+                }
+
+                auto value = Convert(GenerateExpression(node->expression, _returnType), _returnType);
+                Terminate(Op::ReturnValue, {value.id});
+            }
+
+            void GenerateStatement(const std::shared_ptr<Node>& node)
+            {
+                // Statements after a return or discard can never run
+                if (_terminated) return;
+
+                switch (node->nodeType)
+                {
+                case NodeType::NoOp:
+                    break;
+                case NodeType::Scope:
+                    GenerateScope(std::dynamic_pointer_cast<ScopeNode>(node));
+                    break;
+                case NodeType::If:
+                    GenerateIf(std::dynamic_pointer_cast<IfNode>(node));
+                    break;
+                case NodeType::For:
+                    GenerateFor(std::dynamic_pointer_cast<ForNode>(node));
+                    break;
+                case NodeType::Return:
+                    GenerateReturn(std::dynamic_pointer_cast<ReturnNode>(node));
+                    break;
+                case NodeType::Discard:
+                    RequireFragment("discard");
+                    Terminate(Op::Kill);
+                    break;
+                case NodeType::Declaration:
+                case NodeType::Const:
+                    DeclareLocal(AsDeclaration(node));
+                    break;
+                default:
+                    GenerateExpression(node);
+                    break;
+                }
+            }
+
+            // Functions
+
+            void Enqueue(Function& function)
+            {
+                if (function.queued) return;
+                function.queued = true;
+                _functionQueue.push_back(&function);
+            }
+
+            void DeclareFunction(const std::shared_ptr<FunctionNode>& node)
+            {
+                Function function{node, NewId()};
+                function.returnType = TypeOf(node->returnDeclaration, ELayoutRule::None);
+                for (auto& argument : node->arguments)
+                {
+                    function.parameterTypes.push_back(TypeOf(argument->declaration, ELayoutRule::None));
+                }
+
+                auto& overloads = _userFunctions[node->name];
+                for (auto& existing : overloads)
+                {
+                    if (existing.parameterTypes == function.parameterTypes)
+                    {
+                        throw std::runtime_error("Function " + node->name + " is defined more than once");
+                    }
+                }
+                overloads.push_back(std::move(function));
+            }
+
+            void GenerateFunction(const Function& function)
+            {
+                const auto& node = function.node;
+                const auto isMain = node->name == "main";
+
+                if (isMain && (!function.parameterTypes.empty() || function.returnType->kind != ETypeKind::Void))
+                {
+                    throw std::runtime_error("main must take no arguments and return void");
+                }
+
+                Emit(_functions, Op::Function, {
+                         function.returnType->id, function.id, 0,
+                         FunctionType(function.returnType, function.parameterTypes)
+                     });
+                EmitName(function.id, node->name);
+
+                _scopes.emplace_back();
+                for (size_t i = 0; i < node->arguments.size(); i++)
+                {
+                    auto id = NewId();
+                    Emit(_functions, Op::FunctionParameter, {
+                             PointerType(StorageClass::Function, function.parameterTypes[i]), id
+                         });
+                    EmitName(id, node->arguments[i]->declaration->declarationName);
+                    _scopes.back().emplace(node->arguments[i]->declaration->declarationName,
+                                           Variable{id, function.parameterTypes[i], StorageClass::Function});
+                }
+
+                _variables.clear();
+                _body.clear();
+                _returnType = function.returnType;
+                _terminated = false;
+                _currentLabel = NewId();
+                Emit(_functions, Op::Label, {_currentLabel});
+
+                if (isMain)
+                {
+                    for (auto& [pointer, initializer] : _globalInitializers)
+                    {
+                        Store(pointer, GenerateExpression(initializer, pointer.type));
+                    }
+                }
+
+                GenerateScope(node->scope);
+
+                if (!_terminated)
+                {
+                    // Falling off the end of a function that returns a value can not happen in valid code
+                    Terminate(function.returnType->kind == ETypeKind::Void ? Op::Return : Op::Unreachable);
+                }
+
+                _scopes.pop_back();
+                _functions.insert(_functions.end(), _variables.begin(), _variables.end());
+                _functions.insert(_functions.end(), _body.begin(), _body.end());
+                Emit(_functions, Op::FunctionEnd, {});
+            }
+
+        public:
+            std::vector<uint32_t> Generate(const std::shared_ptr<ModuleNode>& module)
+            {
+                EnableCapability(CAPABILITY_SHADER);
+                _scopes.emplace_back();
+
+                for (auto& statement : module->statements)
+                {
+                    switch (statement->nodeType)
+                    {
+                    case NodeType::Struct:
+                        {
+                            auto asStruct = std::dynamic_pointer_cast<StructNode>(statement);
+                            _structs.insert_or_assign(asStruct->name, asStruct);
+                        }
+                        break;
+                    case NodeType::Define:
+                        {
+                            auto asDefine = std::dynamic_pointer_cast<DefineNode>(statement);
+                            _defines.insert_or_assign(asDefine->id, asDefine->expression);
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                }
+
+                for (auto& statement : module->statements)
+                {
+                    switch (statement->nodeType)
+                    {
+                    case NodeType::Layout:
+                        GenerateLayout(std::dynamic_pointer_cast<LayoutNode>(statement));
+                        break;
+                    case NodeType::PushConstant:
+                        GeneratePushConstant(std::dynamic_pointer_cast<PushConstantNode>(statement));
+                        break;
+                    case NodeType::Function:
+                        DeclareFunction(std::dynamic_pointer_cast<FunctionNode>(statement));
+                        break;
+                    case NodeType::Declaration:
+                    case NodeType::Const:
+                        GenerateGlobal(AsDeclaration(statement), {});
+                        break;
+                    case NodeType::Assign:
+                        {
+                            auto asAssign = std::dynamic_pointer_cast<AssignNode>(statement);
+                            auto declaration = AsDeclaration(asAssign->target);
+                            if (!declaration) throw std::runtime_error("Only declarations can be assigned globally");
+                            GenerateGlobal(declaration, asAssign->value);
+                        }
+                        break;
+                    case NodeType::Struct:
+                    case NodeType::Define:
+                    case NodeType::Include:
+                    case NodeType::NoOp:
+                        break;
+                    default:
+                        throw std::runtime_error("Statement cannot be lowered to SPIR-V");
+                    }
+                }
+
+                auto main = _userFunctions.find("main");
+                if (main == _userFunctions.end()) throw std::runtime_error("Scope has no main function");
+                auto& entry = main->second.front();
+
+                // Only functions reachable from main are generated
+                Enqueue(entry);
+                for (size_t i = 0; i < _functionQueue.size(); i++)
+                {
+                    GenerateFunction(*_functionQueue[i]);
+                }
+
+                std::vector<uint32_t> entryPoint{
+                    _scopeType == EScopeType::Vertex ? EXECUTION_MODEL_VERTEX : EXECUTION_MODEL_FRAGMENT, entry.id
+                };
+                AppendString(entryPoint, "main");
+                entryPoint.insert(entryPoint.end(), _interface.begin(), _interface.end());
+
+                std::vector<uint32_t> header{};
+                Emit(header, Op::MemoryModel, {ADDRESSING_LOGICAL, MEMORY_MODEL_GLSL450});
+                Emit(header, Op::EntryPoint, entryPoint);
+                if (_scopeType == EScopeType::Fragment)
+                {
+                    Emit(header, Op::ExecutionMode, {entry.id, EXECUTION_MODE_ORIGIN_UPPER_LEFT});
+                    if (_writesDepth) Emit(header, Op::ExecutionMode, {entry.id, EXECUTION_MODE_DEPTH_REPLACING});
+                }
+
+                std::vector<uint32_t> words{MAGIC, VERSION_1_0, 0, _nextId, 0};
+                for (auto section : {&_capabilities, &_imports, &header, &_debug, &_annotations, &_globals, &_functions})
+                {
+                    words.insert(words.end(), section->begin(), section->end());
+                }
+                return words;
+            }
+        };
+    }
+
+    std::vector<uint32_t> generate(const std::shared_ptr<ModuleNode>& module, EScopeType scopeType)
+    {
+        return Generator(scopeType).Generate(module);
+    }
+}
@@ -0,0 +1,661 @@
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "rsl/spirv.hpp"
+
+namespace rsl::spirv
+{
+    namespace
+    {
+        // Operand layout of an instruction after its result type and result id.
+        //   i  id that must already be defined (inside a function it only has to be defined by the function's end)
+        //   f  id that may be defined later in the module
+        //   l  literal word
+        //   s  literal string
+        //   ?  the operands that follow are optional
+        //   *  the previous operand repeats until the end of the instruction
+        struct OpInfo
+        {
+            bool hasType;
+            bool hasResult;
+            std::string_view operands;
+        };
+
+        const std::unordered_map<Op, OpInfo> OP_INFO = {
+            {Op::Nop, {false, false, ""}},
+            {Op::Undef, {true, true, ""}},
+            {Op::Source, {false, false, "l*"}},
+            {Op::Name, {false, false, "fs"}},
+            {Op::MemberName, {false, false, "fls"}},
+            {Op::ExtInstImport, {false, true, "s"}},
+            {Op::ExtInst, {true, true, "ili*"}},
+            {Op::MemoryModel, {false, false, "ll"}},
+            {Op::EntryPoint, {false, false, "lfs?f*"}},
+            {Op::ExecutionMode, {false, false, "fl*"}},
+            {Op::Capability, {false, false, "l"}},
+            {Op::TypeVoid, {false, true, ""}},
+            {Op::TypeBool, {false, true, ""}},
+            {Op::TypeInt, {false, true, "ll"}},
+            {Op::TypeFloat, {false, true, "l"}},
+            {Op::TypeVector, {false, true, "il"}},
+            {Op::TypeMatrix, {false, true, "il"}},
+            {Op::TypeImage, {false, true, "illllll?l"}},
+            {Op::TypeSampler, {false, true, ""}},
+            {Op::TypeSampledImage, {false, true, "i"}},
+            {Op::TypeArray, {false, true, "ii"}},
+            {Op::TypeRuntimeArray, {false, true, "i"}},
+            {Op::TypeStruct, {false, true, "?i*"}},
+            {Op::TypePointer, {false, true, "li"}},
+            {Op::TypeFunction, {false, true, "i?i*"}},
+            {Op::ConstantTrue, {true, true, ""}},
+            {Op::ConstantFalse, {true, true, ""}},
+            {Op::Constant, {true, true, "l*"}},
+            {Op::ConstantComposite, {true, true, "?i*"}},
+            {Op::Function, {true, true, "li"}},
+            {Op::FunctionParameter, {true, true, ""}},
+            {Op::FunctionEnd, {false, false, ""}},
+            {Op::FunctionCall, {true, true, "f?i*"}},
+            {Op::Variable, {true, true, "l?i"}},
+            {Op::Load, {true, true, "i?l*"}},
+            {Op::Store, {false, false, "ii?l*"}},
+            {Op::AccessChain, {true, true, "i?i*"}},
+            {Op::Decorate, {false, false, "fl?l*"}},
+            {Op::MemberDecorate, {false, false, "fll?l*"}},
+            {Op::VectorShuffle, {true, true, "ii?l*"}},
+            {Op::CompositeConstruct, {true, true, "?i*"}},
+            {Op::CompositeExtract, {true, true, "i?l*"}},
+            {Op::CompositeInsert, {true, true, "ii?l*"}},
+            {Op::Transpose, {true, true, "i"}},
+            {Op::SampledImage, {true, true, "ii"}},
+            {Op::ImageSampleImplicitLod, {true, true, "ii?li*"}},
+            {Op::ImageSampleExplicitLod, {true, true, "iili*"}},
+            {Op::Image, {true, true, "i"}},
+            {Op::ImageQuerySizeLod, {true, true, "ii"}},
+            {Op::ConvertFToS, {true, true, "i"}},
+            {Op::ConvertSToF, {true, true, "i"}},
+            {Op::SNegate, {true, true, "i"}},
+            {Op::FNegate, {true, true, "i"}},
+            {Op::IAdd, {true, true, "ii"}},
+            {Op::FAdd, {true, true, "ii"}},
+            {Op::ISub, {true, true, "ii"}},
+            {Op::FSub, {true, true, "ii"}},
+            {Op::IMul, {true, true, "ii"}},
+            {Op::FMul, {true, true, "ii"}},
+            {Op::SDiv, {true, true, "ii"}},
+            {Op::FDiv, {true, true, "ii"}},
+            {Op::SMod, {true, true, "ii"}},
+            {Op::FMod, {true, true, "ii"}},
+            {Op::VectorTimesScalar, {true, true, "ii"}},
+            {Op::MatrixTimesScalar, {true, true, "ii"}},
+            {Op::VectorTimesMatrix, {true, true, "ii"}},
+            {Op::MatrixTimesVector, {true, true, "ii"}},
+            {Op::MatrixTimesMatrix, {true, true, "ii"}},
+            {Op::Dot, {true, true, "ii"}},
+            {Op::Any, {true, true, "i"}},
+            {Op::All, {true, true, "i"}},
+            {Op::LogicalEqual, {true, true, "ii"}},
+            {Op::LogicalNotEqual, {true, true, "ii"}},
+            {Op::LogicalOr, {true, true, "ii"}},
+            {Op::LogicalAnd, {true, true, "ii"}},
+            {Op::LogicalNot, {true, true, "i"}},
+            {Op::Select, {true, true, "iii"}},
+            {Op::IEqual, {true, true, "ii"}},
+            {Op::INotEqual, {true, true, "ii"}},
+            {Op::SGreaterThan, {true, true, "ii"}},
+            {Op::SGreaterThanEqual, {true, true, "ii"}},
+            {Op::SLessThan, {true, true, "ii"}},
+            {Op::SLessThanEqual, {true, true, "ii"}},
+            {Op::FOrdEqual, {true, true, "ii"}},
+            {Op::FOrdNotEqual, {true, true, "ii"}},
+            {Op::FOrdLessThan, {true, true, "ii"}},
+            {Op::FOrdGreaterThan, {true, true, "ii"}},
+            {Op::FOrdLessThanEqual, {true, true, "ii"}},
+            {Op::FOrdGreaterThanEqual, {true, true, "ii"}},
+            {Op::DPdx, {true, true, "i"}},
+            {Op::DPdy, {true, true, "i"}},
+            {Op::Fwidth, {true, true, "i"}},
+            {Op::Phi, {true, true, "ff*"}},
+            {Op::LoopMerge, {false, false, "ffl?l*"}},
+            {Op::SelectionMerge, {false, false, "fl"}},
+            {Op::Label, {false, true, ""}},
+            {Op::Branch, {false, false, "f"}},
+            {Op::BranchConditional, {false, false, "iff?l*"}},
+            {Op::Kill, {false, false, ""}},
+            {Op::Return, {false, false, ""}},
+            {Op::ReturnValue, {false, false, "i"}},
+            {Op::Unreachable, {false, false, ""}},
+        };
+
+        // Logical sections of a module, which must appear in this order
+        enum class ESection
+        {
+            Capability,
+            ExtInstImport,
+            MemoryModel,
+            EntryPoint,
+            ExecutionMode,
+            Debug,
+            Annotation,
+            Global,
+            Function
+        };
+
+        ESection sectionOf(Op op)
+        {
+            switch (op)
+            {
+            case Op::Capability:
+                return ESection::Capability;
+            case Op::ExtInstImport:
+                return ESection::ExtInstImport;
+            case Op::MemoryModel:
+                return ESection::MemoryModel;
+            case Op::EntryPoint:
+                return ESection::EntryPoint;
+            case Op::ExecutionMode:
+                return ESection::ExecutionMode;
+            case Op::Source:
+            case Op::Name:
+            case Op::MemberName:
+                return ESection::Debug;
+            case Op::Decorate:
+            case Op::MemberDecorate:
+                return ESection::Annotation;
+            case Op::TypeVoid:
+            case Op::TypeBool:
+            case Op::TypeInt:
+            case Op::TypeFloat:
+            case Op::TypeVector:
+            case Op::TypeMatrix:
+            case Op::TypeImage:
+            case Op::TypeSampler:
+            case Op::TypeSampledImage:
+            case Op::TypeArray:
+            case Op::TypeRuntimeArray:
+            case Op::TypeStruct:
+            case Op::TypePointer:
+            case Op::TypeFunction:
+            case Op::ConstantTrue:
+            case Op::ConstantFalse:
+            case Op::Constant:
+            case Op::ConstantComposite:
+            case Op::Undef:
+            case Op::Variable:
+                return ESection::Global;
+            default:
+                return ESection::Function;
+            }
+        }
+
+        bool isType(Op op)
+        {
+            return op >= Op::TypeVoid && op <= Op::TypeFunction;
+        }
+
+        bool isTerminator(Op op)
+        {
+            switch (op)
+            {
+            case Op::Branch:
+            case Op::BranchConditional:
+            case Op::Kill:
+            case Op::Return:
+            case Op::ReturnValue:
+            case Op::Unreachable:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        struct Definition
+        {
+            Op op;
+            // Result type, or 0 for instructions without one
+            uint32_t type = 0;
+            // Offset of the instruction's first word
+            size_t offset = 0;
+        };
+
+        class Validator
+        {
+            const std::vector<uint32_t>& _words;
+            uint32_t _bound = 0;
+            std::unordered_map<uint32_t, Definition> _definitions{};
+            // Ids referenced before their definition, with the offset of the instruction that needs them
+            std::unordered_map<uint32_t, size_t> _forwardReferences{};
+            std::unordered_map<uint32_t, size_t> _functionForwardReferences{};
+            std::unordered_set<uint32_t> _labelTargets{};
+            std::unordered_set<uint32_t> _entryPointFunctions{};
+            std::unordered_set<uint32_t> _interfaces{};
+
+            // Function state
+            bool _inFunction = false;
+            bool _inBlock = false;
+            bool _seenFirstBlock = false;
+            bool _pastVariables = false;
+            uint32_t _returnType = 0;
+            size_t _parametersLeft = 0;
+            std::optional<Op> _pendingMerge{};
+
+        public:
+            explicit Validator(const std::vector<uint32_t>& words) : _words(words)
+            {
+            }
+
+            [[noreturn]] static void Fail(size_t offset, const std::string& message)
+            {
+                throw std::runtime_error("Invalid SPIR-V at word " + std::to_string(offset) + ": " + message);
+            }
+
+            uint32_t Word(size_t offset) const
+            {
+                return _words[offset];
+            }
+
+            const Definition& Require(uint32_t id, size_t offset) const
+            {
+                auto found = _definitions.find(id);
+                if (found == _definitions.end()) Fail(offset, "id " + std::to_string(id) + " is not defined");
+                return found->second;
+            }
+
+            const Definition& RequireType(uint32_t id, size_t offset) const
+            {
+                auto& definition = Require(id, offset);
+                if (!isType(definition.op)) Fail(offset, "id " + std::to_string(id) + " is not a type");
+                return definition;
+            }
+
+            // Pointee type and storage class of a pointer type
+            std::pair<uint32_t, uint32_t> PointerInfo(uint32_t typeId, size_t offset) const
+            {
+                auto& definition = RequireType(typeId, offset);
+                if (definition.op != Op::TypePointer) Fail(offset, "id " + std::to_string(typeId) + " is not a pointer");
+                return {Word(definition.offset + 3), Word(definition.offset + 2)};
+            }
+
+            uint32_t TypeOfValue(uint32_t id, size_t offset) const
+            {
+                auto& definition = Require(id, offset);
+                if (definition.type == 0) Fail(offset, "id " + std::to_string(id) + " is not a value");
+                return definition.type;
+            }
+
+            void Use(uint32_t id, size_t offset, bool forward)
+            {
+                if (id == 0 || id >= _bound) Fail(offset, "id " + std::to_string(id) + " is out of bounds");
+                if (_definitions.contains(id)) return;
+
+                if (forward)
+                {
+                    _forwardReferences.try_emplace(id, offset);
+                }
+                else if (_inFunction)
+                {
+                    _functionForwardReferences.try_emplace(id, offset);
+                }
+                else
+                {
+                    Fail(offset, "id " + std::to_string(id) + " is used before it is defined");
+                }
+            }
+
+            // Walks the operands after the result against the layout in info and returns where they start
+            void CheckOperands(const OpInfo& info, size_t offset, size_t wordCount, size_t first)
+            {
+                auto position = first;
+                auto optional = false;
+                char last = 0;
+                size_t pattern = 0;
+
+                while (position < offset + wordCount)
+                {
+                    char code;
+                    if (pattern < info.operands.size() && info.operands[pattern] == '?')
+                    {
+                        optional = true;
+                        pattern++;
+                    }
+                    if (pattern < info.operands.size() && info.operands[pattern] != '*')
+                    {
+                        code = info.operands[pattern++];
+                        last = code;
+                    }
+                    else if (pattern < info.operands.size() && info.operands[pattern] == '*')
+                    {
+                        code = last;
+                    }
+                    else
+                    {
+                        Fail(offset, "too many operands");
+                    }
+
+                    switch (code)
+                    {
+                    case 'i':
+                        Use(Word(position), offset, false);
+                        position++;
+                        break;
+                    case 'f':
+                        Use(Word(position), offset, true);
+                        position++;
+                        break;
+                    case 's':
+                        {
+                            // Strings end with a word whose last byte is zero
+                            while (position < offset + wordCount && (Word(position) >> 24) != 0) position++;
+                            if (position == offset + wordCount) Fail(offset, "string is not terminated");
+                            position++;
+                        }
+                        break;
+                    default:
+                        position++;
+                        break;
+                    }
+                }
+
+                // Skip a trailing repeat marker and check everything left was optional
+                while (pattern < info.operands.size())
+                {
+                    auto code = info.operands[pattern++];
+                    if (code == '?') optional = true;
+                    else if (code != '*' && !optional) Fail(offset, "missing operands");
+                }
+            }
+
+            void CheckFunctionLayout(Op op, size_t offset)
+            {
+                if (op == Op::Function)
+                {
+                    if (_inFunction) Fail(offset, "functions cannot be nested");
+                    _inFunction = true;
+                    _seenFirstBlock = false;
+                    _inBlock = false;
+                    _pastVariables = false;
+                    return;
+                }
+
+                if (!_inFunction) Fail(offset, "instruction must be inside a function");
+
+                if (op == Op::FunctionParameter)
+                {
+                    if (_parametersLeft == 0 || _seenFirstBlock) Fail(offset, "unexpected function parameter");
+                    _parametersLeft--;
+                    return;
+                }
+
+                if (op == Op::FunctionEnd)
+                {
+                    if (_inBlock) Fail(offset, "block is not terminated");
+                    if (!_seenFirstBlock) Fail(offset, "function has no blocks");
+                    if (!_functionForwardReferences.empty())
+                    {
+                        auto [id, use] = *_functionForwardReferences.begin();
+                        Fail(use, "id " + std::to_string(id) + " is never defined in its function");
+                    }
+                    _inFunction = false;
+                    return;
+                }
+
+                if (op == Op::Label)
+                {
+                    if (_parametersLeft != 0) Fail(offset, "function is missing parameters");
+                    if (_inBlock) Fail(offset, "block is not terminated");
+                    if (_seenFirstBlock) _pastVariables = true;
+                    _seenFirstBlock = true;
+                    _inBlock = true;
+                    return;
+                }
+
+                if (!_inBlock) Fail(offset, "instruction must be inside a block");
+
+                if (op == Op::Variable)
+                {
+                    if (_pastVariables) Fail(offset, "variables must be at the start of the first block");
+                }
+                else
+                {
+                    _pastVariables = true;
+                }
+
+                if (_pendingMerge && !(op == Op::Branch && _pendingMerge == Op::LoopMerge) &&
+                    op != Op::BranchConditional)
+                {
+                    Fail(offset, "merge instruction must be followed by a branch");
+                }
+                _pendingMerge.reset();
+
+                if (op == Op::SelectionMerge || op == Op::LoopMerge) _pendingMerge = op;
+
+                if (isTerminator(op)) _inBlock = false;
+            }
+
+            void CheckSemantics(Op op, size_t offset, size_t wordCount, uint32_t resultType)
+            {
+                switch (op)
+                {
+                case Op::Function:
+                    {
+                        auto& functionType = RequireType(Word(offset + 4), offset);
+                        if (functionType.op != Op::TypeFunction) Fail(offset, "function type is not OpTypeFunction");
+                        if (Word(functionType.offset + 2) != resultType)
+                        {
+                            Fail(offset, "function result type does not match its function type");
+                        }
+                        _returnType = resultType;
+                        const auto typeWords = Word(functionType.offset) >> 16;
+                        _parametersLeft = typeWords - 3;
+                    }
+                    break;
+                case Op::Variable:
+                    {
+                        auto [pointee, storage] = PointerInfo(resultType, offset);
+                        if (storage != Word(offset + 3)) Fail(offset, "variable storage class does not match its type");
+                        const auto isFunctionStorage = storage == static_cast<uint32_t>(StorageClass::Function);
+                        if (_inFunction != isFunctionStorage)
+                        {
+                            Fail(offset, "Function storage variables must be declared in functions and only there");
+                        }
+                        if (wordCount > 4 && TypeOfValue(Word(offset + 4), offset) != pointee)
+                        {
+                            Fail(offset, "variable initializer has the wrong type");
+                        }
+                    }
+                    break;
+                case Op::Load:
+                    {
+                        auto pointer = TypeOfValue(Word(offset + 3), offset);
+                        if (PointerInfo(pointer, offset).first != resultType)
+                        {
+                            Fail(offset, "load result type does not match the pointer");
+                        }
+                    }
+                    break;
+                case Op::Store:
+                    {
+                        auto pointer = TypeOfValue(Word(offset + 1), offset);
+                        if (PointerInfo(pointer, offset).first != TypeOfValue(Word(offset + 2), offset))
+                        {
+                            Fail(offset, "stored value type does not match the pointer");
+                        }
+                    }
+                    break;
+                case Op::AccessChain:
+                    {
+                        auto base = PointerInfo(TypeOfValue(Word(offset + 3), offset), offset);
+                        if (PointerInfo(resultType, offset).second != base.second)
+                        {
+                            Fail(offset, "access chain changes storage class");
+                        }
+                    }
+                    break;
+                case Op::Return:
+                    if (Require(_returnType, offset).op != Op::TypeVoid) Fail(offset, "missing return value");
+                    break;
+                case Op::ReturnValue:
+                    if (TypeOfValue(Word(offset + 1), offset) != _returnType)
+                    {
+                        Fail(offset, "return value does not match the function's result type");
+                    }
+                    break;
+                case Op::Branch:
+                    _labelTargets.insert(Word(offset + 1));
+                    break;
+                case Op::BranchConditional:
+                    _labelTargets.insert(Word(offset + 2));
+                    _labelTargets.insert(Word(offset + 3));
+                    break;
+                case Op::SelectionMerge:
+                    _labelTargets.insert(Word(offset + 1));
+                    break;
+                case Op::LoopMerge:
+                    _labelTargets.insert(Word(offset + 1));
+                    _labelTargets.insert(Word(offset + 2));
+                    break;
+                case Op::Phi:
+                    if ((wordCount - 3) % 2 != 0) Fail(offset, "phi operands must come in pairs");
+                    for (size_t i = offset + 4; i < offset + wordCount; i += 2)
+                    {
+                        _labelTargets.insert(Word(i));
+                    }
+                    break;
+                case Op::EntryPoint:
+                    {
+                        _entryPointFunctions.insert(Word(offset + 2));
+                        auto position = offset + 3;
+                        while ((Word(position) >> 24) != 0) position++;
+                        for (position++; position < offset + wordCount; position++)
+                        {
+                            _interfaces.insert(Word(position));
+                        }
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            void Run()
+            {
+                if (_words.size() < 5) Fail(0, "module is smaller than its header");
+                if (_words[0] != MAGIC) Fail(0, "bad magic number");
+                if ((_words[1] & 0xff0000ff) != 0 || _words[1] > 0x00010600) Fail(1, "unsupported version");
+                if (_words[4] != 0) Fail(4, "schema must be zero");
+                _bound = _words[3];
+
+                auto section = ESection::Capability;
+                size_t capabilities = 0;
+                size_t memoryModels = 0;
+                size_t entryPoints = 0;
+
+                size_t offset = 5;
+                while (offset < _words.size())
+                {
+                    const auto wordCount = static_cast<size_t>(_words[offset] >> 16);
+                    const auto op = static_cast<Op>(_words[offset] & 0xffff);
+                    if (wordCount == 0 || offset + wordCount > _words.size()) Fail(offset, "bad word count");
+
+                    auto info = OP_INFO.find(op);
+                    if (info == OP_INFO.end())
+                    {
+                        Fail(offset, "opcode " + std::to_string(_words[offset] & 0xffff) + " is not supported");
+                    }
+
+                    // Variables are globals outside of functions and locals inside them
+                    auto opSection = sectionOf(op);
+                    if (op == Op::Variable && section == ESection::Function) opSection = ESection::Function;
+                    if (op != Op::Nop)
+                    {
+                        if (opSection < section) Fail(offset, "instruction is out of section order");
+                        section = opSection;
+                    }
+
+                    capabilities += op == Op::Capability;
+                    memoryModels += op == Op::MemoryModel;
+                    entryPoints += op == Op::EntryPoint;
+
+                    if (section == ESection::Function) CheckFunctionLayout(op, offset);
+
+                    auto position = offset + 1;
+                    uint32_t resultType = 0;
+                    if (info->second.hasType)
+                    {
+                        if (position >= offset + wordCount) Fail(offset, "missing result type");
+                        resultType = _words[position++];
+                        RequireType(resultType, offset);
+                    }
+
+                    std::optional<uint32_t> result{};
+                    if (info->second.hasResult)
+                    {
+                        if (position >= offset + wordCount) Fail(offset, "missing result id");
+                        result = _words[position++];
+                        if (*result == 0 || *result >= _bound) Fail(offset, "result id is out of bounds");
+                        if (_definitions.contains(*result)) Fail(offset, "result id is defined twice");
+                    }
+
+                    CheckOperands(info->second, offset, wordCount, position);
+
+                    if (result)
+                    {
+                        _definitions.emplace(*result, Definition{op, resultType, offset});
+                        _forwardReferences.erase(*result);
+                        _functionForwardReferences.erase(*result);
+                    }
+
+                    CheckSemantics(op, offset, wordCount, resultType);
+                    offset += wordCount;
+                }
+
+                if (_inFunction) Fail(offset, "function is not ended");
+                if (capabilities == 0) Fail(offset, "module declares no capabilities");
+                if (memoryModels != 1) Fail(offset, "module must have exactly one memory model");
+                if (entryPoints == 0) Fail(offset, "module has no entry point");
+
+                if (!_forwardReferences.empty())
+                {
+                    auto [id, use] = *_forwardReferences.begin();
+                    Fail(use, "id " + std::to_string(id) + " is never defined");
+                }
+
+                for (auto label : _labelTargets)
+                {
+                    if (_definitions.at(label).op != Op::Label)
+                    {
+                        Fail(_definitions.at(label).offset, "branch target " + std::to_string(label) +
+                             " is not a label");
+                    }
+                }
+
+                for (auto function : _entryPointFunctions)
+                {
+                    if (_definitions.at(function).op != Op::Function)
+                    {
+                        Fail(_definitions.at(function).offset, "entry point is not a function");
+                    }
+                }
+
+                for (auto id : _interfaces)
+                {
+                    auto& definition = _definitions.at(id);
+                    auto storage = definition.op == Op::Variable ? Word(definition.offset + 3) : ~0u;
+                    if (storage != static_cast<uint32_t>(StorageClass::Input) &&
+                        storage != static_cast<uint32_t>(StorageClass::Output))
+                    {
+                        Fail(definition.offset, "entry point interface " + std::to_string(id) +
+                             " is not an Input or Output variable");
+                    }
+                }
+            }
+        };
+    }
+
+    void validate(const std::vector<uint32_t>& words)
+    {
+        Validator(words).Run();
+    }
+}
@@ -48,6 +48,8 @@ namespace rsl
     {
         switch (token.type)
         {
+        case TokenType::OpIncrement:
+        case TokenType::OpDecrement:
         case TokenType::OpSubtract:
         case TokenType::OpAdd:
         case TokenType::OpDivide:
@@ -2,6 +2,7 @@
 #include "rsl/tokenizer.hpp"
 #include <filesystem>
 #include <queue>
+#include <stdexcept>
 
 #include "rsl/parser.hpp"
 
@@ -89,35 +90,219 @@ namespace rsl
         return std::stof(data);
     }
 
-    void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node, std::set<std::string>& included)
+    std::shared_ptr<ModuleNode> loadModule(const std::string& filePath)
+    {
+        auto tokens = tokenize(filePath);
+        return parse(tokens);
+    }
+
+    namespace
+    {
+        std::string resolveIncludePath(const std::shared_ptr<IncludeNode>& node)
+        {
+            if (exists(std::filesystem::absolute(node->targetFile)))
+            {
+                return std::filesystem::absolute(node->targetFile).lexically_normal().string();
+            }
+
+            std::filesystem::path sourcePath = std::filesystem::absolute(node->sourceFile);
+            return (sourcePath.parent_path() / node->targetFile).lexically_normal().string();
+        }
+
+        template <typename T>
+        std::vector<std::shared_ptr<T>> cloneAll(const std::vector<std::shared_ptr<T>>& nodes)
+        {
+            std::vector<std::shared_ptr<T>> result{};
+            result.reserve(nodes.size());
+            for (auto& node : nodes)
+            {
+                result.push_back(clone(node));
+            }
+            return result;
+        }
+
+        std::shared_ptr<DeclarationNode> cloneDeclaration(const std::shared_ptr<DeclarationNode>& node)
+        {
+            if (auto asStruct = std::dynamic_pointer_cast<StructDeclarationNode>(node))
+            {
+                auto result = std::make_shared<StructDeclarationNode>(asStruct->structName, asStruct->declarationName,
+                                                                      asStruct->declarationCount);
+                result->structNode = asStruct->structNode;
+                return result;
+            }
+
+            if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(node))
+            {
+                return std::make_shared<BlockDeclarationNode>(asBlock->declarationName, asBlock->declarationCount,
+                                                              cloneAll(asBlock->declarations));
+            }
+
+            if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(node))
+            {
+                return std::make_shared<BufferDeclarationNode>(asBuffer->declarationName, asBuffer->declarationCount,
+                                                               cloneAll(asBuffer->declarations));
+            }
+
+            return std::make_shared<DeclarationNode>(node->declarationType, node->declarationName,
+                                                     node->declarationCount);
+        }
+    }
+
+    std::shared_ptr<Node> cloneNode(const std::shared_ptr<Node>& node)
+    {
+        if (!node) return {};
+
+        switch (node->nodeType)
+        {
+        case NodeType::NoOp:
+            return std::make_shared<NoOpNode>();
+        case NodeType::BinaryOp:
+            {
+                auto casted = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                return std::make_shared<BinaryOpNode>(cloneNode(casted->left), cloneNode(casted->right), casted->op);
+            }
+        case NodeType::Module:
+            return std::make_shared<ModuleNode>(cloneAll(std::dynamic_pointer_cast<ModuleNode>(node)->statements));
+        case NodeType::Function:
+            {
+                auto casted = std::dynamic_pointer_cast<FunctionNode>(node);
+                return std::make_shared<FunctionNode>(clone(casted->returnDeclaration), casted->name,
+                                                      cloneAll(casted->arguments), clone(casted->scope));
+            }
+        case NodeType::FunctionArgument:
+            {
+                auto casted = std::dynamic_pointer_cast<FunctionArgumentNode>(node);
+                return std::make_shared<FunctionArgumentNode>(casted->isInput, clone(casted->declaration));
+            }
+        case NodeType::Return:
+            return std::make_shared<ReturnNode>(cloneNode(std::dynamic_pointer_cast<ReturnNode>(node)->expression));
+        case NodeType::Assign:
+            {
+                auto casted = std::dynamic_pointer_cast<AssignNode>(node);
+                return std::make_shared<AssignNode>(cloneNode(casted->target), cloneNode(casted->value));
+            }
+        case NodeType::Layout:
+            {
+                auto casted = std::dynamic_pointer_cast<LayoutNode>(node);
+                return std::make_shared<LayoutNode>(casted->layoutType, clone(casted->declaration), casted->tags);
+            }
+        case NodeType::Call:
+            {
+                auto casted = std::dynamic_pointer_cast<CallNode>(node);
+                return std::make_shared<CallNode>(clone(casted->identifier), cloneAll(casted->args));
+            }
+        case NodeType::Access:
+            {
+                auto casted = std::dynamic_pointer_cast<AccessNode>(node);
+                return std::make_shared<AccessNode>(cloneNode(casted->left), cloneNode(casted->right));
+            }
+        case NodeType::Index:
+            {
+                auto casted = std::dynamic_pointer_cast<IndexNode>(node);
+                return std::make_shared<IndexNode>(cloneNode(casted->left), cloneNode(casted->indexExpression));
+            }
+        case NodeType::Scope:
+            return std::make_shared<ScopeNode>(cloneAll(std::dynamic_pointer_cast<ScopeNode>(node)->statements));
+        case NodeType::NamedScope:
+            {
+                auto casted = std::dynamic_pointer_cast<NamedScopeNode>(node);
+                return std::make_shared<NamedScopeNode>(casted->scopeType, clone(casted->scope));
+            }
+        case NodeType::Identifier:
+            return std::make_shared<IdentifierNode>(std::dynamic_pointer_cast<IdentifierNode>(node)->id);
+        case NodeType::Struct:
+            {
+                auto casted = std::dynamic_pointer_cast<StructNode>(node);
+                return std::make_shared<StructNode>(casted->name, cloneAll(casted->declarations));
+            }
+        case NodeType::Declaration:
+            return cloneDeclaration(std::dynamic_pointer_cast<DeclarationNode>(node));
+        case NodeType::Include:
+            {
+                auto casted = std::dynamic_pointer_cast<IncludeNode>(node);
+                return std::make_shared<IncludeNode>(casted->sourceFile, casted->targetFile);
+            }
+        case NodeType::FloatLiteral:
+            return std::make_shared<FloatLiteralNode>(std::dynamic_pointer_cast<FloatLiteralNode>(node)->data);
+        case NodeType::IntLiteral:
+            return std::make_shared<IntegerLiteralNode>(std::dynamic_pointer_cast<IntegerLiteralNode>(node)->data);
+        case NodeType::BooleanLiteral:
+            return std::make_shared<BooleanLiteralNode>(std::dynamic_pointer_cast<BooleanLiteralNode>(node)->data);
+        case NodeType::Const:
+            return std::make_shared<ConstNode>(clone(std::dynamic_pointer_cast<ConstNode>(node)->declaration));
+        case NodeType::ArrayLiteral:
+            return std::make_shared<ArrayLiteralNode>(cloneAll(std::dynamic_pointer_cast<ArrayLiteralNode>(node)->nodes));
+        case NodeType::Negate:
+            return std::make_shared<NegateNode>(cloneNode(std::dynamic_pointer_cast<NegateNode>(node)->target));
+        case NodeType::Precedence:
+            return std::make_shared<PrecedenceNode>(cloneNode(std::dynamic_pointer_cast<PrecedenceNode>(node)->target));
+        case NodeType::PushConstant:
+            {
+                auto casted = std::dynamic_pointer_cast<PushConstantNode>(node);
+                return std::make_shared<PushConstantNode>(cloneAll(casted->declarations), casted->tags);
+            }
+        case NodeType::For:
+            {
+                auto casted = std::dynamic_pointer_cast<ForNode>(node);
+                return std::make_shared<ForNode>(cloneNode(casted->init), cloneNode(casted->condition),
+                                                 cloneNode(casted->update), clone(casted->scope));
+            }
+        case NodeType::Increment:
+            {
+                auto casted = std::dynamic_pointer_cast<IncrementNode>(node);
+                return std::make_shared<IncrementNode>(casted->isPrefix, cloneNode(casted->target));
+            }
+        case NodeType::Decrement:
+            {
+                auto casted = std::dynamic_pointer_cast<DecrementNode>(node);
+                return std::make_shared<DecrementNode>(casted->isPrefix, cloneNode(casted->target));
+            }
+        case NodeType::Discard:
+            return std::make_shared<DiscardNode>();
+        case NodeType::If:
+            {
+                auto casted = std::dynamic_pointer_cast<IfNode>(node);
+                return std::make_shared<IfNode>(cloneNode(casted->condition), clone(casted->scope),
+                                                cloneNode(casted->elseNode));
+            }
+        case NodeType::Conditional:
+            {
+                auto casted = std::dynamic_pointer_cast<ConditionalNode>(node);
+                return std::make_shared<ConditionalNode>(cloneNode(casted->condition), cloneNode(casted->left),
+                                                         cloneNode(casted->right));
+            }
+        case NodeType::Define:
+            {
+                auto casted = std::dynamic_pointer_cast<DefineNode>(node);
+                return std::make_shared<DefineNode>(casted->id, cloneNode(casted->expression));
+            }
+        default:
+            throw std::runtime_error("Cannot clone node");
+        }
+    }
+
+    void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node, std::set<std::string>& included,
+                         const ModuleLoader& loader)
     {
         std::vector<std::shared_ptr<Node>> pendingStatements = node->scope->statements;
         std::vector<std::shared_ptr<Node>> statements{};
         statements.reserve(pendingStatements.size());
         for (size_t i = 0; i < pendingStatements.size(); i++)
         {
-            auto statement = pendingStatements[i];
             if (pendingStatements[i]->nodeType == NodeType::Include)
             {
                 if (auto asInclude = std::dynamic_pointer_cast<IncludeNode>(pendingStatements[i]))
                 {
-                    auto filePath = exists(std::filesystem::absolute(asInclude->targetFile))
-                                        ? std::filesystem::absolute(asInclude->targetFile)
-                                        : std::filesystem::relative(asInclude->targetFile, asInclude->sourceFile);
-
-                    auto filePathAsStr = filePath.string();
+                    auto filePathAsStr = resolveIncludePath(asInclude);
 
                     if (included.contains(filePathAsStr)) continue;
 
                     included.emplace(filePathAsStr);
 
-                    auto tokens = tokenize(filePathAsStr);
+                    auto ast = loader(filePathAsStr);
 
-                    auto ast = parse(tokens);
-
-                    pendingStatements.insert(pendingStatements.begin() + i, ast->statements.begin(),
+                    pendingStatements.insert(pendingStatements.begin() + i + 1, ast->statements.begin(),
                                              ast->statements.end());
-                    i--;
                     continue;
                 }
             }
@@ -128,42 +313,39 @@ namespace rsl
         node->scope->statements = statements;
     }
 
+    void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node, std::set<std::string>& included)
+    {
+        resolveIncludes(node, included, loadModule);
+    }
+
     void resolveIncludes(const std::shared_ptr<NamedScopeNode>& node)
     {
         std::set<std::string> includes{};
         resolveIncludes(node, includes);
     }
 
-    void resolveIncludes(const std::shared_ptr<ModuleNode>& node, std::set<std::string>& included)
+    void resolveIncludes(const std::shared_ptr<ModuleNode>& node, std::set<std::string>& included,
+                         const ModuleLoader& loader)
     {
         std::vector<std::shared_ptr<Node>> pendingStatements = node->statements;
         std::vector<std::shared_ptr<Node>> statements{};
         statements.reserve(pendingStatements.size());
         for (size_t i = 0; i < pendingStatements.size(); i++)
         {
-            auto statement = pendingStatements[i];
             if (pendingStatements[i]->nodeType == NodeType::Include)
             {
                 if (auto asInclude = std::dynamic_pointer_cast<IncludeNode>(pendingStatements[i]))
                 {
-                    std::filesystem::path sourcePath = std::filesystem::absolute(asInclude->sourceFile);
-                    auto filePath = exists(std::filesystem::absolute(asInclude->targetFile))
-                                        ? std::filesystem::absolute(asInclude->targetFile)
-                                        : sourcePath.parent_path() / asInclude->targetFile;
-
-                    auto filePathAsStr = filePath.string();
+                    auto filePathAsStr = resolveIncludePath(asInclude);
 
                     if (included.contains(filePathAsStr)) continue;
 
                     included.emplace(filePathAsStr);
 
-                    auto tokens = tokenize(filePathAsStr);
-
-                    auto ast = parse(tokens);
+                    auto ast = loader(filePathAsStr);
 
-                    pendingStatements.insert(pendingStatements.begin() + i, ast->statements.begin(),
+                    pendingStatements.insert(pendingStatements.begin() + i + 1, ast->statements.begin(),
                                              ast->statements.end());
-                    i--;
                     continue;
                 }
             }
@@ -172,7 +354,12 @@ namespace rsl
             {
                 if (auto asNamedScope = std::dynamic_pointer_cast<NamedScopeNode>(pendingStatements[i]))
                 {
-                    resolveIncludes(asNamedScope, included);
+                    // Resolve into a copy so scopes shared with a loaded module are left untouched
+                    auto resolved = std::make_shared<NamedScopeNode>(
+                        asNamedScope->scopeType, std::make_shared<ScopeNode>(asNamedScope->scope->statements));
+                    resolveIncludes(resolved, included, loader);
+                    statements.push_back(resolved);
+                    continue;
                 }
             }
 
@@ -182,6 +369,11 @@ namespace rsl
         node->statements = statements;
     }
 
+    void resolveIncludes(const std::shared_ptr<ModuleNode>& node, std::set<std::string>& included)
+    {
+        resolveIncludes(node, included, loadModule);
+    }
+
     void resolveIncludes(const std::shared_ptr<ModuleNode>& node)
     {
         std::set<std::string> includes{};
@@ -206,6 +398,163 @@ namespace rsl
     }
 
 
+    namespace
+    {
+        template <typename T>
+        void transformSlot(std::shared_ptr<T>& slot, const NodeTransform& transform)
+        {
+            if (!slot) return;
+
+            auto result = transform(slot);
+            if (result == slot) return;
+
+            auto casted = std::dynamic_pointer_cast<T>(result);
+            if (result && !casted) throw std::runtime_error("Transform replaced a node with one of the wrong kind");
+            slot = casted;
+        }
+
+        template <typename T>
+        void transformSlots(std::vector<std::shared_ptr<T>>& slots, const NodeTransform& transform)
+        {
+            for (auto& slot : slots)
+            {
+                transformSlot(slot, transform);
+            }
+        }
+    }
+
+    void transformChildren(const std::shared_ptr<Node>& node, const NodeTransform& transform)
+    {
+        switch (node->nodeType)
+        {
+        case NodeType::BinaryOp:
+            {
+                auto casted = std::dynamic_pointer_cast<BinaryOpNode>(node);
+                transformSlot(casted->left, transform);
+                transformSlot(casted->right, transform);
+            }
+            break;
+        case NodeType::Module:
+            transformSlots(std::dynamic_pointer_cast<ModuleNode>(node)->statements, transform);
+            break;
+        case NodeType::Function:
+            {
+                auto casted = std::dynamic_pointer_cast<FunctionNode>(node);
+                transformSlot(casted->returnDeclaration, transform);
+                transformSlots(casted->arguments, transform);
+                transformSlot(casted->scope, transform);
+            }
+            break;
+        case NodeType::FunctionArgument:
+            transformSlot(std::dynamic_pointer_cast<FunctionArgumentNode>(node)->declaration, transform);
+            break;
+        case NodeType::Return:
+            transformSlot(std::dynamic_pointer_cast<ReturnNode>(node)->expression, transform);
+            break;
+        case NodeType::Assign:
+            {
+                auto casted = std::dynamic_pointer_cast<AssignNode>(node);
+                transformSlot(casted->target, transform);
+                transformSlot(casted->value, transform);
+            }
+            break;
+        case NodeType::Layout:
+            transformSlot(std::dynamic_pointer_cast<LayoutNode>(node)->declaration, transform);
+            break;
+        case NodeType::Call:
+            {
+                auto casted = std::dynamic_pointer_cast<CallNode>(node);
+                transformSlot(casted->identifier, transform);
+                transformSlots(casted->args, transform);
+            }
+            break;
+        case NodeType::Access:
+            {
+                auto casted = std::dynamic_pointer_cast<AccessNode>(node);
+                transformSlot(casted->left, transform);
+                transformSlot(casted->right, transform);
+            }
+            break;
+        case NodeType::Index:
+            {
+                auto casted = std::dynamic_pointer_cast<IndexNode>(node);
+                transformSlot(casted->left, transform);
+                transformSlot(casted->indexExpression, transform);
+            }
+            break;
+        case NodeType::Scope:
+            transformSlots(std::dynamic_pointer_cast<ScopeNode>(node)->statements, transform);
+            break;
+        case NodeType::NamedScope:
+            transformSlot(std::dynamic_pointer_cast<NamedScopeNode>(node)->scope, transform);
+            break;
+        case NodeType::Struct:
+            transformSlots(std::dynamic_pointer_cast<StructNode>(node)->declarations, transform);
+            break;
+        case NodeType::Declaration:
+            if (auto asBlock = std::dynamic_pointer_cast<BlockDeclarationNode>(node))
+            {
+                transformSlots(asBlock->declarations, transform);
+            }
+            else if (auto asBuffer = std::dynamic_pointer_cast<BufferDeclarationNode>(node))
+            {
+                transformSlots(asBuffer->declarations, transform);
+            }
+            break;
+        case NodeType::Const:
+            transformSlot(std::dynamic_pointer_cast<ConstNode>(node)->declaration, transform);
+            break;
+        case NodeType::ArrayLiteral:
+            transformSlots(std::dynamic_pointer_cast<ArrayLiteralNode>(node)->nodes, transform);
+            break;
+        case NodeType::Negate:
+            transformSlot(std::dynamic_pointer_cast<NegateNode>(node)->target, transform);
+            break;
+        case NodeType::Precedence:
+            transformSlot(std::dynamic_pointer_cast<PrecedenceNode>(node)->target, transform);
+            break;
+        case NodeType::PushConstant:
+            transformSlots(std::dynamic_pointer_cast<PushConstantNode>(node)->declarations, transform);
+            break;
+        case NodeType::For:
+            {
+                auto casted = std::dynamic_pointer_cast<ForNode>(node);
+                transformSlot(casted->init, transform);
+                transformSlot(casted->condition, transform);
+                transformSlot(casted->update, transform);
+                transformSlot(casted->scope, transform);
+            }
+            break;
+        case NodeType::Increment:
+            transformSlot(std::dynamic_pointer_cast<IncrementNode>(node)->target, transform);
+            break;
+        case NodeType::Decrement:
+            transformSlot(std::dynamic_pointer_cast<DecrementNode>(node)->target, transform);
+            break;
+        case NodeType::If:
+            {
+                auto casted = std::dynamic_pointer_cast<IfNode>(node);
+                transformSlot(casted->condition, transform);
+                transformSlot(casted->scope, transform);
+                transformSlot(casted->elseNode, transform);
+            }
+            break;
+        case NodeType::Conditional:
+            {
+                auto casted = std::dynamic_pointer_cast<ConditionalNode>(node);
+                transformSlot(casted->condition, transform);
+                transformSlot(casted->left, transform);
+                transformSlot(casted->right, transform);
+            }
+            break;
+        case NodeType::Define:
+            transformSlot(std::dynamic_pointer_cast<DefineNode>(node)->expression, transform);
+            break;
+        default:
+            break;
+        }
+    }
+
     void resolveReferences(const std::shared_ptr<ModuleNode>& node)
     {
         std::map<std::string, std::shared_ptr<StructNode>> structs{};
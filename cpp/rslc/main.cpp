@@ -0,0 +1,558 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "server.hpp"
+#include "rsl/Compiler.hpp"
+#include "rsl/depfile.hpp"
+#include "rsl/reflection.hpp"
+#include "rsl/utils.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct StageOutput
+    {
+        rsl::EScopeType scopeType;
+        std::string extension;
+    };
+
+    const std::vector<StageOutput> STAGE_OUTPUTS = {
+        {rsl::EScopeType::Vertex, ".vert"},
+        {rsl::EScopeType::Fragment, ".frag"},
+    };
+
+    struct Options
+    {
+        std::vector<fs::path> inputs{};
+        std::string serverSocket{};
+        fs::path outDir{};
+        std::unordered_map<std::string, std::string> defines{};
+        size_t numThreads = 0;
+        bool writeDepfiles = true;
+        bool force = false;
+        bool quiet = false;
+        bool parallelGenerate = false;
+        bool minify = false;
+        bool optimize = false;
+        rsl::InlineOptions inlining{};
+        rsl::UnrollOptions unrolling{};
+        bool spirv = false;
+        bool cpp = false;
+        bool host = false;
+        int lanes = 1;
+        bool printLayout = false;
+        bool writeReflection = false;
+        bool reorderMembers = false;
+    };
+
+    struct InputFile
+    {
+        fs::path path{};
+        std::vector<fs::path> outputs{};
+        // Reflection blob of each output with --reflect
+        std::vector<fs::path> reflections{};
+        fs::path depfile{};
+        // Options the outputs were last compiled with, see optionsStamp
+        fs::path stamp{};
+        bool upToDate = false;
+        std::vector<size_t> jobIndices{};
+    };
+
+    void printUsage()
+    {
+        std::cout << "Usage: rslc [options] <file.rsl>...\n"
+            "       rslc --server <socket> [options]\n"
+            "Compiles every input to <stem>.vert and <stem>.frag, or <stem>.vert.spv and <stem>.frag.spv with --spirv.\n"
+            "With --cpp each input is compiled to a single <stem>.hpp instead, and with --host to <stem>.host.hpp.\n\n"
+            "Options:\n"
+            "  -o, --out-dir <dir>   Write outputs to <dir> instead of next to each input\n"
+            "  -D <name>[=<value>]   Define <name> for every input\n"
+            "  -j, --jobs <count>    Number of worker threads (default: hardware concurrency)\n"
+            "  -f, --force           Recompile inputs even if their outputs are up to date\n"
+            "  --no-depfile          Do not write <stem>.d Make/Ninja depfiles\n"
+            "                        The defines and output options of each compile are kept in <stem>.stamp, and\n"
+            "                        inputs are recompiled when they change.\n"
+            "  --parallel-generate   Generate the functions and structs of each stage in parallel\n"
+            "  --minify              Emit compact GLSL with shortened private identifiers\n"
+            "  -O, --optimize        Inline, fold constants, unroll loops, simplify expressions, reuse repeated\n"
+            "                        expressions and drop unused code\n"
+            "  --inline-threshold <n>\n"
+            "                        Largest body, in AST nodes, inlined at every call with -O (default: 32)\n"
+            "  --inline <name>       Always inline <name> with -O\n"
+            "  --no-inline <name>    Never inline <name>\n"
+            "  --unroll-limit <n>    Most iterations of a loop unrolled fully with -O (default: 16)\n"
+            "  --spirv               Emit SPIR-V modules instead of GLSL\n"
+            "  --cpp                 Emit a C++ header with the structs, constants and functions of each input\n"
+            "  --host                Emit a C++ header mirroring the blocks and push constants of each input\n"
+            "  --lanes <1|4|8>       Invocations per call in C++ output (default: 1)\n"
+            "  --layout              Print the memory layout of every uniform block, buffer and push constant\n"
+            "  --reflect             Write the binary reflection of each stage to <output>.refl\n"
+            "  --reorder-members     Reorder struct and block members to minimize std140/std430 padding\n"
+            "  -q, --quiet           Only print errors\n"
+            "  --server <socket>     Serve compile requests on a Unix domain socket, keeping parsed files cached.\n"
+            "                        Output and -D options apply to every request. --layout and --reflect are not\n"
+            "                        supported.\n"
+            "  -h, --help            Show this message\n";
+    }
+
+    Options parseArgs(int argc, char** argv)
+    {
+        Options options{};
+
+        for (auto i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+
+            auto nextArg = [&]
+            {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+                return std::string{argv[++i]};
+            };
+
+            if (arg == "-h" || arg == "--help")
+            {
+                printUsage();
+                std::exit(0);
+            }
+
+            if (arg == "-o" || arg == "--out-dir")
+            {
+                options.outDir = nextArg();
+            }
+            else if (arg.starts_with("-D"))
+            {
+                auto define = arg.size() > 2 ? arg.substr(2) : nextArg();
+                auto separator = define.find('=');
+                options.defines.insert_or_assign(define.substr(0, separator),
+                                                 separator == std::string::npos ? "" : define.substr(separator + 1));
+            }
+            else if (arg == "-j" || arg == "--jobs")
+            {
+                options.numThreads = static_cast<size_t>(rsl::parseInt(nextArg()));
+            }
+            else if (arg == "-f" || arg == "--force")
+            {
+                options.force = true;
+            }
+            else if (arg == "--no-depfile")
+            {
+                options.writeDepfiles = false;
+            }
+            else if (arg == "--parallel-generate")
+            {
+                options.parallelGenerate = true;
+            }
+            else if (arg == "--minify")
+            {
+                options.minify = true;
+            }
+            else if (arg == "--spirv")
+            {
+                options.spirv = true;
+            }
+            else if (arg == "--cpp")
+            {
+                options.cpp = true;
+            }
+            else if (arg == "--host")
+            {
+                options.host = true;
+            }
+            else if (arg == "--lanes")
+            {
+                options.lanes = rsl::parseInt(nextArg());
+            }
+            else if (arg == "--layout")
+            {
+                options.printLayout = true;
+            }
+            else if (arg == "-O" || arg == "--optimize")
+            {
+                options.optimize = true;
+            }
+            else if (arg == "--inline-threshold")
+            {
+                options.inlining.threshold = static_cast<size_t>(rsl::parseInt(nextArg()));
+            }
+            else if (arg == "--inline")
+            {
+                options.inlining.always.insert(nextArg());
+            }
+            else if (arg == "--no-inline")
+            {
+                options.inlining.never.insert(nextArg());
+            }
+            else if (arg == "--unroll-limit")
+            {
+                options.unrolling.maxIterations = static_cast<size_t>(rsl::parseInt(nextArg()));
+            }
+            else if (arg == "--reflect")
+            {
+                options.writeReflection = true;
+            }
+            else if (arg == "--reorder-members")
+            {
+                options.reorderMembers = true;
+            }
+            else if (arg == "--server")
+            {
+                options.serverSocket = nextArg();
+            }
+            else if (arg == "-q" || arg == "--quiet")
+            {
+                options.quiet = true;
+            }
+            else if (arg.starts_with("-"))
+            {
+                throw std::runtime_error("Unknown option " + arg);
+            }
+            else
+            {
+                options.inputs.emplace_back(arg);
+            }
+        }
+
+        if (!options.serverSocket.empty() && (options.printLayout || options.writeReflection))
+        {
+            throw std::runtime_error("--layout and --reflect cannot be used with --server");
+        }
+
+        return options;
+    }
+
+    std::string readFile(const fs::path& path)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) throw std::runtime_error("Failed to open " + path.string());
+        std::stringstream buffer{};
+        buffer << stream.rdbuf();
+        return buffer.str();
+    }
+
+    // Reads the prerequisites back out of a depfile written by writeDepfile
+    std::vector<fs::path> readDepfile(const fs::path& path)
+    {
+        std::ifstream stream(path);
+        if (!stream) return {};
+
+        std::string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        std::vector<fs::path> result{};
+        for (auto& prerequisite : rsl::parseDepfile(content))
+        {
+            result.emplace_back(prerequisite);
+        }
+        return result;
+    }
+
+    void writeDepfile(const InputFile& input, const std::set<std::string>& dependencies)
+    {
+        std::vector<std::string> targets{};
+        for (auto& outputs : {input.outputs, input.reflections})
+        {
+            for (auto& output : outputs)
+            {
+                targets.push_back(output.string());
+            }
+        }
+
+        std::vector<std::string> prerequisites{fs::absolute(input.path).string()};
+        prerequisites.insert(prerequisites.end(), dependencies.begin(), dependencies.end());
+        std::ofstream(input.depfile) << rsl::formatDepfile(targets, prerequisites);
+    }
+
+    // Every define and option that changes the outputs, one per line in a stable order. Outputs compiled with a
+    // different stamp are out of date whatever their times.
+    std::string optionsStamp(const Options& options)
+    {
+        std::ostringstream stamp{};
+        stamp << "target " << (options.cpp ? "cpp" : options.host ? "host" : options.spirv ? "spirv" : "glsl") << "\n";
+        stamp << "lanes " << options.lanes << "\n";
+        stamp << "minify " << options.minify << "\n";
+        stamp << "reorder-members " << options.reorderMembers << "\n";
+        stamp << "optimize " << options.optimize << "\n";
+        if (options.optimize)
+        {
+            stamp << "inline-threshold " << options.inlining.threshold << "\n";
+            for (auto& [key, names] : {std::pair{"inline", &options.inlining.always},
+                                       std::pair{"no-inline", &options.inlining.never}})
+            {
+                for (auto& name : std::set<std::string>(names->begin(), names->end()))
+                {
+                    stamp << key << " " << name << "\n";
+                }
+            }
+            stamp << "unroll-limit " << options.unrolling.maxIterations << "\n";
+        }
+
+        for (auto& [name, value] : std::map<std::string, std::string>(options.defines.begin(), options.defines.end()))
+        {
+            stamp << "define " << name << "=" << value << "\n";
+        }
+        return stamp.str();
+    }
+
+    bool isUpToDate(const InputFile& input, const std::string& stamp)
+    {
+        std::error_code error{};
+        if (!fs::exists(input.stamp, error)) return false;
+        try
+        {
+            if (readFile(input.stamp) != stamp) return false;
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+
+        auto oldestOutput = fs::file_time_type::max();
+        for (auto& outputs : {input.outputs, input.reflections})
+        {
+            for (auto& output : outputs)
+            {
+                auto time = fs::last_write_time(output, error);
+                if (error) return false;
+                oldestOutput = std::min(oldestOutput, time);
+            }
+        }
+
+        auto prerequisites = readDepfile(input.depfile);
+        prerequisites.push_back(input.path);
+
+        for (auto& prerequisite : prerequisites)
+        {
+            auto time = fs::last_write_time(prerequisite, error);
+            if (error || time > oldestOutput) return false;
+        }
+
+        return true;
+    }
+
+    rsl::CompilerOptions toCompilerOptions(const Options& options)
+    {
+        rsl::CompilerOptions compilerOptions{};
+        compilerOptions.parallelGenerate = options.parallelGenerate;
+        compilerOptions.minify = options.minify;
+        compilerOptions.optimize = options.optimize;
+        compilerOptions.inlining = options.inlining;
+        compilerOptions.unrolling = options.unrolling;
+        compilerOptions.target = options.cpp
+                                     ? rsl::ECompileTarget::Cpp
+                                     : options.host
+                                     ? rsl::ECompileTarget::Host
+                                     : options.spirv
+                                     ? rsl::ECompileTarget::Spirv
+                                     : rsl::ECompileTarget::Glsl;
+        compilerOptions.cpuLanes = options.lanes;
+        compilerOptions.reflect = options.printLayout || options.writeReflection;
+        compilerOptions.reorderMembers = options.reorderMembers;
+        return compilerOptions;
+    }
+
+    double toMilliseconds(const std::chrono::microseconds& time)
+    {
+        return static_cast<double>(time.count()) / 1000.0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options{};
+    try
+    {
+        options = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "rslc: " << e.what() << "\n";
+        printUsage();
+        return 2;
+    }
+
+    if (!options.serverSocket.empty())
+    {
+        return runServer(options.serverSocket, options.numThreads, toCompilerOptions(options), options.defines);
+    }
+
+    if (options.inputs.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<InputFile> inputs{};
+    std::vector<rsl::CompileJob> jobs{};
+    const auto stamp = optionsStamp(options);
+
+    for (auto& path : options.inputs)
+    {
+        InputFile input{};
+        input.path = path;
+
+        auto outDir = options.outDir.empty() ? path.parent_path() : options.outDir;
+        auto stem = path.stem().string();
+        if (options.cpp)
+        {
+            input.outputs.push_back(outDir / (stem + ".hpp"));
+        }
+        else if (options.host)
+        {
+            input.outputs.push_back(outDir / (stem + ".host.hpp"));
+        }
+        else
+        {
+            for (auto& stage : STAGE_OUTPUTS)
+            {
+                input.outputs.push_back(outDir / (stem + stage.extension + (options.spirv ? ".spv" : "")));
+                if (options.writeReflection) input.reflections.push_back(input.outputs.back().string() + ".refl");
+            }
+        }
+        input.depfile = outDir / (stem + ".d");
+        input.stamp = outDir / (stem + ".stamp");
+        input.upToDate = !options.force && isUpToDate(input, stamp);
+
+        if (!input.upToDate)
+        {
+            std::string source{};
+            try
+            {
+                source = readFile(path);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << path.string() << ": error: " << e.what() << "\n";
+                return 1;
+            }
+
+            // C++ and host output cover the whole module, so the stage of its single job does not matter
+            for (size_t i = 0; i < input.outputs.size(); i++)
+            {
+                input.jobIndices.push_back(jobs.size());
+                jobs.push_back({path.string(), source, STAGE_OUTPUTS[i].scopeType, options.defines});
+            }
+        }
+
+        inputs.push_back(input);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto compilerOptions = toCompilerOptions(options);
+    // Inputs usually share included helpers, so each one is only generated once per run
+    compilerOptions.cacheGenerated = true;
+    rsl::Compiler compiler{options.numThreads, compilerOptions};
+    auto results = compiler.CompileBatch(jobs);
+    const auto total = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    auto failed = 0;
+    auto compiled = 0;
+    std::cout << std::fixed;
+    std::cout.precision(2);
+
+    for (auto& input : inputs)
+    {
+        if (input.upToDate)
+        {
+            if (!options.quiet) std::cout << "  up to date  " << input.path.string() << "\n";
+            continue;
+        }
+
+        auto success = true;
+        std::set<std::string> dependencies{};
+        std::chrono::microseconds parseTime{};
+        std::chrono::microseconds generateTime{};
+
+        for (auto& jobIndex : input.jobIndices)
+        {
+            auto& result = results[jobIndex];
+            if (!result.success)
+            {
+                std::cerr << input.path.string() << ": error: " << result.error << "\n";
+                success = false;
+                break;
+            }
+
+            dependencies.insert(result.dependencies.begin(), result.dependencies.end());
+            parseTime = result.parseTime;
+            generateTime += result.generateTime;
+        }
+
+        if (!success)
+        {
+            failed++;
+            continue;
+        }
+
+        for (size_t i = 0; i < input.jobIndices.size(); i++)
+        {
+            if (!input.outputs[i].parent_path().empty())
+            {
+                fs::create_directories(input.outputs[i].parent_path());
+            }
+            std::ofstream stream(input.outputs[i], std::ios::binary);
+            stream << results[input.jobIndices[i]].output;
+
+            if (i < input.reflections.size())
+            {
+                std::ofstream reflectionStream(input.reflections[i], std::ios::binary);
+                reflectionStream << rsl::writeReflection(results[input.jobIndices[i]].reflection,
+                                                         STAGE_OUTPUTS[i].scopeType);
+            }
+        }
+
+        std::ofstream(input.stamp, std::ios::binary) << stamp;
+        if (options.writeDepfiles)
+        {
+            writeDepfile(input, dependencies);
+        }
+
+        if (options.reorderMembers && !options.quiet)
+        {
+            std::set<std::string> printed{};
+            for (auto& jobIndex : input.jobIndices)
+            {
+                for (auto& reorder : results[jobIndex].reorderedMembers)
+                {
+                    if (!printed.insert(reorder.name).second) continue;
+                    std::cout << input.path.string() << ": " << reorder.name << " (" <<
+                        rsl::layoutRuleName(reorder.rule) << ") " << reorder.sizeBefore << " -> " << reorder.sizeAfter
+                        << " bytes\n";
+                }
+            }
+        }
+
+        if (options.printLayout)
+        {
+            // Stages usually share their blocks, so each is printed once
+            std::set<std::string> printed{};
+            for (auto& jobIndex : input.jobIndices)
+            {
+                for (auto& resource : results[jobIndex].reflection.resources)
+                {
+                    if (resource.type == rsl::EResourceType::Opaque || !printed.insert(resource.name).second) continue;
+                    std::cout << input.path.string() << ": " << rsl::formatLayout(resource.layout);
+                }
+            }
+        }
+
+        compiled++;
+
+        if (!options.quiet)
+        {
+            std::cout << "  " << toMilliseconds(parseTime + generateTime) << " ms (parse " << toMilliseconds(parseTime) <<
+                " ms, generate " << toMilliseconds(generateTime) << " ms)  " << input.path.string() << "\n";
+        }
+    }
+
+    if (!options.quiet)
+    {
+        std::cout << compiled << " compiled, " << inputs.size() - compiled - failed << " up to date, " << failed <<
+            " failed in " << toMilliseconds(total) << " ms on " << compiler.GetPool().GetThreadCount() <<
+            " threads\n";
+    }
+
+    return failed == 0 ? 0 : 1;
+}
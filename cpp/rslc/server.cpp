@@ -0,0 +1,330 @@
+#include "server.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "rsl/Compiler.hpp"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+int runServer(const std::string& socketPath, size_t numThreads, const rsl::CompilerOptions& options,
+              const std::unordered_map<std::string, std::string>& defines)
+{
+    std::cerr << "rslc: --server is not supported on this platform\n";
+    return 1;
+}
+#else
+namespace
+{
+    class Connection
+    {
+        int _fd;
+        std::string _buffer{};
+        size_t _offset = 0;
+
+        bool Fill()
+        {
+            if (_offset > 0)
+            {
+                _buffer.erase(0, _offset);
+                _offset = 0;
+            }
+
+            char chunk[4096];
+            const auto count = read(_fd, chunk, sizeof(chunk));
+            if (count <= 0) return false;
+            _buffer.append(chunk, static_cast<size_t>(count));
+            return true;
+        }
+
+    public:
+        explicit Connection(int fd) : _fd(fd)
+        {
+        }
+
+        bool ReadLine(std::string& line)
+        {
+            while (true)
+            {
+                if (auto end = _buffer.find('\n', _offset); end != std::string::npos)
+                {
+                    line = _buffer.substr(_offset, end - _offset);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    _offset = end + 1;
+                    return true;
+                }
+
+                if (!Fill()) return false;
+            }
+        }
+
+        bool ReadBytes(size_t count, std::string& data)
+        {
+            while (_buffer.size() - _offset < count)
+            {
+                if (!Fill()) return false;
+            }
+
+            data = _buffer.substr(_offset, count);
+            _offset += count;
+            return true;
+        }
+
+        bool Write(const std::string& data)
+        {
+            size_t written = 0;
+            while (written < data.size())
+            {
+                const auto count = write(_fd, data.data() + written, data.size() - written);
+                if (count <= 0) return false;
+                written += static_cast<size_t>(count);
+            }
+            return true;
+        }
+    };
+
+    // Parses the byte count of a source header, which must be a plain decimal number no larger than MAX_SOURCE_SIZE
+    bool parseSourceSize(const std::string& value, uint64_t& size)
+    {
+        if (value.empty() || value.front() == '-') return false;
+        const auto end = value.data() + value.size();
+        const auto [last, error] = std::from_chars(value.data(), end, size);
+        return error == std::errc{} && last == end && size <= MAX_SOURCE_SIZE;
+    }
+}
+
+void serveConnection(int fd, rsl::Compiler& compiler, const std::unordered_map<std::string, std::string>& defines)
+{
+    Connection connection{fd};
+    std::string line{};
+
+    while (connection.ReadLine(line))
+    {
+        if (line.empty()) continue;
+
+        rsl::CompileJob job{};
+        job.fileName = "<request>";
+        job.defines = defines;
+        uint64_t sourceSize = 0;
+        std::string headerError{};
+        auto validSize = true;
+
+        do
+        {
+            auto separator = line.find(' ');
+            auto key = line.substr(0, separator);
+            auto value = separator == std::string::npos ? "" : line.substr(separator + 1);
+
+            if (key == "stage")
+            {
+                if (value == "vertex") job.scopeType = rsl::EScopeType::Vertex;
+                else if (value == "fragment") job.scopeType = rsl::EScopeType::Fragment;
+                else headerError = "Unknown stage " + value;
+            }
+            else if (key == "path" || key == "file")
+            {
+                job.fileName = value;
+            }
+            else if (key == "source")
+            {
+                if (!parseSourceSize(value, sourceSize))
+                {
+                    validSize = false;
+                    headerError = "Invalid source size " + value + ", expected at most " +
+                        std::to_string(MAX_SOURCE_SIZE) + " bytes";
+                }
+            }
+            else if (key == "define")
+            {
+                auto equals = value.find('=');
+                job.defines.insert_or_assign(value.substr(0, equals),
+                                             equals == std::string::npos ? "" : value.substr(equals + 1));
+            }
+            else
+            {
+                headerError = "Unknown header " + key;
+            }
+        }
+        while (connection.ReadLine(line) && !line.empty());
+
+        if (!validSize)
+        {
+            connection.Write("error " + std::to_string(headerError.size()) + "\n" + headerError);
+            return;
+        }
+
+        if (sourceSize > 0 && !connection.ReadBytes(sourceSize, job.source)) return;
+
+        std::string response{};
+        if (!headerError.empty())
+        {
+            response = "error " + std::to_string(headerError.size()) + "\n" + headerError;
+        }
+        else
+        {
+            auto result = compiler.Compile(job);
+            auto& body = result.success ? result.output : result.error;
+            response = (result.success ? "ok " : "error ") + std::to_string(body.size()) + "\n" + body;
+        }
+
+        if (!connection.Write(response)) return;
+    }
+}
+
+int runServer(const std::string& socketPath, size_t numThreads, const rsl::CompilerOptions& options,
+              const std::unordered_map<std::string, std::string>& defines)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "rslc: socket path is too long\n";
+        return 1;
+    }
+    socketPath.copy(address.sun_path, socketPath.size());
+
+    const auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        std::cerr << "rslc: failed to create socket\n";
+        return 1;
+    }
+
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0)
+    {
+        std::cerr << "rslc: failed to listen on " << socketPath << "\n";
+        close(listener);
+        return 1;
+    }
+
+    // Stop signals are blocked before the compiler and connection threads exist so they all inherit the mask, and only
+    // signalThread receives them. It wakes the accept loop through stopPipe.
+    sigset_t stopSignals{};
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int stopPipe[2];
+    if (pipe(stopPipe) != 0)
+    {
+        std::cerr << "rslc: failed to create stop pipe\n";
+        close(listener);
+        return 1;
+    }
+
+    std::thread signalThread([&stopSignals, &stopPipe]
+    {
+        auto signal = 0;
+        sigwait(&stopSignals, &signal);
+        [[maybe_unused]] const auto written = write(stopPipe[1], "s", 1);
+    });
+
+    auto compilerOptions = options;
+    compilerOptions.cacheGenerated = true;
+    rsl::Compiler compiler{numThreads, compilerOptions};
+    std::cout << "rslc: listening on " << socketPath << std::endl;
+
+    std::mutex clientsMutex{};
+    std::condition_variable clientClosed{};
+    std::set<int> openClients{};
+    auto exitCode = 0;
+
+    pollfd polled[2]{{listener, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+    while (true)
+    {
+        if (poll(polled, 2, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            std::cerr << "rslc: poll failed: " << std::strerror(errno) << "\n";
+            exitCode = 1;
+            break;
+        }
+        if (polled[1].revents != 0) break;
+        if (polled[0].revents == 0) continue;
+
+        const auto client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                // The connection stays pending, so wait for a client to close instead of polling it again at once
+                std::unique_lock lock(clientsMutex);
+                clientClosed.wait_for(lock, std::chrono::milliseconds(100));
+                continue;
+            }
+            std::cerr << "rslc: accept failed: " << std::strerror(errno) << "\n";
+            exitCode = 1;
+            break;
+        }
+
+        {
+            std::lock_guard lock(clientsMutex);
+            openClients.insert(client);
+        }
+
+        std::thread([client, &compiler, &defines, &clientsMutex, &clientClosed, &openClients]
+        {
+            try
+            {
+                serveConnection(client, compiler, defines);
+            }
+            catch (const std::exception& e)
+            {
+                // Nothing may escape a detached thread, so the connection is dropped instead
+                std::cerr << "rslc: closing connection: " << e.what() << std::endl;
+            }
+            std::lock_guard lock(clientsMutex);
+            openClients.erase(client);
+            close(client);
+            clientClosed.notify_all();
+        }).detach();
+    }
+
+    {
+        // Wake clients blocked on read and wait for them to finish before the compiler goes away
+        std::unique_lock lock(clientsMutex);
+        for (auto& client : openClients)
+        {
+            shutdown(client, SHUT_RDWR);
+        }
+        clientClosed.wait(lock, [&openClients]
+        {
+            return openClients.empty();
+        });
+    }
+
+    // Wake the signal thread itself when the loop ended without a stop signal
+    if (polled[1].revents == 0) pthread_kill(signalThread.native_handle(), SIGTERM);
+    signalThread.join();
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+
+    close(listener);
+    unlink(socketPath.c_str());
+    const auto& cache = compiler.GetModuleCache();
+    const auto& generateCache = compiler.GetGenerateCache();
+    std::cout << "rslc: stopped (module cache " << cache.GetHits() << " hits, " << cache.GetMisses() <<
+        " misses, generate cache " << generateCache.GetHits() << " hits, " << generateCache.GetMisses() << " misses)"
+        << std::endl;
+    return exitCode;
+}
+#endif
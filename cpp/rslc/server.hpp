@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+
+#include "rsl/Compiler.hpp"
+
+// Runs the compile server on a Unix domain socket until interrupted.
+//
+// Each request is a block of header lines ended by an empty line:
+//   stage vertex|fragment
+//   path <file>             compile a file, read through the warm module cache
+//   source <byteCount>      compile the bytes that follow the empty line, at most MAX_SOURCE_SIZE
+//   file <name>             name used for a source request when resolving relative includes
+//   define <name>[=<value>] may repeat
+//
+// Each response is "ok <byteCount>\n" followed by the output, or "error <byteCount>\n" followed by the message.
+// A connection may send any number of requests. A request with a source size that is not a number or too large is
+// answered with an error and the connection is closed, since the bytes that follow cannot be skipped reliably.
+//
+// Every request is compiled with options, and defines are applied before the defines of the request.
+int runServer(const std::string& socketPath, size_t numThreads, const rsl::CompilerOptions& options,
+              const std::unordered_map<std::string, std::string>& defines);
+
+// Answers the requests read from fd, which stays open, until the peer closes it or sends a request that cannot be
+// read. Compile errors are answered rather than ending the connection.
+void serveConnection(int fd, rsl::Compiler& compiler, const std::unordered_map<std::string, std::string>& defines);
+
+// Largest source accepted by a source request, in bytes
+constexpr uint64_t MAX_SOURCE_SIZE = 64ull * 1024 * 1024;
@@ -0,0 +1,99 @@
+#include "rsl/Compiler.hpp"
+#include "rsl/GenerateCache.hpp"
+#include "rsl/parser.hpp"
+#include "rsl/tokenizer.hpp"
+#include "rsl/utils.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    std::vector<std::shared_ptr<rsl::Node>> parseStatements(const std::string& source)
+    {
+        auto tokens = rsl::tokenize("<test>", source);
+        return rsl::parse(tokens)->statements;
+    }
+
+    std::string lookup(rsl::glsl::GenerateCache& cache, size_t key, const rsl::Node& node)
+    {
+        rsl::Writer out{};
+        if (!cache.Write(key, node, out)) return "<miss>";
+        return std::string(out.GetBuffer());
+    }
+}
+
+RSL_TEST(generateCacheComparesNodesOnHit)
+{
+    auto statements = parseStatements(R"(
+float first(float a) { return a + 1.0; }
+float second(float a) { return a + 2.0; }
+)");
+    rsl::glsl::GenerateCache cache{};
+
+    // Both functions under one key stand in for a hash collision
+    cache.Insert(7, statements[0], "first");
+    RSL_CHECK_EQ(lookup(cache, 7, *statements[1]), std::string("<miss>"));
+    cache.Insert(7, statements[1], "second");
+    RSL_CHECK_EQ(cache.GetSize(), size_t{2});
+
+    RSL_CHECK_EQ(lookup(cache, 7, *rsl::cloneNode(statements[0])), std::string("first"));
+    RSL_CHECK_EQ(lookup(cache, 7, *statements[1]), std::string("second"));
+    RSL_CHECK_EQ(lookup(cache, 8, *statements[0]), std::string("<miss>"));
+    RSL_CHECK_EQ(cache.GetHits(), uint64_t{2});
+    RSL_CHECK_EQ(cache.GetMisses(), uint64_t{2});
+
+    // Inserting an equal node again keeps the first text
+    cache.Insert(7, rsl::cloneNode(statements[0]), "again");
+    RSL_CHECK_EQ(lookup(cache, 7, *statements[0]), std::string("first"));
+    RSL_CHECK_EQ(cache.GetSize(), size_t{2});
+}
+
+RSL_TEST(generateCacheClearsWhenFull)
+{
+    auto statements = parseStatements(R"(
+float first(float a) { return a + 1.0; }
+float second(float a) { return a + 2.0; }
+float third(float a) { return a + 3.0; }
+)");
+    rsl::glsl::GenerateCache cache{10};
+
+    cache.Insert(1, statements[0], "1234");
+    cache.Insert(2, statements[1], "5678");
+    RSL_CHECK_EQ(cache.GetSize(), size_t{2});
+    RSL_CHECK_EQ(cache.GetClears(), uint64_t{0});
+
+    cache.Insert(3, statements[2], "9012");
+    RSL_CHECK_EQ(cache.GetSize(), size_t{1});
+    RSL_CHECK_EQ(cache.GetClears(), uint64_t{1});
+    RSL_CHECK_EQ(lookup(cache, 1, *statements[0]), std::string("<miss>"));
+    RSL_CHECK_EQ(lookup(cache, 3, *statements[2]), std::string("9012"));
+
+    // Text larger than the capacity is not kept at all
+    cache.Insert(4, statements[0], "far too long to fit");
+    RSL_CHECK_EQ(lookup(cache, 4, *statements[0]), std::string("<miss>"));
+
+    cache.SetCapacity(2);
+    RSL_CHECK_EQ(cache.GetSize(), size_t{0});
+}
+
+RSL_TEST(generateCacheHitsAcrossCompiles)
+{
+    rsl::CompilerOptions options{};
+    options.cacheGenerated = true;
+    rsl::Compiler compiler(1, options);
+    const rsl::CompileJob job{"cached.rsl", R"(
+float helper(float a) { return a * 2.0; }
+@Fragment {
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(helper(0.5)); }
+}
+)", rsl::EScopeType::Fragment, {}};
+
+    const auto first = compiler.Compile(job);
+    const auto misses = compiler.GetGenerateCache().GetMisses();
+    const auto second = compiler.Compile(job);
+    RSL_CHECK(first.success);
+    RSL_CHECK_EQ(second.output, first.output);
+    RSL_CHECK(compiler.GetGenerateCache().GetHits() > 0);
+    RSL_CHECK_EQ(compiler.GetGenerateCache().GetMisses(), misses);
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include "rsl/ShaderWatcher.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    void writeFile(const std::filesystem::path& path, const std::string& content)
+    {
+        std::ofstream(path, std::ios::binary) << content;
+    }
+
+    std::string rootSource(const std::string& include)
+    {
+        return "#include \"" + include + "\"\n"
+            "@Fragment {\n"
+            "    layout(location = 0) out float4 oColor;\n"
+            "    void main() {\n"
+            "        oColor = float4(shade());\n"
+            "    }\n"
+            "}\n";
+    }
+
+    std::string includeSource(const std::string& value)
+    {
+        return "float shade() {\n    return " + value + ";\n}\n";
+    }
+
+    // Roots reported by the watcher, which calls back from its own thread
+    class Reloads
+    {
+        std::mutex _mutex{};
+        std::condition_variable _changed{};
+        std::set<std::string> _roots{};
+
+    public:
+        void Add(const rsl::ShaderReloadEvent& event)
+        {
+            std::lock_guard lock(_mutex);
+            _roots.insert(std::filesystem::path(event.rootFile).filename().string());
+            _changed.notify_all();
+        }
+
+        // Waits until count roots were reported or the timeout passes, then returns and forgets the reported roots
+        std::set<std::string> Take(size_t count, std::chrono::milliseconds timeout)
+        {
+            std::unique_lock lock(_mutex);
+            _changed.wait_for(lock, timeout, [&]
+            {
+                return _roots.size() >= count;
+            });
+            return std::exchange(_roots, {});
+        }
+    };
+}
+
+RSL_TEST(shaderWatcherRecompilesOnlyDependentRoots)
+{
+    const auto directory = std::filesystem::temp_directory_path() / "rsl_test_shader_watcher";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    writeFile(directory / "shared.rsl", includeSource("0.25"));
+    writeFile(directory / "other.rsl", includeSource("0.5"));
+    writeFile(directory / "first.rsl", rootSource("shared.rsl"));
+    writeFile(directory / "second.rsl", rootSource("other.rsl"));
+    writeFile(directory / "third.rsl", rootSource("shared.rsl"));
+
+    Reloads reloads{};
+    rsl::Compiler compiler{2};
+    {
+        rsl::ShaderWatcher watcher{
+            compiler, [&reloads](const rsl::ShaderReloadEvent& event) { reloads.Add(event); },
+            std::chrono::milliseconds(10)
+        };
+
+        for (auto name : {"first.rsl", "second.rsl", "third.rsl"})
+        {
+            const auto results = watcher.Watch((directory / name).string(), {rsl::EScopeType::Fragment});
+            RSL_CHECK(results.size() == 1 && results[0].success);
+        }
+
+        // Touching the shared include reloads the two roots including it, and the root with its own include stays
+        const std::set<std::string> none{};
+        writeFile(directory / "shared.rsl", includeSource("0.75"));
+        RSL_CHECK(reloads.Take(2, std::chrono::seconds(5)) == std::set<std::string>({"first.rsl", "third.rsl"}));
+        // Give a wrong reload of second.rsl time to show up
+        RSL_CHECK(reloads.Take(1, std::chrono::milliseconds(300)) == none);
+
+        writeFile(directory / "other.rsl", includeSource("1.0"));
+        RSL_CHECK(reloads.Take(1, std::chrono::seconds(5)) == std::set<std::string>({"second.rsl"}));
+        RSL_CHECK(reloads.Take(1, std::chrono::milliseconds(300)) == none);
+
+        // An unwatched root is not reloaded
+        watcher.Unwatch((directory / "third.rsl").string());
+        writeFile(directory / "shared.rsl", includeSource("0.125"));
+        RSL_CHECK(reloads.Take(1, std::chrono::seconds(5)) == std::set<std::string>({"first.rsl"}));
+        RSL_CHECK(reloads.Take(1, std::chrono::milliseconds(300)) == none);
+    }
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,93 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "rsl/Compiler.hpp"
+#include "rsl/ThreadPool.hpp"
+
+#include "test.hpp"
+
+RSL_TEST(parallelForVisitsEveryIndexOnce)
+{
+    rsl::ThreadPool pool(4);
+    std::vector<std::atomic<int>> visits(1000);
+    pool.ParallelFor(visits.size(), [&visits](size_t i) { ++visits[i]; });
+    for (auto& count : visits) RSL_CHECK_EQ(count.load(), 1);
+
+    pool.ParallelFor(0, [](size_t) { rsl::test::fail("called for an empty range", __FILE__, __LINE__); });
+}
+
+RSL_TEST(parallelForNestsInsideTasks)
+{
+    // Fewer workers than outer iterations, so outer iterations can only finish by running inner work themselves
+    rsl::ThreadPool pool(2);
+    std::atomic<size_t> total = 0;
+    pool.ParallelFor(8, [&](size_t)
+    {
+        pool.ParallelFor(100, [&total](size_t i) { total += i; });
+    });
+    RSL_CHECK_EQ(total.load(), size_t{8 * 4950});
+}
+
+RSL_TEST(parallelForRethrowsAfterEveryIndexRan)
+{
+    rsl::ThreadPool pool(3);
+    std::atomic<size_t> ran = 0;
+    RSL_CHECK_THROWS(pool.ParallelFor(50, [&ran](size_t i)
+    {
+        ++ran;
+        if (i == 7) throw std::runtime_error("index 7");
+    }));
+    RSL_CHECK_EQ(ran.load(), size_t{50});
+}
+
+RSL_TEST(submitReturnsTheResult)
+{
+    rsl::ThreadPool pool(2);
+    std::vector<std::future<size_t>> futures{};
+    for (size_t i = 0; i < 64; i++) futures.push_back(pool.Submit([i] { return i * i; }));
+    for (size_t i = 0; i < futures.size(); i++) RSL_CHECK_EQ(futures[i].get(), i * i);
+}
+
+RSL_TEST(compileBatchKeepsSubmissionOrder)
+{
+    const std::string source = R"(
+@Vertex {
+    layout(location = 0) out float2 oUV;
+    void main() { oUV = float2(0.0); gl_Position = float4(0.0); }
+}
+@Fragment {
+    layout(location = 0) in float2 iUV;
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(iUV, 0.0, 1.0); }
+}
+)";
+
+    rsl::Compiler compiler(4);
+    std::vector<rsl::CompileJob> jobs{};
+    for (auto i = 0; i < 16; i++)
+    {
+        rsl::CompileJob job{};
+        job.fileName = "batch.rsl";
+        job.source = source;
+        job.scopeType = i % 2 == 0 ? rsl::EScopeType::Vertex : rsl::EScopeType::Fragment;
+        jobs.push_back(job);
+    }
+    jobs[5].fileName = "broken.rsl";
+    jobs[5].source = "@Fragment { void main() { oColor = ; } }";
+
+    auto results = compiler.CompileBatch(jobs);
+    RSL_CHECK_EQ(results.size(), jobs.size());
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (i == 5)
+        {
+            RSL_CHECK(!results[i].success);
+            RSL_CHECK(!results[i].error.empty());
+            continue;
+        }
+        RSL_CHECK(results[i].success);
+        const auto isVertex = results[i].output.find("gl_Position") != std::string::npos;
+        RSL_CHECK_EQ(isVertex, i % 2 == 0);
+    }
+}
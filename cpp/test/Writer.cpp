@@ -0,0 +1,67 @@
+#include "rsl/Compiler.hpp"
+#include "rsl/Writer.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    // Writes the same output through a writer over caller memory of the given capacity
+    std::string writeInto(size_t capacity, size_t& size)
+    {
+        std::string buffer(capacity, '\0');
+        rsl::Writer out(capacity == 0 ? nullptr : buffer.data(), capacity);
+        out.SetCompact(true);
+        out << "a" << "-";
+        const auto mark = out.GetMark();
+        out << "b";
+        out.Truncate(mark);
+        out << "-" << "b";
+        out.BeginLine();
+        out << "#define X 1";
+        size = out.GetSize();
+        buffer.resize(std::min(size, capacity));
+        return buffer;
+    }
+}
+
+RSL_TEST(writerMeasuresWhatItWrites)
+{
+    size_t measured = 0;
+    writeInto(0, measured);
+    size_t overflowed = 0;
+    writeInto(2, overflowed);
+    size_t written = 0;
+    const auto output = writeInto(measured, written);
+    RSL_CHECK_EQ(output, std::string("a- -b\n#define X 1"));
+    RSL_CHECK_EQ(measured, output.size());
+    RSL_CHECK_EQ(overflowed, output.size());
+    RSL_CHECK_EQ(written, output.size());
+}
+
+RSL_TEST(writerFillsMeasuredMinifiedOutput)
+{
+    rsl::CompilerOptions options{};
+    options.minify = true;
+    rsl::Compiler compiler(1, options);
+    const rsl::CompileJob job{"minified.rsl", R"(
+#define SCALE 2.0;
+float helper(float a, float b) { return a - -b; }
+@Fragment {
+    #define BIAS 0.5;
+    layout(location = 0) in float iA;
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(helper(iA, -iA) * SCALE + BIAS); }
+}
+)", rsl::EScopeType::Fragment, {}};
+
+    rsl::Writer measure(nullptr, 0);
+    RSL_CHECK(compiler.Compile(job, measure).success);
+    const auto size = measure.GetTotalSize();
+
+    std::string buffer(size, '\0');
+    rsl::Writer fill(buffer.data(), buffer.size());
+    RSL_CHECK(compiler.Compile(job, fill).success);
+    RSL_CHECK_EQ(fill.GetTotalSize(), size);
+    RSL_CHECK(!fill.IsOverflowed());
+    RSL_CHECK_EQ(buffer, compiler.Compile(job).output);
+}
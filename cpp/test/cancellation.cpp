@@ -0,0 +1,72 @@
+#include <future>
+#include <mutex>
+
+#include "rsl/Compiler.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    const rsl::CompileJob JOB{"async.rsl", R"(
+@Fragment {
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(1.0); }
+}
+)", rsl::EScopeType::Fragment, {}};
+}
+
+RSL_TEST(compileAsyncReportsEveryPhase)
+{
+    rsl::Compiler compiler(2);
+    std::mutex mutex{};
+    std::vector<rsl::ECompilePhase> phases{};
+    auto handle = compiler.CompileAsync(JOB, [&](rsl::ECompilePhase phase)
+    {
+        std::lock_guard lock(mutex);
+        phases.push_back(phase);
+    });
+
+    RSL_CHECK(handle.IsValid());
+    const auto& result = handle.Get();
+    RSL_CHECK(handle.IsReady());
+    RSL_CHECK(result.success);
+    RSL_CHECK(!result.cancelled);
+    RSL_CHECK(result.output.find("void main()") != std::string::npos);
+
+    std::lock_guard lock(mutex);
+    RSL_CHECK(phases == std::vector<rsl::ECompilePhase>({
+        rsl::ECompilePhase::Tokenized, rsl::ECompilePhase::Parsed, rsl::ECompilePhase::Generated
+        }));
+}
+
+RSL_TEST(compileAsyncStopsAfterCancel)
+{
+    rsl::Compiler compiler(2);
+    std::promise<void> cancelled{};
+    const auto cancelledFuture = cancelled.get_future().share();
+    std::atomic<int> phases = 0;
+
+    // The compile waits after tokenizing until the handle has been cancelled
+    auto handle = compiler.CompileAsync(JOB, [&](rsl::ECompilePhase)
+    {
+        ++phases;
+        cancelledFuture.wait();
+    });
+    handle.Cancel();
+    RSL_CHECK(handle.IsCancelled());
+    cancelled.set_value();
+
+    const auto& result = handle.Get();
+    RSL_CHECK(result.cancelled);
+    RSL_CHECK(!result.success);
+    RSL_CHECK(result.output.empty());
+    RSL_CHECK_EQ(phases.load(), 1);
+}
+
+RSL_TEST(defaultCompileHandleIsInvalid)
+{
+    const rsl::CompileHandle handle{};
+    RSL_CHECK(!handle.IsValid());
+    RSL_CHECK(!handle.IsCancelled());
+    handle.Cancel();
+}
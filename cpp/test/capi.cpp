@@ -0,0 +1,68 @@
+#include <cstring>
+#include <string>
+
+#include "rsl/rsl.h"
+
+#include "test.hpp"
+
+namespace
+{
+    const char* SOURCE = R"(
+@Fragment {
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(1.0); }
+}
+)";
+
+    rsl_compile_options fragmentOptions(const char* source)
+    {
+        rsl_compile_options options{};
+        options.file_name = "capi.rsl";
+        options.source = source;
+        options.source_size = std::strlen(source);
+        options.stage = RSL_STAGE_FRAGMENT;
+        return options;
+    }
+}
+
+RSL_TEST(capiCompilesIntoOwnedAndCallerBuffers)
+{
+    auto compiler = rsl_compiler_create(1);
+    RSL_CHECK(compiler);
+    const auto options = fragmentOptions(SOURCE);
+
+    char* data = nullptr;
+    size_t size = 0;
+    rsl_error error{};
+    RSL_CHECK_EQ(rsl_compile(compiler, &options, &data, &size, &error), RSL_OK);
+    const std::string output(data, size);
+    RSL_CHECK_EQ(std::strlen(data), size);
+    RSL_CHECK(output.find("void main()") != std::string::npos);
+    rsl_free(data);
+
+    size_t required = 0;
+    RSL_CHECK_EQ(rsl_compile_to_buffer(compiler, &options, nullptr, 0, &required, &error),
+                 RSL_ERROR_BUFFER_TOO_SMALL);
+    RSL_CHECK_EQ(required, size);
+    std::string buffer(required, '\0');
+    RSL_CHECK_EQ(rsl_compile_to_buffer(compiler, &options, buffer.data(), buffer.size(), &required, &error), RSL_OK);
+    RSL_CHECK_EQ(buffer, output);
+
+    rsl_compiler_destroy(compiler);
+}
+
+RSL_TEST(capiReportsCompileErrors)
+{
+    auto compiler = rsl_compiler_create(1);
+    const auto options = fragmentOptions("@Fragment { void main() { oColor = ; } }");
+
+    char* data = nullptr;
+    rsl_error error{};
+    RSL_CHECK_EQ(rsl_compile(compiler, &options, &data, nullptr, &error), RSL_ERROR_COMPILE);
+    RSL_CHECK_EQ(error.status, RSL_ERROR_COMPILE);
+    RSL_CHECK(std::strlen(error.message) > 0);
+    RSL_CHECK(data == nullptr);
+
+    RSL_CHECK_EQ(rsl_compile(nullptr, &options, &data, nullptr, &error), RSL_ERROR_INVALID_ARGUMENT);
+    rsl_compiler_destroy(compiler);
+}
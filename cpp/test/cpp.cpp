@@ -0,0 +1,132 @@
+#include <cmath>
+#include <string>
+
+#include "functions_x1.hpp"
+#include "functions_x4.hpp"
+#include "functions_x8.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    template <typename T>
+    struct LaneCount
+    {
+        static constexpr int value = 1;
+    };
+
+    template <typename T, int W>
+    struct LaneCount<rsl::cpu::Lanes<T, W>>
+    {
+        static constexpr int value = W;
+    };
+
+    // Lane i of a scalar or SoA value
+    template <typename T>
+    auto lane(const T& value, int i)
+    {
+        if constexpr (LaneCount<T>::value == 1) return value;
+        else return value[i];
+    }
+
+    // Value holding f(i) in lane i
+    template <typename T, typename F>
+    T lanes(F f)
+    {
+        if constexpr (LaneCount<T>::value == 1) return static_cast<T>(f(0));
+        else
+        {
+            using Element = decltype(lane(T{}, 0));
+            Element values[LaneCount<T>::value];
+            for (auto i = 0; i < LaneCount<T>::value; i++) values[i] = static_cast<Element>(f(i));
+            return T::Load(values);
+        }
+    }
+
+    void checkNear(float actual, float expected, int lanes, int i, const char* file, int line)
+    {
+        if (std::abs(actual - expected) <= 1e-5f * std::max(1.0f, std::abs(expected))) return;
+        rsl::test::fail("x" + std::to_string(lanes) + " lane " + std::to_string(i) + ": expected " +
+                        std::to_string(expected) + " but got " + std::to_string(actual), file, line);
+    }
+
+#define RSL_CHECK_LANE(actual, expected) checkNear((actual), (expected), W, i, __FILE__, __LINE__)
+
+    template <typename Functions, typename Float, typename Int, typename float2, typename float4, typename mat3>
+    void checkFunctions()
+    {
+        constexpr auto W = LaneCount<Float>::value;
+
+        // Every lane maps a different value from [0, 10] to [-1, 1]
+        const auto value = lanes<Float>([](int i) { return 2.5f * static_cast<float>(i) - 1.0f; });
+        const auto mapped = Functions::mapRangeUnClamped(value, 0.0f, 10.0f, -1.0f, 1.0f);
+        for (auto i = 0; i < W; i++)
+        {
+            RSL_CHECK_LANE(lane(mapped, i), -1.0f + 0.2f * (2.5f * static_cast<float>(i) - 1.0f));
+        }
+
+        // Scale by 2 then translate by (10, 20 + lane), in column major order
+        const auto translateY = lanes<Float>([](int i) { return 20 + i; });
+        const mat3 transform(2.0f, 0.0f, 0.0f, 0.0f, 2.0f, 0.0f, 10.0f, translateY, 1.0f);
+        const float2 pos(lanes<Float>([](int i) { return i; }), -3.0f);
+        const auto moved = Functions::applyTransform3(pos, transform);
+        for (auto i = 0; i < W; i++)
+        {
+            RSL_CHECK_LANE(lane(moved.x, i), 2.0f * static_cast<float>(i) + 10.0f);
+            RSL_CHECK_LANE(lane(moved.y, i), 14.0f + static_cast<float>(i));
+        }
+
+        // Out arguments, and an index into a constant array that differs between lanes
+        float2 tl, tr, bl, br;
+        Functions::extentToPoints(float4(1.0f, 2.0f, 3.0f, 4.0f), tl, tr, bl, br);
+        float4 location;
+        float2 uv;
+        Functions::generateVertex(float4(0.0f, 0.0f, 100.0f, 100.0f), float4(25.0f, 25.0f, 50.0f, 50.0f),
+                                 lanes<Int>([](int i) { return i % 6; }), location, uv);
+        constexpr float vertices[][2] = {{-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, -0.5f}, {0.5f, 0.5f},
+                                         {-0.5f, 0.5f}};
+        for (auto i = 0; i < W; i++)
+        {
+            RSL_CHECK_LANE(lane(tr.x, i), 4.0f);
+            RSL_CHECK_LANE(lane(tr.y, i), 2.0f);
+            RSL_CHECK_LANE(lane(bl.x, i), 1.0f);
+            RSL_CHECK_LANE(lane(bl.y, i), 6.0f);
+            RSL_CHECK_LANE(lane(location.x, i), vertices[i % 6][0]);
+            RSL_CHECK_LANE(lane(location.y, i), vertices[i % 6][1]);
+            RSL_CHECK_LANE(lane(location.w, i), 1.0f);
+            RSL_CHECK_LANE(lane(uv.x, i), vertices[i % 6][0] + 0.5f);
+        }
+    }
+
+    // Forwards to the functions of one generated header so a single check covers every lane count
+#define RSL_FORWARD_FUNCTIONS(name, ns) \
+    struct name \
+    { \
+        template <typename... A> static auto mapRangeUnClamped(A&&... args) { return ns::mapRangeUnClamped(args...); } \
+        template <typename... A> static auto applyTransform3(A&&... args) { return ns::applyTransform3(args...); } \
+        template <typename... A> static void extentToPoints(A&&... args) { ns::extentToPoints(args...); } \
+        template <typename... A> static void generateVertex(A&&... args) { ns::generateVertex(args...); } \
+    };
+
+    RSL_FORWARD_FUNCTIONS(OneLane, functions_x1)
+    RSL_FORWARD_FUNCTIONS(FourLanes, functions_x4)
+    RSL_FORWARD_FUNCTIONS(EightLanes, functions_x8)
+}
+
+RSL_TEST(cppFunctionsWithOneLane)
+{
+    using namespace rsl::cpu::scalar;
+    checkFunctions<OneLane, Float, Int, float2, float4, mat3>();
+}
+
+RSL_TEST(cppFunctionsWithFourLanes)
+{
+    using namespace rsl::cpu::x4;
+    checkFunctions<FourLanes, Float, Int, float2, float4, mat3>();
+}
+
+RSL_TEST(cppFunctionsWithEightLanes)
+{
+    using namespace rsl::cpu::x8;
+    checkFunctions<EightLanes, Float, Int, float2, float4, mat3>();
+}
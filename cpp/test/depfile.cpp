@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <filesystem>
+
+#include "rsl/Compiler.hpp"
+#include "rsl/depfile.hpp"
+
+#include "test.hpp"
+
+RSL_TEST(depfileRoundTripsEscapedPaths)
+{
+    const std::vector<std::string> targets{"out/quad.vert", "out/quad.frag"};
+    const std::vector<std::string> prerequisites{
+        "/shaders/quad.rsl", "/shaders/with space.rsl", "/shaders/#hash.rsl", "/shaders/$dollar.rsl"
+    };
+
+    const auto content = rsl::formatDepfile(targets, prerequisites);
+    RSL_CHECK_EQ(content, std::string("out/quad.vert out/quad.frag: /shaders/quad.rsl \\\n"
+                                      "  /shaders/with\\ space.rsl \\\n"
+                                      "  /shaders/\\#hash.rsl \\\n"
+                                      "  /shaders/$$dollar.rsl\n"));
+    RSL_CHECK(rsl::parseDepfile(content) == prerequisites);
+
+    RSL_CHECK(rsl::parseDepfile("").empty());
+    RSL_CHECK(rsl::parseDepfile("out/quad.vert:\n").empty());
+}
+
+RSL_TEST(depfileKeepsBackslashesInWindowsPaths)
+{
+    const std::vector<std::string> prerequisites{
+        "C:\\shaders\\quad.rsl", "C:\\Program Files\\rsl\\#lib.rsl", "\\\\server\\share\\dir\\ x.rsl"
+    };
+
+    const auto content = rsl::formatDepfile({"C:\\out\\quad.vert"}, prerequisites);
+    RSL_CHECK_EQ(content, std::string("C:\\out\\quad.vert: C:\\shaders\\quad.rsl \\\n"
+                                      "  C:\\Program\\ Files\\rsl\\\\\\#lib.rsl \\\n"
+                                      "  \\\\server\\share\\dir\\\\\\ x.rsl\n"));
+    RSL_CHECK(rsl::parseDepfile(content) == prerequisites);
+}
+
+RSL_TEST(depfileListsIncludedFiles)
+{
+    const auto path = rsl::test::dataPath("quad.rsl");
+    rsl::Compiler compiler(1);
+    rsl::CompileJob job{};
+    job.fileName = path;
+    job.scopeType = rsl::EScopeType::Vertex;
+    auto result = compiler.Compile(job);
+    RSL_CHECK(result.success);
+
+    std::vector<std::string> prerequisites{std::filesystem::absolute(path).string()};
+    prerequisites.insert(prerequisites.end(), result.dependencies.begin(), result.dependencies.end());
+    const auto parsed = rsl::parseDepfile(rsl::formatDepfile({"quad.vert"}, prerequisites));
+    RSL_CHECK(parsed == prerequisites);
+
+    const auto functions = std::filesystem::path(RSL_TEST_DATA_DIR) / "../../../examples/functions.rsl";
+    RSL_CHECK(std::ranges::find(parsed, functions.lexically_normal().string()) != parsed.end());
+}
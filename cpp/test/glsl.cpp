@@ -0,0 +1,157 @@
+#include "rsl/Compiler.hpp"
+#include "rsl/glsl.hpp"
+#include "rsl/parser.hpp"
+#include "rsl/tokenizer.hpp"
+#include "rsl/utils.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    const char* QUAD_SOURCE = R"(
+
+struct QuadRenderInfo
+{
+    // [TextureId,RenderMode,0,0]
+    int4 opts;
+    float4 color;
+    float4 borderRadius;
+    float2 size;
+    mat3 transform;
+    float4 uv;
+};
+
+
+layout(set = 1,binding = 0, scalar) uniform batch_info {
+    QuadRenderInfo quads[64];
+};
+
+push(scalar){
+    float4 viewport;
+    mat4 projection;
+};
+
+@Vertex{
+
+    layout(location = 0) out float2 oUV;
+    layout(location = 1) out int oQuadIndex;
+
+    void main(){
+        int index = gl_VertexIndex;
+        int vertexIndex = int(mod(index, 6));
+        int quadIndex = int(floor(index / 6));
+        QuadRenderInfo quad = batch_info.quads[quadIndex];
+        generateRectVertex(quad.size, push.projection, quad.transform, vertexIndex, gl_Position, oUV);
+        oQuadIndex = quadIndex;
+    }
+}
+
+
+@Fragment{
+    layout (location = 0) in float2 iUV;
+    layout (location = 1,$flat) in int iQuadIndex;
+    layout (location = 0) out float4 oColor;
+
+    float median(float r, float g, float b) {
+        return max(min(r, g), min(max(r, g), b));
+    }
+
+    float screenPxRange(float2 uv,float2 size) {
+        float2 unitRange = float2(30.0)/size;
+        float2 screenTexSize = float2(1.0)/fwidth(uv);
+        return max(0.5*dot(unitRange, screenTexSize), 1.0);
+    }
+
+    void main(){
+        QuadRenderInfo quad = batch_info.quads[iQuadIndex];
+        float4 pxColor = quad.color;
+        int textureId = quad.opts.x;
+        int mode = quad.opts.y;
+
+        if(textureId != -1){
+            float4 uvMapping = quad.uv;
+            float u = mapRangeUnClamped(iUV.x,0.0,1.0,uvMapping.x,uvMapping.z);
+            float v = mapRangeUnClamped(iUV.y,0.0,1.0,uvMapping.y,uvMapping.w);
+            float2 uv = float2(u,v);
+
+            if(mode == 0){
+                pxColor = pxColor * sampleTexture(textureId,uv);
+            } else if(mode == 1){
+                float2 texSize = getTextureSize(textureId);
+                float2 actualTexSize = texSize * (uvMapping.zw - uvMapping.xy);
+                float3 msd = sampleTexture(textureId,uv).rgb;
+                float sd = median(msd.r,msd.g,msd.b);
+                float distance = screenPxRange(uv,actualTexSize)*(sd - 0.5);
+                float opacity = clamp(distance + 0.5, 0.0, 1.0);
+                oColor = mix(float4(pxColor.rgb,0.0),pxColor,opacity);
+            }
+        }
+
+        oColor = applyBorderRadius(gl_FragCoord.xy, pxColor, quad.borderRadius, quad.size, quad.transform);
+    }
+})";
+
+    // A module with count structs and a chain of count functions that main reaches, so every one is generated
+    std::string manyDeclarations(int count)
+    {
+        std::string source{};
+        for (auto i = 0; i < count; i++)
+        {
+            const auto n = std::to_string(i);
+            source += "struct Data" + n + "\n{\n    float4 value;\n    float weight" + n + ";\n};\n\n";
+            source += "float step" + n + "(float x) {\n    Data" + n + " data = Data" + n + "(float4(x), " + n +
+                ".0);\n    float y = x * data.weight" + n + " + data.value.y;\n";
+            source += "    return " + (i == 0 ? std::string("y") : "step" + std::to_string(i - 1) + "(y)") + ";\n}\n\n";
+        }
+
+        const auto last = "step" + std::to_string(count - 1);
+        source += "@Vertex {\n    void main() {\n        gl_Position = float4(" + last + "(1.0));\n    }\n}\n\n";
+        source += "@Fragment {\n    layout(location = 0) out float4 oColor;\n";
+        source += "    void main() {\n        oColor = float4(" + last + "(2.0));\n    }\n}\n";
+        return source;
+    }
+}
+
+RSL_TEST(generatesSampleStages)
+{
+    auto tokens = rsl::tokenize("<test>", QUAD_SOURCE);
+    auto ast = rsl::parse(tokens);
+    rsl::resolveReferences(ast);
+
+    auto vertex = rsl::glsl::generate(rsl::extractScope(ast, rsl::EScopeType::Vertex));
+    RSL_CHECK(vertex.find("void main()") != std::string::npos);
+    RSL_CHECK(vertex.find("layout(location = 1) out int oQuadIndex;") != std::string::npos);
+
+    auto fragment = rsl::glsl::generate(rsl::extractScope(ast, rsl::EScopeType::Fragment));
+    RSL_CHECK(fragment.find("float median(") != std::string::npos);
+    RSL_CHECK(fragment.find("oQuadIndex") == std::string::npos);
+}
+
+RSL_TEST(parallelGenerateMatchesSerialOutput)
+{
+    const auto source = manyDeclarations(64);
+    for (const auto minify : {false, true})
+    {
+        rsl::CompilerOptions serialOptions{};
+        serialOptions.minify = minify;
+        auto parallelOptions = serialOptions;
+        parallelOptions.parallelGenerate = true;
+        rsl::Compiler serial{1, serialOptions};
+        rsl::Compiler parallel{4, parallelOptions};
+
+        for (const auto scopeType : {rsl::EScopeType::Vertex, rsl::EScopeType::Fragment})
+        {
+            const rsl::CompileJob job{"many.rsl", source, scopeType, {}};
+            const auto expected = serial.Compile(job);
+            RSL_CHECK(expected.success);
+            RSL_CHECK(minify || expected.output.find("struct Data63") != std::string::npos);
+            // Several runs, since the order workers finish in differs between them
+            for (auto run = 0; run < 3; run++)
+            {
+                const auto actual = parallel.Compile(job);
+                RSL_CHECK(actual.success);
+                RSL_CHECK_EQ(actual.output, expected.output);
+            }
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "host.host.hpp"
+#include "rsl/Compiler.hpp"
+#include "rsl/reflection.hpp"
+
+#include "test.hpp"
+
+// The generated header asserts its own layout. These pin it to the sizes and offsets the reflection of data/host.rsl
+// reports, which hostHeaderMatchesReflection checks at run time.
+static_assert(sizeof(host::Scene) == 352 && offsetof(host::Scene, materials) == 80 &&
+    offsetof(host::Scene, time) == 336);
+static_assert(sizeof(host::Material) == 128 && offsetof(host::Material, uvTransform) == 32 &&
+    offsetof(host::Material, weights) == 80);
+static_assert(sizeof(host::Particles) == 320 && offsetof(host::Particles, range) == 256 &&
+    offsetof(host::Particles, basis) == 272);
+static_assert(sizeof(host::push) == 32 && offsetof(host::push, mode) == 24);
+
+namespace
+{
+    struct HostStruct
+    {
+        std::string name{};
+        size_t size = 0;
+        std::vector<std::pair<std::string, size_t>> offsets{};
+    };
+
+#define RSL_MEMBER(type, member) std::pair<std::string, size_t>{#member, offsetof(type, member)}
+
+    std::string fragmentReflection()
+    {
+        rsl::CompilerOptions options{};
+        options.reflect = true;
+        rsl::Compiler compiler(1, options);
+        rsl::CompileJob job{};
+        job.fileName = rsl::test::dataPath("host.rsl");
+        job.scopeType = rsl::EScopeType::Fragment;
+        const auto result = compiler.Compile(job);
+        if (!result.success) rsl::test::fail(result.error, __FILE__, __LINE__);
+        return rsl::writeReflection(result.reflection, rsl::EScopeType::Fragment);
+    }
+}
+
+RSL_TEST(hostHeaderMatchesReflection)
+{
+    const std::vector<HostStruct> resources{
+        {
+            "Scene", sizeof(host::Scene), {
+                RSL_MEMBER(host::Scene, view), RSL_MEMBER(host::Scene, sun), RSL_MEMBER(host::Scene, materials),
+                RSL_MEMBER(host::Scene, time)
+            }
+        },
+        {
+            "Particles", sizeof(host::Particles), {
+                RSL_MEMBER(host::Particles, positions), RSL_MEMBER(host::Particles, range),
+                RSL_MEMBER(host::Particles, basis)
+            }
+        },
+        {
+            "push", sizeof(host::push), {
+                RSL_MEMBER(host::push, tint), RSL_MEMBER(host::push, offset), RSL_MEMBER(host::push, mode)
+            }
+        },
+    };
+
+    const auto blob = fragmentReflection();
+    const rsl::ReflectionReader reader{blob};
+    RSL_CHECK(reader.IsValid());
+
+    for (const auto& expected : resources)
+    {
+        const auto index = reader.FindResource(expected.name);
+        RSL_CHECK(index >= 0);
+        if (index < 0) continue;
+
+        const auto resource = reader.GetResource(static_cast<uint32_t>(index));
+        RSL_CHECK_EQ(size_t{resource.size}, expected.size);
+        RSL_CHECK_EQ(size_t{resource.memberCount}, expected.offsets.size());
+        for (uint32_t i = 0; i < resource.memberCount && i < expected.offsets.size(); i++)
+        {
+            const auto member = reader.GetMember(resource.firstMember + i);
+            RSL_CHECK_EQ(std::string(member.name), expected.offsets[i].first);
+            RSL_CHECK_EQ(size_t{member.offset}, expected.offsets[i].second);
+        }
+    }
+
+    // Array strides come from the element types, including the padding std140 and std430 add between elements
+    const auto scene = reader.GetResource(static_cast<uint32_t>(reader.FindResource("Scene")));
+    const auto materials = reader.GetMember(scene.firstMember + 2);
+    RSL_CHECK_EQ(size_t{materials.arrayStride}, sizeof(host::Material));
+    RSL_CHECK_EQ(size_t{materials.memberCount}, size_t{5});
+    const std::vector<size_t> materialOffsets{
+        offsetof(host::Material, albedo), offsetof(host::Material, roughness), offsetof(host::Material, uvScale),
+        offsetof(host::Material, uvTransform), offsetof(host::Material, weights)
+    };
+    for (uint32_t i = 0; i < materials.memberCount && i < materialOffsets.size(); i++)
+    {
+        // Members of a struct are reflected at their offset within the struct
+        RSL_CHECK_EQ(size_t{reader.GetMember(materials.firstMember + i).offset}, materialOffsets[i]);
+    }
+
+    const auto weights = reader.GetMember(materials.firstMember + 4);
+    RSL_CHECK_EQ(size_t{weights.arrayStride}, sizeof(host::Material::weights[0]));
+    const auto particles = reader.GetResource(static_cast<uint32_t>(reader.FindResource("Particles")));
+    RSL_CHECK_EQ(size_t{reader.GetMember(particles.firstMember).arrayStride}, sizeof(host::Particles::positions[0]));
+}
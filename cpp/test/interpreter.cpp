@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+
+#include "rsl/interpreter.hpp"
+#include "rsl/parser.hpp"
+#include "rsl/tokenizer.hpp"
+#include "rsl/utils.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    const char* SOURCE = R"(
+const float SCALE = 2.5;
+const int COUNTS[] = { 3, 5, 7 };
+const float2 OFFSET = float2(1.0, -2.0);
+
+float scalars(float a, float b) {
+    return clamp(a, 0.0, 1.0) + mix(a, b, 0.25) + sqrt(b) + pow(a, 3.0) + abs(-b) + floor(a * 1.5) + mod(b, 3.0) +
+        min(a, b) + max(a, b) * SCALE;
+}
+
+int integers(int a, int b) {
+    return a / b + min(a, b) * 10 - abs(b - a) + clamp(a, 0, 9);
+}
+
+float vectors(float3 a, float3 b) {
+    float3 c = cross(a, b);
+    return dot(a, b) + length(c) + normalize(b).z + a.zyx.x + float3(a.xy, 4.0).z;
+}
+
+float2 transform(float2 pos, mat3 m) {
+    return (m * float3(pos, 1.0)).xy;
+}
+
+float3 columns(mat3 m) {
+    mat3 t = transpose(m);
+    return t[0] + m[1];
+}
+
+void split(float4 extent, out float2 low, out float2 high) {
+    low = extent.xy;
+    high = extent.xy + extent.zw;
+}
+
+float branchy(float x, int mode) {
+    float result = 0.0;
+    if (mode == 0) {
+        result = x * 2.0;
+    } else if (mode == 1) {
+        result = -x;
+    } else {
+        for (int i = 0; i < mode; i++) { result = result + x; }
+    }
+    return result;
+}
+)";
+
+    rsl::interp::Program program()
+    {
+        auto tokens = rsl::tokenize("<test>", SOURCE);
+        auto ast = rsl::parse(tokens);
+        rsl::resolveReferences(ast);
+        return rsl::interp::Program(ast);
+    }
+
+    void checkNear(float actual, float expected, const char* file, int line)
+    {
+        if (std::abs(actual - expected) <= 1e-4f * std::max(1.0f, std::abs(expected))) return;
+        rsl::test::fail("expected " + std::to_string(expected) + " but got " + std::to_string(actual), file, line);
+    }
+}
+
+#define RSL_CHECK_NEAR(actual, expected) checkNear((actual), (expected), __FILE__, __LINE__)
+
+RSL_TEST(interpreterRunsScalarBuiltins)
+{
+    auto interpreter = program();
+    const auto expectedScalars = [](float a, float b)
+    {
+        return std::clamp(a, 0.0f, 1.0f) + (a + (b - a) * 0.25f) + std::sqrt(b) + std::pow(a, 3.0f) + std::abs(b) +
+            std::floor(a * 1.5f) + (b - 3.0f * std::floor(b / 3.0f)) + std::min(a, b) + std::max(a, b) * 2.5f;
+    };
+    for (const auto& [a, b] : {std::pair{0.5f, 4.0f}, std::pair{1.75f, 7.5f}, std::pair{-0.5f, 2.0f}})
+    {
+        std::vector args{rsl::interp::Value::Float({a}), rsl::interp::Value::Float({b})};
+        RSL_CHECK_NEAR(interpreter.Invoke("scalars", args).GetFloat(), expectedScalars(a, b));
+    }
+
+    std::vector args{rsl::interp::Value::Int({17}), rsl::interp::Value::Int({5})};
+    RSL_CHECK_EQ(interpreter.Invoke("integers", args).GetInt(), 17 / 5 + 50 - 12 + 9);
+}
+
+RSL_TEST(interpreterRunsVectorAndMatrixBuiltins)
+{
+    auto interpreter = program();
+    std::vector vectorArgs{
+        rsl::interp::Value::Float({1.0f, 2.0f, 3.0f}),
+        rsl::interp::Value::Float({0.0f, 3.0f, 4.0f})
+    };
+    // cross is (-1, -4, 3), with a length of sqrt(26)
+    RSL_CHECK_NEAR(interpreter.Invoke("vectors", vectorArgs).GetFloat(), 18.0f + std::sqrt(26.0f) + 0.8f + 3.0f + 4.0f);
+
+    // Translation by (10, 20) in a column major mat3
+    std::vector transformArgs{
+        rsl::interp::Value::Float({1.0f, 2.0f}),
+        rsl::interp::Value::Float({1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 10.0f, 20.0f, 1.0f})
+    };
+    const auto moved = interpreter.Invoke("transform", transformArgs);
+    RSL_CHECK_EQ(moved.GetComponentCount(), size_t{2});
+    RSL_CHECK_NEAR(moved.GetFloat(0), 11.0f);
+    RSL_CHECK_NEAR(moved.GetFloat(1), 22.0f);
+
+    std::vector matrixArgs{rsl::interp::Value::Float({1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f})};
+    // The first column of the transpose is the first row, (1, 4, 7), and the second column is (4, 5, 6)
+    const auto sum = interpreter.Invoke("columns", matrixArgs);
+    RSL_CHECK_NEAR(sum.GetFloat(0), 5.0f);
+    RSL_CHECK_NEAR(sum.GetFloat(1), 9.0f);
+    RSL_CHECK_NEAR(sum.GetFloat(2), 13.0f);
+}
+
+RSL_TEST(interpreterWritesOutArguments)
+{
+    auto interpreter = program();
+    std::vector args{rsl::interp::Value::Float({1.0f, 2.0f, 3.0f, 4.0f}), rsl::interp::Value{}, rsl::interp::Value{}};
+    const auto result = interpreter.Invoke("split", args);
+    RSL_CHECK_EQ(result.GetComponentCount(), size_t{0});
+    RSL_CHECK_NEAR(args[1].GetFloat(0), 1.0f);
+    RSL_CHECK_NEAR(args[1].GetFloat(1), 2.0f);
+    RSL_CHECK_NEAR(args[2].GetFloat(0), 4.0f);
+    RSL_CHECK_NEAR(args[2].GetFloat(1), 6.0f);
+}
+
+RSL_TEST(interpreterRunsDivergentBatches)
+{
+    auto interpreter = program();
+    // Enough invocations to span several chunks, with a different branch and loop count per invocation
+    constexpr size_t count = 1037;
+    std::vector<rsl::interp::Batch> args{rsl::interp::Batch(count, 1), rsl::interp::Batch(count, 1)};
+    for (size_t i = 0; i < count; i++)
+    {
+        args[0].Set(i, rsl::interp::Value::Float({static_cast<float>(i) * 0.5f}));
+        args[1].Set(i, rsl::interp::Value::Int({static_cast<int32_t>(i % 6)}));
+    }
+
+    const auto result = interpreter.InvokeBatch("branchy", args, count);
+    RSL_CHECK_EQ(result.count, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto x = static_cast<float>(i) * 0.5f;
+        const auto mode = static_cast<int>(i % 6);
+        const auto expected = mode == 0 ? x * 2.0f : mode == 1 ? -x : x * static_cast<float>(mode);
+        RSL_CHECK_NEAR(result.Get(i).GetFloat(), expected);
+    }
+
+    // Out arguments left empty are allocated for the whole batch
+    std::vector<rsl::interp::Batch> splitArgs{rsl::interp::Batch(3, 4), rsl::interp::Batch{}, rsl::interp::Batch{}};
+    for (size_t i = 0; i < 3; i++)
+    {
+        const auto f = static_cast<float>(i);
+        splitArgs[0].Set(i, rsl::interp::Value::Float({f, f, 1.0f, 2.0f}));
+    }
+    interpreter.InvokeBatch("split", splitArgs, 3);
+    RSL_CHECK_EQ(splitArgs[2].count, size_t{3});
+    RSL_CHECK_NEAR(splitArgs[2].Get(2).GetFloat(0), 3.0f);
+    RSL_CHECK_NEAR(splitArgs[2].Get(2).GetFloat(1), 4.0f);
+}
+
+RSL_TEST(interpreterEvaluatesConstants)
+{
+    auto interpreter = program();
+    RSL_CHECK_NEAR(interpreter.GetConstant("SCALE").GetFloat(), 2.5f);
+
+    const auto counts = interpreter.GetConstant("COUNTS");
+    RSL_CHECK_EQ(counts.GetComponentCount(), size_t{3});
+    RSL_CHECK_EQ(counts.GetInt(2), 7);
+
+    const auto offset = interpreter.GetConstant("OFFSET");
+    RSL_CHECK_NEAR(offset.GetFloat(1), -2.0f);
+
+    RSL_CHECK_THROWS(interpreter.GetConstant("MISSING"));
+}
@@ -0,0 +1,110 @@
+#include "rsl/layout.hpp"
+#include "rsl/parser.hpp"
+#include "rsl/tokenizer.hpp"
+#include "rsl/utils.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    const char* SOURCE = R"(
+struct Light {
+    float3 direction;
+    float intensity;
+    float2 extent;
+};
+
+struct Params {
+    float a;
+    float3 b;
+    float c[3];
+    float3 d[2];
+    mat3 e;
+    Light light;
+    float f;
+};
+)";
+
+    rsl::BlockLayout layoutParams(rsl::ELayoutRule rule)
+    {
+        auto tokens = rsl::tokenize("<test>", SOURCE);
+        auto ast = rsl::parse(tokens);
+        rsl::resolveReferences(ast);
+
+        rsl::StructLookup structs{};
+        for (auto& statement : ast->statements)
+        {
+            auto asStruct = std::dynamic_pointer_cast<rsl::StructNode>(statement);
+            if (asStruct) structs[asStruct->name] = asStruct;
+        }
+        return rsl::layoutOf("Params", structs.at("Params")->declarations, rule, structs);
+    }
+
+    struct Expected
+    {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t arrayStride;
+        uint32_t matrixStride;
+    };
+
+    void checkMembers(const rsl::BlockLayout& layout, const std::vector<Expected>& expected)
+    {
+        RSL_CHECK_EQ(layout.members.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            const auto& member = layout.members[i];
+            RSL_CHECK_EQ(member.offset, expected[i].offset);
+            RSL_CHECK_EQ(member.size, expected[i].size);
+            RSL_CHECK_EQ(member.arrayStride, expected[i].arrayStride);
+            RSL_CHECK_EQ(member.matrixStride, expected[i].matrixStride);
+        }
+    }
+}
+
+RSL_TEST(layoutStd140)
+{
+    const auto layout = layoutParams(rsl::ELayoutRule::Std140);
+    checkMembers(layout, {
+                     {0, 4, 0, 0},
+                     {16, 12, 0, 0},
+                     {32, 48, 16, 0},
+                     {80, 32, 16, 0},
+                     {112, 48, 0, 16},
+                     {160, 32, 0, 0},
+                     {192, 4, 0, 0},
+                 });
+    RSL_CHECK_EQ(layout.size, uint32_t{208});
+    RSL_CHECK_EQ(layout.alignment, uint32_t{16});
+}
+
+RSL_TEST(layoutStd430)
+{
+    const auto layout = layoutParams(rsl::ELayoutRule::Std430);
+    checkMembers(layout, {
+                     {0, 4, 0, 0},
+                     {16, 12, 0, 0},
+                     {28, 12, 4, 0},
+                     {48, 32, 16, 0},
+                     {80, 48, 0, 16},
+                     {128, 32, 0, 0},
+                     {160, 4, 0, 0},
+                 });
+    RSL_CHECK_EQ(layout.size, uint32_t{176});
+}
+
+RSL_TEST(layoutScalar)
+{
+    const auto layout = layoutParams(rsl::ELayoutRule::Scalar);
+    checkMembers(layout, {
+                     {0, 4, 0, 0},
+                     {4, 12, 0, 0},
+                     {16, 12, 4, 0},
+                     {28, 24, 12, 0},
+                     {52, 36, 0, 12},
+                     {88, 24, 0, 0},
+                     {112, 4, 0, 0},
+                 });
+    RSL_CHECK_EQ(layout.size, uint32_t{116});
+    RSL_CHECK_EQ(layout.alignment, uint32_t{4});
+}
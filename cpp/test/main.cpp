@@ -1,164 +1,63 @@
+#include <chrono>
 #include <iostream>
+#include <string_view>
 
-#include "rsl/glsl.hpp"
-#include "rsl/parser.hpp"
-#include "rsl/tokenizer.hpp"
-#include "rsl/utils.hpp"
+#include "test.hpp"
 
-int main() {
-//     auto tokens = rsl::tokenize("<test>",R"(
-// struct QuadRenderInfo
-// {
-//     int textureId;
-//     int samplerId;
-//     float4 color;
-//     float4 borderRadius;
-//     float2 size;
-//     mat3 transform;
-// };
-//
-//
-// layout(set = 1,binding = 0, scalar) uniform batch_info {
-//     float time;
-//     float4 viewport;
-//     mat4 projection;
-//     QuadRenderInfo quads[1024];
-// };
-//
-// @Vertex{
-//
-//     layout(location = 0) out float2 oUV;
-//     layout(location = 1) out int oQuadIndex;
-//
-//     void main(){
-//         int index = gl_VertexIndex;
-//         int vertexIndex = mod(index,6);
-//         int quadIndex = floor(x/y);
-//
-//         QuadRenderInfo renderInfo = batch_info.quads[quadIndex];
-//
-//         float4 extent = float4(0.0, 0.0, renderInfo.size);
-//         float2 tl;
-//         float2 tr;
-//         float2 bl;
-//         float2 br;
-//
-//         extentToPoints(extent, tl, tr, bl, br);
-//
-//         float2 vertex[] = { tl, tr, br, tl, br, bl };
-//
-//         float2 finalVert = doProjectionAndTransformation(vertex[vertexIndex], batch_info.projection, renderInfo.transform);
-//
-//         gl_Position = float4(finalVert, 0, 1);
-//
-//         float2 uvs[] = { float2(0.0), float2(1.0, 0.0), float2(1.0), float2(0.0), float2(1.0), float2(1.0, 0.0) };
-//
-//         oUV = vertex[vertexIndex] / size;
-//
-//         oQuadIndex = quadIndex;
-//     }
-//
-//     
-// }
-//
-//
-// @Fragment{
-//     layout (location = 0) in float2 iUV;
-//     layout (location = 1,$flat) in int iQuadIndex;
-//     layout (location = 0) out float4 oColor;
-//
-//     void main(){
-//         oColor = batch_info.quads[iQuadIndex];
-//     }
-//
-//     int foo(float[20] x) -> true ? 1 : 20;
-// })");
-    auto tokens = rsl::tokenize("<test>",R"(
-
-struct QuadRenderInfo
+namespace rsl::test
 {
-    // [TextureId,RenderMode,0,0]
-    int4 opts;
-    float4 color;
-    float4 borderRadius;
-    float2 size;
-    mat3 transform;
-    float4 uv;
-};
-
-
-layout(set = 1,binding = 0, scalar) uniform batch_info {
-    QuadRenderInfo quads[64];
-};
-
-push(scalar){
-    float4 viewport;
-    mat4 projection;
-};
-
-@Vertex{
-
-    layout(location = 0) out float2 oUV;
-    layout(location = 1) out int oQuadIndex;
-
-    void main(){
-        int index = gl_VertexIndex;
-        int vertexIndex = int(mod(index, 6));
-        int quadIndex = int(floor(index / 6));
-        QuadRenderInfo quad = batch_info.quads[quadIndex];
-        generateRectVertex(quad.size, push.projection, quad.transform, vertexIndex, gl_Position, oUV);
-        oQuadIndex = quadIndex;
+    std::vector<TestCase>& registry()
+    {
+        static std::vector<TestCase> tests{};
+        return tests;
     }
-}
-
 
-@Fragment{
-    layout (location = 0) in float2 iUV;
-    layout (location = 1,$flat) in int iQuadIndex;
-    layout (location = 0) out float4 oColor;
-
-    float median(float r, float g, float b) {
-        return max(min(r, g), min(max(r, g), b));
+    Registrar::Registrar(const char* name, void (*fn)())
+    {
+        registry().push_back({name, fn});
     }
 
-    float screenPxRange(float2 uv,float2 size) {
-        float2 unitRange = float2(30.0)/size;
-        float2 screenTexSize = float2(1.0)/fwidth(uv);
-        return max(0.5*dot(unitRange, screenTexSize), 1.0);
+    void fail(const std::string& message, const char* file, int line)
+    {
+        throw Failure(std::string(file) + ":" + std::to_string(line) + ": " + message);
     }
 
-    void main(){
-        QuadRenderInfo quad = batch_info.quads[iQuadIndex];
-        float4 pxColor = quad.color;
-        int textureId = quad.opts.x;
-        int mode = quad.opts.y;
-
-        if(textureId != -1){
-            float4 uvMapping = quad.uv;
-            float u = mapRangeUnClamped(iUV.x,0.0,1.0,uvMapping.x,uvMapping.z);
-            float v = mapRangeUnClamped(iUV.y,0.0,1.0,uvMapping.y,uvMapping.w);
-            float2 uv = float2(u,v);
+    std::string dataPath(const std::string& name)
+    {
+        return std::string(RSL_TEST_DATA_DIR) + "/" + name;
+    }
+}
 
-            if(mode == 0){
-                pxColor = pxColor * sampleTexture(textureId,uv);
-            } else if(mode == 1){
-                float2 texSize = getTextureSize(textureId);
-                float2 actualTexSize = texSize * (uvMapping.zw - uvMapping.xy);
-                float3 msd = sampleTexture(textureId,uv).rgb;
-                float sd = median(msd.r,msd.g,msd.b);
-                float distance = screenPxRange(uv,actualTexSize)*(sd - 0.5);
-                float opacity = clamp(distance + 0.5, 0.0, 1.0);
-                oColor = mix(float4(pxColor.rgb,0.0),pxColor,opacity);
-                return;
-            }
+// Runs every registered test, or only those whose name contains one of the arguments
+int main(int argc, char** argv)
+{
+    size_t run = 0;
+    size_t failed = 0;
+    for (auto& test : rsl::test::registry())
+    {
+        if (argc > 1)
+        {
+            auto selected = false;
+            for (auto i = 1; i < argc; i++) selected |= test.name.find(argv[i]) != std::string::npos;
+            if (!selected) continue;
         }
 
-        oColor = applyBorderRadius(gl_FragCoord.xy, pxColor, quad.borderRadius, quad.size, quad.transform);
+        run++;
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            test.fn();
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+            std::cout << "[ ok ] " << test.name << " (" << elapsed.count() << " ms)\n";
+        }
+        catch (const std::exception& e)
+        {
+            failed++;
+            std::cout << "[FAIL] " << test.name << "\n    " << e.what() << '\n';
+        }
     }
-})");
-    auto ast = rsl::parse(tokens);
-    //rsl::resolveIncludes(ast);
-    rsl::resolveReferences(ast);
-    auto str = rsl::glsl::generate(rsl::extractScope(ast,rsl::EScopeType::Fragment));
-    std::cout  << str << std::endl;
+
+    std::cout << run - failed << " of " << run << " tests passed\n";
+    return failed == 0 && run > 0 ? 0 : 1;
 }
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <map>
+#include <regex>
+
+#include "rsl/Compiler.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    struct Varying
+    {
+        std::string qualifiers{};
+        std::string type{};
+    };
+
+    rsl::CompileResult compileOptimized(const std::string& source, rsl::EScopeType scopeType)
+    {
+        rsl::CompilerOptions options{};
+        options.optimize = true;
+        rsl::Compiler compiler(1, options);
+        rsl::CompileJob job{};
+        job.fileName = "optimize.rsl";
+        job.source = source;
+        job.scopeType = scopeType;
+        auto result = compiler.Compile(job);
+        if (!result.success) rsl::test::fail(result.error, __FILE__, __LINE__);
+        return result;
+    }
+
+    // Varyings of a generated stage keyed by name without the i/o prefix, with their layout qualifiers sorted so
+    // both stages print them alike
+    std::map<std::string, Varying> varyings(const std::string& glsl, const std::string& direction)
+    {
+        static const std::regex declaration(R"(layout\(([^)]*)\)\s*(in|out)\s+(\w+)\s+(\w+);)");
+        std::map<std::string, Varying> result{};
+        for (std::sregex_iterator it(glsl.begin(), glsl.end(), declaration), end; it != end; ++it)
+        {
+            const auto& match = *it;
+            if (match[2] != direction) continue;
+            std::vector<std::string> parts{};
+            const auto list = match[1].str();
+            static const std::regex qualifier(R"((\w+)\s*=\s*(\d+))");
+            for (std::sregex_iterator q(list.begin(), list.end(), qualifier), qEnd; q != qEnd; ++q)
+            {
+                parts.push_back((*q)[1].str() + "=" + (*q)[2].str());
+            }
+            std::ranges::sort(parts);
+            std::string qualifiers{};
+            for (const auto& part : parts) qualifiers += part + " ";
+            result[match[4].str().substr(1)] = {qualifiers, match[3].str()};
+        }
+        return result;
+    }
+
+    // Compiles both stages on their own and checks every varying ends up in the same place on both sides
+    void checkStagesAgree(const std::string& source)
+    {
+        const auto vertex = compileOptimized(source, rsl::EScopeType::Vertex).output;
+        const auto fragment = compileOptimized(source, rsl::EScopeType::Fragment).output;
+        auto outputs = varyings(vertex, "out");
+        const auto inputs = varyings(fragment, "in");
+        for (const auto& [name, input] : inputs)
+        {
+            auto output = outputs.find(name);
+            RSL_CHECK(output != outputs.end());
+            RSL_CHECK_EQ(output->second.qualifiers, input.qualifiers);
+            RSL_CHECK_EQ(output->second.type, input.type);
+            outputs.erase(output);
+        }
+        // Anything left over is an output the fragment stage has no input for
+        RSL_CHECK(outputs.empty());
+    }
+}
+
+RSL_TEST(optimizedStagesAgreeAfterUnrolling)
+{
+    // The loop never runs, so the fragment stage stops reading iB only once it is unrolled
+    checkStagesAgree(R"(
+@Vertex {
+    layout(location = 0) out float oA;
+    layout(location = 1) out float3 oB;
+    layout(location = 2) out float2 oC;
+    void main() { oA = 1.0; oB = float3(2.0); oC = float2(3.0); gl_Position = float4(0.0); }
+}
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 1) in float3 iB;
+    layout(location = 2) in float2 iC;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float x = iA;
+        for (int k = 0; k < 0; k++) { x = x + iB.x; }
+        oColor = float4(x, iC, 1.0);
+    }
+}
+)");
+}
+
+RSL_TEST(optimizedStagesAgreeAfterSimplifying)
+{
+    // mix with a weight of 0.0 is simplified to its first operand, so the fragment stage stops reading iB
+    checkStagesAgree(R"(
+@Vertex {
+    layout(location = 0) out float oA;
+    layout(location = 1) out float3 oB;
+    layout(location = 2) out float2 oC;
+    void main() { oA = 1.0; oB = float3(2.0); oC = float2(3.0); gl_Position = float4(0.0); }
+}
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 1) in float3 iB;
+    layout(location = 2) in float2 iC;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float3 c = mix(float3(iA), iB, 0.0);
+        oColor = float4(c, iC.y);
+    }
+}
+)");
+}
@@ -0,0 +1,498 @@
+#include "rsl/glsl.hpp"
+#include "rsl/parser.hpp"
+#include "rsl/passes.hpp"
+#include "rsl/tokenizer.hpp"
+#include "rsl/utils.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    // A stage of source with its own copy of the nodes, ready for passes to rewrite
+    std::shared_ptr<rsl::ModuleNode> stage(const std::string& source,
+                                           rsl::EScopeType scopeType = rsl::EScopeType::Fragment)
+    {
+        auto tokens = rsl::tokenize("<test>", source);
+        auto ast = rsl::parse(tokens);
+        rsl::resolveReferences(ast);
+        return rsl::clone(rsl::extractScope(ast, scopeType));
+    }
+
+    bool contains(const std::string& text, const std::string& part)
+    {
+        return text.find(part) != std::string::npos;
+    }
+}
+
+RSL_TEST(unrollLoopsRepeatsConstantTripCounts)
+{
+    auto module = stage(R"(
+@Fragment {
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float sum = 0.0;
+        for (int i = 0; i < 3; i++) { sum = sum + float(i); }
+        oColor = float4(sum);
+    }
+}
+)");
+    rsl::unrollLoops(module);
+    rsl::foldConstants(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(!contains(glsl, "for("));
+    RSL_CHECK(contains(glsl, "sum = sum + 0.0;\n\tsum = sum + 1.0;\n\tsum = sum + 2.0;"));
+
+    // Past the limit the body is repeated within the loop, or left alone when partial unrolling is off
+    const auto longLoop = R"(
+@Fragment {
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float sum = 0.0;
+        for (int i = 0; i < 40; i++) { sum = sum + float(i); }
+        oColor = float4(sum);
+    }
+}
+)";
+    auto partial = stage(longLoop);
+    rsl::unrollLoops(partial);
+    const auto partialGlsl = rsl::glsl::generate(partial);
+    RSL_CHECK(contains(partialGlsl, "i = i + 4"));
+    RSL_CHECK(contains(partialGlsl, "( i + 3 )"));
+
+    auto limited = stage(longLoop);
+    rsl::UnrollOptions options{};
+    options.partialFactor = 1;
+    rsl::unrollLoops(limited, options);
+    RSL_CHECK(contains(rsl::glsl::generate(limited), "i++"));
+}
+
+RSL_TEST(simplifyExpressionsDropsIdentities)
+{
+    auto module = stage(R"(
+@Fragment {
+    layout(location = 0) in float3 iA;
+    layout(location = 1) in float3 iB;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float3 c = mix(iA, iB, 0.0) * 1.0;
+        float d = iB.x / 4.0;
+        float e = pow(iA.y, 2.0);
+        oColor = float4(c, d + e);
+    }
+}
+)");
+    rsl::simplifyExpressions(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(contains(glsl, "vec3 c = iA;"));
+    RSL_CHECK(contains(glsl, "float d = iB.x * 0.25;"));
+    RSL_CHECK(contains(glsl, "float e = iA.y * iA.y;"));
+}
+
+RSL_TEST(simplifyExpressionsDropsSelfAssignments)
+{
+    auto module = stage(R"(
+@Fragment {
+    layout(location = 0) in float3 iA;
+    layout(location = 1) in float3 iB;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float s = iA.x;
+        s = s + 0.0;
+        float3 v = iB;
+        if (iA.y > 0.5) {
+            v.y = (v.y - 0.0) * 1.0;
+        }
+        s = s + 1.0;
+        oColor = float4(v, s);
+    }
+}
+)");
+    rsl::simplifyExpressions(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(!contains(glsl, "s = s;"));
+    RSL_CHECK(!contains(glsl, "v.y = v.y;"));
+    RSL_CHECK(contains(glsl, "float s = iA.x;\n\tvec3 v = iB;"));
+    RSL_CHECK(contains(glsl, "s = s + 1.0;"));
+}
+
+RSL_TEST(foldConstantsEvaluatesConstantExpressions)
+{
+    auto module = stage(R"(
+#define SCALE 2;
+const float HALF = 0.5;
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float a = HALF * float(SCALE) + 1.0;
+        int b = (3 + 4) * 2;
+        float d = max(2.0, 3.0);
+        if (SCALE > 1) { a = a + iA; } else { a = 0.0; }
+        oColor = float4(a, float(b), (2 < 3 && false) ? 1.0 : d, 1.0);
+    }
+}
+)");
+    rsl::foldConstants(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(contains(glsl, "float a = 2.0;"));
+    RSL_CHECK(contains(glsl, "int b = 14;"));
+    RSL_CHECK(contains(glsl, "float d = 3.0;"));
+    // The if is replaced by the branch taken and the conditional by its false operand
+    RSL_CHECK(contains(glsl, "\ta = a + iA;\n"));
+    RSL_CHECK(!contains(glsl, "if"));
+    RSL_CHECK(contains(glsl, "oColor = vec4( a , float( b ) , d , 1.0 );"));
+}
+
+RSL_TEST(removeUnusedDeclarationsKeepsWhatMainReaches)
+{
+    auto module = stage(R"(
+#define UNUSED_DEFINE 3;
+const float UNUSED_CONST = 1.0;
+const float USED_CONST = 2.0;
+struct Unused { float a; };
+layout(set = 0, binding = 0) uniform UnusedBlock { float4 value; };
+layout(set = 0, binding = 1) uniform UsedBlock { float4 tint; };
+float unusedHelper(float a) { return a * 3.0; }
+float leaf(float a) { return a * USED_CONST; }
+float usedHelper(float a) { return leaf(a) + 1.0; }
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 1) in float iUnread;
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = UsedBlock.tint * usedHelper(iA); }
+}
+)");
+    rsl::removeUnusedDeclarations(module);
+    const auto glsl = rsl::glsl::generate(module);
+    for (const auto& removed : {"UNUSED_DEFINE", "UNUSED_CONST", "Unused ", "UnusedBlock", "unusedHelper"})
+    {
+        RSL_CHECK(!contains(glsl, removed));
+    }
+    for (const auto& kept : {"USED_CONST = 2.0", "UsedBlock;", "float leaf(", "float usedHelper(", "in float iUnread;"})
+    {
+        RSL_CHECK(contains(glsl, kept));
+    }
+}
+
+RSL_TEST(linkStagesDropsUnconsumedVaryings)
+{
+    const auto source = R"(
+@Vertex {
+    layout(location = 0) in float3 iPosition;
+    layout(location = 1) in float3 iNormal;
+    layout(location = 0) out float oA;
+    layout(location = 1) out float3 oB;
+    layout(location = 2) out float oC;
+    void main() {
+        oA = iPosition.x;
+        oB = normalize(iNormal);
+        oC = iPosition.y;
+        gl_Position = float4(iPosition, 1.0);
+    }
+}
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 2) in float iC;
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(iA); }
+}
+)";
+    auto vertex = stage(source, rsl::EScopeType::Vertex);
+    auto fragment = stage(source, rsl::EScopeType::Fragment);
+    rsl::linkStages(vertex, fragment);
+    const auto vertexGlsl = rsl::glsl::generate(vertex);
+    const auto fragmentGlsl = rsl::glsl::generate(fragment);
+    RSL_CHECK(contains(vertexGlsl, "layout(location = 0) out float oA;"));
+    RSL_CHECK(!contains(vertexGlsl, "oB"));
+    RSL_CHECK(!contains(vertexGlsl, "oC"));
+    RSL_CHECK(!contains(vertexGlsl, "normalize"));
+    RSL_CHECK(contains(vertexGlsl, "gl_Position = vec4( iPosition , 1.0 );"));
+
+    RSL_CHECK(contains(fragmentGlsl, "layout(location = 0) in float iA;"));
+    RSL_CHECK(!contains(fragmentGlsl, "iC"));
+}
+
+RSL_TEST(packVaryingsSharesLocations)
+{
+    const auto source = R"(
+@Vertex {
+    layout(location = 0) out float oA;
+    layout(location = 1) out float3 oB;
+    layout(location = 2) out float2 oC;
+    layout(location = 3) out float2 oD;
+    layout(location = 4) out int oIndex;
+    layout(location = 5) out mat3 oBasis;
+    void main() {
+        oA = 1.0; oB = float3(2.0); oC = float2(3.0); oD = float2(4.0); oIndex = gl_VertexIndex;
+        oBasis = mat3(1.0);
+        gl_Position = float4(0.0);
+    }
+}
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 1) in float3 iB;
+    layout(location = 2) in float2 iC;
+    layout(location = 3) in float2 iD;
+    layout(location = 4) in int iIndex;
+    layout(location = 5) in mat3 iBasis;
+    layout(location = 0) out float4 oColor;
+    void main() { oColor = float4(iB * iBasis, iA + iC.x + iD.y + float(iIndex)); }
+}
+)";
+    auto vertex = stage(source, rsl::EScopeType::Vertex);
+    auto fragment = stage(source, rsl::EScopeType::Fragment);
+    rsl::packVaryings(vertex, fragment);
+    const auto vertexGlsl = rsl::glsl::generate(vertex);
+    const auto fragmentGlsl = rsl::glsl::generate(fragment);
+
+    // The matrix takes locations 0 to 2 first, then vectors share locations with scalars of the same base type
+    for (const auto& declaration : {
+             "layout(location = 0) out mat3 oBasis;",
+             "layout(location = 3) out vec3 oB;",
+             "layout(component = 3 , location = 3) out float oA;",
+             "layout(location = 4) out vec2 oC;",
+             "layout(component = 2 , location = 4) out vec2 oD;",
+             "layout(location = 5) flat out int oIndex;",
+         })
+    {
+        RSL_CHECK(contains(vertexGlsl, declaration));
+    }
+    for (const auto& declaration : {
+             "layout(location = 0) in mat3 iBasis;",
+             "layout(location = 3) in vec3 iB;",
+             "layout(component = 3 , location = 3) in float iA;",
+             "layout(location = 4) in vec2 iC;",
+             "layout(component = 2 , location = 4) in vec2 iD;",
+             "layout(location = 5) flat in int iIndex;",
+         })
+    {
+        RSL_CHECK(contains(fragmentGlsl, declaration));
+    }
+}
+
+RSL_TEST(inlineFunctionsReplacesCalls)
+{
+    const auto source = R"(
+float square(float a) { return a * a; }
+void split(float a, out float low, out float high) {
+    float half = a * 0.5;
+    low = half - 1.0;
+    high = half + 1.0;
+}
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float low;
+        float high;
+        split(iA, low, high);
+        oColor = float4(square(iA), square(low), high, 1.0);
+    }
+}
+)";
+    auto module = stage(source);
+    rsl::inlineFunctions(module);
+    const auto glsl = rsl::glsl::generate(module);
+    // Out arguments are written directly when the caller passes plain locals, and callee locals are renamed
+    RSL_CHECK(contains(glsl, "\tfloat split_half = iA * 0.5;\n\tlow = split_half - 1.0;\n\thigh = split_half + 1.0;"));
+    RSL_CHECK(contains(glsl, "oColor = vec4( ( iA * iA ) , ( low * low ) , high , 1.0 );"));
+
+    auto kept = stage(source);
+    rsl::InlineOptions options{};
+    options.never.insert("square");
+    rsl::inlineFunctions(kept, options);
+    RSL_CHECK(contains(rsl::glsl::generate(kept), "oColor = vec4( square( iA ) , square( low ) , high , 1.0 );"));
+}
+
+RSL_TEST(eliminateCommonSubexpressionsReusesValues)
+{
+    auto module = stage(R"(
+@Fragment {
+    layout(location = 0) in float2 iA;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float x = length(iA * 2.0) + 1.0;
+        float y = length(iA * 2.0) * 3.0;
+        float2 b = iA;
+        b.x = 0.0;
+        float z = length(b * 2.0) + length(b * 2.0);
+        float p = b.y * 4.0;
+        b.y = 1.0;
+        float q = b.y * 4.0;
+        oColor = float4(x, y, z, p + q);
+    }
+}
+)");
+    rsl::eliminateCommonSubexpressions(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(contains(glsl, "\tfloat cse = length( iA * 2.0 );\n\tfloat x = cse + 1.0;\n\tfloat y = cse * 3.0;"));
+    RSL_CHECK(contains(glsl, "\tfloat cse1 = length( b * 2.0 );\n\tfloat z = cse1 + cse1;"));
+    // b.y is written between the two products, so the second is computed again
+    RSL_CHECK(contains(glsl, "\tfloat p = b.y * 4.0;\n\tb.y = 1.0;\n\tfloat q = b.y * 4.0;"));
+}
+
+RSL_TEST(removeDeadStoresDropsUnreadLocals)
+{
+    auto module = stage(R"(
+float sideEffect(out float a) { a = 1.0; return a; }
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float unread = iA * 2.0;
+        float feedsUnread = iA + 1.0;
+        float alsoUnread = feedsUnread * 3.0;
+        float written;
+        float kept = sideEffect(written);
+        float used = iA * 4.0;
+        oColor = float4(used);
+    }
+}
+)");
+    rsl::removeDeadStores(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(!contains(glsl, "unread"));
+    RSL_CHECK(!contains(glsl, "Unread"));
+    // Calls into the module may have other effects, so their stores are kept
+    RSL_CHECK(contains(glsl, "float kept = sideEffect( written );"));
+    RSL_CHECK(contains(glsl, "float used = iA * 4.0;"));
+}
+
+RSL_TEST(reorderMembersMinimizesPadding)
+{
+    auto module = stage(R"(
+struct Light
+{
+    float intensity;
+    float4 color;
+    float range;
+    float3 direction;
+};
+
+layout(set = 0, binding = 0) uniform Lights {
+    float count;
+    mat4 view;
+    float exposure;
+    float4 ambient;
+};
+
+layout(set = 0, binding = 1) uniform Ordered {
+    float4 tint;
+    float scale;
+};
+
+@Fragment {
+    layout(location = 0) out float4 oColor;
+    void main() {
+        Light light = Light(1.0, float4(2.0), 3.0, float3(4.0));
+        oColor = light.color * light.intensity * light.range * Lights.exposure * Lights.count + Lights.ambient +
+            Ordered.tint * Ordered.scale;
+    }
+}
+)");
+    const auto reorders = rsl::reorderMembers(module);
+    const auto glsl = rsl::glsl::generate(module);
+    // Largest alignment first, and the constructor takes its arguments in the new order
+    RSL_CHECK(contains(glsl,
+                       "struct Light {\n\tvec4 color;\n\tvec3 direction;\n\tfloat intensity;\n\tfloat range;\n};"));
+    RSL_CHECK(contains(glsl, "Light light = Light( vec4( 2.0 ) , vec3( 4.0 ) , 1.0 , 3.0 );"));
+    RSL_CHECK(contains(glsl, "{\n\tmat4 view;\n\tvec4 ambient;\n\tfloat count;\n\tfloat exposure;\n} Lights;"));
+    RSL_CHECK(contains(glsl, "{\n\tvec4 tint;\n\tfloat scale;\n} Ordered;"));
+
+    RSL_CHECK_EQ(reorders.size(), size_t{2});
+    for (const auto& reorder : reorders)
+    {
+        RSL_CHECK(reorder.rule == rsl::ELayoutRule::Std140);
+        if (reorder.name == "Lights")
+        {
+            // count and exposure each padded to 16 bytes before, packed after the vec4 once reordered
+            RSL_CHECK_EQ(reorder.sizeBefore, uint32_t{112});
+            RSL_CHECK_EQ(reorder.sizeAfter, uint32_t{96});
+        }
+        else
+        {
+            RSL_CHECK_EQ(reorder.name, std::string("Ordered"));
+            RSL_CHECK_EQ(reorder.sizeBefore, uint32_t{32});
+            RSL_CHECK_EQ(reorder.sizeAfter, uint32_t{32});
+        }
+    }
+}
+
+RSL_TEST(shortenIdentifiersKeepsInterfacesAndAvoidsKeywords)
+{
+    // Enough locals for the generated names to reach the two letter keywords
+    std::string locals{};
+    for (auto i = 1; i < 800; i++)
+    {
+        locals += "        float value" + std::to_string(i) + " = value" + std::to_string(i - 1) + " * 2.0;\n";
+    }
+
+    auto module = stage(R"(
+#define SCALE b;
+layout(set = 0, binding = 0) uniform Params {
+    float a;
+};
+float helper(float x, float c) {
+    return x * c;
+}
+@Fragment {
+    layout(location = 0) in float iValue;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float b = 1.0;
+        float value0 = helper(iValue, Params.a) * SCALE;
+)" + locals + R"(
+        oColor = float4(value799);
+    }
+}
+)");
+    rsl::shortenIdentifiers(module);
+    const auto glsl = rsl::glsl::generate(module);
+
+    // Blocks, their members, interface variables, defines and what a define refers to keep their names
+    for (const auto& kept : {"#define SCALE b", "float a;\n} Params;", "in float iValue;", "out vec4 oColor;",
+                             "float b = 1.0;", "Params.a"})
+    {
+        if (!contains(glsl, kept)) rsl::test::fail(std::string("missing ") + kept, __FILE__, __LINE__);
+    }
+
+    // a, b and c already appear in the module, so the first new name is d
+    RSL_CHECK(!contains(glsl, "helper"));
+    RSL_CHECK(!contains(glsl, "value"));
+    RSL_CHECK(contains(glsl, "float d(in float e , in float f)"));
+    RSL_CHECK(contains(glsl, "float e = d( iValue , Params.a ) * SCALE;"));
+
+    // if comes between hf and jf
+    RSL_CHECK(contains(glsl, "float hf = gf * 2.0;\n\tfloat jf = hf * 2.0;"));
+    for (const auto& keyword : {"float do ", "float if ", "float in "})
+    {
+        if (contains(glsl, keyword)) rsl::test::fail(std::string("declared ") + keyword, __FILE__, __LINE__);
+    }
+}
+
+RSL_TEST(removeRedundantParenthesesKeepsPrecedence)
+{
+    auto module = stage(R"(
+#define HALF (1.0 / 2.0);
+@Fragment {
+    layout(location = 0) in float iA;
+    layout(location = 1) in float iB;
+    layout(location = 2) in float iC;
+    layout(location = 0) out float4 oColor;
+    void main() {
+        float kept = iA - (iB - iC) + iA / (iB * iC) + -(iA + iB) + (iA + iB) * iC + iA - (iB + iC);
+        float negated = -(-iA) + -(--iB) + -(-2.0);
+        float dropped = (iA - iB) - iC + (iA * iB) / iC + iA + (iB * iC) + (iA) + -(iB) * HALF;
+        oColor = float4(kept, dropped, negated, 1.0);
+    }
+}
+)");
+    rsl::removeRedundantParentheses(module);
+    const auto glsl = rsl::glsl::generate(module);
+    RSL_CHECK(contains(glsl, "float kept = iA - ( iB - iC ) + iA / ( iB * iC ) + -( iA + iB ) + ( iA + iB ) * iC + "
+                             "iA - ( iB + iC );"));
+    RSL_CHECK(contains(glsl, "float dropped = iA - iB - iC + iA * iB / iC + iA + iB * iC + iA + -iB * HALF;"));
+    // A minus right after a unary minus would read as a decrement
+    RSL_CHECK(contains(glsl, "float negated = -( -iA ) + -( --iB ) + -( -2.0 );"));
+    RSL_CHECK(contains(glsl, "#define HALF ( 1.0 / 2.0 )"));
+}
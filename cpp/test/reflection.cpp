@@ -0,0 +1,84 @@
+#include "rsl/Compiler.hpp"
+#include "rsl/reflection.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    std::string vertexBlob()
+    {
+        rsl::CompilerOptions options{};
+        options.reflect = true;
+        rsl::Compiler compiler(1, options);
+        const auto result = compiler.Compile({"reflection.rsl", R"(
+layout(set = 1, binding = 2) uniform Camera {
+    mat4 projection;
+    float3 position;
+};
+
+@Vertex {
+    layout(location = 0) in float3 iPosition;
+    layout(location = 0) out float3 oNormal;
+    layout(location = 1) out int oIndex;
+    void main() {
+        oNormal = iPosition - Camera.position;
+        oIndex = gl_VertexIndex;
+        gl_Position = Camera.projection * float4(iPosition, 1.0);
+    }
+}
+)", rsl::EScopeType::Vertex, {}});
+        if (!result.success) rsl::test::fail(result.error, __FILE__, __LINE__);
+        return rsl::writeReflection(result.reflection, rsl::EScopeType::Vertex);
+    }
+}
+
+RSL_TEST(reflectionReaderReadsWrittenBlob)
+{
+    const auto blob = vertexBlob();
+    const rsl::ReflectionReader reader{blob};
+    RSL_CHECK(reader.IsValid());
+    RSL_CHECK(reader.GetStage() == rsl::EScopeType::Vertex);
+
+    const auto index = reader.FindResource("Camera");
+    RSL_CHECK(index >= 0);
+    RSL_CHECK_EQ(reader.FindResource("Missing"), -1);
+    const auto camera = reader.GetResource(static_cast<uint32_t>(index));
+    RSL_CHECK(camera.type == rsl::EResourceType::UniformBlock);
+    RSL_CHECK_EQ(camera.set, 1);
+    RSL_CHECK_EQ(camera.binding, 2);
+    RSL_CHECK_EQ(camera.memberCount, uint32_t{2});
+
+    const auto position = reader.GetMember(camera.firstMember + 1);
+    RSL_CHECK_EQ(position.name, std::string_view("position"));
+    RSL_CHECK_EQ(position.offset, uint32_t{64});
+
+    RSL_CHECK_EQ(reader.GetInputCount(), uint32_t{1});
+    RSL_CHECK_EQ(reader.GetInput(0).name, std::string_view("iPosition"));
+    RSL_CHECK_EQ(reader.GetOutputCount(), uint32_t{2});
+    RSL_CHECK_EQ(reader.GetOutput(1).location, 1);
+    RSL_CHECK_EQ(reader.GetOutput(1).typeName, std::string_view("int"));
+}
+
+RSL_TEST(reflectionReaderRejectsDamagedBlobs)
+{
+    const auto blob = vertexBlob();
+    // Every truncation, down to nothing at all, reads as an empty fragment stage
+    for (size_t size = 0; size < blob.size(); size++)
+    {
+        const rsl::ReflectionReader reader{std::string_view(blob).substr(0, size)};
+        RSL_CHECK(!reader.IsValid());
+        RSL_CHECK(reader.GetStage() == rsl::EScopeType::Fragment);
+        RSL_CHECK_EQ(reader.GetResourceCount(), uint32_t{0});
+        RSL_CHECK_EQ(reader.GetMemberCount(), uint32_t{0});
+        RSL_CHECK_EQ(reader.GetInputCount(), uint32_t{0});
+        RSL_CHECK_EQ(reader.GetOutputCount(), uint32_t{0});
+        RSL_CHECK_EQ(reader.FindResource("Camera"), -1);
+    }
+
+    auto badVersion = blob;
+    badVersion[4] = static_cast<char>(rsl::REFLECTION_VERSION + 1);
+    RSL_CHECK(!rsl::ReflectionReader(badVersion).IsValid());
+
+    const rsl::ReflectionReader empty{nullptr, 0};
+    RSL_CHECK(!empty.IsValid());
+}
@@ -0,0 +1,135 @@
+#ifndef _WIN32
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "server.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    const char* SHADER = R"(
+@Vertex {
+    void main() {
+        gl_Position = float4(0.0, 0.0, 0.0, VALUE);
+    }
+}
+)";
+
+    // Runs serveConnection on one end of a socket pair, sends request from the other end and returns everything the
+    // server wrote until it closed the connection
+    std::string serve(const std::string& request, const std::unordered_map<std::string, std::string>& defines = {})
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::runtime_error("socketpair failed");
+
+        rsl::Compiler compiler{1};
+        std::thread server([&]
+        {
+            serveConnection(fds[1], compiler, defines);
+            close(fds[1]);
+        });
+
+        [[maybe_unused]] const auto written = write(fds[0], request.data(), request.size());
+        shutdown(fds[0], SHUT_WR);
+
+        std::string response{};
+        char chunk[4096];
+        for (auto count = read(fds[0], chunk, sizeof(chunk)); count > 0; count = read(fds[0], chunk, sizeof(chunk)))
+        {
+            response.append(chunk, static_cast<size_t>(count));
+        }
+        server.join();
+        close(fds[0]);
+        return response;
+    }
+
+    std::string sourceRequest(const std::string& headers, const std::string& source)
+    {
+        return headers + "source " + std::to_string(source.size()) + "\n\n" + source;
+    }
+
+    bool contains(const std::string& text, const std::string& part)
+    {
+        return text.find(part) != std::string::npos;
+    }
+
+    // Splits a response stream into its status lines and bodies
+    std::vector<std::pair<std::string, std::string>> responses(const std::string& stream)
+    {
+        std::vector<std::pair<std::string, std::string>> result{};
+        size_t offset = 0;
+        while (offset < stream.size())
+        {
+            const auto end = stream.find('\n', offset);
+            if (end == std::string::npos) throw std::runtime_error("Truncated status line");
+            const auto status = stream.substr(offset, end - offset);
+            const auto size = std::stoull(status.substr(status.find(' ') + 1));
+            result.emplace_back(status.substr(0, status.find(' ')), stream.substr(end + 1, size));
+            offset = end + 1 + size;
+        }
+        return result;
+    }
+}
+
+RSL_TEST(serverAnswersEveryRequestOnAConnection)
+{
+    const auto request = sourceRequest("stage vertex\ndefine VALUE=1.0\n", SHADER) +
+        sourceRequest("stage vertex\nfile other.rsl\ndefine VALUE=2.0\n", SHADER);
+    const auto answers = responses(serve(request));
+    RSL_CHECK_EQ(answers.size(), size_t{2});
+    RSL_CHECK_EQ(answers[0].first, std::string("ok"));
+    RSL_CHECK(contains(answers[0].second, "#define VALUE 1.0"));
+    RSL_CHECK_EQ(answers[1].first, std::string("ok"));
+    RSL_CHECK(contains(answers[1].second, "#define VALUE 2.0"));
+}
+
+RSL_TEST(serverAppliesItsDefinesBeforeTheRequest)
+{
+    const auto fromServer = responses(serve(sourceRequest("stage vertex\n", SHADER), {{"VALUE", "3.0"}}));
+    RSL_CHECK_EQ(fromServer.size(), size_t{1});
+    RSL_CHECK(contains(fromServer[0].second, "#define VALUE 3.0"));
+
+    const auto overridden =
+        responses(serve(sourceRequest("stage vertex\ndefine VALUE=4.0\n", SHADER), {{"VALUE", "3.0"}}));
+    RSL_CHECK(contains(overridden[0].second, "#define VALUE 4.0"));
+    RSL_CHECK(!contains(overridden[0].second, "3.0"));
+}
+
+RSL_TEST(serverAnswersErrorsAndKeepsTheConnection)
+{
+    const auto request = sourceRequest("stage geometry\n", SHADER) + sourceRequest("stage vertex\ncolor red\n", SHADER) +
+        sourceRequest("stage vertex\n", "@Vertex { void main() { gl_Position = float4(; } }") +
+        sourceRequest("stage vertex\ndefine VALUE=1.0\n", SHADER);
+    const auto answers = responses(serve(request));
+    RSL_CHECK_EQ(answers.size(), size_t{4});
+    RSL_CHECK_EQ(answers[0].first, std::string("error"));
+    RSL_CHECK(contains(answers[0].second, "Unknown stage geometry"));
+    RSL_CHECK_EQ(answers[1].first, std::string("error"));
+    RSL_CHECK(contains(answers[1].second, "Unknown header color"));
+    RSL_CHECK_EQ(answers[2].first, std::string("error"));
+    RSL_CHECK_EQ(answers[3].first, std::string("ok"));
+}
+
+RSL_TEST(serverClosesOnAnInvalidSourceSize)
+{
+    for (const auto* size : {"-1", "12abc", "99999999999"})
+    {
+        // Nothing after the invalid request is answered
+        const auto request = "stage vertex\nsource " + std::string(size) + "\n\n" +
+            sourceRequest("stage vertex\ndefine VALUE=1.0\n", SHADER);
+        const auto answers = responses(serve(request));
+        RSL_CHECK_EQ(answers.size(), size_t{1});
+        RSL_CHECK_EQ(answers[0].first, std::string("error"));
+        RSL_CHECK(contains(answers[0].second, "Invalid source size " + std::string(size)));
+    }
+}
+
+RSL_TEST(serverStopsAtATruncatedSource)
+{
+    RSL_CHECK(serve("stage vertex\nsource 100\n\n@Vertex {").empty());
+}
+#endif
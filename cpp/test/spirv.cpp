@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "rsl/Compiler.hpp"
+#include "rsl/spirv.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+    std::string readBinary(const std::string& path)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) throw std::runtime_error("Failed to open " + path);
+        std::stringstream buffer{};
+        buffer << stream.rdbuf();
+        return buffer.str();
+    }
+
+    std::vector<uint32_t> toWords(const std::string& bytes)
+    {
+        std::vector<uint32_t> words(bytes.size() / sizeof(uint32_t));
+        std::memcpy(words.data(), bytes.data(), words.size() * sizeof(uint32_t));
+        return words;
+    }
+
+    // Compiles both stages of a shader in the data directory to SPIR-V, validates them and compares them word for
+    // word with <name><suffix>.vert.spv and <name><suffix>.frag.spv. Set RSL_UPDATE_GOLDEN to rewrite those instead.
+    void checkGolden(const std::string& name, bool optimize)
+    {
+        rsl::CompilerOptions options{};
+        options.target = rsl::ECompileTarget::Spirv;
+        options.optimize = optimize;
+        rsl::Compiler compiler(1, options);
+
+        const auto path = rsl::test::dataPath(name + ".rsl");
+        const auto source = readBinary(path);
+        const auto update = std::getenv("RSL_UPDATE_GOLDEN") != nullptr;
+        for (const auto& [scopeType, extension] : {
+                 std::pair{rsl::EScopeType::Vertex, ".vert.spv"},
+                 std::pair{rsl::EScopeType::Fragment, ".frag.spv"}
+             })
+        {
+            auto result = compiler.Compile({path, source, scopeType, {}});
+            if (!result.success) rsl::test::fail(result.error, __FILE__, __LINE__);
+            RSL_CHECK_EQ(result.output.size() % sizeof(uint32_t), size_t{0});
+            const auto words = toWords(result.output);
+            rsl::spirv::validate(words);
+
+            const auto goldenPath = rsl::test::dataPath(name + (optimize ? ".O" : "") + extension);
+            if (update)
+            {
+                std::ofstream(goldenPath, std::ios::binary) << result.output;
+                continue;
+            }
+            const auto golden = toWords(readBinary(goldenPath));
+            RSL_CHECK_EQ(words.size(), golden.size());
+            for (size_t i = 0; i < words.size(); i++)
+            {
+                if (words[i] != golden[i])
+                {
+                    rsl::test::fail(goldenPath + " differs at word " + std::to_string(i), __FILE__, __LINE__);
+                }
+            }
+        }
+    }
+}
+
+RSL_TEST(spirvMatchesGoldenQuad)
+{
+    checkGolden("quad", false);
+}
+
+RSL_TEST(spirvMatchesGoldenOptimizedQuad)
+{
+    checkGolden("quad", true);
+}
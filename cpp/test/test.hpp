@@ -0,0 +1,79 @@
+#pragma once
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal test registry. Every test is a function registered at static initialization by RSL_TEST and fails by
+// throwing, which the checks below do with the failing expression and its location.
+namespace rsl::test
+{
+    struct TestCase
+    {
+        std::string name{};
+        std::function<void()> fn{};
+    };
+
+    std::vector<TestCase>& registry();
+
+    struct Registrar
+    {
+        Registrar(const char* name, void (*fn)());
+    };
+
+    struct Failure : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    [[noreturn]] void fail(const std::string& message, const char* file, int line);
+
+    template <typename A, typename B>
+    void checkEqual(const A& actual, const B& expected, const char* expression, const char* file, int line)
+    {
+        if (actual == expected) return;
+
+        std::ostringstream message{};
+        message << expression;
+        if constexpr (requires(std::ostream& out) { out << actual << expected; })
+        {
+            message << "\n    actual:   " << actual << "\n    expected: " << expected;
+        }
+        fail(message.str(), file, line);
+    }
+
+    // Directory holding the data files of the tests, set by the build
+    std::string dataPath(const std::string& name);
+}
+
+#define RSL_TEST(name) \
+    static void name(); \
+    static const rsl::test::Registrar name##Registrar(#name, name); \
+    static void name()
+
+#define RSL_CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) rsl::test::fail(#expression, __FILE__, __LINE__); \
+    } \
+    while (false)
+
+#define RSL_CHECK_EQ(actual, expected) \
+    rsl::test::checkEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
+
+#define RSL_CHECK_THROWS(expression) \
+    do \
+    { \
+        auto thrown = false; \
+        try \
+        { \
+            expression; \
+        } \
+        catch (const std::exception&) \
+        { \
+            thrown = true; \
+        } \
+        if (!thrown) rsl::test::fail("expected to throw: " #expression, __FILE__, __LINE__); \
+    } \
+    while (false)